@@ -0,0 +1,65 @@
+#ifndef BENCHSOURCES_H
+#define BENCHSOURCES_H
+
+#include "Audio/AudioSource.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <utility>
+
+// Loops a table of interleaved samples forever, handing out frames which alias the table. Stages
+// writing to them in place copy them into the frame's own storage, which gets reused from frame to frame.
+class LoopSource : public AudioSource
+{
+public:
+    // table is any contiguous container of samples, std::vector<float> for instance
+    template <typename Table>
+    LoopSource(std::shared_ptr<Table> table, const SignalSpec spec, const AudioEncoding encoding,
+               const size_t frameLength)
+        : m_Samples(reinterpret_cast<const uint8_t*>(table->data()), table->size() * sizeof(*table->data())),
+          m_Table(std::move(table)), m_Spec(spec), m_Encoding(encoding), m_FrameLength(frameLength),
+          m_FrameSize(spec.m_Channels.Count() * GetEffectiveEncodingSize(encoding))
+    {
+    }
+
+    SignalSpec Spec() override { return m_Spec; }
+    AudioEncoding Encoding() override { return m_Encoding; }
+
+    std::optional<size_t> TotalSamples() override { return std::nullopt; }
+    std::optional<size_t> CurrentSample() override { return std::nullopt; }
+
+    std::optional<AudioBuffer> NextFrame() override
+    {
+        AudioBuffer frame;
+        NextFrameInto(frame);
+        return frame;
+    }
+
+    bool IsInfallible() override { return true; }
+
+protected:
+    bool DoNextFrameInto(AudioBuffer& frame) override
+    {
+        const size_t frames = m_Samples.size() / m_FrameSize;
+        const size_t count = std::min(m_FrameLength, frames - m_Offset);
+
+        frame.Alias(m_Table, m_Samples.subspan(m_Offset * m_FrameSize, count * m_FrameSize), m_Spec, m_Encoding);
+
+        m_Offset = (m_Offset + count) % frames;
+        return true;
+    }
+
+private:
+    std::span<const uint8_t> m_Samples;
+    std::shared_ptr<const void> m_Table;
+    SignalSpec m_Spec;
+    AudioEncoding m_Encoding;
+    size_t m_FrameLength;
+    size_t m_FrameSize;
+    size_t m_Offset = 0;
+};
+
+#endif //BENCHSOURCES_H
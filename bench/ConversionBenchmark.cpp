@@ -0,0 +1,313 @@
+// Times every AudioEncoding to AudioEncoding conversion through ConvertSampleVectorDynamic and
+// SourceReencoder, with working sets sized for L1, L2 and DRAM, and writes the results as JSON.
+// Before timing, every path gets checked against ConvertSampleBufferScalar, the per-sample
+// ConvertSample templates the vectorized kernels have to agree with.
+//
+// usage: ConversionBenchmark [output.json], the JSON goes to stdout without a path
+
+#include "Audio/AudioSource.h"
+#include "Audio/SampleConversions.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+constexpr std::array ALL_ENCODINGS = {
+    AudioEncoding::UInt8, AudioEncoding::UInt16, AudioEncoding::UInt24, AudioEncoding::UInt32, AudioEncoding::Int8,
+    AudioEncoding::Int16, AudioEncoding::Int24, AudioEncoding::Int32, AudioEncoding::Float32, AudioEncoding::Float64
+};
+
+struct WorkingSet
+{
+    const char* m_Name;
+    // source and destination bytes together
+    size_t m_Bytes;
+};
+
+constexpr std::array WORKING_SETS = {
+    WorkingSet { "l1", 16 * 1024 },
+    WorkingSet { "l2", 512 * 1024 },
+    WorkingSet { "dram", 64 * 1024 * 1024 },
+};
+
+// how long every measurement keeps repeating the conversion
+constexpr auto MEASURE_TIME = std::chrono::milliseconds(40);
+
+static const char* EncodingName(const AudioEncoding encoding)
+{
+    switch (encoding)
+    {
+    case AudioEncoding::UInt8: return "uint8";
+    case AudioEncoding::UInt16: return "uint16";
+    case AudioEncoding::UInt24: return "uint24";
+    case AudioEncoding::UInt32: return "uint32";
+    case AudioEncoding::Int8: return "int8";
+    case AudioEncoding::Int16: return "int16";
+    case AudioEncoding::Int24: return "int24";
+    case AudioEncoding::Int32: return "int32";
+    case AudioEncoding::Float32: return "float32";
+    case AudioEncoding::Float64: return "float64";
+    }
+
+    return "?";
+}
+
+// Random samples over the whole range of the encoding; float samples overshoot [-1, 1] a little so
+// that clipping gets exercised as well.
+static std::vector<uint8_t> MakeInput(const AudioEncoding encoding, const size_t count, std::mt19937& rng)
+{
+    const size_t size = GetEffectiveEncodingSize(encoding);
+    std::vector<uint8_t> bytes(count * size);
+
+    if (encoding == AudioEncoding::Float32 || encoding == AudioEncoding::Float64)
+    {
+        std::uniform_real_distribution<double> distribution(-1.1, 1.1);
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            const double value = distribution(rng);
+            if (encoding == AudioEncoding::Float32)
+            {
+                const auto narrow = static_cast<float>(value);
+                std::memcpy(bytes.data() + i * size, &narrow, size);
+            }
+            else
+            {
+                std::memcpy(bytes.data() + i * size, &value, size);
+            }
+        }
+
+        return bytes;
+    }
+
+    for (uint8_t& byte : bytes)
+        byte = static_cast<uint8_t>(rng());
+
+    return bytes;
+}
+
+// Hands out the same aliased buffer over and over, like a decoder handing out mapped frames.
+class RepeatSource : public AudioSource
+{
+public:
+    RepeatSource(std::shared_ptr<const std::vector<uint8_t>> samples, const AudioEncoding encoding)
+        : m_Samples(std::move(samples)), m_Encoding(encoding) {}
+
+    SignalSpec Spec() override { return { 48000, ChannelLayout(ChannelLayoutType::MONO) }; }
+    AudioEncoding Encoding() override { return m_Encoding; }
+
+    std::optional<size_t> TotalSamples() override { return std::nullopt; }
+    std::optional<size_t> CurrentSample() override { return std::nullopt; }
+
+    std::optional<AudioBuffer> NextFrame() override
+    {
+        AudioBuffer frame;
+        NextFrameInto(frame);
+        return frame;
+    }
+
+    bool IsInfallible() override { return true; }
+
+protected:
+    bool DoNextFrameInto(AudioBuffer& frame) override
+    {
+        frame = AudioBuffer(m_Samples, std::span(*m_Samples), Spec(), m_Encoding);
+        return true;
+    }
+
+private:
+    std::shared_ptr<const std::vector<uint8_t>> m_Samples;
+    AudioEncoding m_Encoding;
+};
+
+struct DifferentialResult
+{
+    size_t m_Mismatches;
+    // largest difference between the optimized and the reference path, in steps of the destination's LSB
+    double m_MaxError;
+};
+
+static double SampleAsDouble(const uint8_t* bytes, const AudioEncoding encoding)
+{
+    // Float64 keeps every encoding exact, integers as they are and floats widened
+    double value;
+    ConvertSampleBufferScalar(bytes, encoding, &value, AudioEncoding::Float64, 1);
+
+    // in steps of the encoding's LSB, for floats their epsilon
+    switch (encoding)
+    {
+    case AudioEncoding::Float32:
+        return value * 0x1p23;
+    case AudioEncoding::Float64:
+        return value * 0x1p52;
+    default:
+        return value * std::ldexp(1., static_cast<int>(GetEffectiveEncodingSize(encoding) * 8 - 1));
+    }
+}
+
+static DifferentialResult Compare(const std::vector<uint8_t>& actual, const std::vector<uint8_t>& expected,
+                                  const AudioEncoding encoding)
+{
+    DifferentialResult result {};
+    const size_t size = GetEffectiveEncodingSize(encoding);
+
+    for (size_t i = 0; i < expected.size() / size; ++i)
+    {
+        if (std::memcmp(actual.data() + i * size, expected.data() + i * size, size) == 0)
+            continue;
+
+        ++result.m_Mismatches;
+        const double error = std::abs(SampleAsDouble(actual.data() + i * size, encoding) -
+                                      SampleAsDouble(expected.data() + i * size, encoding));
+        result.m_MaxError = std::max(result.m_MaxError, error);
+    }
+
+    return result;
+}
+
+// calls f until MEASURE_TIME has passed, returns nanoseconds per call
+template <typename F>
+static double Measure(F&& f)
+{
+    using Clock = std::chrono::steady_clock;
+
+    f();
+
+    size_t calls = 0;
+    const auto start = Clock::now();
+    auto now = start;
+
+    do
+    {
+        f();
+        ++calls;
+        now = Clock::now();
+    } while (now - start < MEASURE_TIME);
+
+    return std::chrono::duration<double, std::nano>(now - start).count() / static_cast<double>(calls);
+}
+
+static void WriteMeasurement(std::FILE* out, bool& first, const char* path, const AudioEncoding src,
+                             const AudioEncoding dst, const WorkingSet& set, const size_t count, const double ns)
+{
+    const double bytes = static_cast<double>(count * GetEffectiveEncodingSize(src));
+
+    std::fprintf(out, "%s\n    {\"path\": \"%s\", \"from\": \"%s\", \"to\": \"%s\", \"working_set\": \"%s\", "
+                      "\"samples\": %zu, \"mb_per_s\": %.1f, \"samples_per_ns\": %.4f}",
+                 first ? "" : ",", path, EncodingName(src), EncodingName(dst), set.m_Name, count,
+                 bytes / ns * 1e3, static_cast<double>(count) / ns);
+    first = false;
+}
+
+int main(const int argc, char** argv)
+{
+    std::FILE* out = argc > 1 ? std::fopen(argv[1], "w") : stdout;
+    if (out == nullptr)
+    {
+        std::perror(argv[1]);
+        return 1;
+    }
+
+    std::mt19937 rng(12345);
+    bool differentialFailed = false;
+
+    std::fprintf(out, "{\n  \"differential\": [");
+    bool first = true;
+
+    // differential check over a length which leaves a vector tail behind
+    for (const auto src : ALL_ENCODINGS)
+    {
+        const size_t count = 100'003;
+        const auto input = MakeInput(src, count, rng);
+
+        for (const auto dst : ALL_ENCODINGS)
+        {
+            std::vector<uint8_t> expected(count * GetEffectiveEncodingSize(dst));
+            ConvertSampleBufferScalar(input.data(), src, expected.data(), dst, count);
+
+            const auto dynamic = VisitSampleType(src, [&]<typename S>(S) {
+                std::vector<S> typed(count);
+                std::memcpy(typed.data(), input.data(), input.size());
+                return ConvertSampleVectorDynamic(typed, dst);
+            });
+
+            const auto shared = std::make_shared<std::vector<uint8_t>>(input);
+            SourceReencoder reencoder(std::make_shared<RepeatSource>(shared, src), dst);
+            AudioBuffer frame;
+            reencoder.NextFrameInto(frame);
+            const auto* reencoded = std::as_const(frame).Data();
+
+            const auto dynamicResult = Compare(dynamic, expected, dst);
+            const auto reencoderResult = Compare(std::vector(reencoded, reencoded + frame.BufferLength()), expected, dst);
+
+            // the vectorized paths have to match the scalar reference bit for bit
+            const bool passed = dynamicResult.m_Mismatches == 0 && reencoderResult.m_Mismatches == 0;
+            differentialFailed |= !passed;
+
+            std::fprintf(out, "%s\n    {\"from\": \"%s\", \"to\": \"%s\", \"mismatches\": %zu, \"max_error\": %g, "
+                              "\"reencoder_mismatches\": %zu, \"passed\": %s}",
+                         first ? "" : ",", EncodingName(src), EncodingName(dst), dynamicResult.m_Mismatches,
+                         std::max(dynamicResult.m_MaxError, reencoderResult.m_MaxError),
+                         reencoderResult.m_Mismatches, passed ? "true" : "false");
+            first = false;
+
+            if (!passed)
+                std::fprintf(stderr, "%s -> %s differs from the scalar reference\n", EncodingName(src), EncodingName(dst));
+        }
+    }
+
+    std::fprintf(out, "\n  ],\n  \"results\": [");
+    first = true;
+
+    for (const auto& set : WORKING_SETS)
+    {
+        for (const auto src : ALL_ENCODINGS)
+        {
+            for (const auto dst : ALL_ENCODINGS)
+            {
+                const size_t count = set.m_Bytes / (GetEffectiveEncodingSize(src) + GetEffectiveEncodingSize(dst));
+                const auto input = MakeInput(src, count, rng);
+                std::fprintf(stderr, "%-4s %-7s -> %s\n", set.m_Name, EncodingName(src), EncodingName(dst));
+
+                std::vector<uint8_t> scalar(count * GetEffectiveEncodingSize(dst));
+                const double scalarNs = Measure([&] {
+                    ConvertSampleBufferScalar(input.data(), src, scalar.data(), dst, count);
+                });
+                WriteMeasurement(out, first, "scalar", src, dst, set, count, scalarNs);
+
+                const double dynamicNs = VisitSampleType(src, [&]<typename S>(S) {
+                    std::vector<S> typed(count);
+                    std::memcpy(typed.data(), input.data(), input.size());
+
+                    return Measure([&] {
+                        const auto converted = ConvertSampleVectorDynamic(typed, dst);
+                        // keeps the conversion from being optimized out
+                        asm volatile("" : : "r"(converted.data()) : "memory");
+                    });
+                });
+                WriteMeasurement(out, first, "vector_dynamic", src, dst, set, count, dynamicNs);
+
+                SourceReencoder reencoder(
+                    std::make_shared<RepeatSource>(std::make_shared<std::vector<uint8_t>>(input), src), dst);
+                AudioBuffer frame;
+                const double reencoderNs = Measure([&] { reencoder.NextFrameInto(frame); });
+                WriteMeasurement(out, first, "reencoder", src, dst, set, count, reencoderNs);
+            }
+        }
+    }
+
+    std::fprintf(out, "\n  ]\n}\n");
+
+    if (out != stdout)
+        std::fclose(out);
+
+    return differentialFailed ? 1 : 0;
+}
@@ -0,0 +1,221 @@
+// Convolves stereo noise with a 2 s reverb response at 48 kHz through SourceConvolver at partition sizes
+// from 64 to 2048 frames, pulling a partition at a time on the schedule a device would, and reports the
+// CPU each channel takes in the pull and on the worker along with the worst pulls. Before that, the
+// output gets checked against a direct convolution, and the tail on the worker against the tail in the
+// pull, which have to match bit for bit.
+
+#include "Audio/AudioMetrics.h"
+#include "Audio/Convolver.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+
+constexpr double RESPONSE_SECONDS = 2.;
+constexpr double INPUT_SECONDS = 4.;
+// frames checked against the direct convolution, which takes a while
+constexpr size_t CHECKED_FRAMES = 4800;
+constexpr float MAX_DIFFERENCE = 1e-4f;
+constexpr size_t PARTITIONS[] = { 64, 128, 256, 512, 1024, 2048 };
+
+static const SignalSpec SPEC { 48000, ChannelLayout(ChannelLayoutType::STEREO) };
+
+// Plays a table of Float32 frames once.
+class TableSource : public AudioSource
+{
+public:
+    explicit TableSource(std::shared_ptr<const std::vector<float>> table) : m_Table(std::move(table)) {}
+
+    SignalSpec Spec() override { return SPEC; }
+    AudioEncoding Encoding() override { return AudioEncoding::Float32; }
+
+    std::optional<size_t> TotalSamples() override { return m_Table->size() / SPEC.m_Channels.Count(); }
+    std::optional<size_t> CurrentSample() override { return m_Offset; }
+
+    std::optional<AudioBuffer> NextFrame() override
+    {
+        AudioBuffer frame;
+        if (!NextFrameInto(frame))
+            return std::nullopt;
+
+        return frame;
+    }
+
+    bool NextFrameUpTo(AudioBuffer& frame, const size_t maxFrames) override
+    {
+        const size_t channels = SPEC.m_Channels.Count();
+        const size_t count = std::min(maxFrames, *TotalSamples() - m_Offset);
+        if (count == 0)
+            return false;
+
+        frame.Reformat(SPEC, AudioEncoding::Float32, count * channels * sizeof(float));
+        std::memcpy(frame.Data(), m_Table->data() + m_Offset * channels, count * channels * sizeof(float));
+
+        m_Offset += count;
+        return true;
+    }
+
+    bool IsInfallible() override { return true; }
+
+protected:
+    bool DoNextFrameInto(AudioBuffer& frame) override { return NextFrameUpTo(frame, 512); }
+
+private:
+    std::shared_ptr<const std::vector<float>> m_Table;
+    size_t m_Offset = 0;
+};
+
+static std::vector<float> Noise(const size_t count, const uint32_t seed)
+{
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> noise(-0.5f, 0.5f);
+
+    std::vector<float> samples(count);
+    for (float& sample : samples)
+        sample = noise(random);
+
+    return samples;
+}
+
+// decaying noise, different on either channel, about what a hall's response looks like
+static AudioBuffer MakeResponse()
+{
+    const size_t channels = SPEC.m_Channels.Count();
+    const auto frames = static_cast<size_t>(RESPONSE_SECONDS * SPEC.m_Rate);
+    std::vector<float> samples = Noise(frames * channels, 99);
+
+    for (size_t i = 0; i < frames; ++i)
+    {
+        // 60 dB down by the end
+        const auto gain = static_cast<float>(0.1 * std::pow(10., -3. * static_cast<double>(i) / frames));
+        for (size_t c = 0; c < channels; ++c)
+            samples[i * channels + c] *= gain;
+    }
+
+    AudioBuffer response;
+    response.Reformat(SPEC, AudioEncoding::Float32, samples.size() * sizeof(float));
+    std::memcpy(response.Data(), samples.data(), samples.size() * sizeof(float));
+
+    return response;
+}
+
+static std::vector<float> Render(SourceConvolver& convolver, const size_t frames)
+{
+    std::vector<float> output;
+    AudioBuffer frame;
+
+    while (output.size() < frames * SPEC.m_Channels.Count() && convolver.NextFrameInto(frame))
+    {
+        const auto samples = frame.View<float>().Samples();
+        output.insert(output.end(), samples.begin(), samples.end());
+    }
+
+    return output;
+}
+
+static bool Check(const std::shared_ptr<const std::vector<float>>& input, const AudioBuffer& response)
+{
+    const size_t channels = SPEC.m_Channels.Count();
+
+    SourceConvolver worker(std::make_shared<TableSource>(input), response, { .m_PartitionSize = 256 });
+    SourceConvolver inline_(std::make_shared<TableSource>(input), response,
+                            { .m_PartitionSize = 256, .m_TailOnWorker = false });
+
+    const std::vector<float> fromWorker = Render(worker, SIZE_MAX);
+    const std::vector<float> fromPull = Render(inline_, SIZE_MAX);
+
+    const size_t expected = (input->size() / channels + response.FrameCount() - 1) * channels;
+    if (fromWorker.size() != expected || fromWorker != fromPull)
+    {
+        std::fprintf(stderr, "tail on the worker gave %zu samples, in the pull %zu, expected %zu, %s\n",
+                     fromWorker.size(), fromPull.size(), expected, fromWorker == fromPull ? "equal" : "different");
+        return false;
+    }
+
+    const auto responseSamples = response.View<float>();
+    const size_t responseFrames = response.FrameCount();
+
+    double difference = 0.;
+    for (size_t i = 0; i < CHECKED_FRAMES; ++i)
+    {
+        for (size_t c = 0; c < channels; ++c)
+        {
+            double sum = 0.;
+            for (size_t k = 0; k <= i && k < responseFrames; ++k)
+                sum += static_cast<double>((*input)[(i - k) * channels + c]) * responseSamples[k * channels + c];
+
+            difference = std::max(difference, std::abs(sum - fromWorker[i * channels + c]));
+        }
+    }
+
+    std::printf("max difference to direct convolution %.2e, worker and pull identical\n\n", difference);
+    return difference <= MAX_DIFFERENCE;
+}
+
+int main()
+{
+    const size_t channels = SPEC.m_Channels.Count();
+    const auto inputFrames = static_cast<size_t>(INPUT_SECONDS * SPEC.m_Rate);
+
+    const auto input = std::make_shared<const std::vector<float>>(Noise(inputFrames * channels, 1234));
+    const AudioBuffer response = MakeResponse();
+
+    std::printf("%zu frame response, direct convolution would take %.1f G multiply-adds per second and channel\n",
+                response.FrameCount(), static_cast<double>(response.FrameCount()) * SPEC.m_Rate / 1e9);
+
+    if (!Check(std::make_shared<const std::vector<float>>(input->begin(), input->begin() + 2 * CHECKED_FRAMES * channels),
+               response))
+    {
+        std::fprintf(stderr, "convolution doesn't match\n");
+        return 1;
+    }
+
+    std::printf("%9s %10s %10s %8s %10s %10s %9s %7s\n", "partition", "latency ms", "partitions", "pull %",
+                "worker %", "pull p99", "pull max", "waits");
+
+    for (const size_t partition : PARTITIONS)
+    {
+        SourceConvolver convolver(std::make_shared<TableSource>(input), response, { .m_PartitionSize = partition });
+
+        DurationHistogram pulls;
+        AudioBuffer frame;
+        size_t frames = 0;
+
+        const auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(static_cast<double>(partition) / SPEC.m_Rate));
+        auto deadline = std::chrono::steady_clock::now();
+
+        while (true)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            if (!convolver.NextFrameUpTo(frame, partition))
+                break;
+
+            pulls.Record(std::chrono::steady_clock::now() - start);
+            frames += frame.FrameCount();
+
+            // in real time, so that the worker gets the time it would have behind a device
+            deadline += period;
+            std::this_thread::sleep_until(deadline);
+        }
+
+        const ConvolverStats stats = convolver.Stats();
+        const DurationHistogramSnapshot timing = pulls.Snapshot();
+        const double channelSeconds = static_cast<double>(frames) / SPEC.m_Rate * static_cast<double>(channels);
+
+        std::printf("%9zu %10.2f %10zu %7.2f%% %9.2f%% %7.1f us %6.1f us %7llu\n", partition,
+                    static_cast<double>(partition) * 1000. / SPEC.m_Rate, convolver.PartitionCount(),
+                    std::chrono::duration<double>(stats.m_PullTime).count() / channelSeconds * 100.,
+                    std::chrono::duration<double>(stats.m_WorkerTime).count() / channelSeconds * 100.,
+                    timing.m_P99Microseconds, timing.m_MaxMicroseconds,
+                    static_cast<unsigned long long>(stats.m_WorkerWaits));
+    }
+
+    return 0;
+}
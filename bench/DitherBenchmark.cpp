@@ -0,0 +1,86 @@
+// Compares the cost of narrowing Float32 to 16 and 8 bits through SourceReencoder with and without
+// dither, and reports the requantization error each mode leaves behind.
+
+#include "Audio/AudioSource.h"
+#include "Audio/SampleConversions.h"
+#include "BenchSources.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <utility>
+#include <vector>
+
+static const char* ModeName(const DitherMode mode)
+{
+    switch (mode)
+    {
+    case DitherMode::None: return "none";
+    case DitherMode::Tpdf: return "tpdf";
+    case DitherMode::NoiseShaped: return "shaped";
+    }
+
+    return "?";
+}
+
+static void Run(const AudioEncoding target, const DitherMode mode, const size_t period)
+{
+    constexpr size_t FRAMES = 48000;
+    const SignalSpec spec { 48000, ChannelLayout(ChannelLayoutType::STEREO) };
+
+    // a quiet 1 kHz tone, a few LSBs at 16 bits, where truncation distortion is easiest to hear
+    auto table = std::make_shared<std::vector<float>>(FRAMES * 2);
+    for (size_t i = 0; i < table->size(); ++i)
+        (*table)[i] = 1e-4f * std::sin(static_cast<float>(i / 2) * 2.f * static_cast<float>(M_PI) * 1000.f / 48000.f);
+
+    SourceReencoder reencoder(std::make_shared<LoopSource>(table, spec, AudioEncoding::Float32, period), target, mode);
+
+    AudioBuffer frame;
+    for (int i = 0; i < 16; ++i)
+        reencoder.NextFrameInto(frame);
+
+    const size_t callbacks = 4'000'000 / period;
+
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < callbacks; ++i)
+        reencoder.NextFrameInto(frame);
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+
+    const double samples = static_cast<double>(callbacks * period * 2);
+    const double ns = std::chrono::duration<double, std::nano>(elapsed).count();
+
+    // error against the float signal over one pass of the table, in LSBs of the target
+    SourceReencoder measured(std::make_shared<LoopSource>(table, spec, AudioEncoding::Float32, FRAMES), target, mode);
+    measured.NextFrameInto(frame);
+
+    std::vector<float> back(frame.SampleCount());
+    ConvertSampleBuffer(std::as_const(frame).Data(), target, back.data(), AudioEncoding::Float32, back.size());
+
+    const double lsb = target == AudioEncoding::Int16 ? 1. / 32768. : 1. / 128.;
+    double errorPower = 0.;
+    double bias = 0.;
+    for (size_t i = 0; i < back.size(); ++i)
+    {
+        const double error = (back[i] - (*table)[i]) / lsb;
+        errorPower += error * error;
+        bias += error;
+    }
+
+    std::printf("%-5s dither %-6s period %4zu  %6.2f ns/sample  %8.1f Msamples/s  error %5.3f LSB rms, %+6.3f LSB mean\n",
+                target == AudioEncoding::Int16 ? "int16" : "uint8", ModeName(mode), period, ns / samples,
+                samples / ns * 1000., std::sqrt(errorPower / static_cast<double>(back.size())),
+                bias / static_cast<double>(back.size()));
+}
+
+int main()
+{
+    for (const auto target : { AudioEncoding::Int16, AudioEncoding::UInt8 })
+    {
+        for (const auto mode : { DitherMode::None, DitherMode::Tpdf, DitherMode::NoiseShaped })
+        {
+            Run(target, mode, 256);
+            Run(target, mode, 4096);
+        }
+    }
+}
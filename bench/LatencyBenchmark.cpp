@@ -0,0 +1,139 @@
+// Runs the same synth -> resampler -> reencoder graph at device periods from 32 to 4096 frames, pulling
+// it with NextFrameUpTo() the way a device callback does, and reports what each period costs: the
+// latency it buys against the CPU the graph takes per second of audio and the worst pulls measured
+// against the period's deadline. With --device the graph also plays through an SdlCallbackAudioOutput
+// asking SDL for each period, to show what the device settles on and whether it keeps up.
+//
+// usage: LatencyBenchmark [--device]
+
+#include "Audio/AudioOutput.h"
+#include "Audio/OscillatorBank.h"
+
+#include <SDL3/SDL.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <thread>
+
+constexpr size_t OSCILLATORS = 64;
+constexpr double SECONDS = 10.;
+constexpr double DEVICE_SECONDS = 2.;
+constexpr size_t PERIODS[] = { 32, 64, 128, 256, 512, 1024, 2048, 4096 };
+
+static const SignalSpec SYNTH_SPEC { 44100, ChannelLayout(ChannelLayoutType::STEREO) };
+static const SignalSpec OUTPUT_SPEC { 48000, ChannelLayout(ChannelLayoutType::STEREO) };
+
+static std::shared_ptr<AudioSource> MakeGraph()
+{
+    // the bank's own frames are longer than any period, so every stage has to keep to the limit
+    auto bank = std::make_shared<OscillatorBank>(SYNTH_SPEC, 8192);
+    for (size_t o = 0; o < OSCILLATORS; ++o)
+    {
+        const auto shape = o % 2 == 0 ? OscillatorShape::Sine : OscillatorShape::Saw;
+        bank->AddOscillator(shape, 110.f + 37.f * static_cast<float>(o), 0.5f / OSCILLATORS);
+    }
+
+    std::shared_ptr<AudioSource> source = std::make_shared<SourceResampler>(bank, OUTPUT_SPEC);
+    return std::make_shared<SourceReencoder>(source, AudioEncoding::Int16, DitherMode::Tpdf);
+}
+
+static double PeriodMilliseconds(const size_t frames)
+{
+    return static_cast<double>(frames) * 1000. / OUTPUT_SPEC.m_Rate;
+}
+
+static bool RunPulls()
+{
+    std::printf("%8s %10s %11s %8s %10s %10s %9s\n", "period", "period ms", "latency ms", "cpu %", "p99 us",
+                "max us", "max/period");
+
+    for (const size_t period : PERIODS)
+    {
+        const std::shared_ptr<AudioSource> graph = MakeGraph();
+        const auto target = static_cast<size_t>(SECONDS * OUTPUT_SPEC.m_Rate);
+
+        DurationHistogram pulls;
+        AudioBuffer frame;
+        size_t frames = 0;
+        std::chrono::steady_clock::duration busy {};
+
+        while (frames < target)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            graph->NextFrameUpTo(frame, period);
+            const auto elapsed = std::chrono::steady_clock::now() - start;
+
+            if (frame.FrameCount() == 0 || frame.FrameCount() > period)
+            {
+                std::fprintf(stderr, "a %zu frame period got a frame of %zu frames\n", period, frame.FrameCount());
+                return false;
+            }
+
+            pulls.Record(elapsed);
+            busy += elapsed;
+            frames += frame.FrameCount();
+        }
+
+        const DurationHistogramSnapshot timing = pulls.Snapshot();
+        const double audioSeconds = static_cast<double>(frames) / OUTPUT_SPEC.m_Rate;
+        const double cpu = std::chrono::duration<double>(busy).count() / audioSeconds * 100.;
+        const double budget = PeriodMilliseconds(period) * 1000.;
+
+        // one period playing while the next one gets filled
+        std::printf("%8zu %10.2f %11.2f %8.2f %10.1f %10.1f %8.1f%%\n", period, PeriodMilliseconds(period),
+                    2. * PeriodMilliseconds(period), cpu, timing.m_P99Microseconds, timing.m_MaxMicroseconds,
+                    timing.m_MaxMicroseconds / budget * 100.);
+    }
+
+    return true;
+}
+
+static void RunDevice()
+{
+    std::printf("\n%10s %10s %11s %10s %11s %12s\n", "requested", "device", "latency ms", "underruns", "late fills",
+                "callback p99");
+
+    for (const size_t period : PERIODS)
+    {
+        SdlCallbackAudioOutput output(OUTPUT_SPEC, AudioEncoding::Int16, period);
+        output.SetSource(MakeGraph());
+
+        std::this_thread::sleep_for(std::chrono::duration<double>(DEVICE_SECONDS));
+        const AudioOutputSnapshot snapshot = output.Snapshot();
+
+        double callbackP99 = 0.;
+        for (const StageTiming& stage : snapshot.m_Stages)
+        {
+            if (stage.m_Name == "callback")
+                callbackP99 = stage.m_Timing.m_P99Microseconds;
+        }
+
+        std::printf("%10zu %10zu %11.2f %10llu %11llu %10.1f us\n", period, output.DevicePeriodFrames(),
+                    snapshot.m_LatencyMilliseconds, static_cast<unsigned long long>(snapshot.m_Underruns),
+                    static_cast<unsigned long long>(snapshot.m_LateWrites), callbackP99);
+    }
+}
+
+int main(const int argc, char** argv)
+{
+    const bool device = argc > 1 && std::strcmp(argv[1], "--device") == 0;
+
+    if (!RunPulls())
+        return 1;
+
+    if (!device)
+        return 0;
+
+    if (!SDL_Init(SDL_INIT_AUDIO))
+    {
+        std::fprintf(stderr, "Could not initialize SDL: %s\n", SDL_GetError());
+        return 1;
+    }
+
+    RunDevice();
+    SDL_Quit();
+
+    return 0;
+}
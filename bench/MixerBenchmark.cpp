@@ -0,0 +1,92 @@
+// Measures how many voices SourceMixer gets through per millisecond of CPU time, and checks that the
+// steady state doesn't allocate.
+
+#include "Audio/AudioMixer.h"
+#include "BenchSources.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <vector>
+
+static std::atomic<size_t> g_Allocations = 0;
+
+void* operator new(const size_t size)
+{
+    g_Allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size))
+        return p;
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+static std::shared_ptr<const std::vector<float>> MakeTable(const size_t frames, const size_t channels)
+{
+    auto table = std::make_shared<std::vector<float>>(frames * channels);
+    for (size_t i = 0; i < table->size(); ++i)
+        (*table)[i] = 0.25f * std::sin(static_cast<float>(i) * 0.01f);
+
+    return table;
+}
+
+static void Run(const size_t voices, const size_t sourceChannels, const size_t period)
+{
+    const SignalSpec mixSpec { 48000, ChannelLayout(ChannelLayoutType::STEREO) };
+    const SignalSpec sourceSpec { 48000, ChannelLayout(sourceChannels == 1 ? ChannelLayoutType::MONO : ChannelLayoutType::STEREO) };
+
+    // a source frame length which doesn't divide the period exercises the carry over between frames
+    const auto table = MakeTable(48000, sourceChannels);
+    SourceMixer mixer(mixSpec, period, voices);
+
+    for (size_t i = 0; i < voices; ++i)
+    {
+        const float pan = static_cast<float>(i) / static_cast<float>(voices) * 2.f - 1.f;
+        mixer.AddSource(std::make_shared<LoopSource>(table, sourceSpec, AudioEncoding::Float32, 1000), 0.05f, pan);
+    }
+
+    AudioBuffer frame;
+
+    // warm up, so that every buffer has reached its steady size
+    for (int i = 0; i < 16; ++i)
+        mixer.NextFrameInto(frame);
+
+    const size_t allocationsBefore = g_Allocations.load();
+    const size_t callbacks = std::max<size_t>(64, 2'000'000 / (voices * period));
+
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < callbacks; ++i)
+        mixer.NextFrameInto(frame);
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+
+    const size_t allocations = g_Allocations.load() - allocationsBefore;
+
+    const double cpuMs = std::chrono::duration<double, std::milli>(elapsed).count();
+    const double audioMs = static_cast<double>(callbacks * period) * 1000. / mixSpec.m_Rate;
+    const double perCallbackUs = cpuMs * 1000. / static_cast<double>(callbacks);
+
+    // voices which could be mixed in realtime on one core, per millisecond of audio
+    const double voicesPerMs = static_cast<double>(voices) * audioMs / cpuMs;
+
+    std::printf("%-6s voices %4zu  period %4zu  %8.2f us/callback  %10.0f voices/ms  %5.2f allocations/callback\n",
+                sourceChannels == 1 ? "mono" : "stereo", voices, period, perCallbackUs, voicesPerMs,
+                static_cast<double>(allocations) / static_cast<double>(callbacks));
+}
+
+int main()
+{
+    for (const size_t channels : { 1, 2 })
+    {
+        for (const size_t voices : { 1, 16, 64, 256, 512 })
+            Run(voices, channels, 256);
+    }
+
+    Run(256, 1, 64);
+    Run(256, 1, 1024);
+}
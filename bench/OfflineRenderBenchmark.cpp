@@ -0,0 +1,91 @@
+// Renders a batch of synth -> resampler -> reencoder graphs to WAV files with no device attached, on
+// one thread and on all of them, and reports the realtime factor each achieves. The files get read
+// back with WavSource to check that every frame made it to disk.
+//
+// usage: OfflineRenderBenchmark [output directory], /tmp without one
+
+#include "Audio/OfflineRenderer.h"
+#include "Audio/OscillatorBank.h"
+#include "Audio/WavSource.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+constexpr size_t GRAPHS = 16;
+constexpr size_t OSCILLATORS = 32;
+constexpr double SECONDS = 30.;
+
+static std::vector<OfflineRenderJob> MakeJobs(const std::string& directory, std::vector<std::string>& paths)
+{
+    const SignalSpec synthSpec { 44100, ChannelLayout(ChannelLayoutType::STEREO) };
+    const SignalSpec outputSpec { 48000, ChannelLayout(ChannelLayoutType::STEREO) };
+
+    std::vector<OfflineRenderJob> jobs;
+    paths.clear();
+
+    for (size_t i = 0; i < GRAPHS; ++i)
+    {
+        auto bank = std::make_shared<OscillatorBank>(synthSpec, 1024);
+        for (size_t o = 0; o < OSCILLATORS; ++o)
+        {
+            const auto shape = o % 2 == 0 ? OscillatorShape::Sine : OscillatorShape::Saw;
+            bank->AddOscillator(shape, 110.f * static_cast<float>(i + 1) + 37.f * static_cast<float>(o),
+                                0.5f / OSCILLATORS);
+        }
+
+        std::shared_ptr<AudioSource> source = std::make_shared<SourceResampler>(bank, outputSpec);
+        source = std::make_shared<SourceReencoder>(source, AudioEncoding::Int16, DitherMode::Tpdf);
+
+        paths.push_back(directory + "/offline-render-" + std::to_string(i) + ".wav");
+        auto output = std::make_shared<FileAudioOutput>(paths.back(), outputSpec, AudioEncoding::Int16);
+
+        jobs.push_back({ source, output, static_cast<size_t>(SECONDS * outputSpec.m_Rate) });
+    }
+
+    return jobs;
+}
+
+static bool Verify(const std::vector<std::string>& paths, const size_t frames)
+{
+    for (const std::string& path : paths)
+    {
+        WavSource source(path);
+        if (source.TotalSamples() != frames)
+        {
+            std::fprintf(stderr, "%s holds %zu frames, expected %zu\n", path.c_str(), *source.TotalSamples(), frames);
+            return false;
+        }
+
+        std::remove(path.c_str());
+    }
+
+    return true;
+}
+
+int main(const int argc, char** argv)
+{
+    const std::string directory = argc > 1 ? argv[1] : "/tmp";
+    const size_t hardwareThreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+    std::vector<size_t> threadCounts = { 1 };
+    if (hardwareThreads > 1)
+        threadCounts.push_back(hardwareThreads);
+
+    for (const size_t threads : threadCounts)
+    {
+        std::vector<std::string> paths;
+        const auto report = RenderOffline(MakeJobs(directory, paths), threads);
+
+        std::printf("%2zu thread(s): %zu graphs, %.0f s of audio in %.3f s, %.1fx realtime overall, "
+                    "%.1fx per graph\n",
+                    threads, GRAPHS, report.m_Total.m_AudioSeconds, report.m_Total.m_WallSeconds,
+                    report.m_Total.m_RealtimeFactor, report.m_Jobs.front().m_RealtimeFactor);
+
+        if (!Verify(paths, report.m_Jobs.front().m_Frames))
+            return 1;
+    }
+}
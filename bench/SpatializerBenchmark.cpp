@@ -0,0 +1,370 @@
+// Measures the Spatializer's two halves. Update() runs the gain kernel over every emitter once per game
+// frame, timed against the same math done one emitter at a time. The callback then mixes a few hundred
+// moving emitters, panned or through HRIRs, on a device's schedule while a game thread keeps moving
+// them; it reports the worst-case callback against the period and the allocations made on the audio
+// thread, which have to stay at zero. Before that, the gains, their ramps and the HRIRs get checked.
+
+#include "Audio/SampleConversions.h"
+#include "Audio/SimdKernels.h"
+#include "Audio/Spatializer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <random>
+#include <thread>
+#include <vector>
+
+constexpr uint32_t RATE = 48000;
+constexpr double SECONDS = 2.;
+// a game running at 120 frames per second
+constexpr int UPDATE_INTERVAL_US = 8333;
+
+static std::atomic<size_t> g_AudioThreadAllocations = 0;
+static thread_local bool t_OnAudioThread = false;
+
+void* operator new(const size_t size)
+{
+    if (t_OnAudioThread)
+        g_AudioThreadAllocations.fetch_add(1, std::memory_order_relaxed);
+
+    if (void* p = std::malloc(size))
+        return p;
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+static std::shared_ptr<const DecodedSound> MakeClip(const std::vector<float>& samples)
+{
+    std::vector<uint8_t> bytes(samples.size() * sizeof(float));
+    std::memcpy(bytes.data(), samples.data(), bytes.size());
+
+    return std::make_shared<const DecodedSound>(std::move(bytes), SignalSpec { RATE, ChannelLayout(ChannelLayoutType::MONO) },
+                                                AudioEncoding::Float32);
+}
+
+// SpatialGains() one emitter at a time with the standard library's square root, sine and cosine
+static void ScalarGains(const float* x, const float* y, const float* z, const float* gains, const size_t count,
+                        const float* listener, const float referenceDistance, const float maxDistance,
+                        const float rolloff, float* left, float* right, float* attenuated)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        const float dx = x[i] - listener[0];
+        const float dy = y[i] - listener[1];
+        const float dz = z[i] - listener[2];
+        const float distance = std::sqrt(dx * dx + dy * dy + dz * dz);
+        const float lateral = distance < 1e-6f ? 0.f : (dx * listener[3] + dy * listener[4] + dz * listener[5]) / distance;
+
+        const float clamped = std::clamp(distance, referenceDistance, maxDistance);
+        const float gain = gains[i] * referenceDistance / (referenceDistance + rolloff * (clamped - referenceDistance));
+        const float angle = (std::clamp(lateral, -1.f, 1.f) + 1.f) * static_cast<float>(M_PI) / 4.f;
+
+        left[i] = gain * std::cos(angle);
+        right[i] = gain * std::sin(angle);
+        attenuated[i] = gain;
+    }
+}
+
+static bool CheckKernel()
+{
+    constexpr size_t COUNT = 1003;
+    std::mt19937 random(3);
+    std::uniform_real_distribution<float> coordinate(-50.f, 50.f);
+
+    std::vector<float> x(COUNT), y(COUNT), z(COUNT), gains(COUNT);
+    for (size_t i = 0; i < COUNT; ++i)
+    {
+        x[i] = coordinate(random);
+        y[i] = coordinate(random) * 0.1f;
+        z[i] = coordinate(random);
+        gains[i] = 0.5f + static_cast<float>(i % 3) * 0.25f;
+    }
+
+    // one right on the listener, one within the reference distance
+    x[0] = 1.f, y[0] = 2.f, z[0] = 3.f;
+    x[1] = 1.5f, y[1] = 2.f, z[1] = 3.f;
+
+    const float listener[6] = { 1.f, 2.f, 3.f, 1.f, 0.f, 0.f };
+
+    std::vector<float> left(COUNT), right(COUNT), attenuated(COUNT);
+    std::vector<float> expectedLeft(COUNT), expectedRight(COUNT), expectedAttenuated(COUNT);
+    SpatialGains(x.data(), y.data(), z.data(), gains.data(), COUNT, listener, 1.f, 40.f, 1.f, left.data(),
+                 right.data(), attenuated.data());
+    ScalarGains(x.data(), y.data(), z.data(), gains.data(), COUNT, listener, 1.f, 40.f, 1.f, expectedLeft.data(),
+                expectedRight.data(), expectedAttenuated.data());
+
+    for (size_t i = 0; i < COUNT; ++i)
+    {
+        if (std::abs(left[i] - expectedLeft[i]) > 1e-5f || std::abs(right[i] - expectedRight[i]) > 1e-5f ||
+            std::abs(attenuated[i] - expectedAttenuated[i]) > 1e-5f)
+        {
+            std::fprintf(stderr, "emitter %zu gets %f, %f, %f instead of %f, %f, %f\n", i, left[i], right[i],
+                         attenuated[i], expectedLeft[i], expectedRight[i], expectedAttenuated[i]);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool CheckRamp()
+{
+    constexpr size_t FRAME = 256;
+    Spatializer spatializer(RATE, 4, FRAME, { .m_LimiterThreshold = std::nullopt });
+
+    // the listener faces -z, so +x is to its right; at twice the reference distance the gain halves
+    const EmitterId id = spatializer.Play(MakeClip(std::vector<float>(RATE, 1.f)), { 2.f, 0.f, 0.f });
+
+    AudioBuffer frame;
+    spatializer.NextFrameInto(frame);
+    auto samples = frame.View<float>().Samples();
+    if (std::abs(samples[0]) > 1e-5f || std::abs(samples[1] - 0.5f) > 1e-5f || std::abs(samples[2 * FRAME - 1] - 0.5f) > 1e-5f)
+    {
+        std::fprintf(stderr, "emitter on the right plays at %f, %f\n", samples[0], samples[1]);
+        return false;
+    }
+
+    // straight ahead at the reference distance, ramping there over the next frame
+    spatializer.SetPosition(id, { 0.f, 0.f, -1.f });
+    spatializer.Update();
+    spatializer.NextFrameInto(frame);
+    samples = frame.View<float>().Samples();
+
+    const float centre = std::sqrt(0.5f);
+    for (size_t i = 0; i < FRAME; ++i)
+    {
+        const float t = static_cast<float>(i) / FRAME;
+        const float left = centre * t;
+        const float right = 0.5f + (centre - 0.5f) * t;
+        if (std::abs(samples[2 * i] - left) > 1e-5f || std::abs(samples[2 * i + 1] - right) > 1e-5f)
+        {
+            std::fprintf(stderr, "ramp frame %zu is %f, %f instead of %f, %f\n", i, samples[2 * i], samples[2 * i + 1],
+                         left, right);
+            return false;
+        }
+    }
+
+    spatializer.Stop(id);
+    spatializer.NextFrameInto(frame);
+    spatializer.Update();
+
+    const SpatializerStats stats = spatializer.Stats();
+    if (spatializer.IsPlaying(id) || stats.m_Finished != 1 || stats.m_ActiveEmitters != 0)
+    {
+        std::fprintf(stderr, "stopped emitter is still around\n");
+        return false;
+    }
+
+    return true;
+}
+
+static bool CheckHrtf()
+{
+    const auto hrirs = HrirSet::SphericalHead(RATE);
+    Spatializer spatializer(RATE, 4, 256, { .m_Hrirs = hrirs, .m_LimiterThreshold = std::nullopt });
+
+    std::vector<float> click(100, 0.f);
+    click[0] = 1.f;
+    spatializer.Play(MakeClip(click), { 3.f, 0.f, 0.f });
+
+    AudioBuffer frame;
+    spatializer.NextFrameInto(frame);
+    const auto samples = frame.View<float>().Samples();
+
+    // on the right, the right ear hears it first and louder
+    size_t peaks[2] = {};
+    float energy[2] = {};
+    for (size_t i = 0; i < samples.size(); ++i)
+    {
+        const size_t ear = i % 2;
+        energy[ear] += samples[i] * samples[i];
+        if (std::abs(samples[i]) > std::abs(samples[peaks[ear] * 2 + ear]))
+            peaks[ear] = i / 2;
+    }
+
+    if (peaks[1] >= peaks[0] || energy[1] <= 2.f * energy[0])
+    {
+        std::fprintf(stderr, "click on the right peaks at %zu, %zu with energy %f, %f\n", peaks[0], peaks[1],
+                     energy[0], energy[1]);
+        return false;
+    }
+
+    spatializer.NextFrameInto(frame);
+    if (spatializer.Stats().m_Finished != 1)
+    {
+        std::fprintf(stderr, "click didn't end\n");
+        return false;
+    }
+
+    return true;
+}
+
+static void RunUpdate(const size_t emitters)
+{
+    Spatializer spatializer(RATE, emitters);
+    const auto clip = MakeClip(std::vector<float>(1024, 0.1f));
+
+    std::mt19937 random(5);
+    std::uniform_real_distribution<float> coordinate(-30.f, 30.f);
+
+    std::vector<EmitterId> ids;
+    for (size_t i = 0; i < emitters; ++i)
+        ids.push_back(spatializer.Play(clip, { coordinate(random), 0.f, coordinate(random) }, 1.f, true));
+
+    std::vector<float> x(emitters), y(emitters), z(emitters), gains(emitters, 1.f);
+    std::vector<float> left(emitters), right(emitters), attenuated(emitters);
+    for (size_t i = 0; i < emitters; ++i)
+    {
+        x[i] = coordinate(random);
+        z[i] = coordinate(random);
+    }
+
+    const float listener[6] = { 0.f, 0.f, 0.f, 1.f, 0.f, 0.f };
+    constexpr int ROUNDS = 2000;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < ROUNDS; ++round)
+    {
+        ScalarGains(x.data(), y.data(), z.data(), gains.data(), emitters, listener, 1.f, 100.f, 1.f, left.data(),
+                    right.data(), attenuated.data());
+        x[round % emitters] += 0.01f;
+    }
+    const double scalarNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / ROUNDS;
+
+    start = std::chrono::steady_clock::now();
+    for (int round = 0; round < ROUNDS; ++round)
+    {
+        SpatialGains(x.data(), y.data(), z.data(), gains.data(), emitters, listener, 1.f, 100.f, 1.f, left.data(),
+                     right.data(), attenuated.data());
+        x[round % emitters] += 0.01f;
+    }
+    const double kernelNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / ROUNDS;
+
+    start = std::chrono::steady_clock::now();
+    for (int round = 0; round < ROUNDS; ++round)
+    {
+        spatializer.SetPosition(ids[round % emitters], { coordinate(random), 0.f, coordinate(random) });
+        spatializer.Update();
+    }
+    const double updateNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / ROUNDS;
+
+    std::printf("%8zu %10.1f %10.1f %7.2fx %10.1f\n", emitters, scalarNs / 1000., kernelNs / 1000., scalarNs / kernelNs,
+                updateNs / 1000.);
+}
+
+static void RunCallback(const size_t emitters, const size_t period, const bool hrtf)
+{
+    SpatializerOptions options;
+    if (hrtf)
+        options.m_Hrirs = HrirSet::SphericalHead(RATE);
+
+    Spatializer spatializer(RATE, emitters, period, options);
+
+    std::vector<std::shared_ptr<const DecodedSound>> clips;
+    for (size_t i = 0; i < 8; ++i)
+    {
+        std::vector<float> samples(RATE / 2);
+        for (size_t j = 0; j < samples.size(); ++j)
+            samples[j] = 0.05f * std::sin(2.f * static_cast<float>(M_PI) * (150.f + 60.f * i) * j / RATE);
+
+        clips.push_back(MakeClip(samples));
+    }
+
+    // every emitter circling the listener at its own radius and speed
+    std::vector<EmitterId> ids;
+    for (size_t i = 0; i < emitters; ++i)
+        ids.push_back(spatializer.Play(clips[i % clips.size()], { 2.f + i % 20, 0.f, 0.f }, 1.f, true));
+
+    std::atomic<bool> done = false;
+
+    std::thread game([&] {
+        float time = 0.f;
+        auto next = std::chrono::steady_clock::now();
+        while (!done.load(std::memory_order_relaxed))
+        {
+            for (size_t i = 0; i < emitters; ++i)
+            {
+                const float radius = 2.f + static_cast<float>(i % 20);
+                const float angle = time * (0.5f + static_cast<float>(i % 7)) + static_cast<float>(i);
+                spatializer.SetPosition(ids[i], { radius * std::cos(angle), 0.f, radius * std::sin(angle) });
+            }
+
+            spatializer.SetListener({ .m_Front = { std::sin(time), 0.f, -std::cos(time) } });
+            spatializer.Update();
+
+            time += UPDATE_INTERVAL_US * 1e-6f;
+            next += std::chrono::microseconds(UPDATE_INTERVAL_US);
+            std::this_thread::sleep_until(next);
+        }
+    });
+
+    size_t allocations = 0;
+
+    std::thread audio([&] {
+        AudioBuffer frame;
+        const auto periodDuration = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(static_cast<double>(period) / RATE));
+        const auto callbacks = static_cast<size_t>(SECONDS * RATE / static_cast<double>(period));
+
+        // the frame's own storage gets allocated by the first pull
+        spatializer.NextFrameInto(frame);
+
+        t_OnAudioThread = true;
+        auto deadline = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < callbacks; ++i)
+        {
+            spatializer.NextFrameInto(frame);
+
+            deadline += periodDuration;
+            std::this_thread::sleep_until(deadline);
+        }
+        t_OnAudioThread = false;
+
+        allocations = g_AudioThreadAllocations.exchange(0);
+    });
+
+    audio.join();
+    done = true;
+    game.join();
+
+    const DurationHistogramSnapshot timing = spatializer.CallbackTiming();
+    const double periodUs = static_cast<double>(period) * 1e6 / RATE;
+
+    std::printf("%8zu %6zu %6s %8.1f %8.1f %8.1f %6.2f%% %6zu\n", emitters, period, hrtf ? "hrtf" : "pan",
+                timing.m_P50Microseconds, timing.m_P99Microseconds, timing.m_MaxMicroseconds,
+                100. * timing.m_MaxMicroseconds / periodUs, allocations);
+}
+
+int main()
+{
+    if (!CheckKernel() || !CheckRamp() || !CheckHrtf())
+    {
+        std::fprintf(stderr, "spatializer output is wrong\n");
+        return 1;
+    }
+
+    std::printf("%8s %10s %10s %8s %10s\n", "emitters", "scalar us", "simd us", "speedup", "update us");
+    for (const size_t emitters : { 256, 1024, 4096 })
+        RunUpdate(emitters);
+
+    std::printf("\n%8s %6s %6s %8s %8s %8s %7s %6s\n", "emitters", "period", "mode", "p50 us", "p99 us", "max us",
+                "max/per", "allocs");
+    for (const size_t emitters : { 64, 256, 512 })
+        RunCallback(emitters, 256, false);
+
+    // convolution costs a few dozen multiplies per sample and ear, rather than one
+    for (const size_t emitters : { 16, 64 })
+        RunCallback(emitters, 256, true);
+
+    return 0;
+}
@@ -0,0 +1,130 @@
+// Compares a decoder-to-device chain of Int24 -> Float32 -> gain -> Int16 built from dynamic
+// AudioSource stages, one pass and one intermediate buffer per stage, with the same chain composed
+// into a StaticPipelineSource, which fuses the gain into a single loop between the same SIMD conversion
+// kernels the dynamic stages use. Both have to agree exactly.
+
+#include "Audio/AudioSource.h"
+#include "Audio/StaticPipeline.h"
+#include "BenchSources.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <utility>
+#include <vector>
+
+constexpr float GAIN = 0.7f;
+
+// A float gain written the way dynamic stages are, in a pass of its own over the upstream frame.
+class GainSource : public AudioSource
+{
+public:
+    GainSource(std::shared_ptr<AudioSource> source, const float gain) : m_Source(std::move(source)), m_Gain(gain) {}
+
+    SignalSpec Spec() override { return m_Source->Spec(); }
+    AudioEncoding Encoding() override { return AudioEncoding::Float32; }
+
+    std::optional<size_t> TotalSamples() override { return m_Source->TotalSamples(); }
+    std::optional<size_t> CurrentSample() override { return m_Source->CurrentSample(); }
+
+    std::optional<AudioBuffer> NextFrame() override
+    {
+        AudioBuffer frame;
+        if (!NextFrameInto(frame))
+            return std::nullopt;
+
+        return frame;
+    }
+
+    bool IsInfallible() override { return true; }
+
+protected:
+    bool DoNextFrameInto(AudioBuffer& frame) override
+    {
+        if (!m_Source->NextFrameInto(frame))
+            return false;
+
+        for (float& sample : frame.View<float>())
+            sample *= m_Gain;
+
+        return true;
+    }
+
+private:
+    std::shared_ptr<AudioSource> m_Source;
+    float m_Gain;
+};
+
+static double Run(AudioSource& source, const size_t samplesPerRun)
+{
+    AudioBuffer frame;
+    for (int i = 0; i < 16; ++i)
+        source.NextFrameInto(frame);
+
+    size_t samples = 0;
+    const auto start = std::chrono::steady_clock::now();
+
+    while (samples < samplesPerRun)
+    {
+        source.NextFrameInto(frame);
+        samples += frame.SampleCount();
+    }
+
+    const auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start);
+    return elapsed.count() / static_cast<double>(samples);
+}
+
+int main()
+{
+    const SignalSpec spec { 48000, ChannelLayout(ChannelLayoutType::STEREO) };
+    constexpr size_t TABLE_FRAMES = 48000;
+
+    auto table = std::make_shared<std::vector<uint8_t>>(TABLE_FRAMES * 2 * sizeof(Int24));
+    std::mt19937 rng(7);
+    for (uint8_t& byte : *table)
+        byte = static_cast<uint8_t>(rng());
+
+    int result = 0;
+
+    for (const size_t period : { 256, 4096 })
+    {
+        const auto makeDynamic = [&] {
+            std::shared_ptr<AudioSource> source = std::make_shared<LoopSource>(table, spec, AudioEncoding::Int24, period);
+            source = std::make_shared<SourceReencoder>(source, AudioEncoding::Float32);
+            source = std::make_shared<GainSource>(source, GAIN);
+            return std::make_shared<SourceReencoder>(source, AudioEncoding::Int16);
+        };
+
+        const auto makeStatic = [&] {
+            return MakeStaticPipelineSource<Int24>(std::make_shared<LoopSource>(table, spec, AudioEncoding::Int24, period),
+                                                   ConvertTo<float>(), Gain { GAIN }, ConvertTo<int16_t>());
+        };
+
+        // both chains convert at either end with the SIMD kernels, so the samples have to be identical
+        AudioBuffer dynamicFrame;
+        AudioBuffer staticFrame;
+        makeDynamic()->NextFrameInto(dynamicFrame);
+        makeStatic()->NextFrameInto(staticFrame);
+
+        int maxError = 0;
+        const auto dynamicSamples = std::as_const(dynamicFrame).View<int16_t>().Samples();
+        const auto staticSamples = std::as_const(staticFrame).View<int16_t>().Samples();
+        for (size_t i = 0; i < dynamicSamples.size(); ++i)
+            maxError = std::max(maxError, std::abs(dynamicSamples[i] - staticSamples[i]));
+
+        const auto dynamicSource = makeDynamic();
+        const auto staticSource = makeStatic();
+        const double dynamicNs = Run(*dynamicSource, 50'000'000);
+        const double staticNs = Run(*staticSource, 50'000'000);
+
+        std::printf("period %4zu  dynamic %.3f ns/sample  static %.3f ns/sample  %.2fx  max difference %d LSB\n",
+                    period, dynamicNs, staticNs, dynamicNs / staticNs, maxError);
+
+        if (maxError != 0)
+            result = 1;
+    }
+
+    return result;
+}
@@ -0,0 +1,201 @@
+// Keeps a VoiceEngine at full polyphony with a game thread firing short clips faster than they end,
+// at random priorities and pans, while the audio thread pulls a period at a time on a device's
+// schedule. Reports how many callbacks ran with every voice busy, the worst-case callback against the
+// period, and the allocations made on the audio thread, which have to stay at zero. Before that, a
+// single voice gets checked against the clip it plays.
+
+#include "Audio/SampleConversions.h"
+#include "Audio/VoiceEngine.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <random>
+#include <thread>
+#include <vector>
+
+constexpr double SECONDS = 2.;
+// a trigger every this many microseconds, far more than the voices can finish
+constexpr int TRIGGER_INTERVAL_US = 200;
+
+static const SignalSpec SPEC { 48000, ChannelLayout(ChannelLayoutType::STEREO) };
+
+static std::atomic<size_t> g_AudioThreadAllocations = 0;
+static thread_local bool t_OnAudioThread = false;
+
+void* operator new(const size_t size)
+{
+    if (t_OnAudioThread)
+        g_AudioThreadAllocations.fetch_add(1, std::memory_order_relaxed);
+
+    if (void* p = std::malloc(size))
+        return p;
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+// a decaying tone, as short effects tend to be
+static std::shared_ptr<const DecodedSound> MakeClip(const size_t frames, const size_t channels, const float frequency,
+                                                    const AudioEncoding encoding)
+{
+    std::vector<float> samples(frames * channels);
+    for (size_t i = 0; i < frames; ++i)
+    {
+        const float t = static_cast<float>(i) / SPEC.m_Rate;
+        const float sample = 0.5f * std::exp(-4.f * t) * std::sin(2.f * static_cast<float>(M_PI) * frequency * t);
+
+        for (size_t c = 0; c < channels; ++c)
+            samples[i * channels + c] = sample;
+    }
+
+    std::vector<uint8_t> bytes(samples.size() * GetEffectiveEncodingSize(encoding));
+    ConvertSampleBuffer(samples.data(), AudioEncoding::Float32, bytes.data(), encoding, samples.size());
+
+    const SignalSpec spec { SPEC.m_Rate, ChannelLayout(channels == 1 ? ChannelLayoutType::MONO : ChannelLayoutType::STEREO) };
+    return std::make_shared<const DecodedSound>(std::move(bytes), spec, encoding);
+}
+
+static bool Check()
+{
+    const auto clip = MakeClip(1000, 1, 440.f, AudioEncoding::Float32);
+
+    VoiceEngine engine(SPEC, 4, VoiceStealing::Oldest, 256, 16, std::nullopt);
+    engine.Play(clip, { .m_Gain = 0.5f, .m_Pan = -1.f });
+
+    AudioBuffer frame;
+    std::vector<float> output;
+    for (int i = 0; i < 5; ++i)
+    {
+        engine.NextFrameInto(frame);
+        const auto samples = frame.View<float>().Samples();
+        output.insert(output.end(), samples.begin(), samples.end());
+    }
+
+    const auto* expected = reinterpret_cast<const float*>(clip->Data());
+    for (size_t i = 0; i < output.size() / 2; ++i)
+    {
+        const float left = i < clip->FrameCount() ? 0.5f * expected[i] : 0.f;
+        if (std::abs(output[i * 2] - left) > 1e-6f || std::abs(output[i * 2 + 1]) > 1e-6f)
+        {
+            std::fprintf(stderr, "frame %zu is %f, %f instead of %f, 0\n", i, output[i * 2], output[i * 2 + 1], left);
+            return false;
+        }
+    }
+
+    const VoiceEngineStats stats = engine.Stats();
+    if (stats.m_Triggered != 1 || stats.m_Finished != 1 || stats.m_ActiveVoices != 0)
+    {
+        std::fprintf(stderr, "voice didn't end with its clip\n");
+        return false;
+    }
+
+    return true;
+}
+
+static void Run(const size_t voices, const size_t period, const VoiceStealing stealing)
+{
+    VoiceEngine engine(SPEC, voices, stealing, period, 1024);
+
+    // mono and stereo clips, a few of them Int16 to go through the conversion
+    std::vector<std::shared_ptr<const DecodedSound>> clips;
+    for (size_t i = 0; i < 16; ++i)
+    {
+        const auto encoding = i % 4 == 3 ? AudioEncoding::Int16 : AudioEncoding::Float32;
+        clips.push_back(MakeClip(12000 + 3000 * i, i % 2 + 1, 200.f + 50.f * static_cast<float>(i), encoding));
+    }
+
+    std::atomic<bool> done = false;
+
+    std::thread game([&] {
+        std::mt19937 random(7);
+        std::uniform_real_distribution<float> pan(-1.f, 1.f);
+        std::uniform_int_distribution<int32_t> priority(0, 3);
+
+        auto next = std::chrono::steady_clock::now();
+        while (!done.load(std::memory_order_relaxed))
+        {
+            const VoiceId id = engine.Play(clips[random() % clips.size()],
+                                           { .m_Gain = 0.1f, .m_Pan = pan(random), .m_Priority = priority(random) });
+            if (random() % 8 == 0)
+                engine.SetPan(id, pan(random));
+
+            next += std::chrono::microseconds(TRIGGER_INTERVAL_US);
+            std::this_thread::sleep_until(next);
+        }
+    });
+
+    size_t fullCallbacks = 0;
+    size_t callbacks = 0;
+    size_t allocations = 0;
+
+    std::thread audio([&] {
+        AudioBuffer frame;
+        const auto periodDuration = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(static_cast<double>(period) / SPEC.m_Rate));
+        callbacks = static_cast<size_t>(SECONDS * SPEC.m_Rate / static_cast<double>(period));
+
+        // the frame's own storage gets allocated by the first pull
+        engine.NextFrameInto(frame);
+
+        t_OnAudioThread = true;
+        auto deadline = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < callbacks; ++i)
+        {
+            engine.NextFrameInto(frame);
+            if (engine.Stats().m_ActiveVoices == voices)
+                ++fullCallbacks;
+
+            deadline += periodDuration;
+            std::this_thread::sleep_until(deadline);
+        }
+        t_OnAudioThread = false;
+
+        allocations = g_AudioThreadAllocations.exchange(0);
+    });
+
+    audio.join();
+    done = true;
+    game.join();
+    engine.ReleaseFinished();
+
+    const DurationHistogramSnapshot timing = engine.CallbackTiming();
+    const VoiceEngineStats stats = engine.Stats();
+    const double periodUs = static_cast<double>(period) * 1e6 / SPEC.m_Rate;
+
+    std::printf("%6zu %6zu %8s %7.1f%% %8.1f %8.1f %8.1f %6.2f%% %8llu %8llu %6zu\n", voices, period,
+                stealing == VoiceStealing::Oldest ? "oldest" : "priority",
+                100. * static_cast<double>(fullCallbacks) / static_cast<double>(callbacks), timing.m_P50Microseconds,
+                timing.m_P99Microseconds, timing.m_MaxMicroseconds, 100. * timing.m_MaxMicroseconds / periodUs,
+                static_cast<unsigned long long>(stats.m_Stolen), static_cast<unsigned long long>(stats.m_Rejected),
+                allocations);
+}
+
+int main()
+{
+    if (!Check())
+    {
+        std::fprintf(stderr, "voice doesn't match its clip\n");
+        return 1;
+    }
+
+    std::printf("%6s %6s %8s %8s %8s %8s %8s %7s %8s %8s %6s\n", "voices", "period", "stealing", "full", "p50 us",
+                "p99 us", "max us", "max/per", "stolen", "rejected", "allocs");
+
+    for (const size_t voices : { 32, 64, 128 })
+    {
+        for (const size_t period : { 64, 256 })
+            Run(voices, period, VoiceStealing::Oldest);
+    }
+
+    Run(64, 256, VoiceStealing::LowestPriority);
+
+    return 0;
+}
@@ -0,0 +1,388 @@
+#include "AudioBuffer.h"
+#include "AudioBufferPool.h"
+#include "SampleConversions.h"
+#include "SimdKernels.h"
+
+#include <cstring>
+#include <stdexcept>
+
+static size_t PlaneStrideFor(const size_t frameCount, const AudioEncoding encoding)
+{
+    const size_t bytes = frameCount * GetEffectiveEncodingSize(encoding);
+    return (bytes + PLANE_ALIGNMENT - 1) / PLANE_ALIGNMENT * PLANE_ALIGNMENT;
+}
+
+AudioBuffer::AudioBuffer(const size_t duration, const SignalSpec spec, const AudioEncoding encoding)
+    : m_Buffer(AudioBufferPool::Global().Acquire(encoding, duration * spec.m_Channels.Count())),
+      m_Encoding(encoding),
+      m_Spec(spec),
+      m_Pooled(true),
+      m_PoolEncoding(encoding),
+      m_PoolSampleCount(duration * spec.m_Channels.Count())
+{
+}
+
+AudioBuffer::AudioBuffer(std::shared_ptr<const void> owner, const std::span<const uint8_t> samples,
+                         const SignalSpec spec, const AudioEncoding encoding)
+    : m_Encoding(encoding),
+      m_Spec(spec),
+      m_SharedOwner(std::move(owner)),
+      m_SharedData(samples.data()),
+      m_SharedLength(samples.size())
+{
+    if (m_SharedData == nullptr)
+        m_SharedData = reinterpret_cast<const uint8_t*>("");
+}
+
+AudioBuffer::AudioBuffer(const AudioBuffer& other)
+    : m_Buffer(other.m_Buffer),
+      m_Encoding(other.m_Encoding),
+      m_Spec(other.m_Spec),
+      m_Pooled(other.m_Pooled),
+      m_Layout(other.m_Layout),
+      m_PlaneOffset(other.m_PlaneOffset),
+      m_PlaneStride(other.m_PlaneStride),
+      m_PlaneFrames(other.m_PlaneFrames),
+      m_PoolEncoding(other.m_PoolEncoding),
+      m_PoolSampleCount(other.m_PoolSampleCount),
+      m_SharedOwner(other.m_SharedOwner),
+      m_SharedData(other.m_SharedData),
+      m_SharedLength(other.m_SharedLength)
+{
+    AlignPlanes();
+}
+
+AudioBuffer::AudioBuffer(AudioBuffer&& other) noexcept
+    : m_Buffer(std::move(other.m_Buffer)),
+      m_Encoding(other.m_Encoding),
+      m_Spec(other.m_Spec),
+      m_Pooled(std::exchange(other.m_Pooled, false)),
+      m_Layout(std::exchange(other.m_Layout, SampleLayout::Interleaved)),
+      m_PlaneOffset(std::exchange(other.m_PlaneOffset, 0)),
+      m_PlaneStride(std::exchange(other.m_PlaneStride, 0)),
+      m_PlaneFrames(std::exchange(other.m_PlaneFrames, 0)),
+      m_PoolEncoding(other.m_PoolEncoding),
+      m_PoolSampleCount(other.m_PoolSampleCount),
+      m_SharedOwner(std::move(other.m_SharedOwner)),
+      m_SharedData(std::exchange(other.m_SharedData, nullptr)),
+      m_SharedLength(std::exchange(other.m_SharedLength, 0))
+{
+}
+
+AudioBuffer& AudioBuffer::operator=(const AudioBuffer& other)
+{
+    if (this != &other)
+    {
+        ReleaseStorage();
+
+        m_Buffer = other.m_Buffer;
+        m_Encoding = other.m_Encoding;
+        m_Spec = other.m_Spec;
+        m_Pooled = other.m_Pooled;
+        m_Layout = other.m_Layout;
+        m_PlaneOffset = other.m_PlaneOffset;
+        m_PlaneStride = other.m_PlaneStride;
+        m_PlaneFrames = other.m_PlaneFrames;
+        m_PoolEncoding = other.m_PoolEncoding;
+        m_PoolSampleCount = other.m_PoolSampleCount;
+        m_SharedOwner = other.m_SharedOwner;
+        m_SharedData = other.m_SharedData;
+        m_SharedLength = other.m_SharedLength;
+
+        AlignPlanes();
+    }
+
+    return *this;
+}
+
+AudioBuffer& AudioBuffer::operator=(AudioBuffer&& other) noexcept
+{
+    if (this != &other)
+    {
+        ReleaseStorage();
+
+        m_Buffer = std::move(other.m_Buffer);
+        m_Encoding = other.m_Encoding;
+        m_Spec = other.m_Spec;
+        m_Pooled = std::exchange(other.m_Pooled, false);
+        m_Layout = std::exchange(other.m_Layout, SampleLayout::Interleaved);
+        m_PlaneOffset = std::exchange(other.m_PlaneOffset, 0);
+        m_PlaneStride = std::exchange(other.m_PlaneStride, 0);
+        m_PlaneFrames = std::exchange(other.m_PlaneFrames, 0);
+        m_PoolEncoding = other.m_PoolEncoding;
+        m_PoolSampleCount = other.m_PoolSampleCount;
+        m_SharedOwner = std::move(other.m_SharedOwner);
+        m_SharedData = std::exchange(other.m_SharedData, nullptr);
+        m_SharedLength = std::exchange(other.m_SharedLength, 0);
+    }
+
+    return *this;
+}
+
+AudioBuffer::~AudioBuffer()
+{
+    ReleaseStorage();
+}
+
+void AudioBuffer::ReleaseStorage() noexcept
+{
+    if (m_Pooled)
+        AudioBufferPool::Global().Release(m_PoolEncoding, m_PoolSampleCount, std::move(m_Buffer));
+
+    m_Buffer = {};
+    m_Pooled = false;
+
+    m_Layout = SampleLayout::Interleaved;
+    m_PlaneOffset = 0;
+    m_PlaneStride = 0;
+    m_PlaneFrames = 0;
+
+    m_SharedOwner.reset();
+    m_SharedData = nullptr;
+    m_SharedLength = 0;
+}
+
+void AudioBuffer::Detach()
+{
+    // storage kept from before the buffer got aliased is reused
+    m_Buffer.assign(m_SharedData, m_SharedData + m_SharedLength);
+
+    m_SharedOwner.reset();
+    m_SharedData = nullptr;
+    m_SharedLength = 0;
+}
+
+void AudioBuffer::Reformat(const SignalSpec spec, const AudioEncoding encoding, const size_t bufferLength)
+{
+    m_Spec = spec;
+    m_Encoding = encoding;
+
+    // the contents don't survive anyway, so shared memory is simply let go
+    m_SharedOwner.reset();
+    m_SharedData = nullptr;
+    m_SharedLength = 0;
+
+    m_Layout = SampleLayout::Interleaved;
+    m_PlaneOffset = 0;
+    m_PlaneStride = 0;
+    m_PlaneFrames = 0;
+
+    m_Buffer.resize(bufferLength);
+}
+
+void AudioBuffer::Alias(std::shared_ptr<const void> owner, const std::span<const uint8_t> samples, const SignalSpec spec,
+                        const AudioEncoding encoding)
+{
+    // pooled storage goes back to the pool rather than being held on to under a different size
+    if (m_Pooled)
+        ReleaseStorage();
+
+    m_Spec = spec;
+    m_Encoding = encoding;
+
+    m_Layout = SampleLayout::Interleaved;
+    m_PlaneOffset = 0;
+    m_PlaneStride = 0;
+    m_PlaneFrames = 0;
+
+    m_SharedOwner = std::move(owner);
+    m_SharedData = samples.data() == nullptr ? reinterpret_cast<const uint8_t*>("") : samples.data();
+    m_SharedLength = samples.size();
+}
+
+void AudioBuffer::ReformatPlanar(const SignalSpec spec, const AudioEncoding encoding, const size_t frameCount)
+{
+    m_Spec = spec;
+    m_Encoding = encoding;
+
+    m_SharedOwner.reset();
+    m_SharedData = nullptr;
+    m_SharedLength = 0;
+
+    m_Layout = SampleLayout::Planar;
+    m_PlaneStride = PlaneStrideFor(frameCount, encoding);
+    m_PlaneFrames = frameCount;
+
+    // room to slide the planes onto an aligned address, wherever the allocation landed
+    m_Buffer.resize(m_PlaneStride * spec.m_Channels.Count() + PLANE_ALIGNMENT - 1);
+    m_PlaneOffset = -reinterpret_cast<uintptr_t>(m_Buffer.data()) & (PLANE_ALIGNMENT - 1);
+}
+
+void AudioBuffer::AlignPlanes()
+{
+    if (!IsPlanar() || IsShared())
+        return;
+
+    const size_t offset = -reinterpret_cast<uintptr_t>(m_Buffer.data()) & (PLANE_ALIGNMENT - 1);
+    if (offset == m_PlaneOffset)
+        return;
+
+    std::memmove(m_Buffer.data() + offset, m_Buffer.data() + m_PlaneOffset, BufferLength());
+    m_PlaneOffset = offset;
+}
+
+void AudioBuffer::DeinterleaveInto(AudioBuffer& dst) const
+{
+    if (IsPlanar() || &dst == this)
+        throw std::runtime_error("DeinterleaveInto needs an interleaved buffer and a separate destination");
+
+    const size_t channels = m_Spec.m_Channels.Count();
+    const size_t frameCount = FrameCount();
+    const size_t sampleSize = GetEffectiveEncodingSize(m_Encoding);
+
+    dst.ReformatPlanar(m_Spec, m_Encoding, frameCount);
+
+    if (sampleSize == sizeof(float))
+    {
+        // a 32-bit sample moves the same whatever its type
+        Deinterleave(reinterpret_cast<float*>(dst.Data()), dst.PlaneStride() / sizeof(float),
+                     reinterpret_cast<const float*>(Data()), channels, frameCount);
+        return;
+    }
+
+    const uint8_t* src = Data();
+    for (size_t c = 0; c < channels; ++c)
+    {
+        uint8_t* plane = dst.PlaneData(c);
+        for (size_t i = 0; i < frameCount; ++i)
+            std::memcpy(plane + i * sampleSize, src + (i * channels + c) * sampleSize, sampleSize);
+    }
+}
+
+void AudioBuffer::InterleaveInto(AudioBuffer& dst) const
+{
+    if (!IsPlanar() || &dst == this)
+        throw std::runtime_error("InterleaveInto needs a planar buffer and a separate destination");
+
+    const size_t channels = m_Spec.m_Channels.Count();
+    const size_t frameCount = m_PlaneFrames;
+    const size_t sampleSize = GetEffectiveEncodingSize(m_Encoding);
+
+    dst.Reformat(m_Spec, m_Encoding, frameCount * channels * sampleSize);
+
+    if (sampleSize == sizeof(float))
+    {
+        Interleave(reinterpret_cast<float*>(dst.Data()), reinterpret_cast<const float*>(Data()),
+                   m_PlaneStride / sizeof(float), channels, frameCount);
+        return;
+    }
+
+    uint8_t* out = dst.Data();
+    for (size_t c = 0; c < channels; ++c)
+    {
+        const uint8_t* plane = PlaneData(c);
+        for (size_t i = 0; i < frameCount; ++i)
+            std::memcpy(out + (i * channels + c) * sampleSize, plane + i * sampleSize, sampleSize);
+    }
+}
+
+void AudioBuffer::CopyFramesInto(AudioBuffer& dst, const size_t first, const size_t count) const
+{
+    if (&dst == this)
+        throw std::runtime_error("CopyFramesInto needs a separate destination");
+    if (first + count > FrameCount())
+        throw std::runtime_error("Frames to copy run past the end of the buffer");
+
+    const size_t sampleSize = GetEffectiveEncodingSize(m_Encoding);
+
+    if (IsPlanar())
+    {
+        dst.ReformatPlanar(m_Spec, m_Encoding, count);
+
+        for (size_t c = 0; c < m_Spec.m_Channels.Count(); ++c)
+            std::memcpy(dst.PlaneData(c), PlaneData(c) + first * sampleSize, count * sampleSize);
+
+        return;
+    }
+
+    const size_t frameSize = m_Spec.m_Channels.Count() * sampleSize;
+
+    dst.Reformat(m_Spec, m_Encoding, count * frameSize);
+    std::memcpy(dst.Data(), Data() + first * frameSize, count * frameSize);
+}
+
+const AudioBuffer& AudioBuffer::Interleaved(AudioBuffer& scratch) const
+{
+    if (!IsPlanar())
+        return *this;
+
+    InterleaveInto(scratch);
+    return scratch;
+}
+
+void AudioBuffer::ReencodeInto(AudioBuffer& dst, const AudioEncoding encoding) const
+{
+    if (IsPlanar())
+    {
+        ReencodePlanarInto(dst, encoding);
+        return;
+    }
+
+    const size_t sampleCount = SampleCount();
+    const size_t dstLength = sampleCount * GetEffectiveEncodingSize(encoding);
+
+    const SignalSpec spec = m_Spec;
+    const AudioEncoding srcEncoding = m_Encoding;
+
+    if (&dst == this && IsShared())
+    {
+        // the shared memory stays readable while the samples get converted into owned storage
+        const auto owner = m_SharedOwner;
+        const uint8_t* src = m_SharedData;
+
+        dst.Reformat(spec, encoding, dstLength);
+        ConvertSampleBuffer(src, srcEncoding, dst.Data(), encoding, sampleCount);
+        return;
+    }
+
+    if (&dst == this)
+    {
+        // the kernels walk forward, so only narrowing (or same width) conversions can share storage
+        if (dstLength > m_Buffer.size())
+            throw std::runtime_error("Can't reencode in place into a wider encoding");
+
+        ConvertSampleBuffer(Data(), srcEncoding, dst.Data(), encoding, sampleCount);
+        dst.Reformat(spec, encoding, dstLength);
+        return;
+    }
+
+    dst.Reformat(spec, encoding, dstLength);
+    ConvertSampleBuffer(Data(), srcEncoding, dst.Data(), encoding, sampleCount);
+}
+
+void AudioBuffer::Reencode(const AudioEncoding encoding)
+{
+    ReencodeInto(*this, encoding);
+}
+
+void AudioBuffer::ReencodePlanarInto(AudioBuffer& dst, const AudioEncoding encoding) const
+{
+    const size_t channels = m_Spec.m_Channels.Count();
+    const size_t frameCount = m_PlaneFrames;
+    const AudioEncoding srcEncoding = m_Encoding;
+
+    if (&dst == this)
+    {
+        if (GetEffectiveEncodingSize(encoding) > GetEffectiveEncodingSize(srcEncoding))
+            throw std::runtime_error("Can't reencode in place into a wider encoding");
+
+        // planes only move towards the start, so walking them in order never overwrites one not yet converted
+        const size_t srcStride = m_PlaneStride;
+        const size_t dstStride = PlaneStrideFor(frameCount, encoding);
+        uint8_t* data = dst.Data();
+
+        for (size_t c = 0; c < channels; ++c)
+            ConvertSampleBuffer(data + c * srcStride, srcEncoding, data + c * dstStride, encoding, frameCount);
+
+        // shrinking keeps the allocation, and with it the alignment
+        dst.m_Encoding = encoding;
+        dst.m_PlaneStride = dstStride;
+        dst.m_Buffer.resize(dstStride * channels + PLANE_ALIGNMENT - 1);
+        return;
+    }
+
+    dst.ReformatPlanar(m_Spec, encoding, frameCount);
+
+    for (size_t c = 0; c < channels; ++c)
+        ConvertSampleBuffer(PlaneData(c), srcEncoding, dst.PlaneData(c), encoding, frameCount);
+}
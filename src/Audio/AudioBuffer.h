@@ -5,11 +5,15 @@
 #ifndef AUDIOBUFFER_H
 #define AUDIOBUFFER_H
 
+#include "AudioEncoding.h"
 #include "ChannelLayout.h"
 
 #include <cstdint>
+#include <memory>
+#include <span>
 #include <stdexcept>
 #include <string>
+#include <type_traits>
 #include <utility>
 #include <vector>
 #include <algorithm>
@@ -20,45 +24,47 @@ struct SignalSpec
     ChannelLayout m_Channels;
 };
 
-enum class AudioEncoding
+enum class SampleLayout
 {
-    UInt8,
-    UInt16,
-    UInt24,
-    UInt32,
-    Int8,
-    Int16,
-    Int24,
-    Int32,
-    Float32,
-    Float64
+    // frames one after another, the channels of a frame side by side
+    Interleaved,
+    // one contiguous plane of samples per channel
+    Planar
 };
 
-inline size_t GetEffectiveEncodingSize(AudioEncoding encoding)
+// every plane of a planar buffer starts on a boundary of this many bytes
+constexpr size_t PLANE_ALIGNMENT = 64;
+
+// Typed, non-owning view over the interleaved samples of an AudioBuffer.
+template <typename T>
+class AudioBufferView
 {
-    switch (encoding)
-    {
-    case AudioEncoding::UInt8:
-    case AudioEncoding::Int8:
-        return 1;
-    case AudioEncoding::UInt16:
-    case AudioEncoding::Int16:
-        return 2;
-    case AudioEncoding::UInt24:
-    case AudioEncoding::Int24:
-        return 3;
-    case AudioEncoding::Float32:
-    case AudioEncoding::UInt32:
-    case AudioEncoding::Int32:
-        return 4;
-    case AudioEncoding::Float64:
-        return 8;
-    default:
-        return 0;
-    }
-}
+public:
+    AudioBufferView(std::span<T> samples, const SignalSpec spec) noexcept
+        : m_Samples(samples), m_Spec(spec) {}
+
+    [[nodiscard]] SignalSpec Spec() const noexcept { return m_Spec; }
+    [[nodiscard]] size_t ChannelCount() const noexcept { return m_Spec.m_Channels.Count(); }
+    [[nodiscard]] size_t FrameCount() const noexcept { return m_Samples.size() / ChannelCount(); }
+
+    [[nodiscard]] std::span<T> Samples() const noexcept { return m_Samples; }
+
+    // samples of a single frame, one per channel
+    [[nodiscard]] std::span<T> Frame(size_t index) const { return m_Samples.subspan(index * ChannelCount(), ChannelCount()); }
+
+    T& operator[](size_t index) const { return m_Samples[index]; }
 
-// Buffer which contains Linear PCM samples.
+    [[nodiscard]] auto begin() const noexcept { return m_Samples.begin(); }
+    [[nodiscard]] auto end() const noexcept { return m_Samples.end(); }
+
+private:
+    std::span<T> m_Samples;
+    SignalSpec m_Spec;
+};
+
+// Buffer which contains Linear PCM samples, interleaved unless it was made planar through ReformatPlanar
+// or DeinterleaveInto. Planar buffers are meant for the DSP stages in the middle of a chain; sources
+// and outputs deal in interleaved frames.
 class AudioBuffer
 {
 public:
@@ -83,22 +89,197 @@ public:
     AudioBuffer(std::vector<uint8_t> _buffer, const SignalSpec _spec, const AudioEncoding _encoding)
         : m_Buffer(std::move(_buffer)), m_Encoding(_encoding), m_Spec(_spec) {}
 
-    AudioBuffer(size_t duration, SignalSpec spec);
+    // Buffer of duration frames drawn from AudioBufferPool::Global(), the storage goes back to the
+    // pool once the buffer is destroyed. Contents are unspecified.
+    AudioBuffer(size_t duration, SignalSpec spec, AudioEncoding encoding = AudioEncoding::Float32);
+
+    /*!
+        \brief Read-only buffer aliasing memory kept alive by owner, such as a file mapping
+        \details Writing through the buffer (non-const Data() or View(), in-place Reencode) first copies
+        the samples into storage of its own.
+    */
+    AudioBuffer(std::shared_ptr<const void> owner, std::span<const uint8_t> samples, SignalSpec spec,
+                AudioEncoding encoding);
+
+    // empty Float32 buffer, meant to be filled through NextFrameInto or ReencodeInto
+    AudioBuffer() : m_Encoding(AudioEncoding::Float32), m_Spec() {}
+
+    AudioBuffer(const AudioBuffer& other);
+    AudioBuffer(AudioBuffer&& other) noexcept;
+
+    AudioBuffer& operator=(const AudioBuffer& other);
+    AudioBuffer& operator=(AudioBuffer&& other) noexcept;
 
-    ~AudioBuffer() = default;
+    ~AudioBuffer();
 
     [[nodiscard]] SignalSpec Spec() const noexcept { return m_Spec; }
     [[nodiscard]] AudioEncoding Encoding() const noexcept { return m_Encoding; }
 
-    [[nodiscard]] size_t BufferLength() const noexcept { return m_Buffer.size(); }
+    [[nodiscard]] SampleLayout Layout() const noexcept { return m_Layout; }
+    [[nodiscard]] bool IsPlanar() const noexcept { return m_Layout == SampleLayout::Planar; }
+
+    // bytes from Data() to the end of the samples, which for planar buffers includes the plane padding
+    [[nodiscard]] size_t BufferLength() const noexcept
+    {
+        if (IsShared())
+            return m_SharedLength;
+
+        return IsPlanar() ? m_PlaneStride * m_Spec.m_Channels.Count() : m_Buffer.size();
+    }
+
+    [[nodiscard]] size_t SampleCount() const noexcept
+    {
+        return IsPlanar() ? m_PlaneFrames * m_Spec.m_Channels.Count() : BufferLength() / GetEffectiveEncodingSize(m_Encoding);
+    }
+    [[nodiscard]] size_t FrameCount() const noexcept
+    {
+        if (IsPlanar())
+            return m_PlaneFrames;
+
+        const size_t channels = m_Spec.m_Channels.Count();
+        return channels == 0 ? 0 : SampleCount() / channels;
+    }
+    [[nodiscard]] bool IsPooled() const noexcept { return m_Pooled; }
+    [[nodiscard]] bool IsShared() const noexcept { return m_SharedData != nullptr; }
+
+    [[nodiscard]] const uint8_t* Data() const noexcept { return IsShared() ? m_SharedData : m_Buffer.data() + m_PlaneOffset; }
+    // copies shared samples into storage of the buffer's own first
+    [[nodiscard]] uint8_t* Data()
+    {
+        if (IsShared())
+            Detach();
+
+        return m_Buffer.data() + m_PlaneOffset;
+    }
+    // only interleaved buffers owning their storage have a vector
+    [[nodiscard]] const std::vector<uint8_t>& Vector() const
+    {
+        if (IsShared())
+            throw std::runtime_error("Shared AudioBuffers aren't backed by a vector");
+        if (IsPlanar())
+            throw std::runtime_error("Planar AudioBuffers aren't backed by a vector of their samples");
+
+        return m_Buffer;
+    }
+
+    // The sample type has to match the buffer's encoding, and the buffer has to be interleaved.
+    template <typename T>
+    [[nodiscard]] AudioBufferView<T> View()
+    {
+        CheckViewType<T>();
+        return { std::span(reinterpret_cast<T*>(Data()), SampleCount()), m_Spec };
+    }
+
+    template <typename T>
+    [[nodiscard]] AudioBufferView<const T> View() const
+    {
+        CheckViewType<T>();
+        return { std::span(reinterpret_cast<const T*>(Data()), SampleCount()), m_Spec };
+    }
+
+    // distance between the starts of two planes, in bytes
+    [[nodiscard]] size_t PlaneStride() const noexcept { return m_PlaneStride; }
+
+    [[nodiscard]] const uint8_t* PlaneData(const size_t channel) const noexcept { return Data() + channel * m_PlaneStride; }
+    [[nodiscard]] uint8_t* PlaneData(const size_t channel) { return Data() + channel * m_PlaneStride; }
+
+    // The samples of one channel of a planar buffer, the sample type has to match the encoding.
+    template <typename T>
+    [[nodiscard]] std::span<T> Plane(const size_t channel)
+    {
+        CheckPlaneType<T>();
+        return { reinterpret_cast<T*>(PlaneData(channel)), m_PlaneFrames };
+    }
+
+    template <typename T>
+    [[nodiscard]] std::span<const T> Plane(const size_t channel) const
+    {
+        CheckPlaneType<T>();
+        return { reinterpret_cast<const T*>(PlaneData(channel)), m_PlaneFrames };
+    }
+
+    // Changes the format and length of the buffer. The storage is kept, so shrinking, or growing
+    // back to a length it already had, doesn't allocate. Contents are left unspecified.
+    void Reformat(SignalSpec spec, AudioEncoding encoding, size_t bufferLength);
+
+    // Makes the buffer alias memory kept alive by owner, like the aliasing constructor does, but holds on
+    // to its own storage so that a later Reformat can reuse it without allocating.
+    void Alias(std::shared_ptr<const void> owner, std::span<const uint8_t> samples, SignalSpec spec,
+               AudioEncoding encoding);
+
+    // Like Reformat, but makes the buffer planar, frameCount samples per plane.
+    void ReformatPlanar(SignalSpec spec, AudioEncoding encoding, size_t frameCount);
+
+    // Copies the samples of this interleaved buffer into dst as planes, reusing dst's storage.
+    void DeinterleaveInto(AudioBuffer& dst) const;
 
-    [[nodiscard]] const uint8_t* Data() const noexcept { return m_Buffer.data(); }
-    [[nodiscard]] const std::vector<uint8_t>& Vector() const noexcept { return m_Buffer; }
+    // Copies the samples of this planar buffer into dst interleaved, reusing dst's storage.
+    void InterleaveInto(AudioBuffer& dst) const;
+
+    // Copies count frames starting at frame first into dst, in this buffer's layout, reusing dst's storage.
+    void CopyFramesInto(AudioBuffer& dst, size_t first, size_t count) const;
+
+    // this buffer if it's interleaved, otherwise scratch holding its samples interleaved
+    [[nodiscard]] const AudioBuffer& Interleaved(AudioBuffer& scratch) const;
+
+    /*!
+        \brief Converts the samples into dst, reusing dst's storage; dst gets the same layout
+        \param dst may be this buffer, as long as the target encoding isn't wider than the current one
+    */
+    void ReencodeInto(AudioBuffer& dst, AudioEncoding encoding) const;
+
+    // Converts the samples in place; the target encoding must not be wider than the current one.
+    void Reencode(AudioEncoding encoding);
 
 private:
+    template <typename T>
+    void CheckViewType() const
+    {
+        if (SampleEncoding<std::remove_const_t<T>>::value != m_Encoding)
+            throw std::runtime_error("View type doesn't match the AudioBuffer's encoding");
+        if (IsPlanar())
+            throw std::runtime_error("Planar AudioBuffers have no interleaved view, use Plane()");
+    }
+
+    template <typename T>
+    void CheckPlaneType() const
+    {
+        if (SampleEncoding<std::remove_const_t<T>>::value != m_Encoding)
+            throw std::runtime_error("Plane type doesn't match the AudioBuffer's encoding");
+        if (!IsPlanar())
+            throw std::runtime_error("Interleaved AudioBuffers have no planes, use View()");
+    }
+
+    void ReencodePlanarInto(AudioBuffer& dst, AudioEncoding encoding) const;
+
+    // moves the planes onto an aligned address again after the storage was copied or reallocated
+    void AlignPlanes();
+
+    // hands pooled storage back to AudioBufferPool::Global() and drops any shared memory
+    void ReleaseStorage() noexcept;
+
+    // replaces the shared memory with an owned copy of it
+    void Detach();
+
     std::vector<uint8_t> m_Buffer;
     AudioEncoding m_Encoding;
     SignalSpec m_Spec;
+    bool m_Pooled = false;
+
+    SampleLayout m_Layout = SampleLayout::Interleaved;
+    // where the first plane starts in m_Buffer, vectors make no promise beyond malloc alignment
+    size_t m_PlaneOffset = 0;
+    size_t m_PlaneStride = 0;
+    size_t m_PlaneFrames = 0;
+
+    // size class the storage was drawn from
+    AudioEncoding m_PoolEncoding = AudioEncoding::Float32;
+    size_t m_PoolSampleCount = 0;
+
+    // memory the buffer aliases instead of m_Buffer, and whatever keeps it alive
+    std::shared_ptr<const void> m_SharedOwner;
+    const uint8_t* m_SharedData = nullptr;
+    size_t m_SharedLength = 0;
 };
 
 #endif //AUDIOBUFFER_H
@@ -0,0 +1,71 @@
+#include "AudioBufferPool.h"
+
+AudioBufferPool& AudioBufferPool::Global()
+{
+    static AudioBufferPool pool;
+    return pool;
+}
+
+std::vector<uint8_t> AudioBufferPool::Acquire(const AudioEncoding encoding, const size_t sampleCount)
+{
+    {
+        std::lock_guard lock(m_Mutex);
+
+        auto it = m_FreeLists.find({ encoding, sampleCount });
+        if (it != m_FreeLists.end() && !it->second.empty())
+        {
+            auto storage = std::move(it->second.back());
+            it->second.pop_back();
+
+            m_Hits.fetch_add(1, std::memory_order_relaxed);
+            return storage;
+        }
+    }
+
+    m_Misses.fetch_add(1, std::memory_order_relaxed);
+    return std::vector<uint8_t>(sampleCount * GetEffectiveEncodingSize(encoding));
+}
+
+void AudioBufferPool::Release(const AudioEncoding encoding, const size_t sampleCount, std::vector<uint8_t> storage) noexcept
+{
+    const size_t length = sampleCount * GetEffectiveEncodingSize(encoding);
+    if (length == 0 || storage.capacity() < length)
+        return;
+
+    storage.resize(length);
+
+    try
+    {
+        std::lock_guard lock(m_Mutex);
+
+        auto& freeList = m_FreeLists[{ encoding, sampleCount }];
+        if (freeList.size() < m_MaxBuffersPerClass)
+        {
+            freeList.push_back(std::move(storage));
+            m_Returns.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+    catch (...)
+    {
+        // growing a free list failed, the storage just gets freed instead
+    }
+
+    m_Discards.fetch_add(1, std::memory_order_relaxed);
+}
+
+AudioBufferPoolStats AudioBufferPool::Stats() const noexcept
+{
+    return {
+        .m_Hits = m_Hits.load(std::memory_order_relaxed),
+        .m_Misses = m_Misses.load(std::memory_order_relaxed),
+        .m_Returns = m_Returns.load(std::memory_order_relaxed),
+        .m_Discards = m_Discards.load(std::memory_order_relaxed),
+    };
+}
+
+void AudioBufferPool::Clear()
+{
+    std::lock_guard lock(m_Mutex);
+    m_FreeLists.clear();
+}
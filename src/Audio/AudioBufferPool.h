@@ -0,0 +1,66 @@
+#ifndef AUDIOBUFFERPOOL_H
+#define AUDIOBUFFERPOOL_H
+
+#include "AudioEncoding.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+struct AudioBufferPoolStats
+{
+    // Acquire calls served from a free list
+    size_t m_Hits;
+    // Acquire calls which had to allocate
+    size_t m_Misses;
+    // buffers taken back into a free list
+    size_t m_Returns;
+    // buffers freed because their free list was full
+    size_t m_Discards;
+};
+
+// Recycles AudioBuffer storage. Free lists are kept per size class, keyed by encoding and frame
+// length in samples, so the steady state of a pipeline which keeps producing frames of the same
+// shape doesn't touch the allocator.
+class AudioBufferPool
+{
+public:
+    explicit AudioBufferPool(size_t maxBuffersPerClass = 8) : m_MaxBuffersPerClass(maxBuffersPerClass) {}
+
+    AudioBufferPool(const AudioBufferPool&) = delete;
+    AudioBufferPool& operator=(const AudioBufferPool&) = delete;
+
+    // the pool AudioBuffer draws from and returns to
+    static AudioBufferPool& Global();
+
+    // storage of exactly sampleCount samples, contents unspecified
+    [[nodiscard]] std::vector<uint8_t> Acquire(AudioEncoding encoding, size_t sampleCount);
+
+    // Takes storage back into the size class it was acquired from. Storage which got narrowed in
+    // place in the meantime still has the capacity of its class, so resizing it back is free.
+    void Release(AudioEncoding encoding, size_t sampleCount, std::vector<uint8_t> storage) noexcept;
+
+    [[nodiscard]] AudioBufferPoolStats Stats() const noexcept;
+
+    // frees every pooled buffer
+    void Clear();
+
+private:
+    using SizeClass = std::pair<AudioEncoding, size_t>;
+
+    size_t m_MaxBuffersPerClass;
+
+    mutable std::mutex m_Mutex;
+    std::map<SizeClass, std::vector<std::vector<uint8_t>>> m_FreeLists;
+
+    std::atomic<size_t> m_Hits = 0;
+    std::atomic<size_t> m_Misses = 0;
+    std::atomic<size_t> m_Returns = 0;
+    std::atomic<size_t> m_Discards = 0;
+};
+
+#endif //AUDIOBUFFERPOOL_H
@@ -0,0 +1,84 @@
+#ifndef AUDIOENCODING_H
+#define AUDIOENCODING_H
+
+#include <cstddef>
+#include <cstdint>
+
+enum class AudioEncoding
+{
+    UInt8,
+    UInt16,
+    UInt24,
+    UInt32,
+    Int8,
+    Int16,
+    Int24,
+    Int32,
+    Float32,
+    Float64
+};
+
+constexpr size_t AUDIO_ENCODING_COUNT = 10;
+
+constexpr size_t GetEffectiveEncodingSize(AudioEncoding encoding)
+{
+    switch (encoding)
+    {
+    case AudioEncoding::UInt8:
+    case AudioEncoding::Int8:
+        return 1;
+    case AudioEncoding::UInt16:
+    case AudioEncoding::Int16:
+        return 2;
+    case AudioEncoding::UInt24:
+    case AudioEncoding::Int24:
+        return 3;
+    case AudioEncoding::Float32:
+    case AudioEncoding::UInt32:
+    case AudioEncoding::Int32:
+        return 4;
+    case AudioEncoding::Float64:
+        return 8;
+    default:
+        return 0;
+    }
+}
+
+struct __attribute__((packed)) Int24 {
+    int32_t value : 24;
+
+    Int24(const int32_t val = 0) { value = val; }
+
+    // convert to int32_t (with sign extension)
+    operator int32_t() const { return (value << 8) >> 8; }
+};
+
+struct __attribute__((packed)) UInt24 {
+    uint32_t value : 24;
+
+    UInt24(const uint32_t val = 0) { value = val; }
+
+    operator uint32_t() const { return value; }
+
+    UInt24 &operator+=(const Int24 i) {
+        value += i.value;
+        return *this;
+    };
+};
+
+// maps a sample type onto its AudioEncoding
+template <typename T>
+struct SampleEncoding;
+
+template <> struct SampleEncoding<uint8_t> { static constexpr AudioEncoding value = AudioEncoding::UInt8; };
+template <> struct SampleEncoding<uint16_t> { static constexpr AudioEncoding value = AudioEncoding::UInt16; };
+template <> struct SampleEncoding<UInt24> { static constexpr AudioEncoding value = AudioEncoding::UInt24; };
+template <> struct SampleEncoding<uint32_t> { static constexpr AudioEncoding value = AudioEncoding::UInt32; };
+template <> struct SampleEncoding<int8_t> { static constexpr AudioEncoding value = AudioEncoding::Int8; };
+template <> struct SampleEncoding<int16_t> { static constexpr AudioEncoding value = AudioEncoding::Int16; };
+template <> struct SampleEncoding<Int24> { static constexpr AudioEncoding value = AudioEncoding::Int24; };
+template <> struct SampleEncoding<int32_t> { static constexpr AudioEncoding value = AudioEncoding::Int32; };
+template <> struct SampleEncoding<float> { static constexpr AudioEncoding value = AudioEncoding::Float32; };
+template <> struct SampleEncoding<double> { static constexpr AudioEncoding value = AudioEncoding::Float64; };
+
+#endif //AUDIOENCODING_H
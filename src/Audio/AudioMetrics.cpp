@@ -0,0 +1,260 @@
+#include "AudioMetrics.h"
+#include "AudioOutput.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdio>
+
+void DurationHistogram::Record(const std::chrono::nanoseconds duration) noexcept
+{
+    const auto nanoseconds = static_cast<uint64_t>(std::max<int64_t>(duration.count(), 0));
+
+    m_Buckets[BucketIndex(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+    m_TotalNanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+
+    uint64_t max = m_MaxNanoseconds.load(std::memory_order_relaxed);
+    while (nanoseconds > max && !m_MaxNanoseconds.compare_exchange_weak(max, nanoseconds, std::memory_order_relaxed))
+    {
+    }
+}
+
+DurationHistogramSnapshot DurationHistogram::Snapshot() const noexcept
+{
+    // the buckets are read one by one, so a snapshot taken while recording may be off by the samples
+    // recorded meanwhile
+    std::array<uint64_t, BUCKET_COUNT> buckets {};
+    uint64_t count = 0;
+
+    for (size_t i = 0; i < BUCKET_COUNT; ++i)
+    {
+        buckets[i] = m_Buckets[i].load(std::memory_order_relaxed);
+        count += buckets[i];
+    }
+
+    DurationHistogramSnapshot snapshot {};
+    snapshot.m_Count = count;
+
+    if (count == 0)
+        return snapshot;
+
+    const auto max = static_cast<double>(m_MaxNanoseconds.load(std::memory_order_relaxed));
+    snapshot.m_MaxMicroseconds = max / 1000.;
+    snapshot.m_MeanMicroseconds =
+        static_cast<double>(m_TotalNanoseconds.load(std::memory_order_relaxed)) / static_cast<double>(count) / 1000.;
+
+    const auto percentile = [&](const double fraction) {
+        const auto rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(fraction * static_cast<double>(count))));
+
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKET_COUNT; ++i)
+        {
+            seen += buckets[i];
+            if (seen >= rank)
+                return std::min(BucketUpperBound(i), max) / 1000.;
+        }
+
+        return max / 1000.;
+    };
+
+    snapshot.m_P50Microseconds = percentile(0.5);
+    snapshot.m_P99Microseconds = percentile(0.99);
+    snapshot.m_P999Microseconds = percentile(0.999);
+
+    return snapshot;
+}
+
+size_t DurationHistogram::BucketIndex(const uint64_t nanoseconds) noexcept
+{
+    // below 4 ns every value gets its own bucket, above that the two bits after the leading one pick
+    // one of the four buckets of the octave
+    if (nanoseconds < SUB_BUCKETS)
+        return nanoseconds;
+
+    const auto exponent = static_cast<size_t>(std::bit_width(nanoseconds)) - 1;
+    const size_t mantissa = (nanoseconds >> (exponent - 2)) & (SUB_BUCKETS - 1);
+
+    return std::min((exponent - 1) * SUB_BUCKETS + mantissa, BUCKET_COUNT - 1);
+}
+
+double DurationHistogram::BucketUpperBound(const size_t index) noexcept
+{
+    if (index < SUB_BUCKETS)
+        return static_cast<double>(index);
+
+    const size_t exponent = index / SUB_BUCKETS + 1;
+    const size_t mantissa = index % SUB_BUCKETS;
+
+    // largest duration which still falls into the bucket
+    return std::ldexp(static_cast<double>(SUB_BUCKETS + mantissa + 1), static_cast<int>(exponent) - 2) - 1.;
+}
+
+static void AppendJsonString(std::string& out, const std::string& value)
+{
+    out += '"';
+
+    for (const char c : value)
+    {
+        if (c == '"' || c == '\\')
+        {
+            out += '\\';
+            out += c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20)
+        {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        }
+        else
+        {
+            out += c;
+        }
+    }
+
+    out += '"';
+}
+
+std::string ToJson(const AudioOutputSnapshot& snapshot)
+{
+    char buffer[512];
+    std::snprintf(buffer, sizeof(buffer),
+                  "{\"seconds\": %.3f, \"queued_bytes\": %zu, \"queued_ms\": %.3f, \"underruns\": %llu, "
+                  "\"late_writes\": %llu, \"frames_written\": %llu, \"device_period_ms\": %.3f, "
+                  "\"processing_ms\": %.3f, \"latency_ms\": %.3f, \"stages\": [",
+                  snapshot.m_Seconds, snapshot.m_QueuedBytes, snapshot.m_QueuedMilliseconds,
+                  static_cast<unsigned long long>(snapshot.m_Underruns),
+                  static_cast<unsigned long long>(snapshot.m_LateWrites),
+                  static_cast<unsigned long long>(snapshot.m_FramesWritten), snapshot.m_DevicePeriodMilliseconds,
+                  snapshot.m_ProcessingMilliseconds, snapshot.m_LatencyMilliseconds);
+
+    std::string json = buffer;
+
+    for (size_t i = 0; i < snapshot.m_Stages.size(); ++i)
+    {
+        const StageTiming& stage = snapshot.m_Stages[i];
+        const DurationHistogramSnapshot& timing = stage.m_Timing;
+
+        json += i == 0 ? "{\"name\": " : ", {\"name\": ";
+        AppendJsonString(json, stage.m_Name);
+
+        std::snprintf(buffer, sizeof(buffer),
+                      ", \"count\": %llu, \"mean_us\": %.3f, \"p50_us\": %.3f, \"p99_us\": %.3f, "
+                      "\"p999_us\": %.3f, \"max_us\": %.3f}",
+                      static_cast<unsigned long long>(timing.m_Count), timing.m_MeanMicroseconds,
+                      timing.m_P50Microseconds, timing.m_P99Microseconds, timing.m_P999Microseconds,
+                      timing.m_MaxMicroseconds);
+        json += buffer;
+    }
+
+    json += "]}";
+    return json;
+}
+
+DurationHistogram& AudioMetrics::Stage(const std::string& name)
+{
+    std::lock_guard lock(m_StagesMutex);
+
+    const auto it = std::find_if(m_Stages.begin(), m_Stages.end(),
+                                 [&](const NamedStage& stage) { return stage.m_Name == name; });
+    if (it != m_Stages.end())
+        return it->m_Histogram;
+
+    return m_Stages.emplace_back(name).m_Histogram;
+}
+
+double AudioMetrics::Seconds() const noexcept
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - m_Created).count();
+}
+
+std::vector<StageTiming> AudioMetrics::Stages() const
+{
+    std::lock_guard lock(m_StagesMutex);
+
+    std::vector<StageTiming> stages;
+    stages.reserve(m_Stages.size());
+
+    for (const NamedStage& stage : m_Stages)
+        stages.push_back({ stage.m_Name, stage.m_Histogram.Snapshot() });
+
+    return stages;
+}
+
+SourceProbe::SourceProbe(std::shared_ptr<AudioSource> source, std::shared_ptr<AudioMetrics> metrics,
+                         const std::string& stage)
+    : m_Source(std::move(source)), m_Metrics(std::move(metrics)), m_Timing(m_Metrics->Stage(stage))
+{
+}
+
+std::optional<AudioBuffer> SourceProbe::NextFrame()
+{
+    const auto start = std::chrono::steady_clock::now();
+    auto frame = m_Source->NextFrame();
+    m_Timing.Record(std::chrono::steady_clock::now() - start);
+
+    return frame;
+}
+
+bool SourceProbe::DoNextFrameInto(AudioBuffer& frame)
+{
+    const auto start = std::chrono::steady_clock::now();
+    const bool produced = m_Source->NextFrameInto(frame);
+    m_Timing.Record(std::chrono::steady_clock::now() - start);
+
+    return produced;
+}
+
+bool SourceProbe::NextFrameUpTo(AudioBuffer& frame, const size_t maxFrames)
+{
+    const auto start = std::chrono::steady_clock::now();
+    const bool produced = m_Source->NextFrameUpTo(frame, maxFrames);
+    m_Timing.Record(std::chrono::steady_clock::now() - start);
+
+    return produced;
+}
+
+AudioMetricsReporter::AudioMetricsReporter(AudioOutput& output, const std::chrono::milliseconds interval,
+                                           std::function<void(const AudioOutputSnapshot&)> callback)
+    : m_Output(output), m_Interval(interval), m_Callback(std::move(callback))
+{
+    if (interval <= std::chrono::milliseconds::zero())
+        throw std::runtime_error("Reporting interval must be positive");
+
+    m_Thread = std::thread(&AudioMetricsReporter::Run, this);
+}
+
+AudioMetricsReporter::~AudioMetricsReporter()
+{
+    Stop();
+}
+
+void AudioMetricsReporter::Stop()
+{
+    {
+        std::lock_guard lock(m_Mutex);
+        m_Stopping = true;
+    }
+
+    m_Wake.notify_all();
+
+    if (m_Thread.joinable())
+        m_Thread.join();
+}
+
+void AudioMetricsReporter::Run()
+{
+    std::unique_lock lock(m_Mutex);
+
+    // a steady schedule, so that a slow callback doesn't make the snapshots drift
+    auto next = std::chrono::steady_clock::now() + m_Interval;
+
+    while (!m_Wake.wait_until(lock, next, [this] { return m_Stopping; }))
+    {
+        lock.unlock();
+        m_Callback(m_Output.Snapshot());
+        lock.lock();
+
+        next += m_Interval;
+    }
+}
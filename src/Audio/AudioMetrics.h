@@ -0,0 +1,188 @@
+#ifndef AUDIOMETRICS_H
+#define AUDIOMETRICS_H
+
+#include "AudioSource.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class AudioOutput;
+
+struct DurationHistogramSnapshot
+{
+    uint64_t m_Count;
+    double m_MeanMicroseconds;
+    double m_MaxMicroseconds;
+    // upper bounds of the buckets the percentiles fall into, at most 25% above the exact value
+    double m_P50Microseconds;
+    double m_P99Microseconds;
+    double m_P999Microseconds;
+};
+
+// Histogram of durations with four buckets per octave, from a nanosecond up to about 18 minutes.
+// Recording is lock-free and never allocates, so audio threads can record into it.
+class DurationHistogram
+{
+public:
+    void Record(std::chrono::nanoseconds duration) noexcept;
+
+    [[nodiscard]] DurationHistogramSnapshot Snapshot() const noexcept;
+
+private:
+    static constexpr size_t SUB_BUCKETS = 4;
+    // up to 2^40 ns, longer durations land in the last bucket
+    static constexpr size_t BUCKET_COUNT = 40 * SUB_BUCKETS;
+
+    static size_t BucketIndex(uint64_t nanoseconds) noexcept;
+    static double BucketUpperBound(size_t index) noexcept;
+
+    std::array<std::atomic<uint64_t>, BUCKET_COUNT> m_Buckets {};
+    std::atomic<uint64_t> m_TotalNanoseconds = 0;
+    std::atomic<uint64_t> m_MaxNanoseconds = 0;
+};
+
+struct StageTiming
+{
+    std::string m_Name;
+    DurationHistogramSnapshot m_Timing;
+};
+
+struct AudioOutputSnapshot
+{
+    // since the output was opened
+    double m_Seconds;
+
+    // audio handed to the output which the device hasn't played yet
+    size_t m_QueuedBytes;
+    double m_QueuedMilliseconds;
+
+    // times the device had nothing to play while a stream was running
+    uint64_t m_Underruns;
+    // audio which reached the output with less than a device period left to spare
+    uint64_t m_LateWrites;
+    // sample frames handed to the device so far
+    uint64_t m_FramesWritten;
+
+    double m_DevicePeriodMilliseconds;
+    // mean time the slowest stage takes per frame, stage timings include everything upstream of them
+    double m_ProcessingMilliseconds;
+    // estimate of how long a sample takes from its source to the speaker: processing, the queue and
+    // one device period
+    double m_LatencyMilliseconds;
+
+    // in the order the stages were first timed
+    std::vector<StageTiming> m_Stages;
+};
+
+// one JSON object on a single line, so snapshots can be appended to a log as JSON lines
+[[nodiscard]] std::string ToJson(const AudioOutputSnapshot& snapshot);
+
+// Counters and per-stage timings of an output and the pipeline feeding it. Counting and timing are
+// lock-free and safe on the audio thread; only creating a stage and reading the stages take a lock.
+class AudioMetrics
+{
+public:
+    // Histogram of the named stage, created on first use. It lives as long as the metrics do.
+    DurationHistogram& Stage(const std::string& name);
+
+    void RecordUnderrun() noexcept { m_Underruns.fetch_add(1, std::memory_order_relaxed); }
+    void RecordLateWrite() noexcept { m_LateWrites.fetch_add(1, std::memory_order_relaxed); }
+    void RecordFrames(const size_t frames) noexcept { m_FramesWritten.fetch_add(frames, std::memory_order_relaxed); }
+
+    [[nodiscard]] uint64_t Underruns() const noexcept { return m_Underruns.load(std::memory_order_relaxed); }
+    [[nodiscard]] uint64_t LateWrites() const noexcept { return m_LateWrites.load(std::memory_order_relaxed); }
+    [[nodiscard]] uint64_t FramesWritten() const noexcept { return m_FramesWritten.load(std::memory_order_relaxed); }
+
+    [[nodiscard]] double Seconds() const noexcept;
+
+    [[nodiscard]] std::vector<StageTiming> Stages() const;
+
+private:
+    struct NamedStage
+    {
+        explicit NamedStage(std::string name) : m_Name(std::move(name)) {}
+
+        std::string m_Name;
+        DurationHistogram m_Histogram;
+    };
+
+    std::chrono::steady_clock::time_point m_Created = std::chrono::steady_clock::now();
+
+    std::atomic<uint64_t> m_Underruns = 0;
+    std::atomic<uint64_t> m_LateWrites = 0;
+    std::atomic<uint64_t> m_FramesWritten = 0;
+
+    mutable std::mutex m_StagesMutex;
+    // a deque never moves its elements, so handed out histograms stay put
+    std::deque<NamedStage> m_Stages;
+};
+
+// Passes a source through unchanged and times every frame pulled from it into a stage of the metrics.
+// The time includes pulling from upstream, so nested probes give inclusive timings.
+class SourceProbe : public AudioSource
+{
+public:
+    SourceProbe(std::shared_ptr<AudioSource> source, std::shared_ptr<AudioMetrics> metrics, const std::string& stage);
+
+    SignalSpec Spec() override { return m_Source->Spec(); }
+    AudioEncoding Encoding() override { return m_Source->Encoding(); }
+
+    std::optional<size_t> TotalSamples() override { return m_Source->TotalSamples(); }
+    std::optional<size_t> CurrentSample() override { return m_Source->CurrentSample(); }
+
+    std::optional<AudioBuffer> NextFrame() override;
+    bool NextFrameUpTo(AudioBuffer& frame, size_t maxFrames) override;
+
+    bool IsInfallible() override { return m_Source->IsInfallible(); }
+    bool IsSeekable() override { return m_Source->IsSeekable(); }
+
+protected:
+    void SeekTo(size_t sample) override { m_Source->Seek(sample); }
+    bool DoNextFrameInto(AudioBuffer& frame) override;
+
+private:
+    std::shared_ptr<AudioSource> m_Source;
+    std::shared_ptr<AudioMetrics> m_Metrics;
+    DurationHistogram& m_Timing;
+};
+
+// Snapshots an output on a background thread every interval and hands the snapshot to a callback,
+// e.g. to append ToJson() of it to a log. The output has to outlive the reporter.
+class AudioMetricsReporter
+{
+public:
+    AudioMetricsReporter(AudioOutput& output, std::chrono::milliseconds interval,
+                         std::function<void(const AudioOutputSnapshot&)> callback);
+
+    AudioMetricsReporter(const AudioMetricsReporter&) = delete;
+    AudioMetricsReporter& operator=(const AudioMetricsReporter&) = delete;
+
+    ~AudioMetricsReporter();
+
+    // joins the reporting thread, the callback isn't called anymore once this returns
+    void Stop();
+
+private:
+    void Run();
+
+    AudioOutput& m_Output;
+    std::chrono::milliseconds m_Interval;
+    std::function<void(const AudioOutputSnapshot&)> m_Callback;
+
+    std::mutex m_Mutex;
+    std::condition_variable m_Wake;
+    bool m_Stopping = false;
+    std::thread m_Thread;
+};
+
+#endif //AUDIOMETRICS_H
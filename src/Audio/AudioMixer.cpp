@@ -0,0 +1,240 @@
+#include "AudioMixer.h"
+#include "ChannelRemixer.h"
+#include "SampleConversions.h"
+#include "Simd.h"
+#include "SimdKernels.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+#include <stdexcept>
+
+PanGains ComputePanGains(const float gain, const float pan, const size_t sourceChannels,
+                         const size_t outChannels) noexcept
+{
+    const float clamped = std::clamp(pan, -1.f, 1.f);
+
+    float left = gain;
+    float right = gain;
+
+    if (sourceChannels == 1 && outChannels == 2)
+    {
+        // constant power, so a sweep keeps its loudness
+        const float angle = (clamped + 1.f) * static_cast<float>(M_PI) / 4.f;
+        left *= std::cos(angle);
+        right *= std::sin(angle);
+    }
+    else if (outChannels >= 2)
+    {
+        // balance, the other side stays untouched
+        left *= std::min(1.f, 1.f - clamped);
+        right *= std::min(1.f, 1.f + clamped);
+    }
+
+    return { left, right };
+}
+
+SourceMixer::SourceMixer(const SignalSpec spec, const size_t frameLength, const size_t maxVoices,
+                         const std::optional<float> limiterThreshold)
+    : m_Spec(spec), m_FrameLength(frameLength), m_MaxVoices(maxVoices), m_LimiterThreshold(limiterThreshold)
+{
+    if (spec.m_Channels.Count() == 0 || frameLength == 0)
+        throw std::runtime_error("SourceMixer needs at least one channel and a non-zero frame length");
+
+    if (limiterThreshold.has_value() && (*limiterThreshold < 0.f || *limiterThreshold >= 1.f))
+        throw std::runtime_error("Limiter threshold must be in [0, 1)");
+
+    // slots never move once reserved, so adding and removing voices doesn't reallocate
+    m_Voices.reserve(maxVoices);
+}
+
+MixerVoiceId SourceMixer::AddSource(std::shared_ptr<AudioSource> source, const float gain, const float pan)
+{
+    if (m_Voices.size() == m_MaxVoices)
+        throw std::runtime_error("SourceMixer has no free voice slots (" + std::to_string(m_MaxVoices) + ")");
+
+    const size_t outChannels = m_Spec.m_Channels.Count();
+
+    // mono sources get panned onto a stereo mix directly, any other layout mismatch gets remixed
+    const bool pannedMono = source->Spec().m_Channels.Count() == 1 && outChannels == 2;
+    if (source->Spec().m_Channels.Count() != outChannels && !pannedMono)
+        source = std::make_shared<SourceRemixer>(std::move(source), m_Spec.m_Channels);
+
+    const size_t channels = source->Spec().m_Channels.Count();
+
+    if (source->Spec().m_Rate != m_Spec.m_Rate)
+    {
+        const SignalSpec resampled { m_Spec.m_Rate, source->Spec().m_Channels };
+        source = std::make_shared<SourceResampler>(std::move(source), resampled);
+    }
+
+    Voice& voice = m_Voices.emplace_back();
+    voice.m_Id = m_NextId++;
+    voice.m_Source = std::move(source);
+    voice.m_Channels = channels;
+    voice.m_Gain = gain;
+    voice.m_Pan = pan;
+    UpdateGains(voice);
+
+    return voice.m_Id;
+}
+
+void SourceMixer::RemoveSource(const MixerVoiceId id)
+{
+    const auto it = std::find_if(m_Voices.begin(), m_Voices.end(), [id](const Voice& v) { return v.m_Id == id; });
+    if (it == m_Voices.end())
+        return;
+
+    // order doesn't matter to a sum
+    std::swap(*it, m_Voices.back());
+    m_Voices.pop_back();
+}
+
+void SourceMixer::SetGain(const MixerVoiceId id, const float gain)
+{
+    if (Voice* voice = FindVoice(id))
+    {
+        voice->m_Gain = gain;
+        UpdateGains(*voice);
+    }
+}
+
+void SourceMixer::SetPan(const MixerVoiceId id, const float pan)
+{
+    if (Voice* voice = FindVoice(id))
+    {
+        voice->m_Pan = pan;
+        UpdateGains(*voice);
+    }
+}
+
+bool SourceMixer::IsPlaying(const MixerVoiceId id) const noexcept
+{
+    return FindVoice(id) != nullptr;
+}
+
+SourceMixer::Voice* SourceMixer::FindVoice(const MixerVoiceId id) noexcept
+{
+    const auto it = std::find_if(m_Voices.begin(), m_Voices.end(), [id](const Voice& v) { return v.m_Id == id; });
+    return it == m_Voices.end() ? nullptr : &*it;
+}
+
+const SourceMixer::Voice* SourceMixer::FindVoice(const MixerVoiceId id) const noexcept
+{
+    const auto it = std::find_if(m_Voices.begin(), m_Voices.end(), [id](const Voice& v) { return v.m_Id == id; });
+    return it == m_Voices.end() ? nullptr : &*it;
+}
+
+void SourceMixer::UpdateGains(Voice& voice) const
+{
+    const auto [left, right] = ComputePanGains(voice.m_Gain, voice.m_Pan, voice.m_Channels, m_Spec.m_Channels.Count());
+
+    voice.m_Left = left;
+    voice.m_Right = right;
+
+    // one gain per output sample over SIMD_LANES frames, so the pattern spans whole vectors
+    voice.m_GainPattern.assign(SIMD_LANES * voice.m_Channels, voice.m_Gain);
+    if (voice.m_Channels >= 2)
+    {
+        for (size_t i = 0; i < voice.m_GainPattern.size(); i += voice.m_Channels)
+        {
+            voice.m_GainPattern[i] = left;
+            voice.m_GainPattern[i + 1] = right;
+        }
+    }
+}
+
+std::optional<AudioBuffer> SourceMixer::NextFrame()
+{
+    AudioBuffer frame;
+    NextFrameInto(frame);
+
+    return frame;
+}
+
+bool SourceMixer::DoNextFrameInto(AudioBuffer& frame)
+{
+    return NextFrameUpTo(frame, SIZE_MAX);
+}
+
+bool SourceMixer::NextFrameUpTo(AudioBuffer& frame, const size_t maxFrames)
+{
+    const size_t frameCount = std::min(m_FrameLength, maxFrames);
+    const size_t sampleCount = frameCount * m_Spec.m_Channels.Count();
+
+    frame.Reformat(m_Spec, AudioEncoding::Float32, sampleCount * sizeof(float));
+    float* out = frame.View<float>().Samples().data();
+    std::fill_n(out, sampleCount, 0.f);
+
+    for (size_t i = 0; i < m_Voices.size();)
+    {
+        if (MixVoice(m_Voices[i], out, frameCount))
+        {
+            ++i;
+            continue;
+        }
+
+        std::swap(m_Voices[i], m_Voices.back());
+        m_Voices.pop_back();
+    }
+
+    if (m_LimiterThreshold.has_value())
+        SoftLimit(out, sampleCount, *m_LimiterThreshold);
+
+    m_Position += frameCount;
+    return true;
+}
+
+bool SourceMixer::MixVoice(Voice& voice, float* out, const size_t frameCount)
+{
+    const size_t outChannels = m_Spec.m_Channels.Count();
+    const bool upmix = voice.m_Channels == 1 && outChannels == 2;
+
+    size_t done = 0;
+
+    while (done < frameCount)
+    {
+        if (voice.m_FrameOffset == voice.m_Frame.FrameCount())
+        {
+            // voices keep to the mix's frame length too, rather than decoding far ahead in bursts
+            if (!voice.m_Source->NextFrameUpTo(voice.m_Frame, frameCount - done))
+                return false;
+
+            voice.m_FrameOffset = 0;
+
+            if (voice.m_Frame.IsPlanar())
+            {
+                voice.m_Frame.InterleaveInto(voice.m_Interleaved);
+                std::swap(voice.m_Frame, voice.m_Interleaved);
+            }
+
+            if (voice.m_Frame.Encoding() != AudioEncoding::Float32)
+            {
+                // grows to the source's frame size once, then gets reused
+                voice.m_Converted.resize(voice.m_Frame.SampleCount());
+                ConvertSampleBuffer(std::as_const(voice.m_Frame).Data(), voice.m_Frame.Encoding(),
+                                    voice.m_Converted.data(), AudioEncoding::Float32, voice.m_Frame.SampleCount());
+            }
+
+            continue;
+        }
+
+        const float* samples = voice.m_Frame.Encoding() == AudioEncoding::Float32
+                                   ? reinterpret_cast<const float*>(std::as_const(voice.m_Frame).Data())
+                                   : voice.m_Converted.data();
+
+        const size_t count = std::min(frameCount - done, voice.m_Frame.FrameCount() - voice.m_FrameOffset);
+        const float* src = samples + voice.m_FrameOffset * voice.m_Channels;
+        float* dst = out + done * outChannels;
+
+        if (upmix)
+            MixAddMonoToStereo(dst, src, count, voice.m_Left, voice.m_Right);
+        else
+            MixAdd(dst, src, count * voice.m_Channels, voice.m_GainPattern.data(), voice.m_GainPattern.size());
+
+        done += count;
+        voice.m_FrameOffset += count;
+    }
+
+    return true;
+}
@@ -0,0 +1,113 @@
+#ifndef AUDIOMIXER_H
+#define AUDIOMIXER_H
+
+#include "AudioSource.h"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+using MixerVoiceId = uint32_t;
+
+// gains of the left and right channels of a source on a mix
+struct PanGains
+{
+    float m_Left;
+    float m_Right;
+};
+
+/*!
+    \brief Pan law of the mixers: constant power for mono sources on a stereo mix, so that a sweep keeps
+           its loudness, and balance otherwise, leaving the other side untouched
+    \param pan -1 (left) to 1 (right), clamped
+*/
+[[nodiscard]] PanGains ComputePanGains(float gain, float pan, size_t sourceChannels, size_t outChannels) noexcept;
+
+// Sums any number of sources into Float32 frames of a fixed length, with a gain and a pan per source
+// and a soft limiter on the sum. Sources get resampled to the mixer's rate, remixed to its layout
+// and converted to float on the way in. Once the voices are added, mixing itself doesn't allocate.
+//
+// Not thread safe: voices have to be added, changed and removed on the thread pulling the frames.
+class SourceMixer : public AudioSource
+{
+public:
+    /*!
+        \param spec rate and layout of the mix
+        \param frameLength frames produced by every NextFrame(), NextFrameUpTo() may ask for fewer
+        \param maxVoices voice slots, reserved up front
+        \param limiterThreshold level above which the sum gets limited, nullopt leaves it unlimited
+    */
+    SourceMixer(SignalSpec spec, size_t frameLength = 512, size_t maxVoices = 256,
+                std::optional<float> limiterThreshold = 0.8f);
+
+    /*!
+        \brief Starts mixing source in; it's dropped once it ends
+        \param pan -1 (left) to 1 (right), constant power for mono sources and balance for stereo ones
+    */
+    MixerVoiceId AddSource(std::shared_ptr<AudioSource> source, float gain = 1.f, float pan = 0.f);
+    void RemoveSource(MixerVoiceId id);
+
+    void SetGain(MixerVoiceId id, float gain);
+    void SetPan(MixerVoiceId id, float pan);
+
+    [[nodiscard]] bool IsPlaying(MixerVoiceId id) const noexcept;
+    [[nodiscard]] size_t ActiveVoices() const noexcept { return m_Voices.size(); }
+
+    SignalSpec Spec() override { return m_Spec; }
+    AudioEncoding Encoding() override { return AudioEncoding::Float32; }
+
+    std::optional<size_t> TotalSamples() override { return std::nullopt; }
+    std::optional<size_t> CurrentSample() override { return m_Position; }
+
+    std::optional<AudioBuffer> NextFrame() override;
+    bool NextFrameUpTo(AudioBuffer& frame, size_t maxFrames) override;
+
+    // the mixer carries on with silence when it has no voices, the voices' errors are rethrown
+    bool IsInfallible() override { return false; }
+
+protected:
+    bool DoNextFrameInto(AudioBuffer& frame) override;
+
+private:
+    struct Voice
+    {
+        MixerVoiceId m_Id;
+        std::shared_ptr<AudioSource> m_Source;
+        size_t m_Channels;
+
+        float m_Gain;
+        float m_Pan;
+        // per output sample gains for MixAdd, and the two gains of a mono source on a stereo mix
+        std::vector<float> m_GainPattern;
+        float m_Left;
+        float m_Right;
+
+        AudioBuffer m_Frame;
+        // planar frames get interleaved here, then swapped into m_Frame
+        AudioBuffer m_Interleaved;
+        // m_Frame as float, unless it already is
+        std::vector<float> m_Converted;
+        size_t m_FrameOffset = 0;
+    };
+
+    [[nodiscard]] Voice* FindVoice(MixerVoiceId id) noexcept;
+    [[nodiscard]] const Voice* FindVoice(MixerVoiceId id) const noexcept;
+
+    void UpdateGains(Voice& voice) const;
+
+    // adds frameCount frames of the voice to out, returns false once its source has ended
+    bool MixVoice(Voice& voice, float* out, size_t frameCount);
+
+    SignalSpec m_Spec;
+    size_t m_FrameLength;
+    size_t m_MaxVoices;
+    std::optional<float> m_LimiterThreshold;
+
+    std::vector<Voice> m_Voices;
+    MixerVoiceId m_NextId = 1;
+
+    size_t m_Position = 0;
+};
+
+#endif //AUDIOMIXER_H
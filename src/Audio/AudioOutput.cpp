@@ -4,7 +4,28 @@
 
 #include "AudioOutput.h"
 
+#include <SDL3/SDL_hints.h>
+
 #include <assert.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <optional>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+constexpr uint16_t WAVE_FORMAT_PCM = 0x0001;
+constexpr uint16_t WAVE_FORMAT_IEEE_FLOAT = 0x0003;
+constexpr uint16_t WAVE_FORMAT_EXTENSIBLE = 0xfffe;
+
+// the rest of the KSDATAFORMAT_SUBTYPE GUID after the format code
+constexpr uint8_t WAVE_SUBTYPE_SUFFIX[14] = {
+    0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xaa, 0x00, 0x38, 0x9b, 0x71
+};
 
 SDL_AudioFormat GetAudioFormat(AudioEncoding encoding)
 {
@@ -35,40 +56,152 @@ SDL_AudioSpec CreateSpec(const SignalSpec spec, const AudioEncoding encoding)
     return sdlSpec;
 }
 
-SdlAudioOutput::SdlAudioOutput(SignalSpec spec, AudioEncoding encoding)
-    : m_Spec(spec),
-      m_Encoding(encoding)
+// Opens the default playback device, asking SDL for a device buffer of periodFrames frames unless
+// that's 0. The hint only lives for the duration of the open, other devices keep SDL's default.
+static SDL_AudioDeviceID OpenDevice(const SDL_AudioSpec& sdlSpec, const size_t periodFrames)
+{
+    if (periodFrames == 0)
+        return SDL_OpenAudioDevice(SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK, &sdlSpec);
+
+    const char* previous = SDL_GetHint(SDL_HINT_AUDIO_DEVICE_SAMPLE_FRAMES);
+    const std::optional<std::string> restore = previous != nullptr ? std::optional<std::string>(previous) : std::nullopt;
+
+    SDL_SetHint(SDL_HINT_AUDIO_DEVICE_SAMPLE_FRAMES, std::to_string(periodFrames).c_str());
+    const SDL_AudioDeviceID device = SDL_OpenAudioDevice(SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK, &sdlSpec);
+    SDL_SetHint(SDL_HINT_AUDIO_DEVICE_SAMPLE_FRAMES, restore.has_value() ? restore->c_str() : nullptr);
+
+    return device;
+}
+
+// Opens the default playback device and binds a stream of the given format to it. The callback,
+// when given, is installed before binding so that it never sees a half constructed output.
+static void OpenBoundStream(const SignalSpec spec, const AudioEncoding encoding, const size_t periodFrames,
+                            SDL_AudioDeviceID& device, SDL_AudioStream*& stream,
+                            SDL_AudioStreamCallback callback = nullptr, void* userdata = nullptr)
 {
     SDL_AudioSpec sdlSpec = CreateSpec(spec, encoding);
 
-    m_Device = SDL_OpenAudioDevice(SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK, &sdlSpec);
-    m_Stream = SDL_CreateAudioStream(&sdlSpec, &sdlSpec);
+    device = OpenDevice(sdlSpec, periodFrames);
 
-    if (m_Device == 0)
+    if (device == 0)
     {
         throw std::runtime_error("Could not open audio device: " + std::string(SDL_GetError()));
     }
 
-    if (m_Stream == nullptr)
+    stream = SDL_CreateAudioStream(&sdlSpec, &sdlSpec);
+
+    if (stream == nullptr)
     {
-        SDL_CloseAudioDevice(m_Device);
+        SDL_CloseAudioDevice(device);
         throw std::runtime_error("Could not create audio stream: " + std::string(SDL_GetError()));
     }
 
-    if (!SDL_BindAudioStream(m_Device, m_Stream))
+    if (callback != nullptr && !SDL_SetAudioStreamGetCallback(stream, callback, userdata))
     {
-        SDL_DestroyAudioStream(m_Stream);
-        SDL_CloseAudioDevice(m_Device);
+        SDL_DestroyAudioStream(stream);
+        SDL_CloseAudioDevice(device);
+        throw std::runtime_error("Could not set audio stream callback: " + std::string(SDL_GetError()));
+    }
+
+    if (!SDL_BindAudioStream(device, stream))
+    {
+        SDL_DestroyAudioStream(stream);
+        SDL_CloseAudioDevice(device);
         throw std::runtime_error("Could not bind audio stream: " + std::string(SDL_GetError()));
     }
 }
 
+// frames the device asks for per period, 0 if SDL doesn't know
+static size_t QueryDevicePeriod(const SDL_AudioDeviceID device)
+{
+    SDL_AudioSpec spec;
+    int sampleFrames = 0;
+
+    if (!SDL_GetAudioDeviceFormat(device, &spec, &sampleFrames) || sampleFrames <= 0)
+        return 0;
+
+    return static_cast<size_t>(sampleFrames);
+}
+
+static size_t StreamQueued(SDL_AudioStream* stream)
+{
+    return static_cast<size_t>(std::max(SDL_GetAudioStreamQueued(stream), 0));
+}
+
+static double BytesToMilliseconds(const size_t bytes, const SignalSpec spec, const AudioEncoding encoding)
+{
+    const size_t frameSize = spec.m_Channels.Count() * GetEffectiveEncodingSize(encoding);
+    if (frameSize == 0 || spec.m_Rate == 0)
+        return 0.;
+
+    return static_cast<double>(bytes / frameSize) * 1000. / static_cast<double>(spec.m_Rate);
+}
+
+double AudioOutput::QueuedMilliseconds()
+{
+    return BytesToMilliseconds(QueuedBytes(), Spec(), Encoding());
+}
+
+AudioOutputSnapshot AudioOutput::Snapshot()
+{
+    AudioOutputSnapshot snapshot {};
+
+    snapshot.m_Seconds = m_Metrics->Seconds();
+    snapshot.m_QueuedBytes = QueuedBytes();
+    snapshot.m_QueuedMilliseconds = BytesToMilliseconds(snapshot.m_QueuedBytes, Spec(), Encoding());
+    snapshot.m_Underruns = m_Metrics->Underruns();
+    snapshot.m_LateWrites = m_Metrics->LateWrites();
+    snapshot.m_FramesWritten = m_Metrics->FramesWritten();
+    snapshot.m_DevicePeriodMilliseconds =
+        static_cast<double>(DevicePeriodFrames()) * 1000. / static_cast<double>(std::max(Spec().m_Rate, 1u));
+    snapshot.m_Stages = m_Metrics->Stages();
+
+    // stage timings include their upstream, so the slowest one is the closest to the whole pipeline
+    for (const StageTiming& stage : snapshot.m_Stages)
+    {
+        snapshot.m_ProcessingMilliseconds =
+            std::max(snapshot.m_ProcessingMilliseconds, stage.m_Timing.m_MeanMicroseconds / 1000.);
+    }
+
+    snapshot.m_LatencyMilliseconds =
+        snapshot.m_ProcessingMilliseconds + snapshot.m_QueuedMilliseconds + snapshot.m_DevicePeriodMilliseconds;
+
+    return snapshot;
+}
+
+static void CheckFormat(const SignalSpec spec, const AudioEncoding encoding, const SignalSpec expectedSpec,
+                        const AudioEncoding expectedEncoding)
+{
+    if (encoding != expectedEncoding)
+        throw std::runtime_error("AudioBuffer encoding must match the output encoding");
+
+    if (spec.m_Channels.Count() != expectedSpec.m_Channels.Count())
+        throw std::runtime_error("AudioBuffer channel layout must match the output channel layout");
+    if (spec.m_Rate != expectedSpec.m_Rate)
+        throw std::runtime_error("AudioBuffer sample rate must match the output sample rate");
+}
+
+SdlAudioOutput::SdlAudioOutput(SignalSpec spec, AudioEncoding encoding, const size_t periodFrames)
+    : m_Spec(spec),
+      m_Encoding(encoding),
+      m_WriteTiming(&m_Metrics->Stage("write"))
+{
+    OpenBoundStream(spec, encoding, periodFrames, m_Device, m_Stream);
+    m_DevicePeriodFrames = QueryDevicePeriod(m_Device);
+}
+
 SdlAudioOutput::SdlAudioOutput(SdlAudioOutput &&other) noexcept
     : m_Device(std::exchange(other.m_Device, 0)),
       m_Stream(std::exchange(other.m_Stream, nullptr)),
       m_Spec(std::exchange(other.m_Spec, {})),
-      m_Encoding(std::exchange(other.m_Encoding, AudioEncoding::UInt8))
+      m_Encoding(std::exchange(other.m_Encoding, AudioEncoding::UInt8)),
+      m_DevicePeriodFrames(std::exchange(other.m_DevicePeriodFrames, 0)),
+      m_Streaming(std::exchange(other.m_Streaming, false)),
+      m_WriteTiming(std::exchange(other.m_WriteTiming, nullptr)),
+      m_Interleaved(std::move(other.m_Interleaved))
 {
+    // the metrics go along with the device they describe
+    std::swap(m_Metrics, other.m_Metrics);
 }
 
 SdlAudioOutput & SdlAudioOutput::operator=(SdlAudioOutput &&other) noexcept
@@ -79,6 +212,11 @@ SdlAudioOutput & SdlAudioOutput::operator=(SdlAudioOutput &&other) noexcept
     std::swap(m_Stream, tmp.m_Stream);
     std::swap(m_Spec, tmp.m_Spec);
     std::swap(m_Encoding, tmp.m_Encoding);
+    std::swap(m_DevicePeriodFrames, tmp.m_DevicePeriodFrames);
+    std::swap(m_Streaming, tmp.m_Streaming);
+    std::swap(m_WriteTiming, tmp.m_WriteTiming);
+    std::swap(m_Metrics, tmp.m_Metrics);
+    std::swap(m_Interleaved, tmp.m_Interleaved);
 
     return *this;
 }
@@ -94,18 +232,619 @@ SdlAudioOutput::~SdlAudioOutput()
 
 void SdlAudioOutput::Write(const AudioBuffer& audioBuffer)
 {
-    if (audioBuffer.Encoding() != m_Encoding)
-        throw std::runtime_error("AudioBuffer encoding must match the output encoding");
+    CheckFormat(audioBuffer.Spec(), audioBuffer.Encoding(), m_Spec, m_Encoding);
 
-    if (audioBuffer.Spec().m_Channels.Count() != m_Spec.m_Channels.Count())
-        throw std::runtime_error("AudioBuffer channel layout must match the output channel layout");
-    if (audioBuffer.Spec().m_Rate != m_Spec.m_Rate)
-        throw std::runtime_error("AudioBuffer sample rate must match the output sample rate");
+    const auto start = std::chrono::steady_clock::now();
+
+    // an empty queue means the device has been playing silence since it ran dry
+    const size_t queued = StreamQueued(m_Stream);
+    const size_t frameSize = m_Spec.m_Channels.Count() * GetEffectiveEncodingSize(m_Encoding);
+
+    if (m_Streaming && queued == 0)
+        m_Metrics->RecordUnderrun();
+    else if (m_Streaming && queued < m_DevicePeriodFrames * frameSize)
+        m_Metrics->RecordLateWrite();
+
+    const AudioBuffer& interleaved = audioBuffer.Interleaved(m_Interleaved);
+    SDL_PutAudioStreamData(m_Stream, interleaved.Data(), static_cast<int32_t>(interleaved.BufferLength()));
 
-    SDL_PutAudioStreamData(m_Stream, audioBuffer.Data(), static_cast<int32_t>(audioBuffer.BufferLength()));
+    m_Streaming = true;
+    m_Metrics->RecordFrames(interleaved.FrameCount());
+    m_WriteTiming->Record(std::chrono::steady_clock::now() - start);
 }
 
 void SdlAudioOutput::Flush()
 {
     SDL_FlushAudioStream(m_Stream);
+
+    // the queue drains on purpose from here on
+    m_Streaming = false;
+}
+
+size_t SdlAudioOutput::QueuedBytes()
+{
+    return StreamQueued(m_Stream);
+}
+
+SdlCallbackAudioOutput::SdlCallbackAudioOutput(const SignalSpec spec, const AudioEncoding encoding,
+                                               const size_t periodFrames)
+    : m_Spec(spec),
+      m_Encoding(encoding),
+      m_FrameSize(spec.m_Channels.Count() * GetEffectiveEncodingSize(encoding)),
+      m_FillTiming(m_Metrics->Stage("callback"))
+{
+    if (m_FrameSize == 0)
+        throw std::runtime_error("Output needs at least one channel");
+
+    OpenBoundStream(spec, encoding, periodFrames, m_Device, m_Stream, &SdlCallbackAudioOutput::OnStreamRequest,
+                    this);
+    m_DevicePeriodFrames = QueryDevicePeriod(m_Device);
+}
+
+SdlCallbackAudioOutput::~SdlCallbackAudioOutput()
+{
+    // destroying the stream waits out a running callback
+    SDL_DestroyAudioStream(m_Stream);
+    SDL_CloseAudioDevice(m_Device);
+}
+
+void SdlCallbackAudioOutput::SetSource(std::shared_ptr<AudioSource> source)
+{
+    if (source != nullptr)
+        CheckFormat(source->Spec(), source->Encoding(), m_Spec, m_Encoding);
+
+    SDL_LockAudioStream(m_Stream);
+
+    // the old source gets destroyed outside of the lock, so the callback isn't held up by it
+    std::swap(m_Source, source);
+    m_FrameOffset = m_Frame.BufferLength();
+    m_SourceEnded = false;
+    m_SourceError = nullptr;
+
+    SDL_UnlockAudioStream(m_Stream);
+}
+
+bool SdlCallbackAudioOutput::IsFinished()
+{
+    SDL_LockAudioStream(m_Stream);
+
+    const bool ended = m_SourceEnded;
+    const std::exception_ptr error = std::exchange(m_SourceError, nullptr);
+
+    SDL_UnlockAudioStream(m_Stream);
+
+    if (error)
+        std::rethrow_exception(error);
+
+    return ended && SDL_GetAudioStreamQueued(m_Stream) == 0;
+}
+
+size_t SdlCallbackAudioOutput::QueuedBytes()
+{
+    SDL_LockAudioStream(m_Stream);
+    const size_t pending = m_Frame.BufferLength() - m_FrameOffset;
+    SDL_UnlockAudioStream(m_Stream);
+
+    return pending + StreamQueued(m_Stream);
+}
+
+void SdlCallbackAudioOutput::Write(const AudioBuffer&)
+{
+    throw std::runtime_error("Pull-mode outputs are fed by their source and can't be written to");
+}
+
+void SdlCallbackAudioOutput::Flush()
+{
+    SDL_FlushAudioStream(m_Stream);
+}
+
+void SDLCALL SdlCallbackAudioOutput::OnStreamRequest(void* userdata, SDL_AudioStream* stream,
+                                                     const int additionalAmount, const int /*totalAmount*/)
+{
+    auto* output = static_cast<SdlCallbackAudioOutput*>(userdata);
+
+    if (additionalAmount > 0)
+        output->Fill(stream, static_cast<size_t>(additionalAmount));
+}
+
+void SdlCallbackAudioOutput::Fill(SDL_AudioStream* stream, const size_t length)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    // whole frames only, SDL keeps the surplus for its next request
+    const size_t requested = (length + m_FrameSize - 1) / m_FrameSize * m_FrameSize;
+    size_t wanted = requested;
+
+    try
+    {
+        while (wanted > 0 && m_Source != nullptr && !m_SourceEnded)
+        {
+            if (m_FrameOffset == m_Frame.BufferLength())
+            {
+                // the whole chain runs at the size of the request, nothing is left over for the next one
+                if (!m_Source->NextFrameUpTo(m_Frame, wanted / m_FrameSize))
+                {
+                    m_SourceEnded = true;
+                    break;
+                }
+
+                if (m_Frame.Encoding() != m_Encoding)
+                    throw std::runtime_error("Source produced a frame in the wrong encoding");
+
+                if (m_Frame.IsPlanar())
+                {
+                    m_Frame.InterleaveInto(m_Interleaved);
+                    std::swap(m_Frame, m_Interleaved);
+                }
+
+                m_FrameOffset = 0;
+                continue;
+            }
+
+            const size_t count = std::min(wanted, m_Frame.BufferLength() - m_FrameOffset);
+            SDL_PutAudioStreamData(stream, m_Frame.Data() + m_FrameOffset, static_cast<int32_t>(count));
+
+            m_FrameOffset += count;
+            wanted -= count;
+        }
+    }
+    catch (...)
+    {
+        m_SourceError = std::current_exception();
+        m_SourceEnded = true;
+    }
+
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    m_FillTiming.Record(elapsed);
+    m_Metrics->RecordFrames((requested - wanted) / m_FrameSize);
+
+    // a source which has ended leaves silence behind on purpose, anything else is a dropout
+    if (wanted > 0 && m_Source != nullptr && !m_SourceEnded)
+        m_Metrics->RecordUnderrun();
+
+    const auto budget = std::chrono::duration<double>(static_cast<double>(requested / m_FrameSize) / m_Spec.m_Rate);
+    if (elapsed > budget)
+        m_Metrics->RecordLateWrite();
+}
+
+SdlRingAudioOutput::SdlRingAudioOutput(const SignalSpec spec, const AudioEncoding encoding,
+                                       const RingAudioOutputOptions options)
+    : m_Spec(spec),
+      m_Encoding(encoding),
+      m_FrameSize(spec.m_Channels.Count() * GetEffectiveEncodingSize(encoding)),
+      m_SourceTiming(m_Metrics->Stage("source")),
+      m_Ring(options.m_CapacityFrames * m_FrameSize),
+      m_HighWatermark(options.m_HighWatermarkFrames * m_FrameSize),
+      m_LowWatermark(options.m_LowWatermarkFrames * m_FrameSize)
+{
+    if (m_FrameSize == 0)
+        throw std::runtime_error("Output needs at least one channel");
+
+    if (options.m_LowWatermarkFrames >= options.m_HighWatermarkFrames ||
+        options.m_HighWatermarkFrames > options.m_CapacityFrames)
+    {
+        throw std::runtime_error("Ring watermarks must satisfy low < high <= capacity");
+    }
+
+    m_CallbackScratch.resize(m_Ring.Capacity() / m_FrameSize * m_FrameSize);
+
+    OpenBoundStream(spec, encoding, options.m_PeriodFrames, m_Device, m_Stream, &SdlRingAudioOutput::OnStreamRequest,
+                    this);
+    m_DevicePeriodFrames = QueryDevicePeriod(m_Device);
+}
+
+SdlRingAudioOutput::~SdlRingAudioOutput()
+{
+    try
+    {
+        Stop();
+    }
+    catch (...)
+    {
+    }
+
+    // destroying the stream waits out a running callback
+    SDL_DestroyAudioStream(m_Stream);
+    SDL_CloseAudioDevice(m_Device);
+}
+
+void SdlRingAudioOutput::Start(std::shared_ptr<AudioSource> source)
+{
+    if (m_Producer.joinable())
+        throw std::runtime_error("The output already has a producer");
+
+    CheckFormat(source->Spec(), source->Encoding(), m_Spec, m_Encoding);
+
+    m_Source = std::move(source);
+    m_ProducerError = nullptr;
+    m_Running.store(true, std::memory_order_release);
+    m_Producing.store(true, std::memory_order_release);
+
+    m_Producer = std::thread(&SdlRingAudioOutput::Produce, this);
+}
+
+void SdlRingAudioOutput::Stop()
+{
+    m_Running.store(false, std::memory_order_release);
+    m_Playing.store(false, std::memory_order_release);
+
+    // wakes the producer (or a blocked Write) out of WaitForConsumer
+    m_ConsumerSignal.fetch_add(1, std::memory_order_release);
+    m_ConsumerSignal.notify_all();
+
+    if (m_Producer.joinable())
+        m_Producer.join();
+
+    m_Source.reset();
+
+    if (m_ProducerError)
+        std::rethrow_exception(std::exchange(m_ProducerError, nullptr));
+}
+
+void SdlRingAudioOutput::Write(const AudioBuffer& audioBuffer)
+{
+    if (m_Producer.joinable())
+        throw std::runtime_error("Can't write into an output fed by a producer thread");
+
+    CheckFormat(audioBuffer.Spec(), audioBuffer.Encoding(), m_Spec, m_Encoding);
+
+    m_Running.store(true, std::memory_order_release);
+
+    const AudioBuffer& interleaved = audioBuffer.Interleaved(m_Interleaved);
+    WriteFrames(interleaved.Data(), interleaved.BufferLength());
+}
+
+void SdlRingAudioOutput::Flush()
+{
+    m_Playing.store(false, std::memory_order_release);
+}
+
+RingAudioOutputStats SdlRingAudioOutput::Stats() const noexcept
+{
+    const size_t fill = m_Ring.Size();
+    const double frames = static_cast<double>(fill / m_FrameSize);
+
+    return {
+        m_Metrics->Underruns(),
+        m_Overruns.load(std::memory_order_relaxed),
+        fill,
+        m_Ring.Capacity(),
+        frames * 1000. / static_cast<double>(m_Spec.m_Rate)
+    };
+}
+
+size_t SdlRingAudioOutput::QueuedBytes()
+{
+    return m_Ring.Size() + StreamQueued(m_Stream);
+}
+
+void SdlRingAudioOutput::Produce()
+{
+    // the ring gets topped up a device period at a time, in whatever frames the source makes otherwise
+    const size_t chunkFrames = m_DevicePeriodFrames > 0 ? m_DevicePeriodFrames : SIZE_MAX;
+
+    try
+    {
+        while (m_Running.load(std::memory_order_acquire))
+        {
+            const auto start = std::chrono::steady_clock::now();
+            const bool produced = m_Source->NextFrameUpTo(m_Frame, chunkFrames);
+            m_SourceTiming.Record(std::chrono::steady_clock::now() - start);
+
+            if (!produced)
+                break;
+
+            const AudioBuffer& interleaved = m_Frame.Interleaved(m_Interleaved);
+            WriteFrames(interleaved.Data(), interleaved.BufferLength());
+        }
+    }
+    catch (...)
+    {
+        m_ProducerError = std::current_exception();
+    }
+
+    // the device drains what's left without counting underruns
+    m_Playing.store(false, std::memory_order_release);
+    m_Producing.store(false, std::memory_order_release);
+}
+
+void SdlRingAudioOutput::WriteFrames(const uint8_t* data, size_t length)
+{
+    // less than a period left in the ring, the device nearly ran dry before this write
+    if (m_Playing.load(std::memory_order_acquire) && m_Ring.Size() < m_DevicePeriodFrames * m_FrameSize)
+        m_Metrics->RecordLateWrite();
+
+    while (length > 0 && m_Running.load(std::memory_order_acquire))
+    {
+        const size_t fill = m_Ring.Size();
+
+        if (fill >= m_HighWatermark)
+        {
+            WaitForConsumer();
+            continue;
+        }
+
+        // only whole frames go in, so the device never reads a torn frame
+        const size_t room = std::min(m_HighWatermark - fill, m_Ring.Capacity() - fill) / m_FrameSize * m_FrameSize;
+
+        if (room == 0)
+        {
+            m_Overruns.fetch_add(1, std::memory_order_relaxed);
+            WaitForConsumer();
+            continue;
+        }
+
+        const size_t written = m_Ring.Write(data, std::min(length, room));
+        data += written;
+        length -= written;
+
+        // the device only starts counting underruns once there has been something to play
+        if (!m_Playing.load(std::memory_order_relaxed))
+            m_Playing.store(true, std::memory_order_release);
+    }
+}
+
+void SdlRingAudioOutput::WaitForConsumer()
+{
+    const uint32_t signal = m_ConsumerSignal.load(std::memory_order_acquire);
+
+    // pairs with the fence in OnStreamRequest: either the callback sees the flag, or this thread
+    // sees the fill level the callback left behind
+    m_ProducerWaiting.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (m_Ring.Size() > m_LowWatermark && m_Running.load(std::memory_order_acquire))
+        m_ConsumerSignal.wait(signal, std::memory_order_acquire);
+
+    m_ProducerWaiting.store(false, std::memory_order_relaxed);
+}
+
+void SDLCALL SdlRingAudioOutput::OnStreamRequest(void* userdata, SDL_AudioStream* stream, const int additionalAmount,
+                                                 const int /*totalAmount*/)
+{
+    auto* output = static_cast<SdlRingAudioOutput*>(userdata);
+
+    if (additionalAmount <= 0)
+        return;
+
+    const size_t frameSize = output->m_FrameSize;
+    size_t wanted = (static_cast<size_t>(additionalAmount) + frameSize - 1) / frameSize * frameSize;
+
+    while (wanted > 0)
+    {
+        const size_t chunk = std::min(wanted, output->m_CallbackScratch.size());
+        const size_t available = std::min(chunk, output->m_Ring.Size() / frameSize * frameSize);
+        const size_t read = output->m_Ring.Read(output->m_CallbackScratch.data(), available);
+
+        if (read > 0)
+        {
+            SDL_PutAudioStreamData(stream, output->m_CallbackScratch.data(), static_cast<int32_t>(read));
+            output->m_Metrics->RecordFrames(read / frameSize);
+        }
+
+        wanted -= read;
+
+        if (read < chunk)
+            break;
+    }
+
+    // SDL plays silence for whatever is still missing
+    if (wanted > 0 && output->m_Playing.load(std::memory_order_acquire))
+        output->m_Metrics->RecordUnderrun();
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (output->m_Ring.Size() <= output->m_LowWatermark &&
+        output->m_ProducerWaiting.load(std::memory_order_relaxed))
+    {
+        output->m_ConsumerSignal.fetch_add(1, std::memory_order_release);
+        output->m_ConsumerSignal.notify_one();
+    }
+}
+
+template <typename T>
+static void AppendLittleEndian(std::vector<uint8_t>& out, const T value)
+{
+    for (size_t i = 0; i < sizeof(T); ++i)
+        out.push_back(static_cast<uint8_t>(static_cast<uint64_t>(value) >> (8 * i)));
+}
+
+static bool IsWavEncoding(const AudioEncoding encoding)
+{
+    switch (encoding)
+    {
+    case AudioEncoding::UInt8:
+    case AudioEncoding::Int16:
+    case AudioEncoding::Int24:
+    case AudioEncoding::Int32:
+    case AudioEncoding::Float32:
+    case AudioEncoding::Float64:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// writes all of data at offset, retrying short writes
+static void WriteFully(const int file, const uint8_t* data, size_t length, uint64_t offset, const std::string& path)
+{
+    while (length > 0)
+    {
+        const ssize_t written = pwrite(file, data, length, static_cast<off_t>(offset));
+
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            throw std::runtime_error("Could not write " + path + ": " + std::strerror(errno));
+        }
+
+        data += written;
+        length -= static_cast<size_t>(written);
+        offset += static_cast<uint64_t>(written);
+    }
+}
+
+FileAudioOutput::FileAudioOutput(const std::string& path, const SignalSpec spec, const AudioEncoding encoding,
+                                 const FileFormat format, const size_t bufferBytes)
+    : m_Path(path),
+      m_Spec(spec),
+      m_Encoding(encoding),
+      m_Format(format),
+      m_FrameSize(spec.m_Channels.Count() * GetEffectiveEncodingSize(encoding)),
+      m_WriteTiming(m_Metrics->Stage("write"))
+{
+    if (m_FrameSize == 0 || spec.m_Rate == 0)
+        throw std::runtime_error("Output needs at least one channel and a sample rate");
+
+    if (format == FileFormat::Wav && !IsWavEncoding(encoding))
+        throw std::runtime_error("WAV files can't hold this encoding, write a raw file instead");
+
+    // whole frames only, so that the file is valid after every staging flush
+    m_Staging.resize(std::max(bufferBytes / m_FrameSize, size_t { 1 }) * m_FrameSize);
+
+    m_File = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (m_File < 0)
+        throw std::runtime_error("Could not create " + path + ": " + std::strerror(errno));
+
+    try
+    {
+        WriteHeader();
+    }
+    catch (...)
+    {
+        close(m_File);
+        throw;
+    }
+}
+
+FileAudioOutput::~FileAudioOutput()
+{
+    try
+    {
+        Flush();
+    }
+    catch (...)
+    {
+    }
+
+    close(m_File);
+}
+
+void FileAudioOutput::Write(const AudioBuffer& audioBuffer)
+{
+    CheckFormat(audioBuffer.Spec(), audioBuffer.Encoding(), m_Spec, m_Encoding);
+
+    const auto start = std::chrono::steady_clock::now();
+
+    const AudioBuffer& interleaved = audioBuffer.Interleaved(m_Interleaved);
+    const uint8_t* data = interleaved.Data();
+    size_t length = interleaved.BufferLength();
+
+    // RIFF sizes are 32 bits, and the pad byte may need room as well
+    if (m_Format == FileFormat::Wav &&
+        m_HeaderSize + m_DataBytes + length + 1 > std::numeric_limits<uint32_t>::max())
+    {
+        throw std::runtime_error("WAV file " + m_Path + " would grow beyond 4 GiB");
+    }
+
+    m_Metrics->RecordFrames(length / m_FrameSize);
+
+    while (length > 0)
+    {
+        const size_t count = std::min(length, m_Staging.size() - m_Staged);
+        std::memcpy(m_Staging.data() + m_Staged, data, count);
+
+        m_Staged += count;
+        m_DataBytes += count;
+        data += count;
+        length -= count;
+
+        if (m_Staged == m_Staging.size())
+            WriteStaged();
+    }
+
+    m_WriteTiming.Record(std::chrono::steady_clock::now() - start);
+}
+
+void FileAudioOutput::Flush()
+{
+    WriteStaged();
+
+    if (m_Format == FileFormat::Wav)
+    {
+        // the data chunk gets padded to an even length, later samples simply overwrite the pad
+        if (m_DataBytes % 2 != 0)
+        {
+            constexpr uint8_t pad = 0;
+            WriteFully(m_File, &pad, 1, m_HeaderSize + m_DataBytes, m_Path);
+        }
+
+        WriteHeader();
+    }
+}
+
+void FileAudioOutput::WriteHeader()
+{
+    if (m_Format != FileFormat::Wav)
+        return;
+
+    const size_t channels = m_Spec.m_Channels.Count();
+    const size_t sampleSize = GetEffectiveEncodingSize(m_Encoding);
+    const bool isFloat = m_Encoding == AudioEncoding::Float32 || m_Encoding == AudioEncoding::Float64;
+    const uint16_t format = isFloat ? WAVE_FORMAT_IEEE_FLOAT : WAVE_FORMAT_PCM;
+
+    // plain format chunks are ambiguous about speaker positions and samples wider than 16 bits
+    const bool extensible = channels > 2 || (!isFloat && sampleSize > 2);
+    const uint32_t formatLength = extensible ? 40 : 16;
+    const uint64_t paddedData = m_DataBytes + m_DataBytes % 2;
+
+    std::vector<uint8_t> header;
+    header.reserve(68);
+
+    header.insert(header.end(), { 'R', 'I', 'F', 'F' });
+    AppendLittleEndian(header, static_cast<uint32_t>(4 + 8 + formatLength + 8 + paddedData));
+    header.insert(header.end(), { 'W', 'A', 'V', 'E', 'f', 'm', 't', ' ' });
+    AppendLittleEndian(header, formatLength);
+
+    AppendLittleEndian(header, extensible ? WAVE_FORMAT_EXTENSIBLE : format);
+    AppendLittleEndian(header, static_cast<uint16_t>(channels));
+    AppendLittleEndian(header, m_Spec.m_Rate);
+    AppendLittleEndian(header, static_cast<uint32_t>(m_Spec.m_Rate * m_FrameSize));
+    AppendLittleEndian(header, static_cast<uint16_t>(m_FrameSize));
+    AppendLittleEndian(header, static_cast<uint16_t>(sampleSize * 8));
+
+    if (extensible)
+    {
+        uint32_t channelMask = 0;
+        for (const auto flag : ALL_CHANNEL_FLAG_VALUES)
+        {
+            if (m_Spec.m_Channels.GetFlagState(flag))
+                channelMask |= static_cast<uint32_t>(flag);
+        }
+
+        AppendLittleEndian(header, uint16_t { 22 });
+        AppendLittleEndian(header, static_cast<uint16_t>(sampleSize * 8));
+        AppendLittleEndian(header, channelMask);
+        AppendLittleEndian(header, format);
+        header.insert(header.end(), std::begin(WAVE_SUBTYPE_SUFFIX), std::end(WAVE_SUBTYPE_SUFFIX));
+    }
+
+    header.insert(header.end(), { 'd', 'a', 't', 'a' });
+    AppendLittleEndian(header, static_cast<uint32_t>(m_DataBytes));
+
+    m_HeaderSize = header.size();
+    WriteFully(m_File, header.data(), header.size(), 0, m_Path);
+}
+
+void FileAudioOutput::WriteStaged()
+{
+    if (m_Staged == 0)
+        return;
+
+    const uint64_t offset = m_HeaderSize + m_DataBytes - m_Staged;
+    WriteFully(m_File, m_Staging.data(), m_Staged, offset, m_Path);
+
+    m_Staged = 0;
 }
@@ -6,8 +6,18 @@
 #define OUTPUT_H
 
 #include "AudioBuffer.h"
+#include "AudioMetrics.h"
+#include "AudioSource.h"
+#include "SpscRingBuffer.h"
 #include <SDL3/SDL_audio.h>
 
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
 class AudioOutput
 {
 public:
@@ -18,12 +28,35 @@ public:
 
     virtual SignalSpec Spec() = 0;
     virtual AudioEncoding Encoding() = 0;
+
+    // bytes handed to the output which the device hasn't played yet, safe to call from any thread
+    [[nodiscard]] virtual size_t QueuedBytes() = 0;
+
+    // frames the device consumes per period, 0 when unknown
+    [[nodiscard]] virtual size_t DevicePeriodFrames() { return 0; }
+
+    [[nodiscard]] double QueuedMilliseconds();
+
+    // Counters and stage timings of the output. Wrap pipeline stages in a SourceProbe on these
+    // metrics to have their NextFrame() times show up in the snapshots.
+    [[nodiscard]] AudioMetrics& Metrics() noexcept { return *m_Metrics; }
+    [[nodiscard]] const std::shared_ptr<AudioMetrics>& SharedMetrics() const noexcept { return m_Metrics; }
+
+    [[nodiscard]] AudioOutputSnapshot Snapshot();
+
+protected:
+    std::shared_ptr<AudioMetrics> m_Metrics = std::make_shared<AudioMetrics>();
 };
 
 class SdlAudioOutput : public AudioOutput
 {
 public:
-    SdlAudioOutput(SignalSpec spec, AudioEncoding encoding);
+    /*!
+        \param periodFrames device buffer size to ask SDL for, 0 keeps SDL's default; DevicePeriodFrames()
+               tells what the device settled on. Writing frames of about that size, e.g. pulled with
+               NextFrameUpTo(), keeps the latency down to a couple of periods
+    */
+    SdlAudioOutput(SignalSpec spec, AudioEncoding encoding, size_t periodFrames = 0);
 
     SdlAudioOutput(SdlAudioOutput &&other) noexcept;
 
@@ -43,12 +76,254 @@ public:
 
     [[nodiscard]] AudioEncoding Encoding() override { return m_Encoding; }
 
+    [[nodiscard]] size_t QueuedBytes() override;
+    [[nodiscard]] size_t DevicePeriodFrames() override { return m_DevicePeriodFrames; }
+
 private:
     SDL_AudioDeviceID m_Device;
     SDL_AudioStream *m_Stream;
 
     SignalSpec m_Spec;
     AudioEncoding m_Encoding;
+    size_t m_DevicePeriodFrames = 0;
+
+    // whether the stream has been written to since the last flush, only then can the device starve
+    bool m_Streaming = false;
+    DurationHistogram* m_WriteTiming;
+
+    // planar buffers get interleaved here on their way out
+    AudioBuffer m_Interleaved;
+};
+
+// Pull-mode output: SDL's stream callback asks the source for exactly as many bytes as the device
+// needs, so nothing sits queued beyond a device period and no thread has to spin on Write(). Sources
+// get pulled through NextFrameUpTo(), so with a small period the whole chain runs in small frames.
+// The dummy audio driver (SDL_AUDIO_DRIVER=dummy) drives the callback as well, so this works headless.
+class SdlCallbackAudioOutput : public AudioOutput
+{
+public:
+    // periodFrames is the device buffer size to ask SDL for, 0 keeps SDL's default
+    SdlCallbackAudioOutput(SignalSpec spec, AudioEncoding encoding, size_t periodFrames = 0);
+
+    // the SDL callback holds a pointer to the output, so it has to stay put
+    SdlCallbackAudioOutput(const SdlCallbackAudioOutput&) = delete;
+    SdlCallbackAudioOutput& operator=(const SdlCallbackAudioOutput&) = delete;
+
+    ~SdlCallbackAudioOutput() override;
+
+    // Replaces the source the device pulls from, its format must match the output's. A null source
+    // plays silence.
+    void SetSource(std::shared_ptr<AudioSource> source);
+
+    // True once the source has ended and SDL has played everything it was given. Rethrows whatever
+    // the source threw on the audio thread.
+    [[nodiscard]] bool IsFinished();
+
+    // Pull-mode outputs are fed by their source, this always throws.
+    void Write(const AudioBuffer&) override;
+
+    void Flush() override;
+
+    [[nodiscard]] SignalSpec Spec() override { return m_Spec; }
+    [[nodiscard]] AudioEncoding Encoding() override { return m_Encoding; }
+
+    // SDL's queue plus the part of the current frame it hasn't been given yet
+    [[nodiscard]] size_t QueuedBytes() override;
+    [[nodiscard]] size_t DevicePeriodFrames() override { return m_DevicePeriodFrames; }
+
+private:
+    static void SDLCALL OnStreamRequest(void* userdata, SDL_AudioStream* stream, int additionalAmount, int totalAmount);
+
+    // Fills are late when they take longer than the audio they deliver, and underrun when the source
+    // couldn't deliver all of it.
+    void Fill(SDL_AudioStream* stream, size_t length);
+
+    SDL_AudioDeviceID m_Device = 0;
+    SDL_AudioStream* m_Stream = nullptr;
+
+    SignalSpec m_Spec;
+    AudioEncoding m_Encoding;
+    size_t m_FrameSize;
+    size_t m_DevicePeriodFrames = 0;
+    DurationHistogram& m_FillTiming;
+
+    // everything below is owned by the audio thread, other threads only touch it under the stream lock
+    std::shared_ptr<AudioSource> m_Source;
+    AudioBuffer m_Frame;
+    // planar frames get interleaved here, then swapped into m_Frame
+    AudioBuffer m_Interleaved;
+    // bytes of m_Frame already handed to SDL
+    size_t m_FrameOffset = 0;
+    bool m_SourceEnded = false;
+    std::exception_ptr m_SourceError;
+};
+
+struct RingAudioOutputOptions
+{
+    // ring size, rounded up so that the ring holds a power of two bytes
+    size_t m_CapacityFrames = 8192;
+    // the producer stops filling once the ring holds this many frames...
+    size_t m_HighWatermarkFrames = 6144;
+    // ...and gets woken up by the device once it drains below this many
+    size_t m_LowWatermarkFrames = 2048;
+    // device buffer size to ask SDL for, 0 keeps SDL's default; the producer pulls frames of the
+    // period the device settles on
+    size_t m_PeriodFrames = 0;
+};
+
+struct RingAudioOutputStats
+{
+    // device requests the ring couldn't fully serve while playing
+    uint64_t m_Underruns;
+    // writes which found the ring full and had to wait for the device
+    uint64_t m_Overruns;
+
+    size_t m_FillBytes;
+    size_t m_CapacityBytes;
+    double m_FillMilliseconds;
+};
+
+// Output decoupled from the thread producing the audio: PCM goes through a wait-free SPSC ring which
+// the SDL stream callback drains. Either Start() a producer thread pulling from an AudioSource, or
+// push through Write(), which only blocks when the ring is full.
+class SdlRingAudioOutput : public AudioOutput
+{
+public:
+    SdlRingAudioOutput(SignalSpec spec, AudioEncoding encoding, RingAudioOutputOptions options = {});
+
+    // the SDL callback holds a pointer to the output, so it has to stay put
+    SdlRingAudioOutput(const SdlRingAudioOutput&) = delete;
+    SdlRingAudioOutput& operator=(const SdlRingAudioOutput&) = delete;
+
+    ~SdlRingAudioOutput() override;
+
+    // Starts a producer thread feeding the ring from source, whose format must match the output's.
+    void Start(std::shared_ptr<AudioSource> source);
+
+    // Joins the producer thread, rethrowing whatever the source threw on it.
+    void Stop();
+
+    // true while the producer thread hasn't run out of input
+    [[nodiscard]] bool IsProducing() const noexcept { return m_Producing.load(std::memory_order_acquire); }
+
+    void Write(const AudioBuffer&) override;
+
+    // Marks the end of the pushed data, so that draining the ring doesn't count as underrunning.
+    void Flush() override;
+
+    [[nodiscard]] SignalSpec Spec() override { return m_Spec; }
+    [[nodiscard]] AudioEncoding Encoding() override { return m_Encoding; }
+
+    [[nodiscard]] RingAudioOutputStats Stats() const noexcept;
+
+    // the ring plus SDL's queue
+    [[nodiscard]] size_t QueuedBytes() override;
+    [[nodiscard]] size_t DevicePeriodFrames() override { return m_DevicePeriodFrames; }
+
+private:
+    static void SDLCALL OnStreamRequest(void* userdata, SDL_AudioStream* stream, int additionalAmount, int totalAmount);
+
+    void Produce();
+
+    // writes whole frames, waiting for the device whenever the ring is above the high watermark
+    void WriteFrames(const uint8_t* data, size_t length);
+
+    // blocks until the device drains the ring below the low watermark, or the output stops
+    void WaitForConsumer();
+
+    SDL_AudioDeviceID m_Device = 0;
+    SDL_AudioStream* m_Stream = nullptr;
+
+    SignalSpec m_Spec;
+    AudioEncoding m_Encoding;
+    size_t m_FrameSize;
+    size_t m_DevicePeriodFrames = 0;
+    // time the producer spends pulling a frame from its source
+    DurationHistogram& m_SourceTiming;
+
+    SpscByteRing m_Ring;
+    size_t m_HighWatermark;
+    size_t m_LowWatermark;
+
+    // staging for the callback, sized once so that the audio thread never allocates
+    std::vector<uint8_t> m_CallbackScratch;
+
+    std::shared_ptr<AudioSource> m_Source;
+    AudioBuffer m_Frame;
+    // planar frames get interleaved here, by Write() or by the producer, whichever feeds the ring
+    AudioBuffer m_Interleaved;
+    std::thread m_Producer;
+    std::exception_ptr m_ProducerError;
+
+    std::atomic<bool> m_Running = false;
+    std::atomic<bool> m_Producing = false;
+    // whether the ring should be holding data, underruns only count while it is
+    std::atomic<bool> m_Playing = false;
+
+    std::atomic<bool> m_ProducerWaiting = false;
+    std::atomic<uint32_t> m_ConsumerSignal = 0;
+
+    std::atomic<uint64_t> m_Overruns = 0;
+};
+
+enum class FileFormat
+{
+    // RIFF/WAVE, readable by WavSource; the sizes in the header get patched on every Flush()
+    Wav,
+    // bare interleaved samples
+    Raw
+};
+
+// Output writing to a file instead of a device, for rendering a graph offline. Samples collect in a
+// large staging buffer which goes out in one write(2) whenever it fills up, so the file system sees
+// few large writes no matter how small the frames are.
+class FileAudioOutput : public AudioOutput
+{
+public:
+    // WAV files take UInt8, Int16, Int24, Int32, Float32 and Float64, raw files any encoding
+    FileAudioOutput(const std::string& path, SignalSpec spec, AudioEncoding encoding,
+                    FileFormat format = FileFormat::Wav, size_t bufferBytes = 4 * 1024 * 1024);
+
+    FileAudioOutput(const FileAudioOutput&) = delete;
+    FileAudioOutput& operator=(const FileAudioOutput&) = delete;
+
+    // flushes, errors get lost here, call Flush() beforehand to see them
+    ~FileAudioOutput() override;
+
+    void Write(const AudioBuffer&) override;
+
+    // Writes out the staging buffer and brings the WAV header up to date, leaving a valid file behind.
+    void Flush() override;
+
+    [[nodiscard]] SignalSpec Spec() override { return m_Spec; }
+    [[nodiscard]] AudioEncoding Encoding() override { return m_Encoding; }
+
+    // what's staged and not written to the file yet
+    [[nodiscard]] size_t QueuedBytes() override { return m_Staged; }
+
+    [[nodiscard]] size_t FramesWritten() const noexcept { return m_DataBytes / m_FrameSize; }
+
+private:
+    void WriteHeader();
+    void WriteStaged();
+
+    std::string m_Path;
+    int m_File = -1;
+
+    SignalSpec m_Spec;
+    AudioEncoding m_Encoding;
+    FileFormat m_Format;
+    size_t m_FrameSize;
+
+    std::vector<uint8_t> m_Staging;
+    size_t m_Staged = 0;
+
+    // sample bytes accepted so far, staged ones included
+    uint64_t m_DataBytes = 0;
+    size_t m_HeaderSize = 0;
+
+    AudioBuffer m_Interleaved;
+    DurationHistogram& m_WriteTiming;
 };
 
 #endif //OUTPUT_H
@@ -6,19 +6,97 @@
 #include "ChannelLayout.h"
 #include "AudioSource.h"
 #include <algorithm>
+#include <cstdint>
 #include <iostream>
 #include <memory>
 #include <optional>
+#include <span>
 #include <stdexcept>
 #include <utility>
 #include <vector>
 
 #include "SampleConversions.h"
 
+bool AudioSource::NextFrameUpTo(AudioBuffer& frame, const size_t maxFrames)
+{
+    if (maxFrames == 0)
+        throw std::runtime_error("Frames have to hold at least one frame");
+
+    if (!HoldsSplitFrame())
+    {
+        // a piece of the last split frame in there would keep it from being reused; letting go of it
+        // keeps the frame's own storage
+        if (frame.IsShared())
+            frame.Reformat(frame.Spec(), frame.Encoding(), 0);
+
+        // nothing held back, so frames short enough go out untouched
+        if (!DoNextFrameInto(frame))
+            return false;
+
+        if (frame.FrameCount() <= maxFrames)
+            return true;
+
+        // only when a piece handed out earlier is still held somewhere
+        if (!m_Remainder || m_Remainder.use_count() > 1)
+            m_Remainder = std::make_shared<AudioBuffer>();
+
+        // the storage the remainder had goes to the frame, to be reused by the next whole frame
+        std::swap(frame, *m_Remainder);
+        m_RemainderFrames = m_Remainder->FrameCount();
+        m_RemainderFrameSize = m_Remainder->Spec().m_Channels.Count() * GetEffectiveEncodingSize(m_Remainder->Encoding());
+        m_RemainderOffset = 0;
+    }
+
+    const AudioBuffer& held = *m_Remainder;
+    const size_t count = std::min(maxFrames, m_RemainderFrames - m_RemainderOffset);
+
+    if (held.IsPlanar())
+    {
+        held.CopyFramesInto(frame, m_RemainderOffset, count);
+    }
+    else
+    {
+        const std::span piece(held.Data() + m_RemainderOffset * m_RemainderFrameSize, count * m_RemainderFrameSize);
+        frame.Alias(m_Remainder, piece, held.Spec(), held.Encoding());
+    }
+
+    m_RemainderOffset += count;
+    return true;
+}
+
+void AudioSource::Seek(const size_t sample)
+{
+    if (!IsSeekable())
+        throw std::runtime_error("This source can't seek");
+
+    // frames split before the seek belong to the old position
+    m_RemainderOffset = m_RemainderFrames;
+
+    SeekTo(sample);
+}
+
+void AudioSource::SeekTo(size_t)
+{
+    throw std::runtime_error("This source can't seek");
+}
+
+// input frames to ask for to get about maxFrames frames out of a rate change from one rate to another
+static size_t ScaleFrameLimit(const size_t maxFrames, const uint32_t from, const uint32_t to)
+{
+    if (maxFrames >= SIZE_MAX / std::max(from, 1u) || to == 0)
+        return SIZE_MAX;
 
-SourceResampler::SourceResampler(std::shared_ptr<AudioSource> source, SignalSpec targetSpec)
-    : m_Spec(targetSpec), m_Source(std::move(source))
+    return std::max<size_t>(1, (maxFrames * from + to - 1) / to);
+}
+
+
+SourceResampler::SourceResampler(std::shared_ptr<AudioSource> source, SignalSpec targetSpec, ResamplerQuality quality)
+    : m_Spec(targetSpec),
+      m_Source(std::move(source)),
+      m_Resampler(m_Source->Spec().m_Rate, targetSpec.m_Rate, targetSpec.m_Channels.Count(), quality)
 {
+    if (m_Source->Spec().m_Channels.Count() != m_Spec.m_Channels.Count())
+        throw std::runtime_error("SourceResampler can't change the channel count");
 }
 
 std::optional<size_t> SourceResampler::TotalSamples()
@@ -30,38 +108,140 @@ std::optional<size_t> SourceResampler::TotalSamples()
         return std::nullopt;
     }
 
-    const double origTotalSamplesDouble = static_cast<double>(originalTotalSamples.value());
-    const double origSampleRate = m_Source->Spec().m_Rate;
-    const double targetSampleRate = m_Spec.m_Rate;
-
-    return static_cast<size_t>(origTotalSamplesDouble * (targetSampleRate / origSampleRate));
+    return static_cast<size_t>(m_Resampler.OutputLength(originalTotalSamples.value()));
 }
 
 std::optional<size_t> SourceResampler::CurrentSample()
 {
-    auto originalCurrentSample = m_Source->CurrentSample();
+    return static_cast<size_t>(m_Resampler.OutputPosition()) + m_SkipFrames;
+}
 
-    if (!originalCurrentSample.has_value())
-    {
+void SourceResampler::SeekTo(size_t sample)
+{
+    if (const auto total = TotalSamples(); total.has_value())
+        sample = std::min(sample, *total);
+
+    // restarts on the last output frame at or before sample which sits exactly on an input frame and
+    // has a whole kernel of input before it, the rest up to sample gets dropped again
+    const PolyphaseFilterBank& filter = m_Resampler.FilterBank();
+    const uint64_t restart = m_Resampler.Restart(sample / filter.Interpolation() * filter.Interpolation());
+
+    m_Source->Seek(static_cast<size_t>(m_Resampler.InputPosition()));
+    m_SkipFrames = sample - static_cast<size_t>(restart);
+}
+
+std::optional<AudioBuffer> SourceResampler::NextFrame()
+{
+    AudioBuffer frame;
+    if (!NextFrameInto(frame))
         return std::nullopt;
+
+    return frame;
+}
+
+bool SourceResampler::DoNextFrameInto(AudioBuffer& frame)
+{
+    return NextFrameUpTo(frame, SIZE_MAX);
+}
+
+bool SourceResampler::NextFrameUpTo(AudioBuffer& frame, const size_t maxFrames)
+{
+    const size_t channels = m_Spec.m_Channels.Count();
+    // upstream gets asked for about as much as this frame needs, so the chain keeps to the limit
+    const size_t inputLimit = ScaleFrameLimit(maxFrames, m_Source->Spec().m_Rate, m_Spec.m_Rate);
+
+    while (true)
+    {
+        while (m_Resampler.AvailableFrames() == 0 && !m_Resampler.IsFinished())
+        {
+            if (!m_Source->NextFrameUpTo(m_Input, inputLimit))
+            {
+                m_Resampler.Finish();
+                break;
+            }
+
+            if (m_Input.IsPlanar())
+            {
+                m_Input.InterleaveInto(m_Interleaved);
+                std::swap(m_Input, m_Interleaved);
+            }
+
+            const auto start = std::chrono::steady_clock::now();
+
+            const size_t sampleCount = m_Input.SampleCount();
+            const float* samples;
+
+            if (m_Input.Encoding() == AudioEncoding::Float32)
+            {
+                samples = m_Input.View<float>().Samples().data();
+            }
+            else
+            {
+                m_FloatInput.resize(sampleCount);
+                ConvertSampleBuffer(m_Input.Data(), m_Input.Encoding(), m_FloatInput.data(), AudioEncoding::Float32, sampleCount);
+                samples = m_FloatInput.data();
+            }
+
+            m_Resampler.Push(samples, sampleCount / channels);
+
+            m_ProcessingTime += std::chrono::steady_clock::now() - start;
+        }
+
+        // after a seek, the frames in front of the target get pulled and dropped
+        const size_t skip = std::min(m_SkipFrames, m_Resampler.AvailableFrames());
+        if (skip == 0)
+            break;
+
+        m_FloatInput.resize(skip * channels);
+        m_Resampler.Pull(m_FloatInput.data(), skip);
+        m_SkipFrames -= skip;
     }
 
-    const double origCurrentSampleDouble = static_cast<double>(originalCurrentSample.value());
-    const double origSampleRate = m_Source->Spec().m_Rate;
-    const double targetSampleRate = m_Spec.m_Rate;
+    const size_t frameCount = std::min(m_Resampler.AvailableFrames(), maxFrames);
+    if (frameCount == 0)
+        return false;
 
-    return static_cast<size_t>(origCurrentSampleDouble * (targetSampleRate / origSampleRate));
+    const auto start = std::chrono::steady_clock::now();
+
+    frame.Reformat(m_Spec, AudioEncoding::Float32, frameCount * channels * sizeof(float));
+    m_Resampler.Pull(frame.View<float>().Samples().data(), frameCount);
+
+    // hand the frame out in the encoding it came in with
+    const AudioEncoding encoding = m_Source->Encoding();
+    if (GetEffectiveEncodingSize(encoding) <= sizeof(float))
+    {
+        frame.Reencode(encoding);
+    }
+    else
+    {
+        frame.ReencodeInto(m_Input, encoding);
+        std::swap(frame, m_Input);
+    }
+
+    m_ProcessingTime += std::chrono::steady_clock::now() - start;
+
+    return true;
 }
 
-std::optional<AudioBuffer> SourceResampler::NextFrame()
+double SourceResampler::RealtimeFactor() const noexcept
 {
-    // TODO:
-    return std::nullopt;
+    const double seconds = std::chrono::duration<double>(m_ProcessingTime).count();
+    if (seconds <= 0.)
+        return 0.;
+
+    const double audioSeconds = static_cast<double>(m_Resampler.OutputPosition()) / static_cast<double>(m_Spec.m_Rate);
+    return audioSeconds / seconds;
 }
 
-SourceReencoder::SourceReencoder(std::shared_ptr<AudioSource> source, AudioEncoding targetEncoding)
+SourceReencoder::SourceReencoder(std::shared_ptr<AudioSource> source, AudioEncoding targetEncoding,
+                                 const DitherMode dither)
     : m_Encoding(targetEncoding), m_Source(std::move(source))
 {
+    if (dither != DitherMode::None && m_Source->Encoding() == AudioEncoding::Float32 &&
+        Ditherer::IsDitheredTarget(targetEncoding))
+    {
+        m_Ditherer.emplace(dither, targetEncoding, m_Source->Spec().m_Channels.Count());
+    }
 }
 
 std::optional<size_t> SourceReencoder::TotalSamples()
@@ -76,40 +256,98 @@ std::optional<size_t> SourceReencoder::CurrentSample()
 
 std::optional<AudioBuffer> SourceReencoder::NextFrame()
 {
+    if (m_Ditherer.has_value())
+    {
+        AudioBuffer frame;
+        if (!NextFrameInto(frame))
+            return std::nullopt;
+
+        return frame;
+    }
+
     auto frame = m_Source->NextFrame();
     if (!frame.has_value())
         return std::nullopt;
 
-    if (frame->Encoding() == m_Encoding)
+    if (GetEffectiveEncodingSize(m_Encoding) <= GetEffectiveEncodingSize(frame->Encoding()))
+    {
+        frame->Reencode(m_Encoding);
         return frame;
+    }
+
+    AudioBuffer converted(frame->FrameCount(), frame->Spec(), m_Encoding);
+    frame->ReencodeInto(converted, m_Encoding);
+
+    return converted;
+}
 
-    switch (frame->Encoding())
+bool SourceReencoder::DoNextFrameInto(AudioBuffer& frame)
+{
+    return NextFrameUpTo(frame, SIZE_MAX);
+}
+
+bool SourceReencoder::NextFrameUpTo(AudioBuffer& frame, const size_t maxFrames)
+{
+    if (m_Ditherer.has_value())
     {
-        case AudioEncoding::UInt8:
-            return AudioBuffer(ConvertSampleVectorDynamic(frame->Vector(), m_Encoding), m_Source->Spec(), m_Encoding);
-        case AudioEncoding::Int8:
-            return AudioBuffer(ConvertSampleVectorDynamic(reinterpret_cast<const std::vector<int8_t>&>(frame->Vector()), m_Encoding), m_Source->Spec(), m_Encoding);
-        case AudioEncoding::UInt16:
-            return AudioBuffer(ConvertSampleVectorDynamic(reinterpret_cast<const std::vector<uint16_t>&>(frame->Vector()), m_Encoding), m_Source->Spec(), m_Encoding);
-        case AudioEncoding::Int16:
-            return AudioBuffer(ConvertSampleVectorDynamic(reinterpret_cast<const std::vector<int16_t>&>(frame->Vector()), m_Encoding), m_Source->Spec(), m_Encoding);
-        case AudioEncoding::UInt24:
-            return AudioBuffer(ConvertSampleVectorDynamic(reinterpret_cast<const std::vector<UInt24>&>(frame->Vector()), m_Encoding), m_Source->Spec(), m_Encoding);
-        case AudioEncoding::Int24:
-            return AudioBuffer(ConvertSampleVectorDynamic(reinterpret_cast<const std::vector<Int24>&>(frame->Vector()), m_Encoding), m_Source->Spec(), m_Encoding);
-        case AudioEncoding::UInt32:
-            return AudioBuffer(ConvertSampleVectorDynamic(reinterpret_cast<const std::vector<uint32_t>&>(frame->Vector()), m_Encoding), m_Source->Spec(), m_Encoding);
-        case AudioEncoding::Int32:
-            return AudioBuffer(ConvertSampleVectorDynamic(reinterpret_cast<const std::vector<int32_t>&>(frame->Vector()), m_Encoding), m_Source->Spec(), m_Encoding);
-        case AudioEncoding::Float32:
-            return AudioBuffer(ConvertSampleVectorDynamic(reinterpret_cast<const std::vector<float>&>(frame->Vector()), m_Encoding), m_Source->Spec(), m_Encoding);
-        case AudioEncoding::Float64:
-            return AudioBuffer(ConvertSampleVectorDynamic(reinterpret_cast<const std::vector<double>&>(frame->Vector()), m_Encoding), m_Source->Spec(), m_Encoding);
-        default:
-            throw std::runtime_error("Unsupported encoding");
+        if (!m_Source->NextFrameUpTo(m_Scratch, maxFrames))
+            return false;
+
+        // the dithered samples sit exactly on the target's grid, so narrowing them in place is lossless
+        m_Ditherer->Apply(m_Scratch, frame);
+        frame.Reencode(m_Encoding);
+        return true;
     }
+
+    if (GetEffectiveEncodingSize(m_Encoding) <= GetEffectiveEncodingSize(m_Source->Encoding()))
+    {
+        if (!m_Source->NextFrameUpTo(frame, maxFrames))
+            return false;
+
+        frame.Reencode(m_Encoding);
+        return true;
+    }
+
+    if (!m_Source->NextFrameUpTo(m_Scratch, maxFrames))
+        return false;
+
+    m_Scratch.ReencodeInto(frame, m_Encoding);
+    return true;
+}
+
+std::optional<AudioBuffer> SourceLayoutConverter::NextFrame()
+{
+    AudioBuffer frame;
+    if (!NextFrameInto(frame))
+        return std::nullopt;
+
+    return frame;
 }
 
+bool SourceLayoutConverter::DoNextFrameInto(AudioBuffer& frame)
+{
+    return NextFrameUpTo(frame, SIZE_MAX);
+}
+
+bool SourceLayoutConverter::NextFrameUpTo(AudioBuffer& frame, const size_t maxFrames)
+{
+    if (!m_Source->NextFrameUpTo(m_Scratch, maxFrames))
+        return false;
+
+    if (m_Scratch.Layout() == m_Layout)
+    {
+        // the storage frame came with stays behind for the next frame
+        std::swap(frame, m_Scratch);
+        return true;
+    }
+
+    if (m_Layout == SampleLayout::Planar)
+        m_Scratch.DeinterleaveInto(frame);
+    else
+        m_Scratch.InterleaveInto(frame);
+
+    return true;
+}
 
 // #define IMPL_NEXT_FRAME(TYPE, CAPITALIZED_TYPE)                                      \
 //     std::optional<AudioBuffer<TYPE>> SourceMp3::NextFrame##CAPITALIZED_TYPE()        \
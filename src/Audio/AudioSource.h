@@ -6,6 +6,10 @@
 #define AUDIOSOURCE_H
 
 #include "AudioBuffer.h"
+#include "Dither.h"
+#include "PolyphaseResampler.h"
+#include <chrono>
+#include <cstdint>
 #include <memory>
 #include <optional>
 #include <string>
@@ -25,13 +29,74 @@ public:
 
     virtual std::optional<AudioBuffer> NextFrame() = 0;
 
+    // Writes the next frame into frame, reusing its storage when the source supports it, which
+    // keeps chains of stages free of per-frame allocations. Returns false once the source ends.
+    bool NextFrameInto(AudioBuffer& frame)
+    {
+        // the rest of a frame the default NextFrameUpTo split comes first
+        if (HoldsSplitFrame())
+            return NextFrameUpTo(frame, SIZE_MAX);
+
+        return DoNextFrameInto(frame);
+    }
+
+    /*!
+        \brief Like NextFrameInto, but the frame holds at most maxFrames frames
+        \details This is the frame size contract outputs rely on to run at the device's period: stages
+                 pass the limit on upstream, so every stage of a chain works on frames no longer than
+                 what the output asked for. Frames may come out shorter, but never empty. SIZE_MAX
+                 leaves the frame length up to the source, just like NextFrameInto.
+
+                 The default splits the source's own frames, holding on to the rest for the next call
+                 and handing the pieces out as aliases of it, without copying or allocating.
+                 NextFrameInto hands out that rest first, so the two mix freely. Sources able to produce
+                 frames of any length override it instead.
+        \param maxFrames at least 1
+    */
+    virtual bool NextFrameUpTo(AudioBuffer& frame, size_t maxFrames);
+
     virtual bool IsInfallible() = 0;
+
+    // whether Seek() works on this source
+    virtual bool IsSeekable() { return false; }
+
+    // Makes the next frame start exactly at sample, or at the end when it's past TotalSamples(). Throws
+    // when the source isn't seekable.
+    void Seek(size_t sample);
+
+protected:
+    // does the work of Seek() for seekable sources
+    virtual void SeekTo(size_t sample);
+
+    // does the work of NextFrameInto() once the rest of a split frame has been handed out
+    virtual bool DoNextFrameInto(AudioBuffer& frame)
+    {
+        auto next = NextFrame();
+        if (!next.has_value())
+            return false;
+
+        frame = std::move(*next);
+        return true;
+    }
+
+private:
+    // whether the default NextFrameUpTo still holds part of a frame it split
+    [[nodiscard]] bool HoldsSplitFrame() const noexcept { return m_RemainderOffset < m_RemainderFrames; }
+
+    // the last frame the default NextFrameUpTo split, shared with the pieces handed out, and reused once
+    // none of them is around anymore
+    std::shared_ptr<AudioBuffer> m_Remainder;
+    // its length and the bytes per frame, worked out once rather than for every piece
+    size_t m_RemainderFrames = 0;
+    size_t m_RemainderFrameSize = 0;
+    size_t m_RemainderOffset = 0;
 };
 
-class SourceResampler : AudioSource
+class SourceResampler : public AudioSource
 {
 public:
-    SourceResampler(std::shared_ptr<AudioSource> source, SignalSpec targetSpec);
+    SourceResampler(std::shared_ptr<AudioSource> source, SignalSpec targetSpec,
+                    ResamplerQuality quality = ResamplerQuality::Medium);
 
     SignalSpec Spec() override { return m_Spec; }
     AudioEncoding Encoding() override { return m_Source->Encoding(); }
@@ -40,18 +105,44 @@ public:
     std::optional<size_t> CurrentSample() override;
 
     std::optional<AudioBuffer> NextFrame() override;
+    bool NextFrameUpTo(AudioBuffer& frame, size_t maxFrames) override;
 
     bool IsInfallible() override { return m_Source->IsInfallible(); }
+    bool IsSeekable() override { return m_Source->IsSeekable(); }
+
+    // how many times faster than realtime the resampling itself runs, pulling upstream excluded
+    [[nodiscard]] double RealtimeFactor() const noexcept;
+
+protected:
+    // lands on the sample exactly, the filter's history gets pulled from upstream rather than assumed silent
+    void SeekTo(size_t sample) override;
+    bool DoNextFrameInto(AudioBuffer& frame) override;
 
 private:
     SignalSpec m_Spec;
     std::shared_ptr<AudioSource> m_Source;
+
+    PolyphaseResampler m_Resampler;
+
+    AudioBuffer m_Input;
+    // planar input gets interleaved here, the resampler works on interleaved frames
+    AudioBuffer m_Interleaved;
+    std::vector<float> m_FloatInput;
+
+    // output frames still to be dropped to land on the sample a seek asked for
+    size_t m_SkipFrames = 0;
+
+    std::chrono::steady_clock::duration m_ProcessingTime {};
 };
 
 class SourceReencoder : public AudioSource
 {
 public:
-    SourceReencoder(std::shared_ptr<AudioSource> source, AudioEncoding targetEncoding);
+    /*!
+        \param dither applied when a Float32 source gets narrowed to an 8 or 16-bit encoding, ignored otherwise
+    */
+    SourceReencoder(std::shared_ptr<AudioSource> source, AudioEncoding targetEncoding,
+                    DitherMode dither = DitherMode::None);
 
     SignalSpec Spec() override { return m_Source->Spec(); }
     AudioEncoding Encoding() override { return m_Encoding; }
@@ -60,34 +151,54 @@ public:
     std::optional<size_t> CurrentSample() override;
 
     std::optional<AudioBuffer> NextFrame() override;
+    bool NextFrameUpTo(AudioBuffer& frame, size_t maxFrames) override;
 
     bool IsInfallible() override { return m_Source->IsInfallible(); }
+    bool IsSeekable() override { return m_Source->IsSeekable(); }
+
+protected:
+    void SeekTo(size_t sample) override { m_Source->Seek(sample); }
+    bool DoNextFrameInto(AudioBuffer& frame) override;
+
 private:
     AudioEncoding m_Encoding;
     std::shared_ptr<AudioSource> m_Source;
+
+    // holds upstream frames which can't be converted in place
+    AudioBuffer m_Scratch;
+
+    std::optional<Ditherer> m_Ditherer;
 };
 
-class SourceSine : public AudioSource
+// Hands out the frames of a source in the given sample layout, so that a chain of DSP stages can
+// work on planes from the decoder onwards.
+class SourceLayoutConverter : public AudioSource
 {
 public:
-    explicit SourceSine(SignalSpec spec, float frequency)
-        : m_SignalSpec(spec), m_Frequency(frequency) {}
+    SourceLayoutConverter(std::shared_ptr<AudioSource> source, SampleLayout layout)
+        : m_Layout(layout), m_Source(std::move(source)) {}
 
-    SignalSpec Spec() { return m_SignalSpec; }
-    AudioEncoding Encoding() { return AudioEncoding::Float32; }
+    SignalSpec Spec() override { return m_Source->Spec(); }
+    AudioEncoding Encoding() override { return m_Source->Encoding(); }
+
+    std::optional<size_t> TotalSamples() override { return m_Source->TotalSamples(); }
+    std::optional<size_t> CurrentSample() override { return m_Source->CurrentSample(); }
 
-    std::optional<size_t> TotalSamples() { return std::nullopt; }
-    std::optional<size_t> CurrentSample() { return std::nullopt; }
+    std::optional<AudioBuffer> NextFrame() override;
+    bool NextFrameUpTo(AudioBuffer& frame, size_t maxFrames) override;
 
-    std::optional<AudioBuffer> NextFrame();
+    bool IsInfallible() override { return m_Source->IsInfallible(); }
+    bool IsSeekable() override { return m_Source->IsSeekable(); }
 
-    bool IsInfallible() { return true; }
+protected:
+    void SeekTo(size_t sample) override { m_Source->Seek(sample); }
+    bool DoNextFrameInto(AudioBuffer& frame) override;
 
 private:
-    float m_Frequency;
-    float m_ThetaRemainder = 0.f;
+    SampleLayout m_Layout;
+    std::shared_ptr<AudioSource> m_Source;
 
-    SignalSpec m_SignalSpec;
+    AudioBuffer m_Scratch;
 };
 
 #endif //AUDIOSOURCE_H
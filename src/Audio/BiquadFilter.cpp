@@ -0,0 +1,265 @@
+#include "BiquadFilter.h"
+#include "SampleConversions.h"
+#include "Simd.h"
+#include "SimdKernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+constexpr size_t COEFFICIENTS_PER_SECTION = 5;
+constexpr size_t STATE_PER_SECTION = 2;
+
+BiquadCoefficients BiquadCoefficients::Design(const BiquadParams& params, const uint32_t rate)
+{
+    if (!(params.m_Frequency > 0.f) || params.m_Frequency >= static_cast<float>(rate) / 2.f)
+        throw std::runtime_error("Biquad frequency must be between 0 and half the rate, got " +
+                                 std::to_string(params.m_Frequency));
+
+    if (!(params.m_Q > 0.f))
+        throw std::runtime_error("Biquad Q must be positive");
+
+    // in double, narrow sections at low frequencies lose too much in float
+    const double w0 = 2. * std::numbers::pi * params.m_Frequency / rate;
+    const double cosW0 = std::cos(w0);
+    const double alpha = std::sin(w0) / (2. * params.m_Q);
+    const double a = std::pow(10., params.m_GainDb / 40.);
+    const double shelf = 2. * std::sqrt(a) * alpha;
+
+    double b0, b1, b2, a0, a1, a2;
+
+    switch (params.m_Type)
+    {
+    case BiquadType::LowPass:
+        b0 = (1. - cosW0) / 2.;
+        b1 = 1. - cosW0;
+        b2 = (1. - cosW0) / 2.;
+        a0 = 1. + alpha;
+        a1 = -2. * cosW0;
+        a2 = 1. - alpha;
+        break;
+    case BiquadType::HighPass:
+        b0 = (1. + cosW0) / 2.;
+        b1 = -(1. + cosW0);
+        b2 = (1. + cosW0) / 2.;
+        a0 = 1. + alpha;
+        a1 = -2. * cosW0;
+        a2 = 1. - alpha;
+        break;
+    case BiquadType::BandPass:
+        b0 = alpha;
+        b1 = 0.;
+        b2 = -alpha;
+        a0 = 1. + alpha;
+        a1 = -2. * cosW0;
+        a2 = 1. - alpha;
+        break;
+    case BiquadType::Notch:
+        b0 = 1.;
+        b1 = -2. * cosW0;
+        b2 = 1.;
+        a0 = 1. + alpha;
+        a1 = -2. * cosW0;
+        a2 = 1. - alpha;
+        break;
+    case BiquadType::AllPass:
+        b0 = 1. - alpha;
+        b1 = -2. * cosW0;
+        b2 = 1. + alpha;
+        a0 = 1. + alpha;
+        a1 = -2. * cosW0;
+        a2 = 1. - alpha;
+        break;
+    case BiquadType::Peaking:
+        b0 = 1. + alpha * a;
+        b1 = -2. * cosW0;
+        b2 = 1. - alpha * a;
+        a0 = 1. + alpha / a;
+        a1 = -2. * cosW0;
+        a2 = 1. - alpha / a;
+        break;
+    case BiquadType::LowShelf:
+        b0 = a * ((a + 1.) - (a - 1.) * cosW0 + shelf);
+        b1 = 2. * a * ((a - 1.) - (a + 1.) * cosW0);
+        b2 = a * ((a + 1.) - (a - 1.) * cosW0 - shelf);
+        a0 = (a + 1.) + (a - 1.) * cosW0 + shelf;
+        a1 = -2. * ((a - 1.) + (a + 1.) * cosW0);
+        a2 = (a + 1.) + (a - 1.) * cosW0 - shelf;
+        break;
+    case BiquadType::HighShelf:
+        b0 = a * ((a + 1.) + (a - 1.) * cosW0 + shelf);
+        b1 = -2. * a * ((a - 1.) + (a + 1.) * cosW0);
+        b2 = a * ((a + 1.) + (a - 1.) * cosW0 - shelf);
+        a0 = (a + 1.) - (a - 1.) * cosW0 + shelf;
+        a1 = 2. * ((a - 1.) - (a + 1.) * cosW0);
+        a2 = (a + 1.) - (a - 1.) * cosW0 - shelf;
+        break;
+    default:
+        throw std::runtime_error("Unsupported biquad type");
+    }
+
+    return { static_cast<float>(b0 / a0), static_cast<float>(b1 / a0), static_cast<float>(b2 / a0),
+             static_cast<float>(a1 / a0), static_cast<float>(a2 / a0) };
+}
+
+SourceBiquadFilter::SourceBiquadFilter(std::shared_ptr<AudioSource> source, const std::vector<BiquadParams>& sections,
+                                       const size_t rampFrames)
+    : m_Source(std::move(source)),
+      m_Rate(m_Source->Spec().m_Rate),
+      m_Channels(m_Source->Spec().m_Channels.Count()),
+      m_RampFrames(rampFrames),
+      m_Params(sections)
+{
+    if (m_Params.empty())
+        throw std::runtime_error("SourceBiquadFilter needs at least one section");
+
+    const size_t coefficientCount = m_Params.size() * COEFFICIENTS_PER_SECTION * SIMD_LANES;
+    m_Coefficients.resize(coefficientCount);
+    m_Targets.resize(coefficientCount);
+    m_Steps.resize(coefficientCount);
+
+    for (size_t s = 0; s < m_Params.size(); ++s)
+        StoreCoefficients(m_Targets, s, BiquadCoefficients::Design(m_Params[s], m_Rate));
+
+    // the first design applies right away, there is nothing to ramp from
+    m_Coefficients = m_Targets;
+
+    const size_t groups = (m_Channels + SIMD_LANES - 1) / SIMD_LANES;
+    m_State.resize(groups * m_Params.size() * STATE_PER_SECTION * SIMD_LANES);
+}
+
+void SourceBiquadFilter::SetSection(const size_t index, const BiquadParams& params)
+{
+    if (index >= m_Params.size())
+        throw std::runtime_error("Biquad section " + std::to_string(index) + " out of range");
+
+    const BiquadCoefficients coefficients = BiquadCoefficients::Design(params, m_Rate);
+
+    m_Params[index] = params;
+    StoreCoefficients(m_Targets, index, coefficients);
+    StartRamp();
+}
+
+void SourceBiquadFilter::StoreCoefficients(std::vector<float>& dst, const size_t section,
+                                           const BiquadCoefficients& coefficients) const
+{
+    const float values[COEFFICIENTS_PER_SECTION] = { coefficients.m_B0, coefficients.m_B1, coefficients.m_B2,
+                                                     coefficients.m_A1, coefficients.m_A2 };
+
+    float* out = dst.data() + section * COEFFICIENTS_PER_SECTION * SIMD_LANES;
+    for (size_t i = 0; i < COEFFICIENTS_PER_SECTION; ++i)
+        std::fill_n(out + i * SIMD_LANES, SIMD_LANES, values[i]);
+}
+
+void SourceBiquadFilter::StartRamp()
+{
+    if (m_RampFrames == 0)
+    {
+        FinishRamp();
+        return;
+    }
+
+    // every section restarts its ramp from wherever it is now, one still underway included
+    const auto frames = static_cast<float>(m_RampFrames);
+    for (size_t i = 0; i < m_Coefficients.size(); ++i)
+        m_Steps[i] = (m_Targets[i] - m_Coefficients[i]) / frames;
+
+    m_RampRemaining = m_RampFrames;
+}
+
+void SourceBiquadFilter::FinishRamp()
+{
+    // snapped onto the targets, the steps don't add up to them exactly
+    m_Coefficients = m_Targets;
+    std::fill(m_Steps.begin(), m_Steps.end(), 0.f);
+    m_RampRemaining = 0;
+}
+
+void SourceBiquadFilter::SeekTo(const size_t sample)
+{
+    m_Source->Seek(sample);
+
+    std::fill(m_State.begin(), m_State.end(), 0.f);
+    FinishRamp();
+}
+
+std::optional<AudioBuffer> SourceBiquadFilter::NextFrame()
+{
+    AudioBuffer frame;
+    if (!NextFrameInto(frame))
+        return std::nullopt;
+
+    return frame;
+}
+
+bool SourceBiquadFilter::DoNextFrameInto(AudioBuffer& frame)
+{
+    return NextFrameUpTo(frame, SIZE_MAX);
+}
+
+bool SourceBiquadFilter::NextFrameUpTo(AudioBuffer& frame, const size_t maxFrames)
+{
+    if (!m_Source->NextFrameUpTo(m_Input, maxFrames))
+        return false;
+
+    if (m_Input.IsPlanar())
+    {
+        m_Input.InterleaveInto(m_Interleaved);
+        std::swap(m_Input, m_Interleaved);
+    }
+
+    const AudioEncoding encoding = m_Input.Encoding();
+    const size_t sampleCount = m_Input.SampleCount();
+    const size_t frameCount = sampleCount / m_Channels;
+
+    if (encoding == AudioEncoding::Float32)
+    {
+        std::swap(frame, m_Input);
+    }
+    else
+    {
+        frame.Reformat(m_Input.Spec(), AudioEncoding::Float32, sampleCount * sizeof(float));
+        ConvertSampleBuffer(m_Input.Data(), encoding, frame.Data(), AudioEncoding::Float32, sampleCount);
+    }
+
+    auto* samples = reinterpret_cast<float*>(frame.Data());
+    const size_t sections = m_Params.size();
+    const size_t ramp = std::min(m_RampRemaining, frameCount);
+
+    if (ramp > 0)
+        m_RampStart = m_Coefficients;
+
+    for (size_t first = 0, group = 0; first < m_Channels; first += SIMD_LANES, ++group)
+    {
+        // the kernel leaves the coefficients where the ramp got to, every group has to start from the same place
+        if (ramp > 0 && group > 0)
+            std::copy(m_RampStart.begin(), m_RampStart.end(), m_Coefficients.begin());
+
+        BiquadCascade(samples + first, m_Channels, std::min(SIMD_LANES, m_Channels - first), frameCount, sections,
+                      m_Coefficients.data(), m_Steps.data(), ramp,
+                      m_State.data() + group * sections * STATE_PER_SECTION * SIMD_LANES);
+    }
+
+    m_RampRemaining -= ramp;
+    if (ramp > 0 && m_RampRemaining == 0)
+        FinishRamp();
+
+    // hand the frame out in the encoding it came in with
+    if (encoding != AudioEncoding::Float32)
+    {
+        if (GetEffectiveEncodingSize(encoding) <= sizeof(float))
+        {
+            frame.Reencode(encoding);
+        }
+        else
+        {
+            frame.ReencodeInto(m_Input, encoding);
+            std::swap(frame, m_Input);
+        }
+    }
+
+    return true;
+}
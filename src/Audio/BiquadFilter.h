@@ -0,0 +1,113 @@
+#ifndef BIQUADFILTER_H
+#define BIQUADFILTER_H
+
+#include "AudioSource.h"
+
+#include <memory>
+#include <vector>
+
+enum class BiquadType
+{
+    LowPass,
+    HighPass,
+    // 0 dB at the centre frequency
+    BandPass,
+    Notch,
+    AllPass,
+    // the ones below boost or cut by m_GainDb
+    Peaking,
+    LowShelf,
+    HighShelf
+};
+
+struct BiquadParams
+{
+    BiquadType m_Type;
+    // cutoff, centre or shelf midpoint in Hz, below half the rate
+    float m_Frequency;
+    float m_Q = 0.7071f;
+    float m_GainDb = 0.f;
+};
+
+// Normalized so that a0 is 1.
+struct BiquadCoefficients
+{
+    float m_B0 = 1.f;
+    float m_B1 = 0.f;
+    float m_B2 = 0.f;
+    float m_A1 = 0.f;
+    float m_A2 = 0.f;
+
+    // Designs the section after the RBJ audio EQ cookbook.
+    static BiquadCoefficients Design(const BiquadParams& params, uint32_t rate);
+};
+
+/*! \brief Runs every channel of a source through a cascade of biquad sections.
+
+    Channels go through the SIMD kernel eight at a time, one per lane, so 5.1 and 7.1 take a single pass
+    per section. Changing a section ramps every coefficient linearly to the new design over rampFrames,
+    instead of stepping it, which would click. A linear ramp between two stable sections stays stable,
+    the region of stable (a1, a2) being convex.
+
+    Frames come out interleaved, in the source's encoding. Not thread safe: sections have to be changed on
+    the thread pulling the frames.
+*/
+class SourceBiquadFilter : public AudioSource
+{
+public:
+    SourceBiquadFilter(std::shared_ptr<AudioSource> source, const std::vector<BiquadParams>& sections,
+                       size_t rampFrames = 512);
+
+    // Redesigns one section, the change gets ramped in from the next frame on.
+    void SetSection(size_t index, const BiquadParams& params);
+
+    [[nodiscard]] size_t SectionCount() const noexcept { return m_Params.size(); }
+    [[nodiscard]] const BiquadParams& Section(const size_t index) const { return m_Params.at(index); }
+
+    SignalSpec Spec() override { return m_Source->Spec(); }
+    AudioEncoding Encoding() override { return m_Source->Encoding(); }
+
+    std::optional<size_t> TotalSamples() override { return m_Source->TotalSamples(); }
+    std::optional<size_t> CurrentSample() override { return m_Source->CurrentSample(); }
+
+    std::optional<AudioBuffer> NextFrame() override;
+    bool NextFrameUpTo(AudioBuffer& frame, size_t maxFrames) override;
+
+    bool IsInfallible() override { return m_Source->IsInfallible(); }
+    bool IsSeekable() override { return m_Source->IsSeekable(); }
+
+protected:
+    // the filter's memory is cleared and a pending ramp skipped to its end
+    void SeekTo(size_t sample) override;
+    bool DoNextFrameInto(AudioBuffer& frame) override;
+
+private:
+    // lays coefficients out the way the kernel reads them, the same value in every lane
+    void StoreCoefficients(std::vector<float>& dst, size_t section, const BiquadCoefficients& coefficients) const;
+    void StartRamp();
+    void FinishRamp();
+
+    std::shared_ptr<AudioSource> m_Source;
+    uint32_t m_Rate;
+    size_t m_Channels;
+    size_t m_RampFrames;
+
+    std::vector<BiquadParams> m_Params;
+
+    // per section, b0, b1, b2, a1 and a2 across the SIMD lanes
+    std::vector<float> m_Coefficients;
+    std::vector<float> m_Targets;
+    std::vector<float> m_Steps;
+    // coefficients at the start of a ramping frame, every group of channels ramps from there
+    std::vector<float> m_RampStart;
+    size_t m_RampRemaining = 0;
+
+    // per group of channels and section, z1 and z2 across the SIMD lanes
+    std::vector<float> m_State;
+
+    AudioBuffer m_Input;
+    // planar input gets interleaved here
+    AudioBuffer m_Interleaved;
+};
+
+#endif //BIQUADFILTER_H
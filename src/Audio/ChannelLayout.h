@@ -116,6 +116,9 @@ public:
     [[nodiscard]] bool GetFlagState(ChannelFlagValue f) const noexcept;
     [[nodiscard]] size_t Count() const noexcept;
 
+    // same speakers, in the same order as channels are ordered by their flags
+    [[nodiscard]] bool operator==(const ChannelLayout& other) const noexcept = default;
+
     [[nodiscard]] std::vector<ChannelFlagValue> GetAllEnabledFlags() const;
 };
 
@@ -0,0 +1,365 @@
+#include "ChannelRemixer.h"
+#include "SampleConversions.h"
+#include "Simd.h"
+#include "SimdKernels.h"
+
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+using Flag = ChannelFlagValue;
+
+// -3 dB, the usual gain for folding one speaker into two
+constexpr float FOLD_GAIN = static_cast<float>(M_SQRT1_2);
+
+// a chain of fallbacks never needs more steps than this, deeper ones are cycles between two
+// missing speakers
+constexpr int MAX_FOLD_DEPTH = 4;
+
+static bool HasFlag(const uint32_t mask, const Flag flag)
+{
+    return (mask & static_cast<uint32_t>(flag)) != 0;
+}
+
+// Adds speaker s at gain into row, the coefficients of the output speakers in dstMask by bit index.
+static void Fold(const Flag s, const float gain, const uint32_t dstMask, std::array<float, 32>& row, const int depth = 0)
+{
+    if (HasFlag(dstMask, s))
+    {
+        row[std::countr_zero(static_cast<uint32_t>(s))] += gain;
+        return;
+    }
+
+    if (depth == MAX_FOLD_DEPTH)
+        return;
+
+    const auto fold = [&](const Flag target, const float factor) { Fold(target, gain * factor, dstMask, row, depth + 1); };
+
+    switch (s)
+    {
+    case Flag::FRONT_CENTRE:
+        fold(Flag::FRONT_LEFT, FOLD_GAIN);
+        fold(Flag::FRONT_RIGHT, FOLD_GAIN);
+        break;
+    case Flag::FRONT_LEFT:
+    case Flag::FRONT_RIGHT:
+        fold(Flag::FRONT_CENTRE, FOLD_GAIN);
+        break;
+    case Flag::LFE1:
+        // the LFE is only ever duplicated content, folding it would just muddy the mix
+        break;
+    case Flag::LFE2:
+        fold(Flag::LFE1, 1.f);
+        break;
+    case Flag::REAR_LEFT:
+        HasFlag(dstMask, Flag::SIDE_LEFT) ? fold(Flag::SIDE_LEFT, 1.f) : fold(Flag::FRONT_LEFT, FOLD_GAIN);
+        break;
+    case Flag::REAR_RIGHT:
+        HasFlag(dstMask, Flag::SIDE_RIGHT) ? fold(Flag::SIDE_RIGHT, 1.f) : fold(Flag::FRONT_RIGHT, FOLD_GAIN);
+        break;
+    case Flag::SIDE_LEFT:
+        HasFlag(dstMask, Flag::REAR_LEFT) ? fold(Flag::REAR_LEFT, 1.f) : fold(Flag::FRONT_LEFT, FOLD_GAIN);
+        break;
+    case Flag::SIDE_RIGHT:
+        HasFlag(dstMask, Flag::REAR_RIGHT) ? fold(Flag::REAR_RIGHT, 1.f) : fold(Flag::FRONT_RIGHT, FOLD_GAIN);
+        break;
+    case Flag::REAR_CENTRE:
+        fold(Flag::REAR_LEFT, FOLD_GAIN);
+        fold(Flag::REAR_RIGHT, FOLD_GAIN);
+        break;
+    case Flag::FRONT_LEFT_CENTRE:
+    case Flag::FRONT_LEFT_WIDE:
+    case Flag::TOP_FRONT_LEFT:
+    case Flag::FRONT_LEFT_HIGH:
+        fold(Flag::FRONT_LEFT, 1.f);
+        break;
+    case Flag::FRONT_RIGHT_CENTRE:
+    case Flag::FRONT_RIGHT_WIDE:
+    case Flag::TOP_FRONT_RIGHT:
+    case Flag::FRONT_RIGHT_HIGH:
+        fold(Flag::FRONT_RIGHT, 1.f);
+        break;
+    case Flag::TOP_FRONT_CENTRE:
+    case Flag::FRONT_CENTRE_HIGH:
+        fold(Flag::FRONT_CENTRE, 1.f);
+        break;
+    case Flag::TOP_CENTRE:
+        fold(Flag::FRONT_CENTRE, FOLD_GAIN);
+        break;
+    case Flag::REAR_LEFT_CENTRE:
+    case Flag::TOP_REAR_LEFT:
+        fold(Flag::REAR_LEFT, 1.f);
+        break;
+    case Flag::REAR_RIGHT_CENTRE:
+    case Flag::TOP_REAR_RIGHT:
+        fold(Flag::REAR_RIGHT, 1.f);
+        break;
+    case Flag::TOP_REAR_CENTRE:
+        fold(Flag::REAR_CENTRE, 1.f);
+        break;
+    }
+}
+
+static uint32_t LayoutMask(const ChannelLayout& layout)
+{
+    uint32_t mask = 0;
+    for (const auto flag : layout.GetAllEnabledFlags())
+        mask |= static_cast<uint32_t>(flag);
+
+    return mask;
+}
+
+ChannelMatrix::ChannelMatrix(const ChannelLayout src, const ChannelLayout dst, const bool normalize)
+    : m_SrcChannels(src.Count()), m_DstChannels(dst.Count())
+{
+    if (m_SrcChannels == 0 || m_DstChannels == 0)
+        throw std::runtime_error("Can't remix from or into a layout without channels");
+
+    uint32_t srcMask = LayoutMask(src);
+    uint32_t dstMask = LayoutMask(dst);
+    const uint32_t srcFlags = srcMask;
+    const uint32_t dstFlags = dstMask;
+
+    // MONO shares its flag with FRONT_LEFT; against any other layout it plays the part of a centre
+    constexpr auto mono = static_cast<uint32_t>(Flag::FRONT_LEFT);
+    if (srcMask != dstMask)
+    {
+        if (srcMask == mono)
+            srcMask = static_cast<uint32_t>(Flag::FRONT_CENTRE);
+        if (dstMask == mono)
+            dstMask = static_cast<uint32_t>(Flag::FRONT_CENTRE);
+    }
+
+    m_Coefficients.assign(m_DstChannels * m_SrcChannels, 0.f);
+
+    // walk the channels in ChannelLayout order, which is ascending flag order
+    size_t s = 0;
+    for (uint32_t srcBits = srcMask; srcBits != 0; ++s)
+    {
+        const uint32_t srcBit = srcBits & -srcBits;
+        srcBits &= srcBits - 1;
+
+        std::array<float, 32> row {};
+        Fold(static_cast<Flag>(srcBit), 1.f, dstMask, row);
+
+        size_t d = 0;
+        for (uint32_t dstBits = dstMask; dstBits != 0; ++d)
+        {
+            m_Coefficients[d * m_SrcChannels + s] = row[std::countr_zero(dstBits)];
+            dstBits &= dstBits - 1;
+        }
+    }
+
+    if (normalize)
+    {
+        float loudest = 0.f;
+        for (size_t d = 0; d < m_DstChannels; ++d)
+        {
+            float sum = 0.f;
+            for (size_t i = 0; i < m_SrcChannels; ++i)
+                sum += std::abs(Coefficient(d, i));
+
+            loudest = std::max(loudest, sum);
+        }
+
+        if (loudest > 1.f)
+        {
+            for (float& coefficient : m_Coefficients)
+                coefficient /= loudest;
+        }
+    }
+
+    // classify, so that remixing can skip the arithmetic whenever it isn't needed
+    m_Sources.assign(m_DstChannels, -1);
+    bool reorder = true;
+
+    for (size_t d = 0; d < m_DstChannels && reorder; ++d)
+    {
+        for (size_t i = 0; i < m_SrcChannels; ++i)
+        {
+            const float coefficient = Coefficient(d, i);
+            if (coefficient == 0.f)
+                continue;
+
+            if (coefficient != 1.f || m_Sources[d] != -1)
+            {
+                reorder = false;
+                break;
+            }
+
+            m_Sources[d] = static_cast<int>(i);
+        }
+    }
+
+    if (srcFlags == dstFlags)
+        m_Kind = ChannelMatrixKind::Identity;
+    else if (reorder)
+        m_Kind = ChannelMatrixKind::Reorder;
+    else
+        m_Kind = ChannelMatrixKind::General;
+
+    const size_t blocks = (m_DstChannels + SIMD_LANES - 1) / SIMD_LANES;
+    m_Columns.assign(blocks * m_SrcChannels * SIMD_LANES, 0.f);
+
+    for (size_t d = 0; d < m_DstChannels; ++d)
+    {
+        const size_t block = d / SIMD_LANES;
+        const size_t lane = d % SIMD_LANES;
+
+        for (size_t i = 0; i < m_SrcChannels; ++i)
+            m_Columns[(block * m_SrcChannels + i) * SIMD_LANES + lane] = Coefficient(d, i);
+    }
+}
+
+SourceRemixer::SourceRemixer(std::shared_ptr<AudioSource> source, const ChannelLayout layout, const bool normalize)
+    : m_Source(std::move(source)), m_Layout(layout), m_Matrix(m_Source->Spec().m_Channels, layout, normalize)
+{
+    const AudioEncoding encoding = m_Source->Encoding();
+    m_Silence.resize(GetEffectiveEncodingSize(encoding));
+
+    const float zero = 0.f;
+    ConvertSampleBuffer(&zero, AudioEncoding::Float32, m_Silence.data(), encoding, 1);
+}
+
+std::optional<AudioBuffer> SourceRemixer::NextFrame()
+{
+    AudioBuffer frame;
+    if (!NextFrameInto(frame))
+        return std::nullopt;
+
+    return frame;
+}
+
+bool SourceRemixer::DoNextFrameInto(AudioBuffer& frame)
+{
+    return NextFrameUpTo(frame, SIZE_MAX);
+}
+
+bool SourceRemixer::NextFrameUpTo(AudioBuffer& frame, const size_t maxFrames)
+{
+    if (m_Matrix.Kind() == ChannelMatrixKind::Identity)
+        return m_Source->NextFrameUpTo(frame, maxFrames);
+
+    if (!m_Source->NextFrameUpTo(m_Input, maxFrames))
+        return false;
+
+    if (m_Input.IsPlanar())
+    {
+        RemixPlanar(frame);
+        return true;
+    }
+
+    const AudioEncoding encoding = m_Input.Encoding();
+    const size_t sampleSize = GetEffectiveEncodingSize(encoding);
+    const size_t frameCount = m_Input.FrameCount();
+    const size_t srcChannels = m_Matrix.SrcChannels();
+    const size_t dstChannels = m_Matrix.DstChannels();
+    const SignalSpec spec { m_Input.Spec().m_Rate, m_Layout };
+
+    frame.Reformat(spec, encoding, frameCount * dstChannels * sampleSize);
+
+    const uint8_t* in = std::as_const(m_Input).Data();
+    uint8_t* out = frame.Data();
+
+    if (m_Matrix.Kind() == ChannelMatrixKind::Reorder)
+    {
+        const auto& sources = m_Matrix.Sources();
+
+        for (size_t i = 0; i < frameCount; ++i)
+        {
+            for (size_t d = 0; d < dstChannels; ++d)
+            {
+                const uint8_t* sample = sources[d] < 0 ? m_Silence.data() : in + (i * srcChannels + sources[d]) * sampleSize;
+                std::memcpy(out + (i * dstChannels + d) * sampleSize, sample, sampleSize);
+            }
+        }
+
+        return true;
+    }
+
+    const float* floatIn = reinterpret_cast<const float*>(in);
+    if (encoding != AudioEncoding::Float32)
+    {
+        m_FloatInput.resize(frameCount * srcChannels);
+        ConvertSampleBuffer(in, encoding, m_FloatInput.data(), AudioEncoding::Float32, m_FloatInput.size());
+        floatIn = m_FloatInput.data();
+    }
+
+    if (encoding == AudioEncoding::Float32)
+    {
+        MixMatrix(reinterpret_cast<float*>(out), dstChannels, floatIn, srcChannels, frameCount, m_Matrix.Columns());
+        return true;
+    }
+
+    // hand the frame out in the encoding it came in with
+    m_FloatOutput.resize(frameCount * dstChannels);
+    MixMatrix(m_FloatOutput.data(), dstChannels, floatIn, srcChannels, frameCount, m_Matrix.Columns());
+    ConvertSampleBuffer(m_FloatOutput.data(), AudioEncoding::Float32, out, encoding, m_FloatOutput.size());
+
+    return true;
+}
+
+void SourceRemixer::RemixPlanar(AudioBuffer& frame)
+{
+    const AudioEncoding encoding = m_Input.Encoding();
+    const size_t sampleSize = GetEffectiveEncodingSize(encoding);
+    const size_t frameCount = m_Input.FrameCount();
+    const SignalSpec spec { m_Input.Spec().m_Rate, m_Layout };
+
+    if (m_Matrix.Kind() == ChannelMatrixKind::Reorder)
+    {
+        // whole planes move at once
+        frame.ReformatPlanar(spec, encoding, frameCount);
+        const auto& sources = m_Matrix.Sources();
+
+        for (size_t d = 0; d < m_Matrix.DstChannels(); ++d)
+        {
+            uint8_t* plane = frame.PlaneData(d);
+
+            if (sources[d] >= 0)
+            {
+                std::memcpy(plane, m_Input.PlaneData(sources[d]), frameCount * sampleSize);
+                continue;
+            }
+
+            for (size_t i = 0; i < frameCount; ++i)
+                std::memcpy(plane + i * sampleSize, m_Silence.data(), sampleSize);
+        }
+
+        return;
+    }
+
+    const AudioBuffer* input = &m_Input;
+    if (encoding != AudioEncoding::Float32)
+    {
+        m_Input.ReencodeInto(m_PlanarFloat, AudioEncoding::Float32);
+        input = &m_PlanarFloat;
+    }
+
+    AudioBuffer& output = encoding == AudioEncoding::Float32 ? frame : m_PlanarMix;
+    output.ReformatPlanar(spec, AudioEncoding::Float32, frameCount);
+
+    // every output plane is a weighted sum of whole input planes
+    std::array<float, SIMD_LANES> gains {};
+    for (size_t d = 0; d < m_Matrix.DstChannels(); ++d)
+    {
+        float* plane = output.Plane<float>(d).data();
+        std::fill_n(plane, frameCount, 0.f);
+
+        for (size_t s = 0; s < m_Matrix.SrcChannels(); ++s)
+        {
+            const float coefficient = m_Matrix.Coefficient(d, s);
+            if (coefficient == 0.f)
+                continue;
+
+            gains.fill(coefficient);
+            MixAdd(plane, input->Plane<float>(s).data(), frameCount, gains.data(), gains.size());
+        }
+    }
+
+    if (encoding != AudioEncoding::Float32)
+        m_PlanarMix.ReencodeInto(frame, encoding);
+}
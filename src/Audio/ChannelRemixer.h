@@ -0,0 +1,95 @@
+#ifndef CHANNELREMIXER_H
+#define CHANNELREMIXER_H
+
+#include "AudioSource.h"
+
+#include <memory>
+#include <vector>
+
+enum class ChannelMatrixKind
+{
+    // same layout, samples pass through untouched
+    Identity,
+    // every output channel copies one input channel or is silent
+    Reorder,
+    // anything which needs arithmetic
+    General
+};
+
+// Mixing matrix between two channel layouts. Channels present in both layouts map onto each other;
+// the others fold into their nearest neighbours with the usual -3 dB coefficients (centre into
+// left/right, surrounds into the fronts, heights onto the plane below, LFE dropped), and a mono
+// layout takes part as a centre channel. Rows are scaled down together if any of them could clip.
+class ChannelMatrix
+{
+public:
+    ChannelMatrix(ChannelLayout src, ChannelLayout dst, bool normalize = true);
+
+    [[nodiscard]] size_t SrcChannels() const noexcept { return m_SrcChannels; }
+    [[nodiscard]] size_t DstChannels() const noexcept { return m_DstChannels; }
+    [[nodiscard]] ChannelMatrixKind Kind() const noexcept { return m_Kind; }
+
+    // gain from input channel s into output channel d, channels in ChannelLayout order
+    [[nodiscard]] float Coefficient(size_t d, size_t s) const noexcept { return m_Coefficients[d * m_SrcChannels + s]; }
+
+    // for Reorder matrices, the input channel each output channel copies, or -1 for silence
+    [[nodiscard]] const std::vector<int>& Sources() const noexcept { return m_Sources; }
+
+    // coefficients laid out for MixMatrix
+    [[nodiscard]] const float* Columns() const noexcept { return m_Columns.data(); }
+
+private:
+    size_t m_SrcChannels;
+    size_t m_DstChannels;
+    ChannelMatrixKind m_Kind;
+
+    std::vector<float> m_Coefficients;
+    std::vector<int> m_Sources;
+    std::vector<float> m_Columns;
+};
+
+// Converts a source to another channel layout. Identity and reorder matrices move samples without
+// touching their values; any other matrix mixes in float and converts back to the source's encoding.
+// Planar frames stay planar, and get remixed a whole plane at a time.
+class SourceRemixer : public AudioSource
+{
+public:
+    SourceRemixer(std::shared_ptr<AudioSource> source, ChannelLayout layout, bool normalize = true);
+
+    SignalSpec Spec() override { return { m_Source->Spec().m_Rate, m_Layout }; }
+    AudioEncoding Encoding() override { return m_Source->Encoding(); }
+
+    std::optional<size_t> TotalSamples() override { return m_Source->TotalSamples(); }
+    std::optional<size_t> CurrentSample() override { return m_Source->CurrentSample(); }
+
+    std::optional<AudioBuffer> NextFrame() override;
+    bool NextFrameUpTo(AudioBuffer& frame, size_t maxFrames) override;
+
+    bool IsInfallible() override { return m_Source->IsInfallible(); }
+    bool IsSeekable() override { return m_Source->IsSeekable(); }
+
+    [[nodiscard]] const ChannelMatrix& Matrix() const noexcept { return m_Matrix; }
+
+protected:
+    void SeekTo(size_t sample) override { m_Source->Seek(sample); }
+    bool DoNextFrameInto(AudioBuffer& frame) override;
+
+private:
+    // remixes the planar m_Input into frame
+    void RemixPlanar(AudioBuffer& frame);
+
+    std::shared_ptr<AudioSource> m_Source;
+    ChannelLayout m_Layout;
+    ChannelMatrix m_Matrix;
+
+    AudioBuffer m_Input;
+    std::vector<float> m_FloatInput;
+    std::vector<float> m_FloatOutput;
+    // float copies of planar frames which come in another encoding, and their mix
+    AudioBuffer m_PlanarFloat;
+    AudioBuffer m_PlanarMix;
+    // encoded silence, for the channels a reorder leaves empty
+    std::vector<uint8_t> m_Silence;
+};
+
+#endif //CHANNELREMIXER_H
@@ -0,0 +1,389 @@
+#include "Convolver.h"
+#include "SimdKernels.h"
+#include "Simd.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+SourceConvolver::SourceConvolver(std::shared_ptr<AudioSource> source, const AudioBuffer& impulseResponse,
+                                 const ConvolverOptions options)
+    : m_Source(std::move(source)),
+      m_Spec(m_Source->Spec()),
+      m_Channels(m_Spec.m_Channels.Count()),
+      m_Options(options),
+      m_PartitionSize(options.m_PartitionSize),
+      m_Fft(2 * options.m_PartitionSize)
+{
+    const size_t responseChannels = impulseResponse.Spec().m_Channels.Count();
+    m_ResponseLength = impulseResponse.FrameCount();
+
+    if (impulseResponse.Spec().m_Rate != m_Spec.m_Rate)
+        throw std::runtime_error("Impulse response rate doesn't match the source's");
+
+    if (responseChannels != 1 && responseChannels != m_Channels)
+        throw std::runtime_error("Impulse response needs one channel or one per source channel, got " +
+                                 std::to_string(responseChannels));
+
+    if (m_ResponseLength == 0 || options.m_HeadPartitions == 0)
+        throw std::runtime_error("SourceConvolver needs a non-empty response and at least one head partition");
+
+    m_ResponseChannels = responseChannels;
+    m_PartitionCount = (m_ResponseLength + m_PartitionSize - 1) / m_PartitionSize;
+    m_HeadPartitions = std::min(options.m_HeadPartitions, m_PartitionCount);
+    // spectra padded to whole vectors
+    m_BinStride = (m_Fft.BinCount() + SIMD_LANES - 1) / SIMD_LANES * SIMD_LANES;
+
+    AudioBuffer response;
+    impulseResponse.ReencodeInto(response, AudioEncoding::Float32);
+
+    m_Responses.assign(m_ResponseChannels * m_PartitionCount * 2 * m_BinStride, 0.f);
+    m_Signal.resize(m_Fft.Size());
+
+    // the inverse FFT's gain gets taken out of the response once, rather than out of every block
+    const float scale = 1.f / static_cast<float>(m_Fft.Size());
+
+    for (size_t c = 0; c < m_ResponseChannels; ++c)
+    {
+        for (size_t p = 0; p < m_PartitionCount; ++p)
+        {
+            std::fill(m_Signal.begin(), m_Signal.end(), 0.f);
+
+            const size_t first = p * m_PartitionSize;
+            const size_t count = std::min(m_PartitionSize, m_ResponseLength - first);
+
+            for (size_t i = 0; i < count; ++i)
+            {
+                const float sample = response.IsPlanar() ? response.Plane<float>(c)[first + i]
+                                                         : response.View<float>()[(first + i) * m_ResponseChannels + c];
+                m_Signal[i] = sample * scale;
+            }
+
+            float* spectrum = m_Responses.data() + (c * m_PartitionCount + p) * 2 * m_BinStride;
+            m_Fft.Forward(m_Signal.data(), spectrum, spectrum + m_BinStride);
+        }
+    }
+
+    m_History.assign(m_Channels * m_Fft.Size(), 0.f);
+    m_Spectra.assign(m_Channels * m_PartitionCount * 2 * m_BinStride, 0.f);
+    m_Accumulator.assign(2 * m_BinStride, 0.f);
+    m_Output.assign(m_Channels * m_PartitionSize, 0.f);
+
+    if (m_PartitionCount > m_HeadPartitions)
+        m_TailSums.assign(m_Channels * m_HeadPartitions * 2 * m_BinStride, 0.f);
+
+    if (m_Options.m_TailOnWorker && m_PartitionCount > m_HeadPartitions)
+        m_Worker = std::thread(&SourceConvolver::WorkerLoop, this);
+}
+
+SourceConvolver::~SourceConvolver()
+{
+    {
+        std::lock_guard lock(m_Mutex);
+        m_Stopping = true;
+    }
+
+    m_WorkerWake.notify_one();
+
+    if (m_Worker.joinable())
+        m_Worker.join();
+}
+
+std::optional<size_t> SourceConvolver::TotalSamples()
+{
+    const auto total = m_Source->TotalSamples();
+    if (!total.has_value())
+        return std::nullopt;
+
+    return *total + m_ResponseLength - 1;
+}
+
+ConvolverStats SourceConvolver::Stats()
+{
+    std::lock_guard lock(m_Mutex);
+    return m_Stats;
+}
+
+float* SourceConvolver::Spectrum(const size_t channel, const uint64_t block)
+{
+    return m_Spectra.data() + (channel * m_PartitionCount + block % m_PartitionCount) * 2 * m_BinStride;
+}
+
+const float* SourceConvolver::Response(const size_t channel, const size_t partition) const
+{
+    const size_t responseChannel = m_ResponseChannels == 1 ? 0 : channel;
+    return m_Responses.data() + (responseChannel * m_PartitionCount + partition) * 2 * m_BinStride;
+}
+
+float* SourceConvolver::TailSum(const size_t channel, const uint64_t block)
+{
+    return m_TailSums.data() + (channel * m_HeadPartitions + block % m_HeadPartitions) * 2 * m_BinStride;
+}
+
+void SourceConvolver::ConvolveTail(const uint64_t block)
+{
+    const size_t bins = m_Fft.BinCount();
+    const size_t last = static_cast<size_t>(std::min<uint64_t>(m_PartitionCount - 1, block));
+
+    for (size_t c = 0; c < m_Channels; ++c)
+    {
+        float* sum = TailSum(c, block);
+        std::fill_n(sum, 2 * m_BinStride, 0.f);
+
+        for (size_t p = m_HeadPartitions; p <= last; ++p)
+        {
+            const float* spectrum = Spectrum(c, block - p);
+            const float* response = Response(c, p);
+
+            ComplexMultiplyAccumulate(sum, sum + m_BinStride, spectrum, spectrum + m_BinStride, response,
+                                      response + m_BinStride, bins);
+        }
+    }
+}
+
+void SourceConvolver::WorkerLoop()
+{
+    while (true)
+    {
+        uint64_t job;
+
+        {
+            std::unique_lock lock(m_Mutex);
+            m_WorkerWake.wait(lock, [this] { return m_Stopping || m_Posted > m_Done; });
+
+            if (m_Stopping)
+                return;
+
+            job = m_Done;
+        }
+
+        // by the time the pull gets to this block, every spectrum of the tail sum is at least
+        // m_HeadPartitions blocks old, and none of them gets overwritten before then
+        const auto start = std::chrono::steady_clock::now();
+        ConvolveTail(job + m_HeadPartitions);
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+
+        {
+            std::lock_guard lock(m_Mutex);
+            ++m_Done;
+            m_Stats.m_WorkerTime += elapsed;
+        }
+
+        m_TailDone.notify_one();
+    }
+}
+
+void SourceConvolver::DrainWorker()
+{
+    std::unique_lock lock(m_Mutex);
+    m_TailDone.wait(lock, [this] { return m_Done == m_Posted; });
+}
+
+void SourceConvolver::Reset()
+{
+    DrainWorker();
+
+    {
+        std::lock_guard lock(m_Mutex);
+        m_Posted = 0;
+        m_Done = 0;
+    }
+
+    std::fill(m_History.begin(), m_History.end(), 0.f);
+    std::fill(m_Spectra.begin(), m_Spectra.end(), 0.f);
+    std::fill(m_TailSums.begin(), m_TailSums.end(), 0.f);
+
+    m_Block = 0;
+    m_InputFill = 0;
+    m_InputEnded = false;
+    m_OutputOffset = 0;
+    m_OutputFrames = 0;
+}
+
+void SourceConvolver::SeekTo(size_t sample)
+{
+    if (const auto total = m_Source->TotalSamples(); total.has_value())
+        sample = std::min(sample, *total);
+
+    m_Source->Seek(sample);
+    Reset();
+
+    m_BlockStart = sample;
+    m_Position = sample;
+}
+
+bool SourceConvolver::ProcessBlock()
+{
+    const size_t blockSize = m_PartitionSize;
+    const size_t fftSize = m_Fft.Size();
+
+    while (!m_InputEnded && m_InputFill < blockSize)
+    {
+        if (!m_Source->NextFrameUpTo(m_Input, blockSize - m_InputFill))
+        {
+            m_InputEnded = true;
+            m_End = m_BlockStart + m_InputFill + m_ResponseLength - 1;
+            break;
+        }
+
+        const AudioBuffer* input = &m_Input;
+        if (m_Input.Encoding() != AudioEncoding::Float32)
+        {
+            m_Input.ReencodeInto(m_Converted, AudioEncoding::Float32);
+            input = &m_Converted;
+        }
+
+        const size_t frames = input->FrameCount();
+        float* current = m_History.data() + blockSize + m_InputFill;
+
+        if (input->IsPlanar())
+        {
+            for (size_t c = 0; c < m_Channels; ++c)
+                std::memcpy(current + c * fftSize, input->Plane<float>(c).data(), frames * sizeof(float));
+        }
+        else
+        {
+            Deinterleave(current, fftSize, reinterpret_cast<const float*>(input->Data()), m_Channels, frames);
+        }
+
+        m_InputFill += frames;
+    }
+
+    if (m_InputEnded && m_BlockStart >= m_End)
+        return false;
+
+    const auto start = std::chrono::steady_clock::now();
+
+    const size_t bins = m_Fft.BinCount();
+    const bool hasTail = m_PartitionCount > m_HeadPartitions;
+    bool waited = false;
+    std::chrono::steady_clock::duration waitTime {};
+
+    for (size_t c = 0; c < m_Channels; ++c)
+    {
+        float* history = m_History.data() + c * fftSize;
+        std::fill(history + blockSize + m_InputFill, history + fftSize, 0.f);
+
+        float* spectrum = Spectrum(c, m_Block);
+        m_Fft.Forward(history, spectrum, spectrum + m_BinStride);
+    }
+
+    if (hasTail && m_Worker.joinable())
+    {
+        // the worker started on this block's tail m_HeadPartitions blocks ago
+        if (m_Block >= m_HeadPartitions)
+        {
+            const auto waitStart = std::chrono::steady_clock::now();
+
+            std::unique_lock lock(m_Mutex);
+            waited = m_Done <= m_Block - m_HeadPartitions;
+            m_TailDone.wait(lock, [this] { return m_Done > m_Block - m_HeadPartitions; });
+
+            waitTime = std::chrono::steady_clock::now() - waitStart;
+        }
+    }
+    else if (hasTail)
+    {
+        ConvolveTail(m_Block);
+    }
+
+    for (size_t c = 0; c < m_Channels; ++c)
+    {
+        if (hasTail)
+            std::copy_n(TailSum(c, m_Block), 2 * m_BinStride, m_Accumulator.data());
+        else
+            std::fill(m_Accumulator.begin(), m_Accumulator.end(), 0.f);
+
+        const size_t last = static_cast<size_t>(std::min<uint64_t>(m_HeadPartitions - 1, m_Block));
+        for (size_t p = 0; p <= last; ++p)
+        {
+            const float* spectrum = Spectrum(c, m_Block - p);
+            const float* response = Response(c, p);
+
+            ComplexMultiplyAccumulate(m_Accumulator.data(), m_Accumulator.data() + m_BinStride, spectrum,
+                                      spectrum + m_BinStride, response, response + m_BinStride, bins);
+        }
+
+        m_Fft.Inverse(m_Accumulator.data(), m_Accumulator.data() + m_BinStride, m_Signal.data());
+
+        // overlap-save: the first half of the inverse is wrapped around, the second half is this block
+        float* history = m_History.data() + c * fftSize;
+        float* output = m_Output.data() + c * blockSize;
+
+        for (size_t i = 0; i < blockSize; ++i)
+            output[i] = m_Options.m_Wet * m_Signal[blockSize + i] + m_Options.m_Dry * history[blockSize + i];
+
+        std::copy_n(history + blockSize, blockSize, history);
+    }
+
+    m_OutputOffset = 0;
+    m_OutputFrames = m_InputEnded ? std::min(blockSize, m_End - m_BlockStart) : blockSize;
+
+    {
+        std::lock_guard lock(m_Mutex);
+
+        if (hasTail && m_Worker.joinable())
+            m_Posted = m_Block + 1;
+
+        m_Stats.m_PullTime += std::chrono::steady_clock::now() - start - waitTime;
+        m_Stats.m_WaitTime += waitTime;
+        ++m_Stats.m_Blocks;
+        m_Stats.m_WorkerWaits += waited ? 1 : 0;
+    }
+
+    m_WorkerWake.notify_one();
+
+    ++m_Block;
+    m_BlockStart += blockSize;
+    m_InputFill = 0;
+
+    return true;
+}
+
+std::optional<AudioBuffer> SourceConvolver::NextFrame()
+{
+    AudioBuffer frame;
+    if (!NextFrameInto(frame))
+        return std::nullopt;
+
+    return frame;
+}
+
+bool SourceConvolver::DoNextFrameInto(AudioBuffer& frame)
+{
+    return NextFrameUpTo(frame, SIZE_MAX);
+}
+
+bool SourceConvolver::NextFrameUpTo(AudioBuffer& frame, const size_t maxFrames)
+{
+    if (m_OutputOffset == m_OutputFrames && !ProcessBlock())
+        return false;
+
+    const size_t count = std::min(maxFrames, m_OutputFrames - m_OutputOffset);
+
+    frame.Reformat(m_Spec, AudioEncoding::Float32, count * m_Channels * sizeof(float));
+    Interleave(reinterpret_cast<float*>(frame.Data()), m_Output.data() + m_OutputOffset, m_PartitionSize, m_Channels,
+               count);
+
+    m_OutputOffset += count;
+    m_Position += count;
+
+    // hand the frame out in the encoding the source has
+    const AudioEncoding encoding = m_Source->Encoding();
+    if (encoding != AudioEncoding::Float32)
+    {
+        if (GetEffectiveEncodingSize(encoding) <= sizeof(float))
+        {
+            frame.Reencode(encoding);
+        }
+        else
+        {
+            frame.ReencodeInto(m_Converted, encoding);
+            std::swap(frame, m_Converted);
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,167 @@
+#ifndef CONVOLVER_H
+#define CONVOLVER_H
+
+#include "AudioSource.h"
+#include "Fft.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct ConvolverOptions
+{
+    // frames per partition and per block the source works in, a power of two; the latency a device
+    // sees grows with it, the cost per frame shrinks
+    size_t m_PartitionSize = 256;
+    // partitions convolved in the pull itself. The worker has to deliver the rest for a block within this
+    // many blocks, before the pull has to wait for it
+    size_t m_HeadPartitions = 4;
+    // convolves the tail on a worker thread, instead of in the pull along with the head
+    bool m_TailOnWorker = true;
+
+    float m_Dry = 0.f;
+    float m_Wet = 1.f;
+};
+
+struct ConvolverStats
+{
+    // spent producing blocks in the pull, upstream and waiting for the worker excluded
+    std::chrono::steady_clock::duration m_PullTime {};
+    // spent in the pull waiting for the worker to deliver a tail
+    std::chrono::steady_clock::duration m_WaitTime {};
+    // spent by the worker on the tail
+    std::chrono::steady_clock::duration m_WorkerTime {};
+    uint64_t m_Blocks = 0;
+    // blocks for which the pull had to wait for the worker
+    uint64_t m_WorkerWaits = 0;
+};
+
+/*! \brief Convolves a source with an impulse response, e.g. a reverb, through uniformly partitioned
+           convolution in the frequency domain.
+
+    Upstream gets pulled a partition at a time. Each block goes through an FFT of twice the partition
+    size into a delay line of spectra, which get multiplied with the spectra of the response's
+    partitions and summed, so that one inverse FFT per block gives the output (overlap-save). A 2 s
+    response costs a few multiply-adds per bin and partition instead of 96000 per sample.
+
+    The first m_HeadPartitions partitions are summed in the pull. The tail's sum for a block only needs
+    spectra that are m_HeadPartitions blocks old by then, so a worker thread works it out ahead of time
+    and the pull only adds it in. Results don't depend on where the tail runs.
+
+    The output runs on for the length of the response past the end of the source. A seek restarts the
+    reverb from silence.
+*/
+class SourceConvolver : public AudioSource
+{
+public:
+    /*!
+        \param impulseResponse at the source's rate, with one channel for all of the source's channels or
+               one for each, in any encoding and layout
+    */
+    SourceConvolver(std::shared_ptr<AudioSource> source, const AudioBuffer& impulseResponse,
+                    ConvolverOptions options = {});
+
+    SourceConvolver(const SourceConvolver&) = delete;
+    SourceConvolver& operator=(const SourceConvolver&) = delete;
+
+    ~SourceConvolver() override;
+
+    SignalSpec Spec() override { return m_Spec; }
+    AudioEncoding Encoding() override { return m_Source->Encoding(); }
+
+    std::optional<size_t> TotalSamples() override;
+    std::optional<size_t> CurrentSample() override { return m_Position; }
+
+    std::optional<AudioBuffer> NextFrame() override;
+    bool NextFrameUpTo(AudioBuffer& frame, size_t maxFrames) override;
+
+    bool IsInfallible() override { return m_Source->IsInfallible(); }
+    bool IsSeekable() override { return m_Source->IsSeekable(); }
+
+    [[nodiscard]] size_t PartitionCount() const noexcept { return m_PartitionCount; }
+
+    // safe to call from any thread
+    [[nodiscard]] ConvolverStats Stats();
+
+protected:
+    void SeekTo(size_t sample) override;
+    bool DoNextFrameInto(AudioBuffer& frame) override;
+
+private:
+    // Pulls the next block from upstream and convolves it. Returns false once the response has rung out.
+    bool ProcessBlock();
+
+    // sums the tail partitions for block into its slot, from the spectra of the blocks before
+    void ConvolveTail(uint64_t block);
+    void WorkerLoop();
+
+    // waits for the worker to finish everything posted
+    void DrainWorker();
+    void Reset();
+
+    [[nodiscard]] float* Spectrum(size_t channel, uint64_t block);
+    [[nodiscard]] const float* Response(size_t channel, size_t partition) const;
+    [[nodiscard]] float* TailSum(size_t channel, uint64_t block);
+
+    std::shared_ptr<AudioSource> m_Source;
+    SignalSpec m_Spec;
+    size_t m_Channels;
+    ConvolverOptions m_Options;
+
+    size_t m_PartitionSize;
+    size_t m_PartitionCount;
+    size_t m_HeadPartitions;
+    size_t m_ResponseLength;
+    // floats from the real parts of a spectrum to its imaginary parts, and to the next spectrum
+    size_t m_BinStride;
+
+    RealFft m_Fft;
+
+    // per response channel and partition, scaled by the inverse FFT's gain
+    std::vector<float> m_Responses;
+    size_t m_ResponseChannels;
+
+    // per channel, the previous block followed by the current one
+    std::vector<float> m_History;
+    // per channel, the spectra of the last m_PartitionCount blocks, the newest overwriting the oldest
+    std::vector<float> m_Spectra;
+    // per channel, the tail sums of the next m_HeadPartitions blocks, written by whoever runs the tail
+    std::vector<float> m_TailSums;
+
+    std::vector<float> m_Accumulator;
+    std::vector<float> m_Signal;
+    // per channel, the block being handed out
+    std::vector<float> m_Output;
+    size_t m_OutputOffset = 0;
+    size_t m_OutputFrames = 0;
+
+    uint64_t m_Block = 0;
+    // frames of the current block pulled from upstream so far
+    size_t m_InputFill = 0;
+    bool m_InputEnded = false;
+    // first frame of the current block, and where the output stops once upstream has ended
+    size_t m_BlockStart = 0;
+    size_t m_End = 0;
+    size_t m_Position = 0;
+
+    AudioBuffer m_Input;
+    AudioBuffer m_Converted;
+
+    // shared between the worker and the pull
+    std::mutex m_Mutex;
+    std::condition_variable m_WorkerWake;
+    std::condition_variable m_TailDone;
+    // blocks whose spectra the worker may convolve, and blocks it has convolved
+    uint64_t m_Posted = 0;
+    uint64_t m_Done = 0;
+    bool m_Stopping = false;
+    ConvolverStats m_Stats;
+
+    std::thread m_Worker;
+};
+
+#endif //CONVOLVER_H
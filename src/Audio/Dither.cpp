@@ -0,0 +1,146 @@
+#include "Dither.h"
+#include "SimdKernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+// Lipshitz, Vanderkooy and Wannamaker's E-weighted error feedback filter, which pushes the noise
+// out of the 2-6 kHz region towards the top of the band
+constexpr std::array<float, 5> SHAPING_COEFFICIENTS = { 2.033f, -2.165f, 1.959f, -1.590f, 0.6149f };
+
+static float GridScale(const AudioEncoding encoding)
+{
+    switch (encoding)
+    {
+    case AudioEncoding::UInt8:
+    case AudioEncoding::Int8:
+        return 128.f;
+    case AudioEncoding::UInt16:
+    case AudioEncoding::Int16:
+        return 32768.f;
+    default:
+        return 0.f;
+    }
+}
+
+// splitmix32-style scrambling, so that neighbouring seeds give unrelated, non-zero generators
+static uint32_t ScrambleSeed(uint32_t x)
+{
+    x += 0x9e3779b9;
+    x = (x ^ (x >> 16)) * 0x85ebca6b;
+    x = (x ^ (x >> 13)) * 0xc2b2ae35;
+    x ^= x >> 16;
+
+    return x == 0 ? 1 : x;
+}
+
+Ditherer::Ditherer(const DitherMode mode, const AudioEncoding target, const size_t channels, const uint32_t seed)
+    : m_Mode(IsDitheredTarget(target) ? mode : DitherMode::None),
+      m_Scale(GridScale(target))
+{
+    if (channels == 0)
+        throw std::runtime_error("Ditherer needs at least one channel");
+
+    for (size_t lane = 0; lane < m_LaneGenerators.size(); ++lane)
+        m_LaneGenerators[lane] = ScrambleSeed(seed + static_cast<uint32_t>(lane));
+
+    m_Channels.resize(channels);
+    for (size_t c = 0; c < channels; ++c)
+        m_Channels[c].m_Generator = ScrambleSeed(seed + static_cast<uint32_t>(m_LaneGenerators.size() + c));
+}
+
+bool Ditherer::IsDitheredTarget(const AudioEncoding encoding) noexcept
+{
+    return GridScale(encoding) != 0.f;
+}
+
+void Ditherer::Apply(const AudioBuffer& src, AudioBuffer& dst)
+{
+    if (src.Encoding() != AudioEncoding::Float32)
+        throw std::runtime_error("Only Float32 samples can be dithered");
+
+    if (src.Spec().m_Channels.Count() != m_Channels.size())
+        throw std::runtime_error("Frame channel count doesn't match the Ditherer's");
+
+    const size_t channels = m_Channels.size();
+    const size_t frameCount = src.FrameCount();
+
+    if (src.IsPlanar())
+        dst.ReformatPlanar(src.Spec(), AudioEncoding::Float32, frameCount);
+    else
+        dst.Reformat(src.Spec(), AudioEncoding::Float32, frameCount * channels * sizeof(float));
+
+    const auto* in = reinterpret_cast<const float*>(src.Data());
+    auto* out = reinterpret_cast<float*>(dst.Data());
+
+    // distances between the first samples of two channels, and between two samples of a channel
+    const size_t channelOffset = src.IsPlanar() ? src.PlaneStride() / sizeof(float) : 1;
+    const size_t dstChannelOffset = dst.IsPlanar() ? dst.PlaneStride() / sizeof(float) : 1;
+    const size_t stride = src.IsPlanar() ? 1 : channels;
+
+    switch (m_Mode)
+    {
+    case DitherMode::None:
+        for (size_t c = 0; c < channels; ++c)
+        {
+            for (size_t i = 0; i < frameCount; ++i)
+                out[c * dstChannelOffset + i * stride] = in[c * channelOffset + i * stride];
+        }
+        break;
+    case DitherMode::Tpdf:
+        if (src.IsPlanar())
+        {
+            for (size_t c = 0; c < channels; ++c)
+            {
+                DitherTpdf(in + c * channelOffset, out + c * dstChannelOffset, frameCount, m_Scale,
+                           m_LaneGenerators.data());
+            }
+        }
+        else
+        {
+            DitherTpdf(in, out, frameCount * channels, m_Scale, m_LaneGenerators.data());
+        }
+        break;
+    case DitherMode::NoiseShaped:
+        for (size_t c = 0; c < channels; ++c)
+            Shape(in + c * channelOffset, out + c * dstChannelOffset, frameCount, stride, m_Channels[c]);
+        break;
+    }
+}
+
+void Ditherer::Shape(const float* src, float* dst, const size_t count, const size_t stride, ChannelState& state) const
+{
+    const float inverseScale = 1.f / m_Scale;
+    const float limit = m_Scale - 1.f;
+
+    uint32_t generator = state.m_Generator;
+    auto errors = state.m_Errors;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        generator ^= generator << 13;
+        generator ^= generator >> 17;
+        generator ^= generator << 5;
+
+        const float difference = static_cast<float>(generator & 0xffff) - static_cast<float>(generator >> 16);
+        const float noise = difference * (1.f / 65536.f);
+
+        float feedback = 0.f;
+        for (size_t k = 0; k < SHAPING_ORDER; ++k)
+            feedback += SHAPING_COEFFICIENTS[k] * errors[k];
+
+        const float wanted = src[i * stride] * m_Scale - feedback;
+        const float quantized = std::nearbyint(wanted + noise);
+
+        // the error is taken before clipping, clipped errors would grow without bound through the feedback
+        for (size_t k = SHAPING_ORDER - 1; k > 0; --k)
+            errors[k] = errors[k - 1];
+        errors[0] = quantized - wanted;
+
+        dst[i * stride] = std::clamp(quantized, -m_Scale, limit) * inverseScale;
+    }
+
+    state.m_Generator = generator;
+    state.m_Errors = errors;
+}
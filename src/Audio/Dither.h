@@ -0,0 +1,62 @@
+#ifndef DITHER_H
+#define DITHER_H
+
+#include "AudioBuffer.h"
+#include "Simd.h"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+enum class DitherMode
+{
+    // plain conversion, the samples get truncated
+    None,
+    // triangular dither of +-1 LSB, which decorrelates the requantization error from the signal
+    Tpdf,
+    // TPDF dither with the error fed back through a filter which moves it out of the band where
+    // hearing is most sensitive
+    NoiseShaped
+};
+
+// Requantizes Float32 samples onto the grid of a narrower integer encoding, so that the following
+// conversion is exact and no longer truncates. Only 8 and 16-bit targets get dithered: float samples
+// carry about as many bits as a 24-bit encoding, and more than 32-bit ones could use.
+//
+// The dither and the error feedback are stateful, so frames of a stream have to be fed in order.
+class Ditherer
+{
+public:
+    Ditherer(DitherMode mode, AudioEncoding target, size_t channels, uint32_t seed = 0x9e3779b9);
+
+    // whether converting into encoding benefits from dither at all
+    [[nodiscard]] static bool IsDitheredTarget(AudioEncoding encoding) noexcept;
+
+    [[nodiscard]] DitherMode Mode() const noexcept { return m_Mode; }
+
+    // Writes src, which has to be Float32, into dst dithered, in the same layout. dst may not be src.
+    void Apply(const AudioBuffer& src, AudioBuffer& dst);
+
+private:
+    // feedback filter taps, the error history of each channel keeps the same number of samples
+    static constexpr size_t SHAPING_ORDER = 5;
+
+    struct ChannelState
+    {
+        uint32_t m_Generator;
+        // most recent error first
+        std::array<float, SHAPING_ORDER> m_Errors {};
+    };
+
+    // error feedback over count samples stride apart, which is inherently serial
+    void Shape(const float* src, float* dst, size_t count, size_t stride, ChannelState& state) const;
+
+    DitherMode m_Mode;
+    float m_Scale;
+
+    // one generator per vector lane for the TPDF kernel, and one per channel for noise shaping
+    std::array<uint32_t, SIMD_LANES> m_LaneGenerators {};
+    std::vector<ChannelState> m_Channels;
+};
+
+#endif //DITHER_H
@@ -0,0 +1,150 @@
+#include "Fft.h"
+#include "SimdKernels.h"
+
+#include <bit>
+#include <cmath>
+#include <numbers>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+RealFft::RealFft(const size_t size) : m_Size(size), m_Half(size / 2)
+{
+    if (!std::has_single_bit(size) || size < 4 || size > (size_t { 1 } << 31))
+        throw std::runtime_error("FFT size must be a power of two between 4 and 2^31, got " + std::to_string(size));
+
+    const unsigned bits = std::countr_zero(m_Half);
+
+    m_BitReverse.resize(m_Half);
+    for (size_t i = 0; i < m_Half; ++i)
+    {
+        size_t reversed = 0;
+        for (unsigned b = 0; b < bits; ++b)
+            reversed |= ((i >> b) & 1) << (bits - 1 - b);
+
+        m_BitReverse[i] = static_cast<uint32_t>(reversed);
+    }
+
+    // with an odd number of stages, the first one runs on its own as radix-2
+    for (size_t span = bits % 2 == 1 ? 2 : 1; 4 * span <= m_Half; span *= 4)
+    {
+        const size_t first = m_ForwardTwiddles.size();
+        m_ForwardTwiddles.resize(first + 6 * span);
+        m_InverseTwiddles.resize(first + 6 * span);
+
+        for (size_t j = 0; j < span; ++j)
+        {
+            const double angle1 = -std::numbers::pi * static_cast<double>(j) / static_cast<double>(span);
+            const double angle2 = angle1 / 2.;
+            // the second half of the second stage's butterflies, a quarter turn further
+            const double angle3 = angle2 - std::numbers::pi / 2.;
+
+            const double angles[3] = { angle1, angle2, angle3 };
+            for (size_t w = 0; w < 3; ++w)
+            {
+                const auto re = static_cast<float>(std::cos(angles[w]));
+                const auto im = static_cast<float>(std::sin(angles[w]));
+
+                m_ForwardTwiddles[first + 2 * w * span + j] = re;
+                m_ForwardTwiddles[first + (2 * w + 1) * span + j] = im;
+                m_InverseTwiddles[first + 2 * w * span + j] = re;
+                m_InverseTwiddles[first + (2 * w + 1) * span + j] = -im;
+            }
+        }
+    }
+
+    m_UntangleRe.resize(m_Half + 1);
+    m_UntangleIm.resize(m_Half + 1);
+    for (size_t k = 0; k <= m_Half; ++k)
+    {
+        const double angle = -2. * std::numbers::pi * static_cast<double>(k) / static_cast<double>(m_Size);
+        m_UntangleRe[k] = static_cast<float>(std::cos(angle));
+        m_UntangleIm[k] = static_cast<float>(std::sin(angle));
+    }
+
+    m_Re.resize(m_Half);
+    m_Im.resize(m_Half);
+}
+
+void RealFft::Transform(const float* twiddles)
+{
+    float* re = m_Re.data();
+    float* im = m_Im.data();
+
+    size_t span = 1;
+
+    if (std::countr_zero(m_Half) % 2 == 1)
+    {
+        for (size_t i = 0; i < m_Half; i += 2)
+        {
+            const float aRe = re[i], aIm = im[i];
+            re[i] = aRe + re[i + 1];
+            im[i] = aIm + im[i + 1];
+            re[i + 1] = aRe - re[i + 1];
+            im[i + 1] = aIm - im[i + 1];
+        }
+
+        span = 2;
+    }
+
+    for (; 4 * span <= m_Half; span *= 4)
+    {
+        FftRadix4Pass(re, im, m_Half, span, twiddles);
+        twiddles += 6 * span;
+    }
+}
+
+void RealFft::Forward(const float* signal, float* re, float* im)
+{
+    // even samples into the real parts, odd ones into the imaginary parts, in bit reversed order
+    for (size_t n = 0; n < m_Half; ++n)
+    {
+        m_Re[m_BitReverse[n]] = signal[2 * n];
+        m_Im[m_BitReverse[n]] = signal[2 * n + 1];
+    }
+
+    Transform(m_ForwardTwiddles.data());
+
+    // X[k] = E[k] + W^k O[k], E and O being the spectra of the even and of the odd samples
+    for (size_t k = 0; k <= m_Half; ++k)
+    {
+        const size_t a = k == m_Half ? 0 : k;
+        const size_t b = k == 0 ? 0 : m_Half - k;
+
+        const float evenRe = (m_Re[a] + m_Re[b]) * 0.5f;
+        const float evenIm = (m_Im[a] - m_Im[b]) * 0.5f;
+        const float oddRe = (m_Im[a] + m_Im[b]) * 0.5f;
+        const float oddIm = (m_Re[b] - m_Re[a]) * 0.5f;
+
+        re[k] = evenRe + m_UntangleRe[k] * oddRe - m_UntangleIm[k] * oddIm;
+        im[k] = evenIm + m_UntangleRe[k] * oddIm + m_UntangleIm[k] * oddRe;
+    }
+}
+
+void RealFft::Inverse(const float* re, const float* im, float* signal)
+{
+    // packs the spectra of the even and of the odd samples back into one, twice over
+    for (size_t k = 0; k < m_Half; ++k)
+    {
+        const size_t b = m_Half - k;
+
+        const float evenRe = re[k] + re[b];
+        const float evenIm = im[k] - im[b];
+        const float differenceRe = re[k] - re[b];
+        const float differenceIm = im[k] + im[b];
+
+        const float oddRe = differenceRe * m_UntangleRe[k] + differenceIm * m_UntangleIm[k];
+        const float oddIm = differenceIm * m_UntangleRe[k] - differenceRe * m_UntangleIm[k];
+
+        m_Re[m_BitReverse[k]] = evenRe - oddIm;
+        m_Im[m_BitReverse[k]] = evenIm + oddRe;
+    }
+
+    Transform(m_InverseTwiddles.data());
+
+    for (size_t n = 0; n < m_Half; ++n)
+    {
+        signal[2 * n] = m_Re[n];
+        signal[2 * n + 1] = m_Im[n];
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef FFT_H
+#define FFT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*! \brief Transform of real signals of a power of two size, spectra in split form.
+
+    The signal gets packed into a complex one of half the size, which goes through radix-4 passes (and
+    one radix-2 stage when its size is an odd power of two), and is then untangled into the Size() / 2 + 1
+    bins of the real spectrum. Holds scratch space, so an instance can't be shared between threads.
+*/
+class RealFft
+{
+public:
+    // size a power of two, at least 4
+    explicit RealFft(size_t size);
+
+    [[nodiscard]] size_t Size() const noexcept { return m_Size; }
+    [[nodiscard]] size_t BinCount() const noexcept { return m_Size / 2 + 1; }
+
+    // Size() samples in, BinCount() real and imaginary parts out, unscaled.
+    void Forward(const float* signal, float* re, float* im);
+
+    // BinCount() bins in, Size() samples out, scaled by Size(): Inverse(Forward(x)) is Size() * x.
+    void Inverse(const float* re, const float* im, float* signal);
+
+private:
+    // complex transform of the packed signal in place, from bit reversed into natural order
+    void Transform(const float* twiddles);
+
+    size_t m_Size;
+    // of the complex transform
+    size_t m_Half;
+
+    std::vector<uint32_t> m_BitReverse;
+    // per radix-4 pass, the twiddles laid out for FftRadix4Pass(), forward then inverse
+    std::vector<float> m_ForwardTwiddles;
+    std::vector<float> m_InverseTwiddles;
+    // e^(-2 pi i k / Size()) for k up to m_Half, untangles the packed transform
+    std::vector<float> m_UntangleRe;
+    std::vector<float> m_UntangleIm;
+
+    std::vector<float> m_Re;
+    std::vector<float> m_Im;
+};
+
+#endif //FFT_H
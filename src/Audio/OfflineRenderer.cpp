@@ -0,0 +1,118 @@
+#include "OfflineRenderer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <stdexcept>
+#include <thread>
+
+static OfflineRenderStats MakeStats(const size_t frames, const uint32_t rate, const double wallSeconds)
+{
+    const double audioSeconds = static_cast<double>(frames) / static_cast<double>(rate);
+    return { frames, audioSeconds, wallSeconds, wallSeconds > 0. ? audioSeconds / wallSeconds : 0. };
+}
+
+static OfflineRenderStats RenderJob(const OfflineRenderJob& job)
+{
+    if (job.m_Source == nullptr || job.m_Output == nullptr)
+        throw std::runtime_error("Offline render jobs need a source and an output");
+
+    const uint32_t rate = job.m_Output->Spec().m_Rate;
+    const size_t limit = job.m_MaxFrames.value_or(SIZE_MAX);
+
+    AudioBuffer frame;
+    size_t frames = 0;
+
+    const auto start = std::chrono::steady_clock::now();
+
+    // the last frame gets cut to the limit by the source itself
+    while (frames < limit && job.m_Source->NextFrameUpTo(frame, limit - frames))
+    {
+        job.m_Output->Write(frame);
+        frames += frame.FrameCount();
+    }
+
+    job.m_Output->Flush();
+
+    const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start);
+    return MakeStats(frames, rate, elapsed.count());
+}
+
+OfflineRenderReport RenderOffline(const std::vector<OfflineRenderJob>& jobs, const size_t threads)
+{
+    OfflineRenderReport report = RenderOffline(
+        jobs.size(), [&jobs](const size_t index) { return jobs[index]; }, threads);
+
+    for (const std::exception_ptr& error : report.m_Errors)
+    {
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+    report.m_Errors.clear();
+    return report;
+}
+
+OfflineRenderReport RenderOffline(const size_t jobCount, const OfflineJobFactory& makeJob, size_t threads,
+                                  const OfflineJobCallback& onFinished)
+{
+    if (threads == 0)
+        threads = std::max(std::thread::hardware_concurrency(), 1u);
+    threads = std::min(threads, jobCount);
+
+    OfflineRenderReport report;
+    report.m_Jobs.resize(jobCount);
+    report.m_Errors.resize(jobCount);
+
+    std::atomic<size_t> nextJob = 0;
+
+    // jobs get claimed one at a time, so a long job doesn't hold up a queue of short ones behind it
+    const auto work = [&] {
+        for (size_t i = nextJob.fetch_add(1); i < jobCount; i = nextJob.fetch_add(1))
+        {
+            try
+            {
+                // the job's source and output go away again before the next one gets made
+                report.m_Jobs[i] = RenderJob(makeJob(i));
+            }
+            catch (...)
+            {
+                report.m_Jobs[i] = {};
+                report.m_Errors[i] = std::current_exception();
+            }
+
+            if (onFinished)
+                onFinished(i, report.m_Jobs[i], report.m_Errors[i]);
+        }
+    };
+
+    const auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> workers;
+    workers.reserve(threads > 0 ? threads - 1 : 0);
+    for (size_t i = 1; i < threads; ++i)
+        workers.emplace_back(work);
+
+    // the calling thread works along instead of waiting idle
+    work();
+
+    for (std::thread& worker : workers)
+        worker.join();
+
+    const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start);
+
+    // jobs may run at different rates, the total counts seconds of audio rather than frames
+    double audioSeconds = 0.;
+    size_t frames = 0;
+    for (const OfflineRenderStats& stats : report.m_Jobs)
+    {
+        audioSeconds += stats.m_AudioSeconds;
+        frames += stats.m_Frames;
+    }
+
+    const double wallSeconds = elapsed.count();
+    report.m_Total = { frames, audioSeconds, wallSeconds, wallSeconds > 0. ? audioSeconds / wallSeconds : 0. };
+
+    return report;
+}
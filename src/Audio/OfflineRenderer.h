@@ -0,0 +1,68 @@
+#ifndef OFFLINERENDERER_H
+#define OFFLINERENDERER_H
+
+#include "AudioOutput.h"
+#include "AudioSource.h"
+
+#include <exception>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <vector>
+
+struct OfflineRenderJob
+{
+    std::shared_ptr<AudioSource> m_Source;
+    std::shared_ptr<AudioOutput> m_Output;
+    // stops after this many frames, sources which never end need a limit
+    std::optional<size_t> m_MaxFrames;
+};
+
+struct OfflineRenderStats
+{
+    size_t m_Frames;
+    double m_AudioSeconds;
+    double m_WallSeconds;
+    // audio seconds rendered per second of wall time
+    double m_RealtimeFactor;
+};
+
+struct OfflineRenderReport
+{
+    // in the order of the jobs
+    std::vector<OfflineRenderStats> m_Jobs;
+    // what each job threw, null for the ones which finished. Only the RenderOffline() taking a job
+    // factory fills these in, the other one rethrows
+    std::vector<std::exception_ptr> m_Errors;
+    // all audio over the wall time of the whole render, so it grows with the threads put to use
+    OfflineRenderStats m_Total;
+};
+
+/*! \brief Renders every job's source into its output as fast as the graph allows, with no device involved.
+
+    Jobs are independent of each other and get spread over worker threads, one job is only ever pulled
+    from by a single thread. Outputs get flushed once their source ends or hits its frame limit. When a
+    job throws, the remaining jobs still finish before the first error gets rethrown.
+
+    \param threads worker count, 0 uses one per hardware thread; never more than there are jobs
+*/
+OfflineRenderReport RenderOffline(const std::vector<OfflineRenderJob>& jobs, size_t threads = 0);
+
+// makes the job of the given index
+using OfflineJobFactory = std::function<OfflineRenderJob(size_t index)>;
+// told about every job as it finishes, on the thread which rendered it; error is null when it went fine
+using OfflineJobCallback =
+    std::function<void(size_t index, const OfflineRenderStats& stats, const std::exception_ptr& error)>;
+
+/*! \brief Same as the RenderOffline() above, for batches too large to set up all at once.
+
+    Each job gets made by makeJob on the thread which renders it and is dropped right after, so no more
+    than threads jobs hold their sources and outputs at any time. A job throwing, makeJob included, is
+    recorded in the report's m_Errors and doesn't stop the others.
+
+    \param onFinished optional, mustn't throw
+*/
+OfflineRenderReport RenderOffline(size_t jobCount, const OfflineJobFactory& makeJob, size_t threads = 0,
+                                  const OfflineJobCallback& onFinished = nullptr);
+
+#endif //OFFLINERENDERER_H
@@ -0,0 +1,245 @@
+#include "OggPageReader.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+
+constexpr size_t PAGE_HEADER_SIZE = 27;
+constexpr char CAPTURE_PATTERN[] = { 'O', 'g', 'g', 'S' };
+
+// chunk read at a time while looking for the next capture pattern
+constexpr size_t SCAN_CHUNK_SIZE = 64 * 1024;
+
+// CRC-32 with polynomial 0x04c11db7, no reflection, zero initial value and no final xor
+static constexpr std::array<uint32_t, 256> MakeCrcTable()
+{
+    std::array<uint32_t, 256> table {};
+
+    for (uint32_t i = 0; i < 256; ++i)
+    {
+        uint32_t r = i << 24;
+        for (int bit = 0; bit < 8; ++bit)
+            r = (r & 0x80000000u) != 0 ? (r << 1) ^ 0x04c11db7u : r << 1;
+
+        table[i] = r;
+    }
+
+    return table;
+}
+
+static constexpr auto CRC_TABLE = MakeCrcTable();
+
+static uint32_t UpdateCrc(uint32_t crc, const uint8_t* data, const size_t length)
+{
+    for (size_t i = 0; i < length; ++i)
+        crc = (crc << 8) ^ CRC_TABLE[((crc >> 24) ^ data[i]) & 0xff];
+
+    return crc;
+}
+
+template <typename T>
+static T ReadLittleEndian(const uint8_t* data)
+{
+    T value = 0;
+    for (size_t i = 0; i < sizeof(T); ++i)
+        value |= static_cast<T>(data[i]) << (8 * i);
+
+    return value;
+}
+
+OggPageReader::OggPageReader(const std::string& path)
+    : m_File(path, std::ios::binary)
+{
+    if (!m_File)
+        throw std::runtime_error("Could not open " + path);
+
+    m_File.seekg(0, std::ios::end);
+    m_FileSize = static_cast<uint64_t>(m_File.tellg());
+    m_File.seekg(0);
+}
+
+bool OggPageReader::NextPage(OggPage& page)
+{
+    while (m_Position + PAGE_HEADER_SIZE <= m_FileSize)
+    {
+        if (TryReadPage(page))
+            return true;
+
+        // look for the next capture pattern past the broken page
+        std::vector<uint8_t> chunk(SCAN_CHUNK_SIZE);
+        uint64_t offset = m_Position + 1;
+        bool found = false;
+
+        while (!found && offset + sizeof(CAPTURE_PATTERN) <= m_FileSize)
+        {
+            const size_t length = std::min<uint64_t>(chunk.size(), m_FileSize - offset);
+
+            m_File.clear();
+            m_File.seekg(static_cast<std::streamoff>(offset));
+            m_File.read(reinterpret_cast<char*>(chunk.data()), static_cast<std::streamsize>(length));
+
+            const auto it = std::search(chunk.begin(), chunk.begin() + static_cast<ptrdiff_t>(length),
+                                        std::begin(CAPTURE_PATTERN), std::end(CAPTURE_PATTERN));
+
+            if (it != chunk.begin() + static_cast<ptrdiff_t>(length))
+            {
+                m_Position = offset + static_cast<uint64_t>(it - chunk.begin());
+                found = true;
+            }
+            else
+            {
+                // the pattern may straddle two chunks
+                offset += length - (sizeof(CAPTURE_PATTERN) - 1);
+                if (length < chunk.size())
+                    break;
+            }
+        }
+
+        if (!found)
+        {
+            m_Position = m_FileSize;
+            return false;
+        }
+    }
+
+    return false;
+}
+
+void OggPageReader::SeekTo(const uint64_t offset)
+{
+    m_Position = std::min(offset, m_FileSize);
+}
+
+std::optional<int64_t> OggPageReader::LastGranule(const uint32_t serial)
+{
+    std::vector<uint8_t> chunk(SCAN_CHUNK_SIZE);
+    uint64_t end = m_FileSize;
+    OggPage page;
+
+    while (end > 0)
+    {
+        const uint64_t start = end > chunk.size() ? end - chunk.size() : 0;
+        const size_t length = end - start;
+
+        m_File.clear();
+        m_File.seekg(static_cast<std::streamoff>(start));
+        m_File.read(reinterpret_cast<char*>(chunk.data()), static_cast<std::streamsize>(length));
+
+        std::optional<int64_t> granule;
+
+        for (size_t i = 0; i + sizeof(CAPTURE_PATTERN) <= length; ++i)
+        {
+            if (std::memcmp(chunk.data() + i, CAPTURE_PATTERN, sizeof(CAPTURE_PATTERN)) != 0)
+                continue;
+
+            m_Position = start + i;
+            if (TryReadPage(page) && page.m_Serial == serial && page.m_Granule != OGG_NO_GRANULE)
+                granule = page.m_Granule;
+        }
+
+        if (granule.has_value())
+            return granule;
+
+        // keep an overlap, so that a pattern straddling the chunks is seen in the next one
+        end = start == 0 ? 0 : start + sizeof(CAPTURE_PATTERN) - 1;
+    }
+
+    return std::nullopt;
+}
+
+bool OggPageReader::TryReadPage(OggPage& page)
+{
+    std::array<uint8_t, PAGE_HEADER_SIZE> header {};
+
+    if (m_Position + header.size() > m_FileSize)
+        return false;
+
+    m_File.clear();
+    m_File.seekg(static_cast<std::streamoff>(m_Position));
+    m_File.read(reinterpret_cast<char*>(header.data()), header.size());
+
+    if (!m_File || std::memcmp(header.data(), CAPTURE_PATTERN, sizeof(CAPTURE_PATTERN)) != 0 || header[4] != 0)
+        return false;
+
+    const uint8_t segmentCount = header[26];
+    page.m_Lacing.resize(segmentCount);
+    m_File.read(reinterpret_cast<char*>(page.m_Lacing.data()), segmentCount);
+
+    const size_t bodySize = std::accumulate(page.m_Lacing.begin(), page.m_Lacing.end(), size_t { 0 });
+    if (!m_File || m_Position + header.size() + segmentCount + bodySize > m_FileSize)
+        return false;
+
+    page.m_Body.resize(bodySize);
+    m_File.read(reinterpret_cast<char*>(page.m_Body.data()), static_cast<std::streamsize>(bodySize));
+
+    // the checksum is computed with its own field zeroed
+    const uint32_t expectedCrc = ReadLittleEndian<uint32_t>(header.data() + 22);
+    std::fill_n(header.begin() + 22, 4, 0);
+
+    uint32_t crc = UpdateCrc(0, header.data(), header.size());
+    crc = UpdateCrc(crc, page.m_Lacing.data(), page.m_Lacing.size());
+    crc = UpdateCrc(crc, page.m_Body.data(), page.m_Body.size());
+
+    if (!m_File || crc != expectedCrc)
+        return false;
+
+    page.m_Offset = m_Position;
+    page.m_HeaderType = header[5];
+    page.m_Granule = static_cast<int64_t>(ReadLittleEndian<uint64_t>(header.data() + 6));
+    page.m_Serial = ReadLittleEndian<uint32_t>(header.data() + 14);
+    page.m_Sequence = ReadLittleEndian<uint32_t>(header.data() + 18);
+
+    m_Position += page.Size();
+    return true;
+}
+
+void OggPacketAssembler::Push(const OggPage& page, std::vector<std::vector<uint8_t>>& packets)
+{
+    // a gap in the sequence means the partial packet is missing its middle
+    if (m_LastSequence.has_value() && page.m_Sequence != *m_LastSequence + 1)
+        Reset();
+
+    m_LastSequence = page.m_Sequence;
+
+    // without the start of the continued packet, its remainder has to be skipped
+    bool skipping = page.IsContinued() && !m_HasPartial;
+    if (!page.IsContinued())
+    {
+        m_Partial.clear();
+        m_HasPartial = false;
+    }
+
+    size_t offset = 0;
+
+    for (const uint8_t lacing : page.m_Lacing)
+    {
+        if (!skipping)
+        {
+            m_Partial.insert(m_Partial.end(), page.m_Body.begin() + static_cast<ptrdiff_t>(offset),
+                             page.m_Body.begin() + static_cast<ptrdiff_t>(offset + lacing));
+            m_HasPartial = true;
+        }
+
+        offset += lacing;
+
+        // a lacing value below 255 ends the packet
+        if (lacing < 255)
+        {
+            if (!skipping)
+                packets.push_back(std::move(m_Partial));
+
+            m_Partial.clear();
+            m_HasPartial = false;
+            skipping = false;
+        }
+    }
+}
+
+void OggPacketAssembler::Reset() noexcept
+{
+    m_Partial.clear();
+    m_HasPartial = false;
+    m_LastSequence.reset();
+}
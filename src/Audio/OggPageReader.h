@@ -0,0 +1,83 @@
+#ifndef OGGPAGEREADER_H
+#define OGGPAGEREADER_H
+
+#include <cstdint>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <vector>
+
+// header_type flags
+constexpr uint8_t OGG_PAGE_CONTINUED = 0x01;
+constexpr uint8_t OGG_PAGE_FIRST = 0x02;
+constexpr uint8_t OGG_PAGE_LAST = 0x04;
+
+// granule position of pages on which no packet ends
+constexpr int64_t OGG_NO_GRANULE = -1;
+
+struct OggPage
+{
+    // file offset of the capture pattern
+    uint64_t m_Offset;
+    uint8_t m_HeaderType;
+    int64_t m_Granule;
+    uint32_t m_Serial;
+    uint32_t m_Sequence;
+
+    std::vector<uint8_t> m_Lacing;
+    std::vector<uint8_t> m_Body;
+
+    [[nodiscard]] bool IsContinued() const noexcept { return (m_HeaderType & OGG_PAGE_CONTINUED) != 0; }
+    [[nodiscard]] bool IsLast() const noexcept { return (m_HeaderType & OGG_PAGE_LAST) != 0; }
+    // total size of the page in the file
+    [[nodiscard]] uint64_t Size() const noexcept { return 27 + m_Lacing.size() + m_Body.size(); }
+};
+
+// Reads the pages of an Ogg file, resynchronising on the next capture pattern whenever a page is
+// malformed or fails its checksum.
+class OggPageReader
+{
+public:
+    explicit OggPageReader(const std::string& path);
+
+    // Reads the page at the current position, or the first valid one after it. Returns false at the
+    // end of the file.
+    bool NextPage(OggPage& page);
+
+    // Continues reading at offset, which doesn't have to be on a page boundary.
+    void SeekTo(uint64_t offset);
+
+    [[nodiscard]] uint64_t Position() const noexcept { return m_Position; }
+    [[nodiscard]] uint64_t FileSize() const noexcept { return m_FileSize; }
+
+    // Granule position of the last page of the stream serial which has one, found by scanning
+    // backwards from the end of the file. Leaves the read position unspecified.
+    [[nodiscard]] std::optional<int64_t> LastGranule(uint32_t serial);
+
+private:
+    // tries to parse a page at m_Position, the position is left untouched on failure
+    bool TryReadPage(OggPage& page);
+
+    std::ifstream m_File;
+    uint64_t m_FileSize;
+    uint64_t m_Position = 0;
+};
+
+// Splits a sequence of pages of one logical stream into packets.
+class OggPacketAssembler
+{
+public:
+    // Appends the packets completed on page to packets. A packet continued from a page which wasn't
+    // pushed (after Reset(), or past a gap in the page sequence) is dropped.
+    void Push(const OggPage& page, std::vector<std::vector<uint8_t>>& packets);
+
+    // Forgets the partially assembled packet, for when reading resumes somewhere else.
+    void Reset() noexcept;
+
+private:
+    std::vector<uint8_t> m_Partial;
+    bool m_HasPartial = false;
+    std::optional<uint32_t> m_LastSequence;
+};
+
+#endif //OGGPAGEREADER_H
@@ -0,0 +1,186 @@
+#include "OggSeekIndex.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+constexpr char CACHE_MAGIC[8] = { 'O', 'g', 'g', 'S', 'I', 'd', 'x', 1 };
+constexpr size_t CACHE_HEADER_SIZE = sizeof(CACHE_MAGIC) + 4 + 8 + 8 + 8;
+constexpr size_t CACHE_POINT_SIZE = 16;
+// smallest possible Ogg page, bounds how many points a stream of a given size can have
+constexpr uint64_t MIN_PAGE_SIZE = 27;
+
+struct FileIdentity
+{
+    uint64_t m_Size;
+    int64_t m_ModifiedNanoseconds;
+};
+
+static std::optional<FileIdentity> Identify(const std::string& path)
+{
+    struct stat info {};
+    if (stat(path.c_str(), &info) != 0)
+        return std::nullopt;
+
+    return FileIdentity { static_cast<uint64_t>(info.st_size),
+                          static_cast<int64_t>(info.st_mtim.tv_sec) * 1'000'000'000 + info.st_mtim.tv_nsec };
+}
+
+template <typename T>
+static void PutLittleEndian(std::vector<uint8_t>& out, const T value)
+{
+    const auto bits = static_cast<uint64_t>(value);
+    for (size_t i = 0; i < sizeof(T); ++i)
+        out.push_back(static_cast<uint8_t>(bits >> (8 * i)));
+}
+
+template <typename T>
+static T GetLittleEndian(const uint8_t* data)
+{
+    uint64_t bits = 0;
+    for (size_t i = 0; i < sizeof(T); ++i)
+        bits |= static_cast<uint64_t>(data[i]) << (8 * i);
+
+    return static_cast<T>(bits);
+}
+
+OggSeekIndex OggSeekIndex::Build(const std::string& path, OggPageReader& reader, const uint32_t serial,
+                                 const uint64_t dataOffset)
+{
+    OggSeekIndex index;
+    index.m_Path = path;
+    index.m_Serial = serial;
+
+    if (const auto identity = Identify(path); identity.has_value())
+    {
+        index.m_FileSize = identity->m_Size;
+        index.m_ModifiedNanoseconds = identity->m_ModifiedNanoseconds;
+    }
+
+    OggPage page;
+    reader.SeekTo(dataOffset);
+
+    while (reader.NextPage(page))
+    {
+        if (page.m_Serial != serial || page.m_Granule == OGG_NO_GRANULE)
+            continue;
+
+        // granule positions only ever grow, a page going backwards is corrupt and can't be seeked to
+        if (!index.m_Points.empty() && page.m_Granule < index.m_Points.back().m_Granule)
+            continue;
+
+        index.m_Points.push_back({ page.m_Granule, page.m_Offset });
+    }
+
+    return index;
+}
+
+std::optional<OggSeekIndex> OggSeekIndex::Load(const std::string& path, const uint32_t serial)
+{
+    const auto identity = Identify(path);
+    if (!identity.has_value())
+        return std::nullopt;
+
+    std::ifstream file(CachePath(path), std::ios::binary | std::ios::ate);
+    if (!file)
+        return std::nullopt;
+
+    const auto length = static_cast<size_t>(file.tellg());
+    if (length < CACHE_HEADER_SIZE)
+        return std::nullopt;
+
+    std::vector<uint8_t> data(length);
+    file.seekg(0);
+    if (!file.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(length)))
+        return std::nullopt;
+
+    const uint8_t* header = data.data();
+    if (std::memcmp(header, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0)
+        return std::nullopt;
+
+    OggSeekIndex index;
+    index.m_Path = path;
+    index.m_Serial = GetLittleEndian<uint32_t>(header + 8);
+    index.m_FileSize = GetLittleEndian<uint64_t>(header + 12);
+    index.m_ModifiedNanoseconds = GetLittleEndian<int64_t>(header + 20);
+    const auto count = GetLittleEndian<uint64_t>(header + 28);
+
+    // a cache for another stream, for an older version of the file, or cut short
+    if (index.m_Serial != serial || index.m_FileSize != identity->m_Size ||
+        index.m_ModifiedNanoseconds != identity->m_ModifiedNanoseconds || count > identity->m_Size / MIN_PAGE_SIZE ||
+        length != CACHE_HEADER_SIZE + count * CACHE_POINT_SIZE)
+    {
+        return std::nullopt;
+    }
+
+    index.m_Points.resize(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        const uint8_t* point = data.data() + CACHE_HEADER_SIZE + i * CACHE_POINT_SIZE;
+        index.m_Points[i] = { GetLittleEndian<int64_t>(point), GetLittleEndian<uint64_t>(point + 8) };
+
+        if (index.m_Points[i].m_Offset >= identity->m_Size ||
+            (i > 0 && index.m_Points[i].m_Granule < index.m_Points[i - 1].m_Granule))
+        {
+            return std::nullopt;
+        }
+    }
+
+    return index;
+}
+
+bool OggSeekIndex::Save() const
+{
+    std::vector<uint8_t> data(std::begin(CACHE_MAGIC), std::end(CACHE_MAGIC));
+    data.reserve(CACHE_HEADER_SIZE + m_Points.size() * CACHE_POINT_SIZE);
+
+    PutLittleEndian(data, m_Serial);
+    PutLittleEndian(data, m_FileSize);
+    PutLittleEndian(data, m_ModifiedNanoseconds);
+    PutLittleEndian(data, static_cast<uint64_t>(m_Points.size()));
+
+    for (const OggSeekPoint& point : m_Points)
+    {
+        PutLittleEndian(data, point.m_Granule);
+        PutLittleEndian(data, point.m_Offset);
+    }
+
+    // written aside and renamed into place, so a reader never sees half a cache, even with two
+    // processes building it at once
+    const std::string cachePath = CachePath(m_Path);
+    const std::string temporaryPath = cachePath + "." + std::to_string(getpid());
+
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (!file || !file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size())))
+        {
+            std::remove(temporaryPath.c_str());
+            return false;
+        }
+    }
+
+    if (std::rename(temporaryPath.c_str(), cachePath.c_str()) != 0)
+    {
+        std::remove(temporaryPath.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+std::optional<uint64_t> OggSeekIndex::PageBefore(const int64_t granule) const
+{
+    const auto after = std::upper_bound(m_Points.begin(), m_Points.end(), granule,
+                                        [](const int64_t value, const OggSeekPoint& point) {
+                                            return value < point.m_Granule;
+                                        });
+
+    if (after == m_Points.begin())
+        return std::nullopt;
+
+    return std::prev(after)->m_Offset;
+}
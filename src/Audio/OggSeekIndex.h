@@ -0,0 +1,56 @@
+#ifndef OGGSEEKINDEX_H
+#define OGGSEEKINDEX_H
+
+#include "OggPageReader.h"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+struct OggSeekPoint
+{
+    // granule position at the end of the page
+    int64_t m_Granule;
+    // file offset of the page
+    uint64_t m_Offset;
+};
+
+/*! \brief Granule positions of the pages of one logical stream, in file order.
+
+    Finding the page to start decoding from becomes a binary search in memory rather than a bisection
+    over the file. Building the index takes one pass over the pages, so it gets cached in a file next to
+    the stream and reused for as long as the stream's size and modification time stay the same.
+*/
+class OggSeekIndex
+{
+public:
+    // Reads every page of the stream serial from dataOffset on. Leaves reader's position unspecified.
+    static OggSeekIndex Build(const std::string& path, OggPageReader& reader, uint32_t serial, uint64_t dataOffset);
+
+    // The index cached for the stream at path, nullopt when there is none or it's out of date.
+    static std::optional<OggSeekIndex> Load(const std::string& path, uint32_t serial);
+
+    // Writes the cache file, returns false when it can't be written, e.g. next to a read-only asset.
+    bool Save() const;
+
+    static std::string CachePath(const std::string& path) { return path + ".seekindex"; }
+
+    // offset of the last page whose granule position isn't past granule, if any
+    [[nodiscard]] std::optional<uint64_t> PageBefore(int64_t granule) const;
+
+    [[nodiscard]] const std::vector<OggSeekPoint>& Points() const noexcept { return m_Points; }
+
+private:
+    OggSeekIndex() = default;
+
+    std::string m_Path;
+    uint32_t m_Serial = 0;
+    // of the stream when the index was built, a cache not matching them is stale
+    uint64_t m_FileSize = 0;
+    int64_t m_ModifiedNanoseconds = 0;
+
+    std::vector<OggSeekPoint> m_Points;
+};
+
+#endif //OGGSEEKINDEX_H
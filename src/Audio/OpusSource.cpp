@@ -0,0 +1,438 @@
+#include "OpusSource.h"
+
+#include <opus/opus_multistream.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+
+// Opus always decodes at 48 kHz
+constexpr uint32_t OPUS_RATE = 48000;
+// longest packet, 120 ms
+constexpr size_t OPUS_MAX_PACKET_SAMPLES = 5760;
+// decoding this long ahead of a seek target lets the decoder converge, see RFC 7845 section 4.6
+constexpr int64_t OPUS_SEEK_PREROLL = 3840;
+
+// decoded packets kept ahead of the consumer
+constexpr size_t DECODE_QUEUE_CAPACITY = 32;
+
+constexpr ChannelFlagValue FL = ChannelFlagValue::FRONT_LEFT;
+constexpr ChannelFlagValue FR = ChannelFlagValue::FRONT_RIGHT;
+constexpr ChannelFlagValue FC = ChannelFlagValue::FRONT_CENTRE;
+constexpr ChannelFlagValue LFE = ChannelFlagValue::LFE1;
+constexpr ChannelFlagValue RL = ChannelFlagValue::REAR_LEFT;
+constexpr ChannelFlagValue RR = ChannelFlagValue::REAR_RIGHT;
+constexpr ChannelFlagValue RC = ChannelFlagValue::REAR_CENTRE;
+constexpr ChannelFlagValue SL = ChannelFlagValue::SIDE_LEFT;
+constexpr ChannelFlagValue SR = ChannelFlagValue::SIDE_RIGHT;
+
+// speaker of each coded channel for mapping families 0 and 1, in Vorbis channel order
+static const std::vector<ChannelFlagValue> VORBIS_CHANNEL_ORDERS[] = {
+    { FL },
+    { FL, FR },
+    { FL, FC, FR },
+    { FL, FR, RL, RR },
+    { FL, FC, FR, RL, RR },
+    { FL, FC, FR, RL, RR, LFE },
+    { FL, FC, FR, SL, SR, RC, LFE },
+    { FL, FC, FR, SL, SR, RL, RR, LFE },
+};
+
+OpusSource::OpusSource(const std::string& path)
+    : m_Path(path), m_Reader(path)
+{
+    ReadHeaders();
+    m_Index = OggSeekIndex::Load(path, m_Serial);
+
+    const auto lastGranule = m_Reader.LastGranule(m_Serial);
+    m_EndGranule = std::max<int64_t>(lastGranule.value_or(0), m_PreSkip);
+    m_TotalSamples = static_cast<size_t>(m_EndGranule - m_PreSkip);
+
+    int error = OPUS_OK;
+    m_Decoder = opus_multistream_decoder_create(OPUS_RATE, static_cast<int>(m_Spec.m_Channels.Count()), m_StreamCount,
+                                                m_CoupledCount, m_Mapping.data(), &error);
+
+    if (error != OPUS_OK || m_Decoder == nullptr)
+        throw std::runtime_error("Could not create Opus decoder: " + std::string(opus_strerror(error)));
+
+    opus_multistream_decoder_ctl(m_Decoder, OPUS_SET_GAIN(m_OutputGain));
+
+    m_Pcm.resize(OPUS_MAX_PACKET_SAMPLES * m_Spec.m_Channels.Count());
+
+    m_Reader.SeekTo(m_DataOffset);
+    m_NextGranule = 0;
+    m_DiscardUntil = m_PreSkip;
+
+    m_DecoderThread = std::thread(&OpusSource::DecodeLoop, this);
+}
+
+OpusSource::~OpusSource()
+{
+    {
+        std::lock_guard lock(m_Mutex);
+        m_Stopping = true;
+    }
+
+    m_DecoderWake.notify_one();
+
+    if (m_DecoderThread.joinable())
+        m_DecoderThread.join();
+
+    if (m_Decoder != nullptr)
+        opus_multistream_decoder_destroy(m_Decoder);
+}
+
+void OpusSource::ReadHeaders()
+{
+    bool haveHead = false;
+    size_t packetIndex = 0;
+
+    // the identification header sits alone on the first page, the comment header follows on its own
+    // pages, and audio starts on a fresh page after it
+    while (m_Reader.NextPage(m_Page))
+    {
+        if (!haveHead)
+        {
+            if ((m_Page.m_HeaderType & OGG_PAGE_FIRST) == 0)
+                continue;
+
+            m_Packets.clear();
+            OggPacketAssembler headAssembler;
+            headAssembler.Push(m_Page, m_Packets);
+
+            if (m_Packets.empty() || m_Packets.front().size() < 8 ||
+                std::memcmp(m_Packets.front().data(), "OpusHead", 8) != 0)
+            {
+                continue;
+            }
+
+            m_Serial = m_Page.m_Serial;
+            ParseOpusHead(m_Packets.front());
+
+            haveHead = true;
+            m_Packets.clear();
+            m_Assembler.Reset();
+            packetIndex = 1;
+            continue;
+        }
+
+        if (m_Page.m_Serial != m_Serial)
+            continue;
+
+        m_Assembler.Push(m_Page, m_Packets);
+        packetIndex += m_Packets.size();
+        m_Packets.clear();
+
+        if (packetIndex >= 2)
+        {
+            m_DataOffset = m_Reader.Position();
+            m_Assembler.Reset();
+            return;
+        }
+    }
+
+    throw std::runtime_error(haveHead ? "Opus stream has no comment header" : "Not an Ogg Opus stream");
+}
+
+void OpusSource::ParseOpusHead(const std::vector<uint8_t>& packet)
+{
+    if (packet.size() < 19)
+        throw std::runtime_error("Opus identification header is truncated");
+
+    // only the major version is fixed, minor versions stay compatible
+    if ((packet[8] & 0xf0) != 0)
+        throw std::runtime_error("Unsupported Opus version " + std::to_string(packet[8]));
+
+    const size_t channels = packet[9];
+    m_PreSkip = static_cast<uint16_t>(packet[10] | packet[11] << 8);
+    m_OutputGain = static_cast<int16_t>(packet[16] | packet[17] << 8);
+
+    const uint8_t family = packet[18];
+    std::array<uint8_t, 255> mapping {};
+
+    if (family == 0)
+    {
+        if (channels < 1 || channels > 2)
+            throw std::runtime_error("Opus mapping family 0 needs one or two channels");
+
+        m_StreamCount = 1;
+        m_CoupledCount = static_cast<int>(channels) - 1;
+        mapping[0] = 0;
+        mapping[1] = 1;
+    }
+    else if (family == 1)
+    {
+        if (channels < 1 || channels > 8 || packet.size() < 21 + channels)
+            throw std::runtime_error("Malformed Opus channel mapping table");
+
+        m_StreamCount = packet[19];
+        m_CoupledCount = packet[20];
+        std::copy_n(packet.begin() + 21, channels, mapping.begin());
+    }
+    else
+    {
+        throw std::runtime_error("Unsupported Opus channel mapping family " + std::to_string(family));
+    }
+
+    // ChannelLayout orders channels by their flag, so the decoder's output gets permuted to match
+    const auto& speakers = VORBIS_CHANNEL_ORDERS[channels - 1];
+    std::vector<size_t> order(channels);
+    std::iota(order.begin(), order.end(), size_t { 0 });
+    std::sort(order.begin(), order.end(), [&](const size_t a, const size_t b) {
+        return static_cast<uint32_t>(speakers[a]) < static_cast<uint32_t>(speakers[b]);
+    });
+
+    ChannelLayout layout;
+    for (size_t i = 0; i < channels; ++i)
+    {
+        layout.SetFlagState(speakers[order[i]], true);
+        m_Mapping[i] = mapping[order[i]];
+    }
+
+    m_Spec = { OPUS_RATE, layout };
+}
+
+std::optional<AudioBuffer> OpusSource::NextFrame()
+{
+    AudioBuffer frame;
+    if (!NextFrameInto(frame))
+        return std::nullopt;
+
+    return frame;
+}
+
+bool OpusSource::DoNextFrameInto(AudioBuffer& frame)
+{
+    return NextFrameUpTo(frame, SIZE_MAX);
+}
+
+bool OpusSource::NextFrameUpTo(AudioBuffer& frame, const size_t maxFrames)
+{
+    std::unique_lock lock(m_Mutex);
+    m_QueueChanged.wait(lock, [this] { return !m_Queue.empty() || m_DecoderEnded; });
+
+    if (m_DecoderError)
+        std::rethrow_exception(m_DecoderError);
+
+    if (m_Queue.empty())
+        return false;
+
+    AudioBuffer& front = m_Queue.front();
+    const size_t remaining = front.FrameCount() - m_FrontOffset;
+
+    if (m_FrontOffset == 0 && remaining <= maxFrames)
+    {
+        frame = std::move(front);
+    }
+    else
+    {
+        // decoded frames are 20 ms long at most, smaller periods take them apart
+        const size_t count = std::min(maxFrames, remaining);
+        front.CopyFramesInto(frame, m_FrontOffset, count);
+        m_FrontOffset += count;
+    }
+
+    m_CurrentSample += frame.FrameCount();
+
+    if (m_FrontOffset != 0 && m_FrontOffset < front.FrameCount())
+        return true;
+
+    m_Queue.pop_front();
+    m_FrontOffset = 0;
+
+    lock.unlock();
+    m_DecoderWake.notify_one();
+
+    return true;
+}
+
+void OpusSource::SeekTo(const size_t sample)
+{
+    {
+        std::lock_guard lock(m_Mutex);
+
+        if (m_DecoderError)
+            std::rethrow_exception(m_DecoderError);
+
+        m_SeekRequest = std::min(sample, *m_TotalSamples);
+        m_CurrentSample = *m_SeekRequest;
+        ++m_Generation;
+        m_Queue.clear();
+        m_FrontOffset = 0;
+        m_DecoderEnded = false;
+    }
+
+    m_DecoderWake.notify_one();
+}
+
+void OpusSource::DecodeLoop()
+{
+    AudioBuffer frame;
+
+    try
+    {
+        while (true)
+        {
+            uint64_t generation;
+
+            {
+                std::unique_lock lock(m_Mutex);
+                m_DecoderWake.wait(lock, [this] {
+                    return m_Stopping || m_SeekRequest.has_value() ||
+                           (!m_DecoderEnded && m_Queue.size() < DECODE_QUEUE_CAPACITY);
+                });
+
+                if (m_Stopping)
+                    return;
+
+                if (m_SeekRequest.has_value())
+                {
+                    const size_t target = *m_SeekRequest;
+                    m_SeekRequest.reset();
+
+                    lock.unlock();
+                    Reposition(target);
+                    continue;
+                }
+
+                generation = m_Generation;
+            }
+
+            // libopus runs outside of the lock, so the consumer is never held up by it
+            const bool decoded = DecodeNext(frame);
+
+            {
+                std::lock_guard lock(m_Mutex);
+
+                // a seek came in while decoding, the frame belongs to the old position
+                if (generation != m_Generation)
+                    continue;
+
+                if (decoded)
+                    m_Queue.push_back(std::move(frame));
+                else
+                    m_DecoderEnded = true;
+            }
+
+            m_QueueChanged.notify_one();
+        }
+    }
+    catch (...)
+    {
+        {
+            std::lock_guard lock(m_Mutex);
+            m_DecoderError = std::current_exception();
+            m_DecoderEnded = true;
+        }
+
+        m_QueueChanged.notify_one();
+    }
+}
+
+bool OpusSource::DecodeNext(AudioBuffer& frame)
+{
+    const size_t channels = m_Spec.m_Channels.Count();
+
+    while (true)
+    {
+        // right after a seek the position is only known once a page with a granule position shows
+        // up, it then counts back over the packets completed since
+        while (m_PendingPackets.empty() || !m_NextGranule.has_value())
+        {
+            if (!m_Reader.NextPage(m_Page))
+                return false;
+
+            if (m_Page.m_Serial != m_Serial)
+                continue;
+
+            m_Packets.clear();
+            m_Assembler.Push(m_Page, m_Packets);
+            for (auto& packet : m_Packets)
+                m_PendingPackets.push_back(std::move(packet));
+
+            if (!m_NextGranule.has_value() && m_Page.m_Granule != OGG_NO_GRANULE)
+            {
+                int64_t samples = 0;
+                for (const auto& packet : m_PendingPackets)
+                {
+                    const int count = opus_packet_get_nb_samples(packet.data(), static_cast<opus_int32>(packet.size()), OPUS_RATE);
+                    if (count < 0)
+                        throw std::runtime_error("Malformed Opus packet: " + std::string(opus_strerror(count)));
+
+                    samples += count;
+                }
+
+                m_NextGranule = m_Page.m_Granule - samples;
+            }
+        }
+
+        const std::vector<uint8_t> packet = std::move(m_PendingPackets.front());
+        m_PendingPackets.pop_front();
+
+        const int count = opus_multistream_decode_float(m_Decoder, packet.data(), static_cast<opus_int32>(packet.size()),
+                                                        m_Pcm.data(), OPUS_MAX_PACKET_SAMPLES, 0);
+        if (count < 0)
+            throw std::runtime_error("Opus decoding failed: " + std::string(opus_strerror(count)));
+
+        const int64_t start = *m_NextGranule;
+        const int64_t end = start + count;
+        m_NextGranule = end;
+
+        // pre-skip, seek pre-roll and end trimming all come down to clipping to [discard, end granule)
+        const int64_t first = std::max(start, m_DiscardUntil);
+        const int64_t last = std::min(end, m_EndGranule);
+
+        if (first >= m_EndGranule)
+            return false;
+
+        if (last <= first)
+            continue;
+
+        const auto frameCount = static_cast<size_t>(last - first);
+        frame = AudioBuffer(frameCount, m_Spec, AudioEncoding::Float32);
+        std::memcpy(frame.Data(), m_Pcm.data() + static_cast<size_t>(first - start) * channels,
+                    frameCount * channels * sizeof(float));
+
+        return true;
+    }
+}
+
+void OpusSource::Reposition(const size_t sample)
+{
+    const int64_t target = static_cast<int64_t>(sample) + m_PreSkip;
+
+    opus_multistream_decoder_ctl(m_Decoder, OPUS_RESET_STATE);
+    opus_multistream_decoder_ctl(m_Decoder, OPUS_SET_GAIN(m_OutputGain));
+    m_Assembler.Reset();
+    m_PendingPackets.clear();
+    m_DiscardUntil = target;
+
+    const auto page = FindPageBefore(target - OPUS_SEEK_PREROLL);
+
+    if (page.has_value())
+    {
+        m_Reader.SeekTo(*page);
+        m_NextGranule.reset();
+    }
+    else
+    {
+        // too close to the start, decode from the first audio page like on open
+        m_Reader.SeekTo(m_DataOffset);
+        m_NextGranule = 0;
+    }
+}
+
+std::optional<uint64_t> OpusSource::FindPageBefore(const int64_t granule)
+{
+    if (!m_Index.has_value())
+    {
+        m_Index = OggSeekIndex::Build(m_Path, m_Reader, m_Serial, m_DataOffset);
+
+        // without a cache the next open builds the index again, seeking works all the same
+        m_Index->Save();
+    }
+
+    return m_Index->PageBefore(granule);
+}
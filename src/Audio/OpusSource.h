@@ -0,0 +1,115 @@
+#ifndef OPUSSOURCE_H
+#define OPUSSOURCE_H
+
+#include "AudioSource.h"
+#include "OggPageReader.h"
+#include "OggSeekIndex.h"
+
+#include <array>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+struct OpusMSDecoder;
+
+// Ogg Opus file source. Packets get decoded ahead of time on a background thread into a bounded
+// queue, so NextFrame() only ever waits for the decoder when it has fallen behind. Always yields
+// Float32 at 48 kHz, in the channel order of ChannelLayout.
+class OpusSource : public AudioSource
+{
+public:
+    explicit OpusSource(const std::string& path);
+
+    OpusSource(const OpusSource&) = delete;
+    OpusSource& operator=(const OpusSource&) = delete;
+
+    ~OpusSource() override;
+
+    SignalSpec Spec() override { return m_Spec; }
+    AudioEncoding Encoding() override { return AudioEncoding::Float32; }
+
+    std::optional<size_t> TotalSamples() override { return m_TotalSamples; }
+    std::optional<size_t> CurrentSample() override { return m_CurrentSample; }
+
+    std::optional<AudioBuffer> NextFrame() override;
+    bool NextFrameUpTo(AudioBuffer& frame, size_t maxFrames) override;
+
+    bool IsInfallible() override { return false; }
+    bool IsSeekable() override { return true; }
+
+protected:
+    // The decoder restarts a little earlier than sample to converge before then. The first seek builds
+    // the stream's seek index, unless a cached one was found on open.
+    void SeekTo(size_t sample) override;
+    bool DoNextFrameInto(AudioBuffer& frame) override;
+
+private:
+    void ReadHeaders();
+    void ParseOpusHead(const std::vector<uint8_t>& packet);
+
+    void DecodeLoop();
+
+    // Decodes packets until some of their output survives trimming. Returns false at the end of the stream.
+    bool DecodeNext(AudioBuffer& frame);
+
+    // Moves the decoder in front of the page from which decoding towards sample has to start.
+    void Reposition(size_t sample);
+
+    // offset of the last page whose granule position isn't past granule, if any
+    [[nodiscard]] std::optional<uint64_t> FindPageBefore(int64_t granule);
+
+    std::string m_Path;
+
+    SignalSpec m_Spec;
+
+    uint32_t m_Serial = 0;
+    uint16_t m_PreSkip = 0;
+    int16_t m_OutputGain = 0;
+    int m_StreamCount = 0;
+    int m_CoupledCount = 0;
+    // stream channel for each output channel, already reordered into ChannelLayout's order
+    std::array<uint8_t, 255> m_Mapping {};
+
+    // first page after the header packets
+    uint64_t m_DataOffset = 0;
+    // granule position of the end of the stream
+    int64_t m_EndGranule = 0;
+    std::optional<size_t> m_TotalSamples;
+
+    // owned by the decoder thread once it runs
+    OggPageReader m_Reader;
+    OggPacketAssembler m_Assembler;
+    OggPage m_Page;
+    std::optional<OggSeekIndex> m_Index;
+    std::vector<std::vector<uint8_t>> m_Packets;
+    // packets assembled but not decoded yet
+    std::deque<std::vector<uint8_t>> m_PendingPackets;
+    OpusMSDecoder* m_Decoder = nullptr;
+    std::vector<float> m_Pcm;
+    // granule position of the next decoded sample, unknown right after a seek
+    std::optional<int64_t> m_NextGranule;
+    // decoded samples in front of this granule position are dropped
+    int64_t m_DiscardUntil = 0;
+
+    // shared between the decoder thread and the consumer
+    std::mutex m_Mutex;
+    std::condition_variable m_QueueChanged;
+    std::condition_variable m_DecoderWake;
+    std::deque<AudioBuffer> m_Queue;
+    // frames of the queue's front already handed out by NextFrameUpTo
+    size_t m_FrontOffset = 0;
+    // bumped by every seek, frames decoded for an older generation get dropped
+    uint64_t m_Generation = 0;
+    std::optional<size_t> m_SeekRequest;
+    bool m_DecoderEnded = false;
+    bool m_Stopping = false;
+    std::exception_ptr m_DecoderError;
+
+    size_t m_CurrentSample = 0;
+
+    std::thread m_DecoderThread;
+};
+
+#endif //OPUSSOURCE_H
@@ -0,0 +1,156 @@
+#include "OscillatorBank.h"
+#include "SimdKernels.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <bit>
+#include <cmath>
+#include <stdexcept>
+
+Wavetable::Wavetable(const std::span<const float> cycle)
+{
+    if (!std::has_single_bit(cycle.size()) || cycle.size() < 2 || cycle.size() > (1u << 24))
+        throw std::runtime_error("Wavetable length must be a power of two between 2 and 2^24, got " +
+                                 std::to_string(cycle.size()));
+
+    m_Bits = std::countr_zero(cycle.size());
+
+    m_Samples.reserve(cycle.size() + 1);
+    m_Samples.assign(cycle.begin(), cycle.end());
+    m_Samples.push_back(cycle.front());
+}
+
+OscillatorBank::OscillatorBank(const SignalSpec spec, const size_t frameLength, const size_t maxOscillators)
+    : m_Spec(spec), m_FrameLength(frameLength), m_MaxOscillators(maxOscillators)
+{
+    if (spec.m_Channels.Count() == 0 || spec.m_Rate == 0 || frameLength == 0)
+        throw std::runtime_error("OscillatorBank needs at least one channel, a rate and a non-zero frame length");
+
+    m_Oscillators.reserve(maxOscillators);
+
+    if (spec.m_Channels.Count() > 1)
+        m_Mix.resize(frameLength);
+}
+
+OscillatorId OscillatorBank::AddOscillator(const OscillatorShape shape, const float frequency, const float amplitude,
+                                           std::shared_ptr<const Wavetable> wavetable)
+{
+    if (m_Oscillators.size() == m_MaxOscillators)
+        throw std::runtime_error("OscillatorBank has no free slots (" + std::to_string(m_MaxOscillators) + ")");
+
+    if (shape == OscillatorShape::Wavetable && wavetable == nullptr)
+        throw std::runtime_error("Wavetable oscillators need a wavetable");
+
+    Oscillator& oscillator = m_Oscillators.emplace_back();
+    oscillator.m_Id = m_NextId++;
+    oscillator.m_Shape = shape;
+    oscillator.m_Wavetable = std::move(wavetable);
+    oscillator.m_Phase = 0;
+    oscillator.m_Increment = PhaseIncrement(frequency);
+    oscillator.m_Amplitude = amplitude;
+
+    return oscillator.m_Id;
+}
+
+void OscillatorBank::RemoveOscillator(const OscillatorId id)
+{
+    const auto it = std::find_if(m_Oscillators.begin(), m_Oscillators.end(),
+                                 [id](const Oscillator& o) { return o.m_Id == id; });
+    if (it == m_Oscillators.end())
+        return;
+
+    // order doesn't matter to a sum
+    std::swap(*it, m_Oscillators.back());
+    m_Oscillators.pop_back();
+}
+
+void OscillatorBank::SetFrequency(const OscillatorId id, const float frequency)
+{
+    // the phase carries on where it was, so frequency changes don't click
+    if (Oscillator* oscillator = FindOscillator(id))
+        oscillator->m_Increment = PhaseIncrement(frequency);
+}
+
+void OscillatorBank::SetAmplitude(const OscillatorId id, const float amplitude)
+{
+    if (Oscillator* oscillator = FindOscillator(id))
+        oscillator->m_Amplitude = amplitude;
+}
+
+OscillatorBank::Oscillator* OscillatorBank::FindOscillator(const OscillatorId id) noexcept
+{
+    const auto it = std::find_if(m_Oscillators.begin(), m_Oscillators.end(),
+                                 [id](const Oscillator& o) { return o.m_Id == id; });
+    return it == m_Oscillators.end() ? nullptr : &*it;
+}
+
+uint32_t OscillatorBank::PhaseIncrement(const float frequency) const
+{
+    const double cycles = static_cast<double>(frequency) / m_Spec.m_Rate;
+    if (!(cycles >= 0.0 && cycles < 0.5))
+        throw std::runtime_error("Oscillator frequency must be in [0, " + std::to_string(m_Spec.m_Rate / 2) + ") Hz");
+
+    return static_cast<uint32_t>(std::llround(std::ldexp(cycles, 32)));
+}
+
+std::optional<AudioBuffer> OscillatorBank::NextFrame()
+{
+    AudioBuffer frame;
+    NextFrameInto(frame);
+
+    return frame;
+}
+
+bool OscillatorBank::DoNextFrameInto(AudioBuffer& frame)
+{
+    return NextFrameUpTo(frame, SIZE_MAX);
+}
+
+bool OscillatorBank::NextFrameUpTo(AudioBuffer& frame, const size_t maxFrames)
+{
+    const size_t frameCount = std::min(m_FrameLength, maxFrames);
+    const size_t channels = m_Spec.m_Channels.Count();
+
+    frame.Reformat(m_Spec, AudioEncoding::Float32, frameCount * channels * sizeof(float));
+    float* out = frame.View<float>().Samples().data();
+
+    // a mono frame is the sum itself
+    float* mix = channels == 1 ? out : m_Mix.data();
+    std::fill_n(mix, frameCount, 0.f);
+
+    for (Oscillator& oscillator : m_Oscillators)
+    {
+        const uint32_t phase = oscillator.m_Phase;
+        const uint32_t increment = oscillator.m_Increment;
+        const float amplitude = oscillator.m_Amplitude;
+
+        switch (oscillator.m_Shape)
+        {
+        case OscillatorShape::Sine:
+            AddSine(mix, frameCount, phase, increment, amplitude);
+            break;
+        case OscillatorShape::Square:
+            AddSquare(mix, frameCount, phase, increment, amplitude);
+            break;
+        case OscillatorShape::Saw:
+            AddSaw(mix, frameCount, phase, increment, amplitude);
+            break;
+        case OscillatorShape::Wavetable:
+            AddWavetable(mix, frameCount, phase, increment, amplitude, oscillator.m_Wavetable->Samples(),
+                         oscillator.m_Wavetable->Bits());
+            break;
+        }
+
+        // wraps around exactly like the phases inside the frame did
+        oscillator.m_Phase = phase + static_cast<uint32_t>(frameCount) * increment;
+    }
+
+    if (channels > 1)
+    {
+        for (size_t i = 0; i < frameCount; ++i)
+            std::fill_n(out + i * channels, channels, mix[i]);
+    }
+
+    m_Position += frameCount;
+    return true;
+}
@@ -0,0 +1,121 @@
+#ifndef OSCILLATORBANK_H
+#define OSCILLATORBANK_H
+
+#include "AudioSource.h"
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+using OscillatorId = uint32_t;
+
+enum class OscillatorShape
+{
+    Sine,
+    // square and saw are band limited
+    Square,
+    Saw,
+    Wavetable
+};
+
+// One cycle of an arbitrary waveform, played back with linear interpolation.
+class Wavetable
+{
+public:
+    // cycle must hold a power of two number of samples, at most 2^24
+    explicit Wavetable(std::span<const float> cycle);
+
+    [[nodiscard]] const float* Samples() const noexcept { return m_Samples.data(); }
+    [[nodiscard]] unsigned Bits() const noexcept { return m_Bits; }
+
+private:
+    // the cycle followed by its first sample again, so interpolation never wraps
+    std::vector<float> m_Samples;
+    unsigned m_Bits;
+};
+
+// Sums any number of oscillators into Float32 frames of a fixed length, the same signal on every
+// channel. Phases are kept in 32-bit fixed point, so they carry on exactly from one frame into the
+// next whatever the frame length, and every waveform is evaluated eight samples at a time with
+// polynomials instead of libm calls.
+//
+// Not thread safe: oscillators have to be added, changed and removed on the thread pulling the frames.
+class OscillatorBank : public AudioSource
+{
+public:
+    /*!
+        \param spec rate and layout of the frames
+        \param frameLength frames produced by every NextFrame(), NextFrameUpTo() may ask for fewer
+        \param maxOscillators oscillator slots, reserved up front
+    */
+    explicit OscillatorBank(SignalSpec spec, size_t frameLength = 512, size_t maxOscillators = 4096);
+
+    /*!
+        \param frequency in Hz, below half the rate
+        \param wavetable the cycle to play, only for OscillatorShape::Wavetable
+    */
+    OscillatorId AddOscillator(OscillatorShape shape, float frequency, float amplitude = 1.f,
+                               std::shared_ptr<const Wavetable> wavetable = nullptr);
+    void RemoveOscillator(OscillatorId id);
+
+    void SetFrequency(OscillatorId id, float frequency);
+    void SetAmplitude(OscillatorId id, float amplitude);
+
+    [[nodiscard]] size_t ActiveOscillators() const noexcept { return m_Oscillators.size(); }
+
+    SignalSpec Spec() override { return m_Spec; }
+    AudioEncoding Encoding() override { return AudioEncoding::Float32; }
+
+    std::optional<size_t> TotalSamples() override { return std::nullopt; }
+    std::optional<size_t> CurrentSample() override { return m_Position; }
+
+    std::optional<AudioBuffer> NextFrame() override;
+    bool NextFrameUpTo(AudioBuffer& frame, size_t maxFrames) override;
+
+    bool IsInfallible() override { return true; }
+
+protected:
+    bool DoNextFrameInto(AudioBuffer& frame) override;
+
+private:
+    struct Oscillator
+    {
+        OscillatorId m_Id;
+        OscillatorShape m_Shape;
+        std::shared_ptr<const Wavetable> m_Wavetable;
+
+        // fractions of a cycle, 2^32 being a whole one
+        uint32_t m_Phase;
+        uint32_t m_Increment;
+        float m_Amplitude;
+    };
+
+    [[nodiscard]] Oscillator* FindOscillator(OscillatorId id) noexcept;
+    [[nodiscard]] uint32_t PhaseIncrement(float frequency) const;
+
+    SignalSpec m_Spec;
+    size_t m_FrameLength;
+    size_t m_MaxOscillators;
+
+    std::vector<Oscillator> m_Oscillators;
+    OscillatorId m_NextId = 1;
+
+    // the mono sum, for layouts with more than one channel
+    std::vector<float> m_Mix;
+
+    size_t m_Position = 0;
+};
+
+// A single sine, the same on every channel.
+class SourceSine : public OscillatorBank
+{
+public:
+    SourceSine(const SignalSpec spec, const float frequency, const size_t frameLength = 512)
+        : OscillatorBank(spec, frameLength, 1)
+    {
+        AddOscillator(OscillatorShape::Sine, frequency);
+    }
+};
+
+#endif //OSCILLATORBANK_H
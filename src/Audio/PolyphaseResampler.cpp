@@ -0,0 +1,262 @@
+#include "PolyphaseResampler.h"
+#include "Simd.h"
+#include "SimdKernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+
+// the filter bank grows with L * taps, ratios needing more phases than this are rejected
+constexpr size_t MAX_PHASES = 4096;
+constexpr size_t MAX_TAPS = 1024;
+
+// history which may pile up in front of the filter before it gets compacted
+constexpr int64_t HISTORY_COMPACT_THRESHOLD = 4096;
+
+struct ResamplerQualityParameters
+{
+    size_t m_Taps;
+    double m_KaiserBeta;
+    // passband edge relative to the Nyquist frequency of the lower of the two rates
+    double m_Rolloff;
+};
+
+static ResamplerQualityParameters GetQualityParameters(const ResamplerQuality quality)
+{
+    switch (quality)
+    {
+    case ResamplerQuality::Fast:
+        return { 16, 6.0, 0.90 };
+    case ResamplerQuality::Medium:
+        return { 32, 8.6, 0.94 };
+    case ResamplerQuality::High:
+        return { 64, 12.0, 0.97 };
+    default:
+        throw std::runtime_error("Unsupported resampler quality");
+    }
+}
+
+static double Sinc(const double x)
+{
+    if (x == 0.)
+        return 1.;
+
+    return std::sin(M_PI * x) / (M_PI * x);
+}
+
+// x in [-1, 1]
+static double KaiserWindow(const double x, const double beta)
+{
+    const double t = std::max(0., 1. - x * x);
+    return std::cyl_bessel_i(0., beta * std::sqrt(t)) / std::cyl_bessel_i(0., beta);
+}
+
+PolyphaseFilterBank::PolyphaseFilterBank(const uint32_t srcRate, const uint32_t dstRate, const ResamplerQuality quality)
+{
+    if (srcRate == 0 || dstRate == 0)
+        throw std::runtime_error("Sample rates must be non-zero");
+
+    const uint32_t divisor = std::gcd(srcRate, dstRate);
+    m_Interpolation = dstRate / divisor;
+    m_Decimation = srcRate / divisor;
+
+    if (m_Interpolation > MAX_PHASES)
+    {
+        throw std::runtime_error("Unsupported resampling ratio " + std::to_string(srcRate) + " -> " +
+                                 std::to_string(dstRate) + " (needs " + std::to_string(m_Interpolation) + " phases)");
+    }
+
+    const auto parameters = GetQualityParameters(quality);
+
+    // when decimating the cutoff drops below the input's Nyquist frequency, and the kernel has to
+    // widen by the same factor to keep its transition band
+    const double ratio = std::min(1., static_cast<double>(m_Interpolation) / static_cast<double>(m_Decimation));
+    const double cutoff = parameters.m_Rolloff * ratio;
+
+    const auto widened = static_cast<size_t>(std::ceil(static_cast<double>(parameters.m_Taps) / ratio));
+    m_TapCount = std::min(MAX_TAPS, (widened + SIMD_LANES - 1) / SIMD_LANES * SIMD_LANES);
+
+    const auto half = static_cast<double>(m_TapCount / 2);
+
+    m_Coefficients.resize(m_Interpolation * m_TapCount);
+    std::vector<double> kernel(m_TapCount);
+
+    for (size_t phase = 0; phase < m_Interpolation; ++phase)
+    {
+        float* taps = m_Coefficients.data() + phase * m_TapCount;
+        const double fraction = static_cast<double>(phase) / static_cast<double>(m_Interpolation);
+
+        double sum = 0.;
+
+        for (size_t j = 0; j < m_TapCount; ++j)
+        {
+            // distance from the output position to the input sample under tap j
+            const double distance = fraction + (half - 1.) - static_cast<double>(j);
+
+            kernel[j] = cutoff * Sinc(cutoff * distance) * KaiserWindow(distance / half, parameters.m_KaiserBeta);
+            sum += kernel[j];
+        }
+
+        // normalizing every phase to unity DC gain keeps the ripple between phases out of the output
+        for (size_t j = 0; j < m_TapCount; ++j)
+            taps[j] = static_cast<float>(kernel[j] / sum);
+    }
+}
+
+PolyphaseResampler::PolyphaseResampler(const uint32_t srcRate, const uint32_t dstRate, const size_t channels,
+                                       const ResamplerQuality quality)
+    : m_FilterBank(srcRate, dstRate, quality), m_Channels(channels), m_History(channels)
+{
+    if (channels == 0)
+        throw std::runtime_error("Resampler needs at least one channel");
+
+    Reset();
+}
+
+void PolyphaseResampler::Push(const float* frames, const size_t frameCount)
+{
+    if (m_Finished)
+        throw std::runtime_error("Can't push into a finished resampler");
+
+    for (size_t channel = 0; channel < m_Channels; ++channel)
+    {
+        auto& plane = m_History[channel];
+        const size_t offset = plane.size();
+        plane.resize(offset + frameCount);
+
+        for (size_t i = 0; i < frameCount; ++i)
+            plane[offset + i] = frames[i * m_Channels + channel];
+    }
+
+    m_InputFrames += frameCount;
+}
+
+void PolyphaseResampler::Finish()
+{
+    if (m_Finished)
+        return;
+
+    // zeros past the end let the last frames use the full kernel
+    for (auto& plane : m_History)
+        plane.resize(plane.size() + m_FilterBank.TapCount() / 2, 0.f);
+
+    m_Finished = true;
+}
+
+uint64_t PolyphaseResampler::OutputLength(const uint64_t inputFrames) const noexcept
+{
+    const uint64_t l = m_FilterBank.Interpolation();
+    const uint64_t m = m_FilterBank.Decimation();
+
+    return (inputFrames * l + m - 1) / m;
+}
+
+size_t PolyphaseResampler::AvailableFrames() const noexcept
+{
+    if (m_Finished)
+        return OutputLength(m_InputFrames) - m_OutputFrames;
+
+    const auto l = static_cast<int64_t>(m_FilterBank.Interpolation());
+    const auto m = static_cast<int64_t>(m_FilterBank.Decimation());
+    const auto half = static_cast<int64_t>(m_FilterBank.TapCount() / 2);
+
+    // every output frame centred on an input frame with half a kernel of input after it can go out;
+    // positions are counted in 1/L input frames
+    const int64_t lastBase = static_cast<int64_t>(m_InputFrames) - 1 - half;
+    const int64_t limit = (lastBase + 1) * l - 1;
+    const int64_t position = m_Base * l + static_cast<int64_t>(m_Phase);
+
+    if (limit < position)
+        return 0;
+
+    return static_cast<size_t>((limit - position) / m + 1);
+}
+
+int64_t PolyphaseResampler::FirstTapIndex() const noexcept
+{
+    const auto half = static_cast<int64_t>(m_FilterBank.TapCount() / 2);
+    return m_Base - (half - 1) - m_HistoryStart;
+}
+
+size_t PolyphaseResampler::Pull(float* out, const size_t maxFrames)
+{
+    const size_t frameCount = std::min(maxFrames, AvailableFrames());
+    const size_t taps = m_FilterBank.TapCount();
+    const size_t l = m_FilterBank.Interpolation();
+    const size_t m = m_FilterBank.Decimation();
+
+    for (size_t i = 0; i < frameCount; ++i)
+    {
+        const auto first = static_cast<size_t>(FirstTapIndex());
+        const float* coefficients = m_FilterBank.Phase(m_Phase);
+
+        for (size_t channel = 0; channel < m_Channels; ++channel)
+            out[i * m_Channels + channel] = DotProduct(m_History[channel].data() + first, coefficients, taps);
+
+        m_Phase += m;
+        m_Base += static_cast<int64_t>(m_Phase / l);
+        m_Phase %= l;
+    }
+
+    m_OutputFrames += frameCount;
+
+    // drop the input the filter has moved past, in large enough chunks to amortize the move
+    const int64_t consumed = FirstTapIndex();
+    if (consumed >= HISTORY_COMPACT_THRESHOLD ||
+        (consumed > 0 && static_cast<size_t>(consumed) * 2 >= m_History.front().size()))
+    {
+        for (auto& plane : m_History)
+            plane.erase(plane.begin(), plane.begin() + consumed);
+
+        m_HistoryStart += consumed;
+    }
+
+    return frameCount;
+}
+
+void PolyphaseResampler::Reset()
+{
+    const size_t leadIn = m_FilterBank.TapCount() / 2 - 1;
+
+    // the first output frame is centred on input frame 0, so the taps before it see silence
+    for (auto& plane : m_History)
+        plane.assign(leadIn, 0.f);
+
+    m_HistoryStart = -static_cast<int64_t>(leadIn);
+    m_InputFrames = 0;
+    m_OutputFrames = 0;
+    m_Base = 0;
+    m_Phase = 0;
+    m_Finished = false;
+}
+
+uint64_t PolyphaseResampler::Restart(const uint64_t outputFrame)
+{
+    const uint64_t l = m_FilterBank.Interpolation();
+    const uint64_t m = m_FilterBank.Decimation();
+    const uint64_t leadIn = m_FilterBank.TapCount() / 2 - 1;
+
+    // output frame k * L is centred right on input frame k * M
+    const uint64_t k = outputFrame / l;
+    const uint64_t centre = k * m;
+
+    if (centre < leadIn)
+    {
+        Reset();
+        return 0;
+    }
+
+    for (auto& plane : m_History)
+        plane.clear();
+
+    m_HistoryStart = static_cast<int64_t>(centre - leadIn);
+    m_InputFrames = centre - leadIn;
+    m_OutputFrames = k * l;
+    m_Base = static_cast<int64_t>(centre);
+    m_Phase = 0;
+    m_Finished = false;
+
+    return k * l;
+}
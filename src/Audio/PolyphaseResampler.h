@@ -0,0 +1,106 @@
+#ifndef POLYPHASERESAMPLER_H
+#define POLYPHASERESAMPLER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+enum class ResamplerQuality
+{
+    // 16 taps per phase, ~60 dB stopband
+    Fast,
+    // 32 taps per phase, ~90 dB stopband
+    Medium,
+    // 64 taps per phase, ~120 dB stopband
+    High
+};
+
+// Windowed-sinc lowpass split into one FIR per output phase, for a rational rate ratio
+// dstRate / srcRate = L / M (reduced).
+class PolyphaseFilterBank
+{
+public:
+    PolyphaseFilterBank(uint32_t srcRate, uint32_t dstRate, ResamplerQuality quality);
+
+    [[nodiscard]] size_t PhaseCount() const noexcept { return m_Interpolation; }
+    [[nodiscard]] size_t Interpolation() const noexcept { return m_Interpolation; }
+    [[nodiscard]] size_t Decimation() const noexcept { return m_Decimation; }
+    [[nodiscard]] size_t TapCount() const noexcept { return m_TapCount; }
+
+    // TapCount() coefficients, laid out to be dotted with TapCount() consecutive input samples
+    [[nodiscard]] const float* Phase(size_t phase) const noexcept { return m_Coefficients.data() + phase * m_TapCount; }
+
+private:
+    size_t m_Interpolation;
+    size_t m_Decimation;
+    size_t m_TapCount;
+
+    std::vector<float> m_Coefficients;
+};
+
+// Streaming polyphase resampler over interleaved float frames.
+//
+// Output frame t is centred on input position t * M / L, so N input frames produce exactly
+// ceil(N * L / M) output frames once Finish() has been called.
+class PolyphaseResampler
+{
+public:
+    PolyphaseResampler(uint32_t srcRate, uint32_t dstRate, size_t channels, ResamplerQuality quality);
+
+    // Appends interleaved input frames.
+    void Push(const float* frames, size_t frameCount);
+
+    // Marks the end of the input, so that the frames depending on the tail can be produced.
+    void Finish();
+
+    // Output frames which can be pulled without pushing more input.
+    [[nodiscard]] size_t AvailableFrames() const noexcept;
+
+    // Writes up to maxFrames interleaved frames into out and returns how many were written.
+    size_t Pull(float* out, size_t maxFrames);
+
+    // Drops all buffered input and starts over at position zero.
+    void Reset();
+
+    /*!
+        \brief Drops all buffered input and starts over at outputFrame, a multiple of L
+        \details Input has to continue at InputPosition() afterwards: the frames before the first
+                  output frame's centre fill the kernel's history, so the output matches an
+                  uninterrupted run sample for sample. Near the start, where the history would reach
+                  in front of the input, this is a Reset().
+        \return the output frame it restarted at
+    */
+    uint64_t Restart(uint64_t outputFrame);
+
+    [[nodiscard]] bool IsFinished() const noexcept { return m_Finished; }
+
+    [[nodiscard]] uint64_t InputPosition() const noexcept { return m_InputFrames; }
+    [[nodiscard]] uint64_t OutputPosition() const noexcept { return m_OutputFrames; }
+
+    // exact output length of inputFrames input frames
+    [[nodiscard]] uint64_t OutputLength(uint64_t inputFrames) const noexcept;
+
+    [[nodiscard]] const PolyphaseFilterBank& FilterBank() const noexcept { return m_FilterBank; }
+
+private:
+    // index into the history of the first tap of the next output frame
+    [[nodiscard]] int64_t FirstTapIndex() const noexcept;
+
+    PolyphaseFilterBank m_FilterBank;
+    size_t m_Channels;
+
+    // one plane per channel, m_History[c][0] is input frame m_HistoryStart
+    std::vector<std::vector<float>> m_History;
+    int64_t m_HistoryStart = 0;
+
+    uint64_t m_InputFrames = 0;
+    uint64_t m_OutputFrames = 0;
+
+    // input frame under the centre of the next output frame, and its fractional phase
+    int64_t m_Base = 0;
+    size_t m_Phase = 0;
+
+    bool m_Finished = false;
+};
+
+#endif //POLYPHASERESAMPLER_H
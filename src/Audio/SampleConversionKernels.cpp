@@ -0,0 +1,65 @@
+// the 256/512-bit helpers only ever get inlined, so the ABI of passing them around doesn't matter
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+#include "SampleConversions.h"
+#include "Simd.h"
+
+#include <array>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+using SampleConversionKernel = void (*)(const uint8_t* src, uint8_t* dst, size_t count);
+
+template <AudioEncoding E>
+constexpr bool IS_UNSIGNED_ENCODING = E == AudioEncoding::UInt8 || E == AudioEncoding::UInt16 ||
+                                      E == AudioEncoding::UInt24 || E == AudioEncoding::UInt32;
+
+// 2^(bits - 1), the value the float conversions scale [-1, 1] by
+template <AudioEncoding E>
+constexpr double INTEGER_FULL_SCALE = static_cast<double>(1ull << (GetEffectiveEncodingSize(E) * 8 - 1));
+
+#if defined(__x86_64__) || defined(__i386__)
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+namespace Avx2
+{
+#include "SampleConversionKernels.inl"
+}
+#pragma GCC pop_options
+#endif
+
+// baseline build of the kernels (SSE2 on x86-64)
+namespace Generic
+{
+#include "SampleConversionKernels.inl"
+}
+
+void ConvertSampleBuffer(const void* src, const AudioEncoding srcEncoding, void* dst, const AudioEncoding dstEncoding,
+                         const size_t count)
+{
+    const auto srcIndex = static_cast<size_t>(srcEncoding);
+    const auto dstIndex = static_cast<size_t>(dstEncoding);
+
+    if (srcIndex >= AUDIO_ENCODING_COUNT || dstIndex >= AUDIO_ENCODING_COUNT)
+        throw std::runtime_error("Unsupported encoding");
+
+    if (srcEncoding == dstEncoding)
+    {
+        if (src != dst)
+            std::memmove(dst, src, count * GetEffectiveEncodingSize(srcEncoding));
+        return;
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+    static const auto& kernels = CpuSupportsAvx2() ? Avx2::KERNELS : Generic::KERNELS;
+#else
+    static const auto& kernels = Generic::KERNELS;
+#endif
+
+    kernels[srcIndex * AUDIO_ENCODING_COUNT + dstIndex](
+        static_cast<const uint8_t*>(src), static_cast<uint8_t*>(dst), count);
+}
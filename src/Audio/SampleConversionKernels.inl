@@ -0,0 +1,205 @@
+// Body of the bulk sample conversion kernels. SampleConversionKernels.cpp includes this file once
+// per instruction set, inside a namespace compiled with the matching target options, so nothing
+// in here may include headers or define anything outside of that namespace.
+//
+// Every kernel is bit-identical to the per-sample ConvertSample<S, D> templates, which remain the
+// reference implementation (see ConvertSampleBufferScalar).
+
+template <typename V, typename T>
+[[gnu::always_inline]] inline V Clamp(const V& v, const T lo, const T hi)
+{
+    // same argument order as std::clamp, so NaNs propagate the same way
+    const V low = v < lo ? lo : v;
+    return hi < low ? hi : low;
+}
+
+// Loads 8 packed 3-byte samples into the top three bytes of each lane.
+[[gnu::always_inline]] inline SimdI32 LoadPacked24(const uint8_t* src)
+{
+    constexpr SimdU8x32 spread = {
+        32, 0,  1,  2,  32, 3,  4,  5,  32, 6,  7,  8,  32, 9,  10, 11,
+        32, 12, 13, 14, 32, 15, 16, 17, 32, 18, 19, 20, 32, 21, 22, 23,
+    };
+
+    SimdU8x32 packed {};
+    std::memcpy(&packed, src, 3 * SIMD_LANES);
+
+    return reinterpret_cast<SimdI32>(__builtin_shuffle(packed, SimdU8x32 {}, spread));
+}
+
+// Stores the low three bytes of each lane as 8 packed 3-byte samples.
+[[gnu::always_inline]] inline void StorePacked24(uint8_t* dst, const SimdI32& v)
+{
+    constexpr SimdU8x32 pack = {
+        0,  1,  2,  4,  5,  6,  8,  9,  10, 12, 13, 14, 16, 17, 18, 20,
+        21, 22, 24, 25, 26, 28, 29, 30, 0,  0,  0,  0,  0,  0,  0,  0,
+    };
+
+    const SimdU8x32 packed = __builtin_shuffle(reinterpret_cast<SimdU8x32>(v), pack);
+    std::memcpy(dst, &packed, 3 * SIMD_LANES);
+}
+
+// Integer samples are widened to a left-justified int32 ("canonical" form). Every integer to
+// integer conversion in the matrix is a shift plus a flip of the sign bit, so going through the
+// canonical form is exact, and so is its conversion to float/double scaled by 2^-31.
+template <AudioEncoding E>
+[[gnu::always_inline]] inline SimdI32 LoadCanonical(const uint8_t* src)
+{
+    if constexpr (E == AudioEncoding::UInt8)
+        return (__builtin_convertvector(SimdLoad<SimdU8x8>(src), SimdI32) - 0x80) << 24;
+    else if constexpr (E == AudioEncoding::Int8)
+        return __builtin_convertvector(SimdLoad<SimdI8x8>(src), SimdI32) << 24;
+    else if constexpr (E == AudioEncoding::UInt16)
+        return (__builtin_convertvector(SimdLoad<SimdU16x8>(src), SimdI32) - 0x8000) << 16;
+    else if constexpr (E == AudioEncoding::Int16)
+        return __builtin_convertvector(SimdLoad<SimdI16x8>(src), SimdI32) << 16;
+    else if constexpr (E == AudioEncoding::UInt24)
+        return LoadPacked24(src) ^ INT32_MIN;
+    else if constexpr (E == AudioEncoding::Int24)
+        return LoadPacked24(src);
+    else if constexpr (E == AudioEncoding::UInt32)
+        return SimdLoad<SimdI32>(src) ^ INT32_MIN;
+    else
+        return SimdLoad<SimdI32>(src);
+}
+
+// Stores integers which are already in the native range of the encoding.
+template <AudioEncoding E>
+[[gnu::always_inline]] inline void StoreInteger(uint8_t* dst, const SimdI32& v)
+{
+    if constexpr (E == AudioEncoding::UInt8)
+        SimdStore(dst, __builtin_convertvector(v, SimdU8x8));
+    else if constexpr (E == AudioEncoding::Int8)
+        SimdStore(dst, __builtin_convertvector(v, SimdI8x8));
+    else if constexpr (E == AudioEncoding::UInt16)
+        SimdStore(dst, __builtin_convertvector(v, SimdU16x8));
+    else if constexpr (E == AudioEncoding::Int16)
+        SimdStore(dst, __builtin_convertvector(v, SimdI16x8));
+    else if constexpr (E == AudioEncoding::UInt24 || E == AudioEncoding::Int24)
+        StorePacked24(dst, v);
+    else
+        SimdStore(dst, v);
+}
+
+template <AudioEncoding E>
+[[gnu::always_inline]] inline void StoreCanonical(uint8_t* dst, const SimdI32& v)
+{
+    const SimdU32 offset = reinterpret_cast<SimdU32>(v ^ INT32_MIN);
+
+    if constexpr (E == AudioEncoding::UInt8)
+        StoreInteger<E>(dst, reinterpret_cast<SimdI32>(offset >> 24));
+    else if constexpr (E == AudioEncoding::Int8)
+        StoreInteger<E>(dst, v >> 24);
+    else if constexpr (E == AudioEncoding::UInt16)
+        StoreInteger<E>(dst, reinterpret_cast<SimdI32>(offset >> 16));
+    else if constexpr (E == AudioEncoding::Int16)
+        StoreInteger<E>(dst, v >> 16);
+    else if constexpr (E == AudioEncoding::UInt24)
+        StoreInteger<E>(dst, reinterpret_cast<SimdI32>(offset >> 8));
+    else if constexpr (E == AudioEncoding::Int24)
+        StoreInteger<E>(dst, v >> 8);
+    else if constexpr (E == AudioEncoding::UInt32)
+        StoreInteger<E>(dst, reinterpret_cast<SimdI32>(offset));
+    else if constexpr (E == AudioEncoding::Int32)
+        StoreInteger<E>(dst, v);
+    else if constexpr (E == AudioEncoding::Float32)
+        SimdStore(dst, __builtin_convertvector(v, SimdF32) * 0x1p-31f);
+    else
+        SimdStore(dst, __builtin_convertvector(v, SimdF64) * 0x1p-31);
+}
+
+// Truncates values in [0, 2^32) to uint32. There is no packed double to uint32 conversion before
+// AVX-512, so the value is biased into the int32 range and the truncation is turned into a floor.
+[[gnu::always_inline]] inline SimdI32 TruncateToUInt32(const SimdF64& y)
+{
+    const SimdF64 biased = y - 2'147'483'648.;
+    const SimdI32 truncated = __builtin_convertvector(biased, SimdI32);
+    const SimdI32 roundedUp = __builtin_convertvector(__builtin_convertvector(truncated, SimdF64) > biased, SimdI32);
+
+    return (truncated + roundedUp) ^ INT32_MIN;
+}
+
+// Mirrors the IMPL_CONVERT(float, ...) and IMPL_CONVERT(double, ...) families.
+template <AudioEncoding E, typename V, typename T>
+[[gnu::always_inline]] inline void StoreFromFloating(uint8_t* dst, const V& x)
+{
+    constexpr bool fromFloat = std::is_same_v<T, float>;
+    const V c = Clamp(x, T(-1), T(1));
+
+    if constexpr (E == AudioEncoding::Float32)
+    {
+        if constexpr (fromFloat)
+            SimdStore(dst, x);
+        else
+            SimdStore(dst, __builtin_convertvector(x, SimdF32));
+    }
+    else if constexpr (E == AudioEncoding::Float64)
+    {
+        if constexpr (fromFloat)
+            SimdStore(dst, __builtin_convertvector(x, SimdF64));
+        else
+            SimdStore(dst, x);
+    }
+    else if constexpr (E == AudioEncoding::UInt32)
+    {
+        SimdF64 y;
+        if constexpr (fromFloat)
+            y = __builtin_convertvector(c + 1.f, SimdF64) * 2'147'483'648.;
+        else
+            y = (c + 1.) * 2'147'483'648.;
+
+        StoreInteger<E>(dst, TruncateToUInt32(Clamp(y, 0., 4'294'967'295.)));
+    }
+    else if constexpr (E == AudioEncoding::Int32 && fromFloat)
+    {
+        // the product is at most 2^31, which only the scalar path's int64 clamp can represent
+        const SimdF32 y = c * 2'147'483'648.f;
+        const SimdI32 truncated = __builtin_convertvector(y < 2'147'483'648.f ? y : 0.f, SimdI32);
+
+        StoreInteger<E>(dst, y < 2'147'483'648.f ? truncated : INT32_MAX);
+    }
+    else
+    {
+        constexpr T scale = static_cast<T>(INTEGER_FULL_SCALE<E>);
+
+        if constexpr (IS_UNSIGNED_ENCODING<E>)
+            StoreInteger<E>(dst, __builtin_convertvector(Clamp((c + T(1)) * scale, T(0), T(2) * scale - T(1)), SimdI32));
+        else
+            StoreInteger<E>(dst, __builtin_convertvector(Clamp(c * scale, -scale, scale - T(1)), SimdI32));
+    }
+}
+
+template <AudioEncoding S, AudioEncoding D>
+void ConvertSamples(const uint8_t* src, uint8_t* dst, const size_t count)
+{
+    constexpr size_t srcSize = GetEffectiveEncodingSize(S);
+    constexpr size_t dstSize = GetEffectiveEncodingSize(D);
+
+    size_t i = 0;
+
+    // each block is loaded completely before it is stored, which keeps in-place narrowing safe
+    for (; i + SIMD_LANES <= count; i += SIMD_LANES)
+    {
+        const uint8_t* s = src + i * srcSize;
+        uint8_t* d = dst + i * dstSize;
+
+        if constexpr (S == AudioEncoding::Float32)
+            StoreFromFloating<D, SimdF32, float>(d, SimdLoad<SimdF32>(s));
+        else if constexpr (S == AudioEncoding::Float64)
+            StoreFromFloating<D, SimdF64, double>(d, SimdLoad<SimdF64>(s));
+        else
+            StoreCanonical<D>(d, LoadCanonical<S>(s));
+    }
+
+    ConvertSampleBufferScalar(src + i * srcSize, S, dst + i * dstSize, D, count - i);
+}
+
+template <size_t... I>
+constexpr std::array<SampleConversionKernel, sizeof...(I)> MakeKernelTable(std::index_sequence<I...>)
+{
+    return { &ConvertSamples<static_cast<AudioEncoding>(I / AUDIO_ENCODING_COUNT),
+                             static_cast<AudioEncoding>(I % AUDIO_ENCODING_COUNT)>... };
+}
+
+// indexed by [source encoding * AUDIO_ENCODING_COUNT + destination encoding]
+const auto KERNELS = MakeKernelTable(std::make_index_sequence<AUDIO_ENCODING_COUNT * AUDIO_ENCODING_COUNT> {});
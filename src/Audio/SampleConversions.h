@@ -33,100 +33,72 @@
 #define F64_MID 0.
 #define F64_MIN (-1.)
 
-struct __attribute__((packed)) Int24 {
-    int32_t value : 24;
-
-    Int24(const int32_t val = 0) { value = val; }
-
-    // convert to int32_t (with sign extension)
-    operator int32_t() const { return (value << 8) >> 8; }
-};
-
-struct __attribute__((packed)) UInt24 {
-    uint32_t value : 24;
-
-    UInt24(const uint32_t val = 0) { value = val; }
-
-    operator uint32_t() const { return value; }
-
-    UInt24 &operator+=(const Int24 i) {
-        value += i.value;
-        return *this;
-    };
-};
-
 template <typename S, typename D>
 D ConvertSample(S src);
 
-template <typename S, typename D>
-std::vector<D> ConvertSampleVector(const std::vector<S>& src)
-{
-    std::vector<D> converted;
-    converted.reserve(src.size());
-
-    for (const auto& sample : src)
-    {
-        converted.push_back(ConvertSample<S, D>(sample));
-    }
-
-    return converted;
-}
+#include "SampleConversions.inl"
 
-template <typename S>
-std::vector<uint8_t> ConvertSampleVectorDynamic(const std::vector<S>& src, const AudioEncoding dstEncoding)
+// Invokes visitor with a value-initialized sample of the type matching the encoding.
+template <typename F>
+decltype(auto) VisitSampleType(const AudioEncoding encoding, F&& visitor)
 {
-    switch (dstEncoding)
+    switch (encoding)
     {
     case AudioEncoding::UInt8:
-        return ConvertSampleVector<S, uint8_t>(src);
+        return visitor(uint8_t {});
     case AudioEncoding::UInt16:
-    {
-        auto conv = ConvertSampleVector<S, uint16_t>(src);
-        return reinterpret_cast<std::vector<uint8_t>&>(conv);
-    }
+        return visitor(uint16_t {});
     case AudioEncoding::UInt24:
-    {
-        auto conv = ConvertSampleVector<S, UInt24>(src);
-        return reinterpret_cast<std::vector<uint8_t>&>(conv);
-    }
+        return visitor(UInt24 {});
     case AudioEncoding::UInt32:
-    {
-        auto conv = ConvertSampleVector<S, uint32_t>(src);
-        return reinterpret_cast<std::vector<uint8_t>&>(conv);
-    }
+        return visitor(uint32_t {});
     case AudioEncoding::Int8:
-    {
-        auto conv = ConvertSampleVector<S, int8_t>(src);
-        return reinterpret_cast<std::vector<uint8_t>&>(conv);
-    }
+        return visitor(int8_t {});
     case AudioEncoding::Int16:
-    {
-        auto conv = ConvertSampleVector<S, int16_t>(src);
-        return reinterpret_cast<std::vector<uint8_t>&>(conv);
-    }
+        return visitor(int16_t {});
     case AudioEncoding::Int24:
-    {
-        auto conv = ConvertSampleVector<S, Int24>(src);
-        return reinterpret_cast<std::vector<uint8_t>&>(conv);
-    }
+        return visitor(Int24 {});
     case AudioEncoding::Int32:
-    {
-        auto conv = ConvertSampleVector<S, int32_t>(src);
-        return reinterpret_cast<std::vector<uint8_t>&>(conv);
-    }
+        return visitor(int32_t {});
     case AudioEncoding::Float32:
-    {
-        auto conv = ConvertSampleVector<S, float>(src);
-        return reinterpret_cast<std::vector<uint8_t>&>(conv);
-    }
+        return visitor(float {});
     case AudioEncoding::Float64:
-    {
-        auto conv = ConvertSampleVector<S, double>(src);
-        return reinterpret_cast<std::vector<uint8_t>&>(conv);
-    }
+        return visitor(double {});
     default:
         throw std::runtime_error("Unsupported encoding");
     }
 }
 
+/*!
+    \brief Converts count packed samples from one encoding to another, using the SIMD kernels
+           for the running CPU
+    \param src source samples, no alignment required
+    \param dst destination samples, may be equal to src when the destination encoding isn't wider
+*/
+void ConvertSampleBuffer(const void* src, AudioEncoding srcEncoding, void* dst, AudioEncoding dstEncoding, size_t count);
+
+/*!
+    \brief Same as ConvertSampleBuffer, but goes through ConvertSample<S, D> one sample at a time.
+           This is the reference the vectorized kernels are checked against
+*/
+void ConvertSampleBufferScalar(const void* src, AudioEncoding srcEncoding, void* dst, AudioEncoding dstEncoding, size_t count);
+
+template <typename S, typename D>
+std::vector<D> ConvertSampleVector(const std::vector<S>& src)
+{
+    std::vector<D> converted(src.size());
+    ConvertSampleBuffer(src.data(), SampleEncoding<S>::value, converted.data(), SampleEncoding<D>::value, src.size());
+
+    return converted;
+}
+
+template <typename S>
+std::vector<uint8_t> ConvertSampleVectorDynamic(const std::vector<S>& src, const AudioEncoding dstEncoding)
+{
+    std::vector<uint8_t> converted(src.size() * GetEffectiveEncodingSize(dstEncoding));
+    ConvertSampleBuffer(src.data(), SampleEncoding<S>::value, converted.data(), dstEncoding, src.size());
+
+    return converted;
+}
+
 #endif //SAMPLECONVERSIONS_H
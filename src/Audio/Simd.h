@@ -0,0 +1,50 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <cstdint>
+#include <cstring>
+
+// 8-lane vector types built on the GCC vector extensions. Kernels written against these types get
+// compiled once per instruction set (see SampleConversionKernels.cpp), so the same source lowers
+// to AVX2 on capable CPUs and to SSE2 (or NEON, or plain scalar code) everywhere else.
+constexpr size_t SIMD_LANES = 8;
+
+using SimdF32 = float __attribute__((vector_size(32)));
+using SimdF64 = double __attribute__((vector_size(64)));
+using SimdI32 = int32_t __attribute__((vector_size(32)));
+using SimdU32 = uint32_t __attribute__((vector_size(32)));
+using SimdI64 = int64_t __attribute__((vector_size(64)));
+
+using SimdU8x8 = uint8_t __attribute__((vector_size(8)));
+using SimdI8x8 = int8_t __attribute__((vector_size(8)));
+using SimdU16x8 = uint16_t __attribute__((vector_size(16)));
+using SimdI16x8 = int16_t __attribute__((vector_size(16)));
+using SimdU8x32 = uint8_t __attribute__((vector_size(32)));
+
+// unaligned load/store, memcpy keeps them free of aliasing and alignment assumptions
+template <typename V>
+[[gnu::always_inline]] inline V SimdLoad(const void* src)
+{
+    V v;
+    std::memcpy(&v, src, sizeof(V));
+    return v;
+}
+
+template <typename V>
+[[gnu::always_inline]] inline void SimdStore(void* dst, const V& v)
+{
+    std::memcpy(dst, &v, sizeof(V));
+}
+
+// true when the AVX2 builds of the kernels may be used on this machine
+inline bool CpuSupportsAvx2()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    static const bool supported = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+#endif //SIMD_H
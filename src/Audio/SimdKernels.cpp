@@ -0,0 +1,150 @@
+// the 256-bit helpers only ever get inlined, so the ABI of passing them around doesn't matter
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+#include "SimdKernels.h"
+#include "Simd.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+namespace Avx2
+{
+#include "SimdKernels.inl"
+}
+#pragma GCC pop_options
+#endif
+
+// baseline build of the kernels (SSE2 on x86-64)
+namespace Generic
+{
+#include "SimdKernels.inl"
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SIMD_KERNEL(name) (CpuSupportsAvx2() ? Avx2::name : Generic::name)
+#else
+#define SIMD_KERNEL(name) (Generic::name)
+#endif
+
+float DotProduct(const float* a, const float* b, const size_t count)
+{
+    static const auto kernel = SIMD_KERNEL(DotProduct);
+    return kernel(a, b, count);
+}
+
+void MixAdd(float* dst, const float* src, const size_t count, const float* gains, const size_t gainCount)
+{
+    static const auto kernel = SIMD_KERNEL(MixAdd);
+    kernel(dst, src, count, gains, gainCount);
+}
+
+void MixAddMonoToStereo(float* dst, const float* src, const size_t frameCount, const float left, const float right)
+{
+    static const auto kernel = SIMD_KERNEL(MixAddMonoToStereo);
+    kernel(dst, src, frameCount, left, right);
+}
+
+void MixMatrix(float* dst, const size_t dstChannels, const float* src, const size_t srcChannels,
+               const size_t frameCount, const float* columns)
+{
+    static const auto kernel = SIMD_KERNEL(MixMatrix);
+    kernel(dst, dstChannels, src, srcChannels, frameCount, columns);
+}
+
+void SoftLimit(float* samples, const size_t count, const float threshold)
+{
+    static const auto kernel = SIMD_KERNEL(SoftLimit);
+    kernel(samples, count, threshold);
+}
+
+void AddSine(float* dst, const size_t count, const uint32_t phase, const uint32_t increment, const float amplitude)
+{
+    static const auto kernel = SIMD_KERNEL(AddSine);
+    kernel(dst, count, phase, increment, amplitude);
+}
+
+void AddSquare(float* dst, const size_t count, const uint32_t phase, const uint32_t increment, const float amplitude)
+{
+    static const auto kernel = SIMD_KERNEL(AddSquare);
+    kernel(dst, count, phase, increment, amplitude);
+}
+
+void AddSaw(float* dst, const size_t count, const uint32_t phase, const uint32_t increment, const float amplitude)
+{
+    static const auto kernel = SIMD_KERNEL(AddSaw);
+    kernel(dst, count, phase, increment, amplitude);
+}
+
+void AddWavetable(float* dst, const size_t count, const uint32_t phase, const uint32_t increment, const float amplitude,
+                  const float* table, const unsigned tableBits)
+{
+    static const auto kernel = SIMD_KERNEL(AddWavetable);
+    kernel(dst, count, phase, increment, amplitude, table, tableBits);
+}
+
+void Deinterleave(float* planes, const size_t planeStride, const float* src, const size_t channels,
+                  const size_t frameCount)
+{
+    static const auto kernel = SIMD_KERNEL(Deinterleave);
+    kernel(planes, planeStride, src, channels, frameCount);
+}
+
+void Interleave(float* dst, const float* planes, const size_t planeStride, const size_t channels,
+                const size_t frameCount)
+{
+    static const auto kernel = SIMD_KERNEL(Interleave);
+    kernel(dst, planes, planeStride, channels, frameCount);
+}
+
+void DitherTpdf(const float* src, float* dst, const size_t count, const float scale, uint32_t* state)
+{
+    static const auto kernel = SIMD_KERNEL(DitherTpdf);
+    kernel(src, dst, count, scale, state);
+}
+
+void BiquadCascade(float* samples, const size_t stride, const size_t lanes, const size_t frameCount,
+                   const size_t sections, float* coefficients, const float* steps, const size_t rampFrames,
+                   float* state)
+{
+    static const auto kernel = SIMD_KERNEL(BiquadCascade);
+    kernel(samples, stride, lanes, frameCount, sections, coefficients, steps, rampFrames, state);
+}
+
+void FftRadix4Pass(float* re, float* im, const size_t count, const size_t span, const float* twiddles)
+{
+    static const auto kernel = SIMD_KERNEL(FftRadix4Pass);
+    kernel(re, im, count, span, twiddles);
+}
+
+void ComplexMultiplyAccumulate(float* accRe, float* accIm, const float* aRe, const float* aIm, const float* bRe,
+                               const float* bIm, const size_t count)
+{
+    static const auto kernel = SIMD_KERNEL(ComplexMultiplyAccumulate);
+    kernel(accRe, accIm, aRe, aIm, bRe, bIm, count);
+}
+
+void SpatialGains(const float* x, const float* y, const float* z, const float* gains, const size_t count,
+                  const float* listener, const float referenceDistance, const float maxDistance, const float rolloff,
+                  float* left, float* right, float* attenuated)
+{
+    static const auto kernel = SIMD_KERNEL(SpatialGains);
+    kernel(x, y, z, gains, count, listener, referenceDistance, maxDistance, rolloff, left, right, attenuated);
+}
+
+void MixAddMonoToStereoRamp(float* dst, const float* src, const size_t frameCount, const float left, const float right,
+                            const float leftStep, const float rightStep)
+{
+    static const auto kernel = SIMD_KERNEL(MixAddMonoToStereoRamp);
+    kernel(dst, src, frameCount, left, right, leftStep, rightStep);
+}
+
+void FirFilter(float* dst, const float* src, const size_t count, const float* taps, const size_t tapCount)
+{
+    static const auto kernel = SIMD_KERNEL(FirFilter);
+    kernel(dst, src, count, taps, tapCount);
+}
@@ -0,0 +1,106 @@
+#ifndef SIMDKERNELS_H
+#define SIMDKERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Float DSP primitives shared by the processing stages. Each one is compiled for AVX2 and for the
+// baseline instruction set, and dispatched at runtime (see SimdKernels.cpp).
+
+// sum of a[i] * b[i]
+float DotProduct(const float* a, const float* b, size_t count);
+
+// dst[i] += src[i] * gains[i % gainCount], gainCount must be a multiple of SIMD_LANES
+void MixAdd(float* dst, const float* src, size_t count, const float* gains, size_t gainCount);
+
+// adds a mono signal to an interleaved stereo one: dst[2i] += src[i] * left, dst[2i + 1] += src[i] * right
+void MixAddMonoToStereo(float* dst, const float* src, size_t frameCount, float left, float right);
+
+/*!
+    \brief dst frame = M * src frame for every interleaved frame
+    \param columns M laid out in blocks of SIMD_LANES output channels: for block b and input channel s,
+           columns[(b * srcChannels + s) * SIMD_LANES + lane] = M[b * SIMD_LANES + lane][s], zero padded
+    \param dst may not overlap src
+*/
+void MixMatrix(float* dst, size_t dstChannels, const float* src, size_t srcChannels, size_t frameCount,
+               const float* columns);
+
+// Leaves samples within [-threshold, threshold] alone and bends the ones beyond it smoothly
+// towards +-1, which they never reach. threshold must be in [0, 1).
+void SoftLimit(float* samples, size_t count, float threshold);
+
+// Oscillators add amplitude * wave to dst[0, count). The phase is a fixed point fraction of the cycle,
+// 2^32 being a whole one, at dst[0] and advances by increment every sample, wrapping around.
+void AddSine(float* dst, size_t count, uint32_t phase, uint32_t increment, float amplitude);
+
+// band limited with PolyBLEP, increment must stay below half a cycle
+void AddSquare(float* dst, size_t count, uint32_t phase, uint32_t increment, float amplitude);
+void AddSaw(float* dst, size_t count, uint32_t phase, uint32_t increment, float amplitude);
+
+// table holds one cycle of 2^tableBits samples, tableBits in [1, 24], followed by a copy of its first sample
+void AddWavetable(float* dst, size_t count, uint32_t phase, uint32_t increment, float amplitude,
+                  const float* table, unsigned tableBits);
+
+// planes[c * planeStride + i] = src[i * channels + c]; any 32-bit samples can go through as floats
+void Deinterleave(float* planes, size_t planeStride, const float* src, size_t channels, size_t frameCount);
+
+// dst[i * channels + c] = planes[c * planeStride + i]
+void Interleave(float* dst, const float* planes, size_t planeStride, size_t channels, size_t frameCount);
+
+/*!
+    \brief Rounds samples onto a grid of 1 / scale steps after adding TPDF dither of +-1 step
+    \param scale grid steps per unit, at most 2^16
+    \param state SIMD_LANES xorshift32 states, none of them zero, carried over between calls
+    \param dst may be equal to src
+*/
+void DitherTpdf(const float* src, float* dst, size_t count, float scale, uint32_t* state);
+
+/*!
+    \brief Filters interleaved frames in place through a cascade of biquads in transposed direct form II,
+           every SIMD lane running one channel
+    \param stride floats from one frame to the next; the lanes channels starting at samples[0] get
+           filtered, lanes at most SIMD_LANES
+    \param coefficients b0, b1, b2, a1 and a2 of every section (a0 normalized to 1), SIMD_LANES values
+           each, one per lane. The first rampFrames frames add steps (laid out alike) to them before
+           filtering, and the ramped values are written back
+    \param state z1 and z2 of every section, SIMD_LANES values each, carried over between calls
+*/
+void BiquadCascade(float* samples, size_t stride, size_t lanes, size_t frameCount, size_t sections,
+                   float* coefficients, const float* steps, size_t rampFrames, float* state);
+
+/*!
+    \brief Runs two consecutive radix-2 decimation in time stages over a split complex array, as one
+           radix-4 pass
+    \param count complex values in re and im, a multiple of 4 * span
+    \param span half the size of the first stage's butterflies
+    \param twiddles the real then the imaginary parts of the first stage's twiddles, of the second
+           stage's for the first and for the second half of its butterflies, span values each
+*/
+void FftRadix4Pass(float* re, float* im, size_t count, size_t span, const float* twiddles);
+
+// acc += a * b over split complex arrays.
+void ComplexMultiplyAccumulate(float* accRe, float* accIm, const float* aRe, const float* aIm, const float* bRe,
+                               const float* bIm, size_t count);
+
+/*!
+    \brief Gains of point emitters around a listener: inverse distance attenuation, clamped to
+           [referenceDistance, maxDistance], then ComputePanGains()'s constant power pan, with the sine of
+           the angle between the emitter and the listener's front as the pan
+    \param x, y, z, gains positions and gains of count emitters, structure of arrays
+    \param listener position then unit right vector, 3 floats each
+    \param referenceDistance distance within which emitters play at their own gain, greater than 0
+    \param rolloff 1 halves the gain with every doubling of the distance, 0 turns attenuation off
+    \param attenuated the gains after attenuation, left^2 + right^2 = attenuated^2
+*/
+void SpatialGains(const float* x, const float* y, const float* z, const float* gains, size_t count,
+                  const float* listener, float referenceDistance, float maxDistance, float rolloff, float* left,
+                  float* right, float* attenuated);
+
+// MixAddMonoToStereo() with gains ramping linearly, frame i getting left + i * leftStep and right + i * rightStep
+void MixAddMonoToStereoRamp(float* dst, const float* src, size_t frameCount, float left, float right, float leftStep,
+                            float rightStep);
+
+// dst[i] = sum of taps[k] * src[i - k], src has to be preceded by tapCount - 1 samples of history
+void FirFilter(float* dst, const float* src, size_t count, const float* taps, size_t tapCount);
+
+#endif //SIMDKERNELS_H
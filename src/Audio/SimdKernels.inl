@@ -0,0 +1,740 @@
+// Body of the float DSP primitives declared in SimdKernels.h. SimdKernels.cpp includes this file
+// once per instruction set, inside a namespace compiled with the matching target options.
+
+float DotProduct(const float* a, const float* b, const size_t count)
+{
+    // two accumulators hide the latency of the dependent adds
+    SimdF32 acc0 {};
+    SimdF32 acc1 {};
+
+    size_t i = 0;
+    for (; i + 2 * SIMD_LANES <= count; i += 2 * SIMD_LANES)
+    {
+        acc0 += SimdLoad<SimdF32>(a + i) * SimdLoad<SimdF32>(b + i);
+        acc1 += SimdLoad<SimdF32>(a + i + SIMD_LANES) * SimdLoad<SimdF32>(b + i + SIMD_LANES);
+    }
+
+    for (; i + SIMD_LANES <= count; i += SIMD_LANES)
+        acc0 += SimdLoad<SimdF32>(a + i) * SimdLoad<SimdF32>(b + i);
+
+    const SimdF32 acc = acc0 + acc1;
+
+    float sum = 0.f;
+    for (size_t lane = 0; lane < SIMD_LANES; ++lane)
+        sum += acc[lane];
+
+    for (; i < count; ++i)
+        sum += a[i] * b[i];
+
+    return sum;
+}
+
+void MixAdd(float* dst, const float* src, const size_t count, const float* gains, const size_t gainCount)
+{
+    size_t i = 0;
+    size_t phase = 0;
+
+    // the gain pattern spans whole vectors, so it lines up with every block
+    for (; i + SIMD_LANES <= count; i += SIMD_LANES)
+    {
+        const SimdF32 mixed = SimdLoad<SimdF32>(dst + i) + SimdLoad<SimdF32>(src + i) * SimdLoad<SimdF32>(gains + phase);
+        SimdStore(dst + i, mixed);
+
+        phase += SIMD_LANES;
+        if (phase == gainCount)
+            phase = 0;
+    }
+
+    for (; i < count; ++i)
+        dst[i] += src[i] * gains[i % gainCount];
+}
+
+void MixAddMonoToStereo(float* dst, const float* src, const size_t frameCount, const float left, const float right)
+{
+    const SimdF32 gains = { left, right, left, right, left, right, left, right };
+
+    size_t i = 0;
+    for (; i + SIMD_LANES <= frameCount; i += SIMD_LANES)
+    {
+        const auto mono = SimdLoad<SimdF32>(src + i);
+        const SimdF32 low = __builtin_shuffle(mono, SimdI32 { 0, 0, 1, 1, 2, 2, 3, 3 });
+        const SimdF32 high = __builtin_shuffle(mono, SimdI32 { 4, 4, 5, 5, 6, 6, 7, 7 });
+
+        SimdStore(dst + 2 * i, SimdLoad<SimdF32>(dst + 2 * i) + low * gains);
+        SimdStore(dst + 2 * i + SIMD_LANES, SimdLoad<SimdF32>(dst + 2 * i + SIMD_LANES) + high * gains);
+    }
+
+    for (; i < frameCount; ++i)
+    {
+        dst[2 * i] += src[i] * left;
+        dst[2 * i + 1] += src[i] * right;
+    }
+}
+
+void MixMatrix(float* dst, const size_t dstChannels, const float* src, const size_t srcChannels,
+               const size_t frameCount, const float* columns)
+{
+    const size_t blocks = (dstChannels + SIMD_LANES - 1) / SIMD_LANES;
+    const size_t total = frameCount * dstChannels;
+
+    for (size_t frame = 0; frame < frameCount; ++frame)
+    {
+        const float* in = src + frame * srcChannels;
+
+        for (size_t block = 0; block < blocks; ++block)
+        {
+            // output channels across the lanes, one broadcast input channel at a time
+            const float* column = columns + block * srcChannels * SIMD_LANES;
+            SimdF32 acc {};
+
+            for (size_t s = 0; s < srcChannels; ++s)
+                acc += SimdLoad<SimdF32>(column + s * SIMD_LANES) * in[s];
+
+            // lanes past this frame's channels spill into the next frame, which overwrites them
+            // later; only the very end of the buffer needs a partial store
+            const size_t offset = frame * dstChannels + block * SIMD_LANES;
+            if (offset + SIMD_LANES <= total)
+            {
+                SimdStore(dst + offset, acc);
+            }
+            else
+            {
+                for (size_t lane = 0; offset + lane < total; ++lane)
+                    dst[offset + lane] = acc[lane];
+            }
+        }
+    }
+}
+
+void SoftLimit(float* samples, const size_t count, const float threshold)
+{
+    // past the knee the excess d (in units of the headroom) maps onto d / (1 + d), which starts
+    // with unit slope and approaches the headroom asymptotically
+    const float headroom = 1.f - threshold;
+    const float inverseHeadroom = 1.f / headroom;
+
+    size_t i = 0;
+    for (; i + SIMD_LANES <= count; i += SIMD_LANES)
+    {
+        const auto x = SimdLoad<SimdF32>(samples + i);
+        const SimdF32 magnitude = x < 0.f ? -x : x;
+
+        const SimdF32 excess = (magnitude - threshold) * inverseHeadroom;
+        const SimdF32 bent = threshold + headroom * excess / (1.f + excess);
+        const SimdF32 limited = magnitude > threshold ? bent : magnitude;
+
+        SimdStore(samples + i, x < 0.f ? -limited : limited);
+    }
+
+    for (; i < count; ++i)
+    {
+        const float magnitude = std::abs(samples[i]);
+        if (magnitude <= threshold)
+            continue;
+
+        const float excess = (magnitude - threshold) * inverseHeadroom;
+        const float limited = threshold + headroom * excess / (1.f + excess);
+        samples[i] = samples[i] < 0.f ? -limited : limited;
+    }
+}
+
+// phases of SIMD_LANES consecutive oscillator samples, the first one at phase
+[[gnu::always_inline]] inline SimdU32 OscillatorPhases(const uint32_t phase, const uint32_t increment)
+{
+    const SimdU32 steps = { 0, 1, 2, 3, 4, 5, 6, 7 };
+    return phase + steps * increment;
+}
+
+// fixed point phase as a fraction of the cycle in [0, 1), its top 24 bits convert exactly
+[[gnu::always_inline]] inline SimdF32 PhaseToUnit(const SimdU32& phase)
+{
+    return __builtin_convertvector((SimdI32)(phase >> 8), SimdF32) * (1.f / 16777216.f);
+}
+
+// sin(pi u) for u in [-1/2, 1/2], an odd minimax polynomial below float rounding error
+[[gnu::always_inline]] inline SimdF32 SinPi(const SimdF32& u)
+{
+    const SimdF32 u2 = u * u;
+    const SimdF32 p =
+        3.14159258f + u2 * (-5.16770687f + u2 * (2.55003118f + u2 * (-0.59804409f + u2 * 0.0772181776f)));
+
+    return u * p;
+}
+
+// the correction which takes the step out of a naive unit step at t = 0, dt being the phase increment
+[[gnu::always_inline]] inline SimdF32 PolyBlep(const SimdF32& t, const float dt, const float inverseDt)
+{
+    const SimdF32 after = t * inverseDt;
+    const SimdF32 before = (t - 1.f) * inverseDt;
+
+    const SimdF32 rising = after + after - after * after - 1.f;
+    const SimdF32 falling = before * before + before + before + 1.f;
+    const SimdF32 none {};
+
+    return t < dt ? rising : (t > 1.f - dt ? falling : none);
+}
+
+template <typename Wave>
+[[gnu::always_inline]] inline void AddOscillator(float* dst, const size_t count, const uint32_t phase,
+                                                 const uint32_t increment, const float amplitude, const Wave& wave)
+{
+    SimdU32 phases = OscillatorPhases(phase, increment);
+    const uint32_t stride = increment * SIMD_LANES;
+
+    size_t i = 0;
+    for (; i + SIMD_LANES <= count; i += SIMD_LANES)
+    {
+        SimdStore(dst + i, SimdLoad<SimdF32>(dst + i) + amplitude * wave(phases));
+        phases += stride;
+    }
+
+    // the tail gets a whole vector evaluated too, only its first lanes land in dst
+    if (i < count)
+    {
+        const SimdF32 tail = amplitude * wave(phases);
+        for (size_t lane = 0; i + lane < count; ++lane)
+            dst[i + lane] += tail[lane];
+    }
+}
+
+void AddSine(float* dst, const size_t count, const uint32_t phase, const uint32_t increment, const float amplitude)
+{
+    const auto wave = [](const SimdU32& phases) __attribute__((always_inline))
+    {
+        // sin(2 pi t) = -sin(pi u) with u = 2t - 1, folded into [-1/2, 1/2] by sin(pi u) = sin(pi (+-1 - u));
+        // the odd polynomial is a minimax fit of sin(pi u) there, below float rounding error
+        SimdF32 u = 2.f * PhaseToUnit(phases) - 1.f;
+        u = u > 0.5f ? 1.f - u : u;
+        u = u < -0.5f ? -1.f - u : u;
+
+        return -SinPi(u);
+    };
+
+    AddOscillator(dst, count, phase, increment, amplitude, wave);
+}
+
+void AddSquare(float* dst, const size_t count, const uint32_t phase, const uint32_t increment, const float amplitude)
+{
+    const float dt = static_cast<float>(increment) * 0x1p-32f;
+    const float inverseDt = 1.f / dt;
+
+    const auto wave = [dt, inverseDt](const SimdU32& phases) __attribute__((always_inline))
+    {
+        const SimdF32 t = PhaseToUnit(phases);
+        const SimdF32 half = PhaseToUnit(phases + 0x80000000u);
+        const SimdF32 high = { 1.f, 1.f, 1.f, 1.f, 1.f, 1.f, 1.f, 1.f };
+
+        // rises at t = 0 and falls at t = 1/2
+        return (t < 0.5f ? high : -high) + PolyBlep(t, dt, inverseDt) - PolyBlep(half, dt, inverseDt);
+    };
+
+    AddOscillator(dst, count, phase, increment, amplitude, wave);
+}
+
+void AddSaw(float* dst, const size_t count, const uint32_t phase, const uint32_t increment, const float amplitude)
+{
+    const float dt = static_cast<float>(increment) * 0x1p-32f;
+    const float inverseDt = 1.f / dt;
+
+    const auto wave = [dt, inverseDt](const SimdU32& phases) __attribute__((always_inline))
+    {
+        const SimdF32 t = PhaseToUnit(phases);
+        return 2.f * t - 1.f - PolyBlep(t, dt, inverseDt);
+    };
+
+    AddOscillator(dst, count, phase, increment, amplitude, wave);
+}
+
+void AddWavetable(float* dst, const size_t count, const uint32_t phase, const uint32_t increment, const float amplitude,
+                  const float* table, const unsigned tableBits)
+{
+    const auto wave = [table, tableBits](const SimdU32& phases) __attribute__((always_inline))
+    {
+        const SimdU32 index = phases >> (32 - tableBits);
+        const SimdF32 fraction = PhaseToUnit(phases << tableBits);
+
+        SimdF32 a;
+        SimdF32 b;
+        for (size_t lane = 0; lane < SIMD_LANES; ++lane)
+        {
+            a[lane] = table[index[lane]];
+            b[lane] = table[index[lane] + 1];
+        }
+
+        return a + (b - a) * fraction;
+    };
+
+    AddOscillator(dst, count, phase, increment, amplitude, wave);
+}
+
+void Deinterleave(float* planes, const size_t planeStride, const float* src, const size_t channels,
+                  const size_t frameCount)
+{
+    size_t i = 0;
+
+    if (channels == 2)
+    {
+        float* left = planes;
+        float* right = planes + planeStride;
+
+        for (; i + SIMD_LANES <= frameCount; i += SIMD_LANES)
+        {
+            const auto low = SimdLoad<SimdF32>(src + 2 * i);
+            const auto high = SimdLoad<SimdF32>(src + 2 * i + SIMD_LANES);
+
+            SimdStore(left + i, __builtin_shuffle(low, high, SimdI32 { 0, 2, 4, 6, 8, 10, 12, 14 }));
+            SimdStore(right + i, __builtin_shuffle(low, high, SimdI32 { 1, 3, 5, 7, 9, 11, 13, 15 }));
+        }
+    }
+    else
+    {
+        // strided gathers, but every plane still gets whole vectors stored
+        for (; i + SIMD_LANES <= frameCount; i += SIMD_LANES)
+        {
+            for (size_t c = 0; c < channels; ++c)
+            {
+                SimdF32 plane;
+                for (size_t lane = 0; lane < SIMD_LANES; ++lane)
+                    plane[lane] = src[(i + lane) * channels + c];
+
+                SimdStore(planes + c * planeStride + i, plane);
+            }
+        }
+    }
+
+    for (; i < frameCount; ++i)
+    {
+        for (size_t c = 0; c < channels; ++c)
+            planes[c * planeStride + i] = src[i * channels + c];
+    }
+}
+
+void Interleave(float* dst, const float* planes, const size_t planeStride, const size_t channels,
+                const size_t frameCount)
+{
+    size_t i = 0;
+
+    if (channels == 2)
+    {
+        const float* left = planes;
+        const float* right = planes + planeStride;
+
+        for (; i + SIMD_LANES <= frameCount; i += SIMD_LANES)
+        {
+            const auto l = SimdLoad<SimdF32>(left + i);
+            const auto r = SimdLoad<SimdF32>(right + i);
+
+            SimdStore(dst + 2 * i, __builtin_shuffle(l, r, SimdI32 { 0, 8, 1, 9, 2, 10, 3, 11 }));
+            SimdStore(dst + 2 * i + SIMD_LANES, __builtin_shuffle(l, r, SimdI32 { 4, 12, 5, 13, 6, 14, 7, 15 }));
+        }
+    }
+    else
+    {
+        for (; i + SIMD_LANES <= frameCount; i += SIMD_LANES)
+        {
+            for (size_t c = 0; c < channels; ++c)
+            {
+                const auto plane = SimdLoad<SimdF32>(planes + c * planeStride + i);
+                for (size_t lane = 0; lane < SIMD_LANES; ++lane)
+                    dst[(i + lane) * channels + c] = plane[lane];
+            }
+        }
+    }
+
+    for (; i < frameCount; ++i)
+    {
+        for (size_t c = 0; c < channels; ++c)
+            dst[i * channels + c] = planes[c * planeStride + i];
+    }
+}
+
+void DitherTpdf(const float* src, float* dst, const size_t count, const float scale, uint32_t* state)
+{
+    // adding and taking away 1.5 * 2^23 rounds to the nearest integer for anything below 2^22
+    constexpr float ROUNDING_MAGIC = 12582912.f;
+    const float inverseScale = 1.f / scale;
+
+    auto generator = SimdLoad<SimdU32>(state);
+
+    const auto next = [&]() __attribute__((always_inline))
+    {
+        // xorshift32 in every lane, the two halves of the output give two uniform values whose
+        // difference has the triangular distribution over (-1, 1)
+        generator ^= generator << 13;
+        generator ^= generator >> 17;
+        generator ^= generator << 5;
+
+        const SimdI32 difference = (SimdI32)(generator & 0xffffu) - (SimdI32)(generator >> 16);
+        return __builtin_convertvector(difference, SimdF32) * (1.f / 65536.f);
+    };
+
+    size_t i = 0;
+    for (; i + SIMD_LANES <= count; i += SIMD_LANES)
+    {
+        const SimdF32 v = SimdLoad<SimdF32>(src + i) * scale + next();
+        SimdStore(dst + i, (v + ROUNDING_MAGIC - ROUNDING_MAGIC) * inverseScale);
+    }
+
+    if (i < count)
+    {
+        float tail[SIMD_LANES] {};
+        std::memcpy(tail, src + i, (count - i) * sizeof(float));
+
+        const SimdF32 v = SimdLoad<SimdF32>(tail) * scale + next();
+        SimdStore(tail, (v + ROUNDING_MAGIC - ROUNDING_MAGIC) * inverseScale);
+        std::memcpy(dst + i, tail, (count - i) * sizeof(float));
+    }
+
+    SimdStore(state, generator);
+}
+
+void BiquadCascade(float* samples, const size_t stride, const size_t lanes, const size_t frameCount,
+                   const size_t sections, float* coefficients, const float* steps, const size_t rampFrames,
+                   float* state)
+{
+    // frames per block, the padded copy stays in L1 while every section runs over it
+    constexpr size_t BLOCK = 256;
+    // state below this has decayed into inaudibility, flushing it keeps the recursion out of denormals
+    constexpr float DENORMAL_GUARD = 1e-15f;
+
+    SimdF32 block[BLOCK];
+
+    for (size_t start = 0; start < frameCount; start += BLOCK)
+    {
+        const size_t count = std::min(BLOCK, frameCount - start);
+        const size_t ramp = rampFrames > start ? std::min(rampFrames - start, count) : 0;
+        float* frames = samples + start * stride;
+
+        // one channel per lane, lanes past the channels run on silence
+        for (size_t i = 0; i < count; ++i)
+        {
+            block[i] = SimdF32 {};
+            std::memcpy(&block[i], frames + i * stride, lanes * sizeof(float));
+        }
+
+        // section by section, so that coefficients and state stay in registers across the block
+        for (size_t s = 0; s < sections; ++s)
+        {
+            float* c = coefficients + s * 5 * SIMD_LANES;
+            const float* d = steps + s * 5 * SIMD_LANES;
+
+            auto b0 = SimdLoad<SimdF32>(c);
+            auto b1 = SimdLoad<SimdF32>(c + SIMD_LANES);
+            auto b2 = SimdLoad<SimdF32>(c + 2 * SIMD_LANES);
+            auto a1 = SimdLoad<SimdF32>(c + 3 * SIMD_LANES);
+            auto a2 = SimdLoad<SimdF32>(c + 4 * SIMD_LANES);
+
+            auto z1 = SimdLoad<SimdF32>(state + s * 2 * SIMD_LANES);
+            auto z2 = SimdLoad<SimdF32>(state + (s * 2 + 1) * SIMD_LANES);
+
+            // transposed direct form II
+            const auto tick = [&](const SimdF32& x) __attribute__((always_inline))
+            {
+                const SimdF32 y = b0 * x + z1;
+                z1 = b1 * x - a1 * y + z2;
+                z2 = b2 * x - a2 * y;
+                return y;
+            };
+
+            size_t i = 0;
+
+            if (ramp > 0)
+            {
+                const auto db0 = SimdLoad<SimdF32>(d);
+                const auto db1 = SimdLoad<SimdF32>(d + SIMD_LANES);
+                const auto db2 = SimdLoad<SimdF32>(d + 2 * SIMD_LANES);
+                const auto da1 = SimdLoad<SimdF32>(d + 3 * SIMD_LANES);
+                const auto da2 = SimdLoad<SimdF32>(d + 4 * SIMD_LANES);
+
+                for (; i < ramp; ++i)
+                {
+                    b0 += db0;
+                    b1 += db1;
+                    b2 += db2;
+                    a1 += da1;
+                    a2 += da2;
+
+                    block[i] = tick(block[i]);
+                }
+
+                SimdStore(c, b0);
+                SimdStore(c + SIMD_LANES, b1);
+                SimdStore(c + 2 * SIMD_LANES, b2);
+                SimdStore(c + 3 * SIMD_LANES, a1);
+                SimdStore(c + 4 * SIMD_LANES, a2);
+            }
+
+            for (; i < count; ++i)
+                block[i] = tick(block[i]);
+
+            const SimdF32 zero {};
+            z1 = (z1 < DENORMAL_GUARD && z1 > -DENORMAL_GUARD) ? zero : z1;
+            z2 = (z2 < DENORMAL_GUARD && z2 > -DENORMAL_GUARD) ? zero : z2;
+
+            SimdStore(state + s * 2 * SIMD_LANES, z1);
+            SimdStore(state + (s * 2 + 1) * SIMD_LANES, z2);
+        }
+
+        for (size_t i = 0; i < count; ++i)
+            std::memcpy(frames + i * stride, &block[i], lanes * sizeof(float));
+    }
+}
+
+void FftRadix4Pass(float* re, float* im, const size_t count, const size_t span, const float* twiddles)
+{
+    const float* w1Re = twiddles;
+    const float* w1Im = twiddles + span;
+    const float* w2Re = twiddles + 2 * span;
+    const float* w2Im = twiddles + 3 * span;
+    const float* w3Re = twiddles + 4 * span;
+    const float* w3Im = twiddles + 5 * span;
+
+    for (size_t block = 0; block < count; block += 4 * span)
+    {
+        float* r0 = re + block;
+        float* i0 = im + block;
+        float* r1 = r0 + span;
+        float* i1 = i0 + span;
+        float* r2 = r1 + span;
+        float* i2 = i1 + span;
+        float* r3 = r2 + span;
+        float* i3 = i2 + span;
+
+        // two radix-2 stages per pass, every element gets loaded and stored once for both
+        size_t j = 0;
+        for (; j + SIMD_LANES <= span; j += SIMD_LANES)
+        {
+            const auto aRe = SimdLoad<SimdF32>(r0 + j);
+            const auto aIm = SimdLoad<SimdF32>(i0 + j);
+            const auto bRe = SimdLoad<SimdF32>(r1 + j);
+            const auto bIm = SimdLoad<SimdF32>(i1 + j);
+            const auto cRe = SimdLoad<SimdF32>(r2 + j);
+            const auto cIm = SimdLoad<SimdF32>(i2 + j);
+            const auto dRe = SimdLoad<SimdF32>(r3 + j);
+            const auto dIm = SimdLoad<SimdF32>(i3 + j);
+
+            const auto t1Re = SimdLoad<SimdF32>(w1Re + j);
+            const auto t1Im = SimdLoad<SimdF32>(w1Im + j);
+            const auto t2Re = SimdLoad<SimdF32>(w2Re + j);
+            const auto t2Im = SimdLoad<SimdF32>(w2Im + j);
+            const auto t3Re = SimdLoad<SimdF32>(w3Re + j);
+            const auto t3Im = SimdLoad<SimdF32>(w3Im + j);
+
+            const SimdF32 bwRe = bRe * t1Re - bIm * t1Im;
+            const SimdF32 bwIm = bRe * t1Im + bIm * t1Re;
+            const SimdF32 dwRe = dRe * t1Re - dIm * t1Im;
+            const SimdF32 dwIm = dRe * t1Im + dIm * t1Re;
+
+            const SimdF32 a1Re = aRe + bwRe, a1Im = aIm + bwIm;
+            const SimdF32 b1Re = aRe - bwRe, b1Im = aIm - bwIm;
+            const SimdF32 c1Re = cRe + dwRe, c1Im = cIm + dwIm;
+            const SimdF32 d1Re = cRe - dwRe, d1Im = cIm - dwIm;
+
+            const SimdF32 cwRe = c1Re * t2Re - c1Im * t2Im;
+            const SimdF32 cwIm = c1Re * t2Im + c1Im * t2Re;
+            const SimdF32 ewRe = d1Re * t3Re - d1Im * t3Im;
+            const SimdF32 ewIm = d1Re * t3Im + d1Im * t3Re;
+
+            SimdStore(r0 + j, a1Re + cwRe);
+            SimdStore(i0 + j, a1Im + cwIm);
+            SimdStore(r2 + j, a1Re - cwRe);
+            SimdStore(i2 + j, a1Im - cwIm);
+            SimdStore(r1 + j, b1Re + ewRe);
+            SimdStore(i1 + j, b1Im + ewIm);
+            SimdStore(r3 + j, b1Re - ewRe);
+            SimdStore(i3 + j, b1Im - ewIm);
+        }
+
+        for (; j < span; ++j)
+        {
+            const float bwRe = r1[j] * w1Re[j] - i1[j] * w1Im[j];
+            const float bwIm = r1[j] * w1Im[j] + i1[j] * w1Re[j];
+            const float dwRe = r3[j] * w1Re[j] - i3[j] * w1Im[j];
+            const float dwIm = r3[j] * w1Im[j] + i3[j] * w1Re[j];
+
+            const float a1Re = r0[j] + bwRe, a1Im = i0[j] + bwIm;
+            const float b1Re = r0[j] - bwRe, b1Im = i0[j] - bwIm;
+            const float c1Re = r2[j] + dwRe, c1Im = i2[j] + dwIm;
+            const float d1Re = r2[j] - dwRe, d1Im = i2[j] - dwIm;
+
+            const float cwRe = c1Re * w2Re[j] - c1Im * w2Im[j];
+            const float cwIm = c1Re * w2Im[j] + c1Im * w2Re[j];
+            const float ewRe = d1Re * w3Re[j] - d1Im * w3Im[j];
+            const float ewIm = d1Re * w3Im[j] + d1Im * w3Re[j];
+
+            r0[j] = a1Re + cwRe;
+            i0[j] = a1Im + cwIm;
+            r2[j] = a1Re - cwRe;
+            i2[j] = a1Im - cwIm;
+            r1[j] = b1Re + ewRe;
+            i1[j] = b1Im + ewIm;
+            r3[j] = b1Re - ewRe;
+            i3[j] = b1Im - ewIm;
+        }
+    }
+}
+
+void ComplexMultiplyAccumulate(float* accRe, float* accIm, const float* aRe, const float* aIm, const float* bRe,
+                               const float* bIm, const size_t count)
+{
+    size_t i = 0;
+    for (; i + SIMD_LANES <= count; i += SIMD_LANES)
+    {
+        const auto xRe = SimdLoad<SimdF32>(aRe + i);
+        const auto xIm = SimdLoad<SimdF32>(aIm + i);
+        const auto yRe = SimdLoad<SimdF32>(bRe + i);
+        const auto yIm = SimdLoad<SimdF32>(bIm + i);
+
+        SimdStore(accRe + i, SimdLoad<SimdF32>(accRe + i) + xRe * yRe - xIm * yIm);
+        SimdStore(accIm + i, SimdLoad<SimdF32>(accIm + i) + xRe * yIm + xIm * yRe);
+    }
+
+    for (; i < count; ++i)
+    {
+        accRe[i] += aRe[i] * bRe[i] - aIm[i] * bIm[i];
+        accIm[i] += aRe[i] * bIm[i] + aIm[i] * bRe[i];
+    }
+}
+
+void SpatialGains(const float* x, const float* y, const float* z, const float* gains, const size_t count,
+                  const float* listener, const float referenceDistance, const float maxDistance, const float rolloff,
+                  float* left, float* right, float* attenuated)
+{
+    const float px = listener[0], py = listener[1], pz = listener[2];
+    const float rx = listener[3], ry = listener[4], rz = listener[5];
+
+    const SimdF32 zeros {};
+    const SimdF32 ones = zeros + 1.f;
+
+    // the classic estimate, within 0.2%, and two Newton-Raphson steps which take it to float precision
+    const auto rsqrt = [](const SimdF32& v) __attribute__((always_inline))
+    {
+        SimdF32 r = reinterpret_cast<SimdF32>(0x5f375a86 - (reinterpret_cast<SimdI32>(v) >> 1));
+        r = r * (1.5f - 0.5f * v * r * r);
+        return r * (1.5f - 0.5f * v * r * r);
+    };
+
+    const auto compute = [&](const SimdF32& ex, const SimdF32& ey, const SimdF32& ez, const SimdF32& gain, SimdF32& l,
+                             SimdF32& r, SimdF32& g) __attribute__((always_inline))
+    {
+        const SimdF32 dx = ex - px;
+        const SimdF32 dy = ey - py;
+        const SimdF32 dz = ez - pz;
+
+        // an emitter right on the listener has no direction to be panned to
+        const SimdF32 squared = dx * dx + dy * dy + dz * dz;
+        const auto near = squared < 1e-12f;
+        const SimdF32 inverse = rsqrt(near ? ones : squared);
+
+        const SimdF32 distance = near ? zeros : squared * inverse;
+        const SimdF32 lateral = near ? zeros : (dx * rx + dy * ry + dz * rz) * inverse;
+
+        // inverse distance, clamped to the reference distance and the maximum
+        SimdF32 clamped = distance < referenceDistance ? zeros + referenceDistance : distance;
+        clamped = clamped > maxDistance ? zeros + maxDistance : clamped;
+        g = gain * referenceDistance / (referenceDistance + rolloff * (clamped - referenceDistance));
+
+        // constant power as in ComputePanGains(), the angle (pan + 1) pi / 4 as u = (pan + 1) / 4 turns of pi
+        SimdF32 u = 0.25f + 0.25f * lateral;
+        u = u < 0.f ? zeros : u;
+        u = u > 0.5f ? zeros + 0.5f : u;
+
+        l = g * SinPi(0.5f - u);
+        r = g * SinPi(u);
+    };
+
+    size_t i = 0;
+    for (; i + SIMD_LANES <= count; i += SIMD_LANES)
+    {
+        SimdF32 l, r, g;
+        compute(SimdLoad<SimdF32>(x + i), SimdLoad<SimdF32>(y + i), SimdLoad<SimdF32>(z + i),
+                SimdLoad<SimdF32>(gains + i), l, r, g);
+
+        SimdStore(left + i, l);
+        SimdStore(right + i, r);
+        SimdStore(attenuated + i, g);
+    }
+
+    if (i < count)
+    {
+        // the rest goes through padded copies, so that it gets exactly the same math
+        float padded[4][SIMD_LANES] {};
+        const size_t rest = count - i;
+        std::memcpy(padded[0], x + i, rest * sizeof(float));
+        std::memcpy(padded[1], y + i, rest * sizeof(float));
+        std::memcpy(padded[2], z + i, rest * sizeof(float));
+        std::memcpy(padded[3], gains + i, rest * sizeof(float));
+
+        SimdF32 l, r, g;
+        compute(SimdLoad<SimdF32>(padded[0]), SimdLoad<SimdF32>(padded[1]), SimdLoad<SimdF32>(padded[2]),
+                SimdLoad<SimdF32>(padded[3]), l, r, g);
+
+        for (size_t lane = 0; lane < rest; ++lane)
+        {
+            left[i + lane] = l[lane];
+            right[i + lane] = r[lane];
+            attenuated[i + lane] = g[lane];
+        }
+    }
+}
+
+void MixAddMonoToStereoRamp(float* dst, const float* src, const size_t frameCount, const float left, const float right,
+                            const float leftStep, const float rightStep)
+{
+    const SimdF32 start = { left, right, left, right, left, right, left, right };
+    const SimdF32 steps = { leftStep, rightStep, leftStep, rightStep, leftStep, rightStep, leftStep, rightStep };
+    const SimdF32 offsets = { 0.f, 0.f, 1.f, 1.f, 2.f, 2.f, 3.f, 3.f };
+
+    size_t i = 0;
+    for (; i + SIMD_LANES <= frameCount; i += SIMD_LANES)
+    {
+        // each frame's gains from its own index, so that nothing accumulates over the frame
+        const SimdF32 lowGains = start + (offsets + static_cast<float>(i)) * steps;
+        const SimdF32 highGains = start + (offsets + static_cast<float>(i + SIMD_LANES / 2)) * steps;
+
+        const auto mono = SimdLoad<SimdF32>(src + i);
+        const SimdF32 low = __builtin_shuffle(mono, SimdI32 { 0, 0, 1, 1, 2, 2, 3, 3 });
+        const SimdF32 high = __builtin_shuffle(mono, SimdI32 { 4, 4, 5, 5, 6, 6, 7, 7 });
+
+        SimdStore(dst + 2 * i, SimdLoad<SimdF32>(dst + 2 * i) + low * lowGains);
+        SimdStore(dst + 2 * i + SIMD_LANES, SimdLoad<SimdF32>(dst + 2 * i + SIMD_LANES) + high * highGains);
+    }
+
+    for (; i < frameCount; ++i)
+    {
+        dst[2 * i] += src[i] * (left + static_cast<float>(i) * leftStep);
+        dst[2 * i + 1] += src[i] * (right + static_cast<float>(i) * rightStep);
+    }
+}
+
+void FirFilter(float* dst, const float* src, const size_t count, const float* taps, const size_t tapCount)
+{
+    size_t i = 0;
+    for (; i + SIMD_LANES <= count; i += SIMD_LANES)
+    {
+        // eight outputs at a time, one broadcast tap against eight inputs
+        SimdF32 acc0 {};
+        SimdF32 acc1 {};
+
+        size_t k = 0;
+        for (; k + 2 <= tapCount; k += 2)
+        {
+            acc0 += SimdLoad<SimdF32>(src + i - k) * taps[k];
+            acc1 += SimdLoad<SimdF32>(src + i - k - 1) * taps[k + 1];
+        }
+
+        if (k < tapCount)
+            acc0 += SimdLoad<SimdF32>(src + i - k) * taps[k];
+
+        SimdStore(dst + i, acc0 + acc1);
+    }
+
+    for (; i < count; ++i)
+    {
+        float sum = 0.f;
+        for (size_t k = 0; k < tapCount; ++k)
+            sum += src[i - k] * taps[k];
+
+        dst[i] = sum;
+    }
+}
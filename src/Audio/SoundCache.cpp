@@ -0,0 +1,348 @@
+#include "SoundCache.h"
+#include "ChannelRemixer.h"
+#include "OpusSource.h"
+#include "WavSource.h"
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <span>
+#include <stdexcept>
+#include <utility>
+
+DecodedSound::DecodedSound(std::vector<uint8_t> samples, const SignalSpec spec, const AudioEncoding encoding)
+    : m_Samples(std::move(samples)), m_Spec(spec), m_Encoding(encoding)
+{
+    const size_t frameSize = spec.m_Channels.Count() * GetEffectiveEncodingSize(encoding);
+    if (frameSize == 0)
+        throw std::runtime_error("DecodedSound needs at least one channel");
+    if (m_Samples.size() % frameSize != 0)
+        throw std::runtime_error("DecodedSound's samples aren't a whole number of frames");
+
+    m_FrameCount = m_Samples.size() / frameSize;
+}
+
+DecodedSoundSource::DecodedSoundSource(std::shared_ptr<const DecodedSound> sound, const size_t frameLength)
+    : m_Sound(std::move(sound)), m_FrameLength(frameLength)
+{
+    if (m_FrameLength == 0)
+        throw std::runtime_error("DecodedSoundSource's frame length must be at least 1");
+}
+
+std::optional<AudioBuffer> DecodedSoundSource::NextFrame()
+{
+    AudioBuffer frame;
+    if (!NextFrameInto(frame))
+        return std::nullopt;
+
+    return frame;
+}
+
+bool DecodedSoundSource::DoNextFrameInto(AudioBuffer& frame)
+{
+    return NextFrameUpTo(frame, SIZE_MAX);
+}
+
+bool DecodedSoundSource::NextFrameUpTo(AudioBuffer& frame, const size_t maxFrames)
+{
+    const size_t frameCount = std::min({ m_FrameLength, maxFrames, m_Sound->FrameCount() - m_Position });
+    if (frameCount == 0)
+        return false;
+
+    const size_t frameSize = m_Sound->Spec().m_Channels.Count() * GetEffectiveEncodingSize(m_Sound->Encoding());
+    const std::span samples(m_Sound->Data() + m_Position * frameSize, frameCount * frameSize);
+
+    frame.Alias(m_Sound, samples, m_Sound->Spec(), m_Sound->Encoding());
+
+    m_Position += frameCount;
+    return true;
+}
+
+SoundCache::SoundCache(const size_t budgetBytes, const ResamplerQuality quality, SoundDecoder decoder)
+    : m_Quality(quality), m_Decoder(decoder ? std::move(decoder) : SoundDecoder(&SoundCache::OpenFile)),
+      m_BudgetBytes(budgetBytes)
+{
+    m_PreloadThread = std::thread(&SoundCache::PreloadLoop, this);
+}
+
+SoundCache::~SoundCache()
+{
+    {
+        std::lock_guard lock(m_Mutex);
+        m_Stopping = true;
+        m_PreloadQueue.clear();
+    }
+
+    m_PreloadWake.notify_all();
+    m_PreloadsDone.notify_all();
+    m_PreloadThread.join();
+}
+
+std::shared_ptr<AudioSource> SoundCache::OpenFile(const std::string& path)
+{
+    std::string extension = std::filesystem::path(path).extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](const unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+    if (extension == ".wav")
+        return std::make_shared<WavSource>(path);
+
+    return std::make_shared<OpusSource>(path);
+}
+
+std::shared_ptr<const DecodedSound> SoundCache::Get(const std::string& path, const SignalSpec spec,
+                                                    const AudioEncoding encoding)
+{
+    const Request request { path, spec, encoding };
+    const Key key = MakeKey(request);
+
+    std::unique_lock lock(m_Mutex);
+
+    const auto entry = FindOrAdd(lock, key);
+    if (entry->second.m_Sound)
+    {
+        ++m_Stats.m_Hits;
+        Touch(entry->second);
+        return entry->second.m_Sound;
+    }
+
+    ++m_Stats.m_Misses;
+    lock.unlock();
+
+    // nobody else touches the entry while it has no sound, so it stays valid without the lock
+    std::shared_ptr<const DecodedSound> sound;
+    try
+    {
+        sound = Decode(request);
+    }
+    catch (...)
+    {
+        lock.lock();
+        m_Entries.erase(entry);
+        m_Decoded.notify_all();
+        throw;
+    }
+
+    lock.lock();
+    Insert(entry, sound);
+    m_Decoded.notify_all();
+
+    return sound;
+}
+
+std::shared_ptr<AudioSource> SoundCache::Play(const std::string& path, const SignalSpec spec,
+                                              const AudioEncoding encoding)
+{
+    return std::make_shared<DecodedSoundSource>(Get(path, spec, encoding));
+}
+
+void SoundCache::Preload(const std::string& path, const SignalSpec spec, const AudioEncoding encoding)
+{
+    Request request { path, spec, encoding };
+
+    {
+        std::lock_guard lock(m_Mutex);
+
+        if (const auto entry = m_Entries.find(MakeKey(request)); entry != m_Entries.end())
+        {
+            // cached, or being decoded already
+            if (entry->second.m_Sound)
+                Touch(entry->second);
+
+            return;
+        }
+
+        m_PreloadQueue.push_back(std::move(request));
+        ++m_PreloadsPending;
+    }
+
+    m_PreloadWake.notify_one();
+}
+
+void SoundCache::WaitForPreloads()
+{
+    std::unique_lock lock(m_Mutex);
+    m_PreloadsDone.wait(lock, [this] { return m_PreloadsPending == 0 || m_Stopping; });
+}
+
+void SoundCache::SetBudget(const size_t budgetBytes)
+{
+    std::lock_guard lock(m_Mutex);
+
+    m_BudgetBytes = budgetBytes;
+    EvictToBudget();
+}
+
+void SoundCache::Clear()
+{
+    std::lock_guard lock(m_Mutex);
+
+    // sounds being decoded stay, whoever decodes them still needs their entries
+    for (const Key* key : m_Uses)
+        m_Entries.erase(*key);
+
+    m_Uses.clear();
+    m_Bytes = 0;
+}
+
+SoundCacheStats SoundCache::Stats()
+{
+    std::lock_guard lock(m_Mutex);
+
+    SoundCacheStats stats = m_Stats;
+    stats.m_Sounds = m_Uses.size();
+    stats.m_Bytes = m_Bytes;
+    stats.m_BudgetBytes = m_BudgetBytes;
+
+    return stats;
+}
+
+SoundCache::Key SoundCache::MakeKey(const Request& request)
+{
+    uint32_t channels = 0;
+    for (const ChannelFlagValue flag : request.m_Spec.m_Channels.GetAllEnabledFlags())
+        channels |= static_cast<uint32_t>(flag);
+
+    return { request.m_Path, request.m_Spec.m_Rate, channels, request.m_Encoding };
+}
+
+SoundCache::Entries::iterator SoundCache::FindOrAdd(std::unique_lock<std::mutex>& lock, const Key& key)
+{
+    while (true)
+    {
+        const auto entry = m_Entries.find(key);
+        if (entry == m_Entries.end())
+            return m_Entries.emplace(key, Entry {}).first;
+
+        if (entry->second.m_Sound)
+            return entry;
+
+        // once it's done the entry either holds the sound, or is gone because decoding failed
+        m_Decoded.wait(lock);
+    }
+}
+
+std::shared_ptr<const DecodedSound> SoundCache::Decode(const Request& request) const
+{
+    std::shared_ptr<AudioSource> source = m_Decoder(request.m_Path);
+    const SignalSpec spec = source->Spec();
+
+    if (spec.m_Channels.GetAllEnabledFlags() != request.m_Spec.m_Channels.GetAllEnabledFlags())
+        source = std::make_shared<SourceRemixer>(source, request.m_Spec.m_Channels);
+
+    if (spec.m_Rate != request.m_Spec.m_Rate)
+    {
+        // resampled in float, so that the only requantization is the dithered one at the end
+        if (source->Encoding() != AudioEncoding::Float32)
+            source = std::make_shared<SourceReencoder>(source, AudioEncoding::Float32);
+
+        source = std::make_shared<SourceResampler>(source, request.m_Spec, m_Quality);
+    }
+
+    if (source->Encoding() != request.m_Encoding)
+        source = std::make_shared<SourceReencoder>(source, request.m_Encoding, DitherMode::Tpdf);
+
+    std::vector<uint8_t> samples;
+    if (const auto total = source->TotalSamples())
+        samples.reserve(*total * request.m_Spec.m_Channels.Count() * GetEffectiveEncodingSize(request.m_Encoding));
+
+    AudioBuffer frame;
+    AudioBuffer scratch;
+    while (source->NextFrameInto(frame))
+    {
+        const AudioBuffer& interleaved = frame.Interleaved(scratch);
+        samples.insert(samples.end(), interleaved.Data(), interleaved.Data() + interleaved.BufferLength());
+    }
+
+    // the budget counts what the sound holds, not what got reserved for it
+    samples.shrink_to_fit();
+
+    return std::make_shared<const DecodedSound>(std::move(samples), source->Spec(), source->Encoding());
+}
+
+void SoundCache::Insert(const Entries::iterator entry, std::shared_ptr<const DecodedSound> sound)
+{
+    // a sound larger than the whole budget isn't kept, rather than flushing everything else for it
+    if (sound->ByteCount() > m_BudgetBytes)
+    {
+        m_Entries.erase(entry);
+        ++m_Stats.m_Evictions;
+        return;
+    }
+
+    m_Bytes += sound->ByteCount();
+
+    entry->second.m_Sound = std::move(sound);
+    m_Uses.push_front(&entry->first);
+    entry->second.m_Use = m_Uses.begin();
+
+    EvictToBudget();
+}
+
+void SoundCache::EvictToBudget()
+{
+    while (m_Bytes > m_BudgetBytes && !m_Uses.empty())
+    {
+        const auto entry = m_Entries.find(*m_Uses.back());
+        m_Uses.pop_back();
+
+        m_Bytes -= entry->second.m_Sound->ByteCount();
+        m_Entries.erase(entry);
+        ++m_Stats.m_Evictions;
+    }
+}
+
+void SoundCache::Touch(Entry& entry)
+{
+    m_Uses.splice(m_Uses.begin(), m_Uses, entry.m_Use);
+}
+
+void SoundCache::PreloadLoop()
+{
+    std::unique_lock lock(m_Mutex);
+
+    while (true)
+    {
+        m_PreloadWake.wait(lock, [this] { return m_Stopping || !m_PreloadQueue.empty(); });
+        if (m_Stopping)
+            return;
+
+        const Request request = std::move(m_PreloadQueue.front());
+        m_PreloadQueue.pop_front();
+
+        const Key key = MakeKey(request);
+
+        // a Get() may have decoded it, or be decoding it, since it got queued
+        if (!m_Entries.contains(key))
+        {
+            const auto entry = m_Entries.emplace(key, Entry {}).first;
+            lock.unlock();
+
+            std::shared_ptr<const DecodedSound> sound;
+            try
+            {
+                sound = Decode(request);
+            }
+            catch (...)
+            {
+            }
+
+            lock.lock();
+            if (sound)
+            {
+                Insert(entry, std::move(sound));
+                ++m_Stats.m_Preloads;
+            }
+            else
+            {
+                m_Entries.erase(entry);
+                ++m_Stats.m_PreloadFailures;
+            }
+
+            m_Decoded.notify_all();
+        }
+
+        if (--m_PreloadsPending == 0)
+            m_PreloadsDone.notify_all();
+    }
+}
@@ -0,0 +1,205 @@
+#ifndef SOUNDCACHE_H
+#define SOUNDCACHE_H
+
+#include "AudioSource.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+// The samples of a whole sound, decoded and converted once. Immutable, so any number of voices can
+// play it at the same time.
+class DecodedSound
+{
+public:
+    DecodedSound(std::vector<uint8_t> samples, SignalSpec spec, AudioEncoding encoding);
+
+    [[nodiscard]] SignalSpec Spec() const noexcept { return m_Spec; }
+    [[nodiscard]] AudioEncoding Encoding() const noexcept { return m_Encoding; }
+
+    [[nodiscard]] size_t FrameCount() const noexcept { return m_FrameCount; }
+    [[nodiscard]] size_t ByteCount() const noexcept { return m_Samples.size(); }
+    [[nodiscard]] const uint8_t* Data() const noexcept { return m_Samples.data(); }
+
+private:
+    std::vector<uint8_t> m_Samples;
+    SignalSpec m_Spec;
+    AudioEncoding m_Encoding;
+    size_t m_FrameCount;
+};
+
+// Plays a DecodedSound. Frames alias the sound's samples rather than copying them, and keep it alive
+// for as long as they're around, even once the cache has evicted it.
+class DecodedSoundSource : public AudioSource
+{
+public:
+    // frameLength is the number of frames handed out per NextFrame(), NextFrameUpTo() may ask for fewer
+    explicit DecodedSoundSource(std::shared_ptr<const DecodedSound> sound, size_t frameLength = 4096);
+
+    SignalSpec Spec() override { return m_Sound->Spec(); }
+    AudioEncoding Encoding() override { return m_Sound->Encoding(); }
+
+    std::optional<size_t> TotalSamples() override { return m_Sound->FrameCount(); }
+    std::optional<size_t> CurrentSample() override { return m_Position; }
+
+    std::optional<AudioBuffer> NextFrame() override;
+    bool NextFrameUpTo(AudioBuffer& frame, size_t maxFrames) override;
+
+    bool IsInfallible() override { return true; }
+    bool IsSeekable() override { return true; }
+
+protected:
+    void SeekTo(size_t sample) override { m_Position = std::min(sample, m_Sound->FrameCount()); }
+    bool DoNextFrameInto(AudioBuffer& frame) override;
+
+private:
+    std::shared_ptr<const DecodedSound> m_Sound;
+    size_t m_FrameLength;
+    size_t m_Position = 0;
+};
+
+struct SoundCacheStats
+{
+    // Get calls served by a sound already decoded, or being decoded by someone else
+    uint64_t m_Hits = 0;
+    // Get calls which had to decode the sound themselves
+    uint64_t m_Misses = 0;
+    // sounds dropped to stay within the budget, including ones too large to be kept at all
+    uint64_t m_Evictions = 0;
+    // sounds decoded by the preload thread, and preloads which failed
+    uint64_t m_Preloads = 0;
+    uint64_t m_PreloadFailures = 0;
+
+    size_t m_Sounds = 0;
+    size_t m_Bytes = 0;
+    size_t m_BudgetBytes = 0;
+};
+
+// opens the file a sound gets decoded from
+using SoundDecoder = std::function<std::shared_ptr<AudioSource>(const std::string& path)>;
+
+/*! \brief Decoded sounds, e.g. short effects played over and over, keyed by path and the format they
+           were converted to.
+
+    A sound gets decoded and converted to the requested rate, layout and encoding once, and then
+    shared by every voice playing it. Sounds are kept within a byte budget, the least recently used
+    going first. Voices still playing an evicted sound keep it alive, the budget only covers what the
+    cache holds on to.
+
+    Preload() decodes on a background thread, so that the first Get() doesn't have to. A Get() for a
+    sound being decoded waits for it rather than decoding it again. All of it is safe to call from
+    any thread, but a miss decodes the whole file, so keep Get() off the audio thread for sounds which
+    might not be cached.
+*/
+class SoundCache
+{
+public:
+    /*!
+        \param decoder opens the files, OpenFile() by default
+    */
+    explicit SoundCache(size_t budgetBytes, ResamplerQuality quality = ResamplerQuality::High,
+                        SoundDecoder decoder = nullptr);
+
+    SoundCache(const SoundCache&) = delete;
+    SoundCache& operator=(const SoundCache&) = delete;
+
+    // drops preloads not started yet, and waits for the one running
+    ~SoundCache();
+
+    // WavSource for .wav, OpusSource for anything else
+    static std::shared_ptr<AudioSource> OpenFile(const std::string& path);
+
+    // The sound at path in the given format, decoded on this thread unless it's cached. Throws when it
+    // can't be decoded.
+    [[nodiscard]] std::shared_ptr<const DecodedSound> Get(const std::string& path, SignalSpec spec,
+                                                          AudioEncoding encoding);
+
+    // a new voice playing the sound, see Get()
+    [[nodiscard]] std::shared_ptr<AudioSource> Play(const std::string& path, SignalSpec spec, AudioEncoding encoding);
+
+    // Queues the sound to be decoded on the background thread. A sound already cached counts as just
+    // used instead. Failures only show up in the stats, the next Get() tries again and throws.
+    void Preload(const std::string& path, SignalSpec spec, AudioEncoding encoding);
+
+    // blocks until every queued preload has finished
+    void WaitForPreloads();
+
+    // evicts right away when the new budget is smaller than what's cached
+    void SetBudget(size_t budgetBytes);
+
+    // drops every cached sound, voices playing them keep them alive
+    void Clear();
+
+    [[nodiscard]] SoundCacheStats Stats();
+
+private:
+    // path, rate, channel flags, encoding
+    using Key = std::tuple<std::string, uint32_t, uint32_t, AudioEncoding>;
+
+    struct Entry
+    {
+        // null while the sound is being decoded
+        std::shared_ptr<const DecodedSound> m_Sound;
+        // where the sound is in m_Uses, once it's decoded
+        std::list<const Key*>::iterator m_Use;
+    };
+
+    using Entries = std::map<Key, Entry>;
+
+    struct Request
+    {
+        std::string m_Path;
+        SignalSpec m_Spec;
+        AudioEncoding m_Encoding;
+    };
+
+    static Key MakeKey(const Request& request);
+
+    // Waits for a decode of the key in flight, then either hands out the entry holding the sound, or
+    // adds an entry to be decoded by the caller. Needs the lock.
+    Entries::iterator FindOrAdd(std::unique_lock<std::mutex>& lock, const Key& key);
+
+    // decodes and converts the whole sound, without the lock
+    [[nodiscard]] std::shared_ptr<const DecodedSound> Decode(const Request& request) const;
+
+    // caches the sound decoded for the entry, and evicts down to the budget
+    void Insert(Entries::iterator entry, std::shared_ptr<const DecodedSound> sound);
+    void EvictToBudget();
+    void Touch(Entry& entry);
+
+    void PreloadLoop();
+
+    ResamplerQuality m_Quality;
+    SoundDecoder m_Decoder;
+
+    std::mutex m_Mutex;
+    // signalled whenever a decode finishes, successfully or not
+    std::condition_variable m_Decoded;
+    std::condition_variable m_PreloadWake;
+    std::condition_variable m_PreloadsDone;
+
+    Entries m_Entries;
+    // keys of the decoded sounds, most recently used first
+    std::list<const Key*> m_Uses;
+    size_t m_Bytes = 0;
+    size_t m_BudgetBytes;
+
+    std::deque<Request> m_PreloadQueue;
+    // queued preloads plus the one running
+    size_t m_PreloadsPending = 0;
+    bool m_Stopping = false;
+    SoundCacheStats m_Stats;
+
+    std::thread m_PreloadThread;
+};
+
+#endif //SOUNDCACHE_H
@@ -0,0 +1,567 @@
+#include "Spatializer.h"
+#include "SampleConversions.h"
+#include "SimdKernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numbers>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace
+{
+    std::array<float, 3> Normalized(const std::array<float, 3>& v)
+    {
+        const float length = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+        if (length == 0.f)
+            throw std::runtime_error("Listener vectors mustn't be zero or parallel");
+
+        return { v[0] / length, v[1] / length, v[2] / length };
+    }
+
+    std::array<float, 3> Cross(const std::array<float, 3>& a, const std::array<float, 3>& b)
+    {
+        return { a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0] };
+    }
+}
+
+HrirSet::HrirSet(const uint32_t rate, std::vector<float> taps, const size_t tapCount, const size_t azimuthCount)
+    : m_Rate(rate), m_Taps(std::move(taps)), m_TapCount(tapCount), m_AzimuthCount(azimuthCount)
+{
+}
+
+HrirSet::HrirSet(const AudioBuffer& responses, const size_t azimuthCount)
+    : m_Rate(responses.Spec().m_Rate), m_TapCount(0), m_AzimuthCount(azimuthCount)
+{
+    if (responses.Spec().m_Channels.Count() != 2 || responses.IsPlanar())
+        throw std::runtime_error("HRIRs have to be interleaved stereo");
+
+    const size_t frames = responses.FrameCount();
+    if (azimuthCount == 0 || frames == 0 || frames % azimuthCount != 0)
+    {
+        throw std::runtime_error("HRIRs of " + std::to_string(frames) + " frames can't be split into " +
+                                 std::to_string(azimuthCount) + " responses");
+    }
+
+    m_TapCount = frames / azimuthCount;
+
+    std::vector<float> samples(responses.SampleCount());
+    ConvertSampleBuffer(responses.Data(), responses.Encoding(), samples.data(), AudioEncoding::Float32, samples.size());
+
+    m_Taps.resize(samples.size());
+    for (size_t azimuth = 0; azimuth < azimuthCount; ++azimuth)
+    {
+        for (size_t i = 0; i < m_TapCount; ++i)
+        {
+            const size_t frame = azimuth * m_TapCount + i;
+            m_Taps[2 * azimuth * m_TapCount + i] = samples[2 * frame];
+            m_Taps[(2 * azimuth + 1) * m_TapCount + i] = samples[2 * frame + 1];
+        }
+    }
+}
+
+std::shared_ptr<const HrirSet> HrirSet::SphericalHead(const uint32_t rate, const size_t azimuthCount)
+{
+    if (rate == 0 || azimuthCount == 0)
+        throw std::runtime_error("Spherical head HRIRs need a rate and at least one azimuth");
+
+    // an average head radius in metres, and the speed of sound
+    constexpr double RADIUS = 0.0875;
+    constexpr double SPEED = 343.;
+    // the shadow at its deepest, and the angle from the ear where it is
+    constexpr double MIN_ALPHA = 0.1;
+    constexpr double MIN_ALPHA_ANGLE = 150. / 180. * std::numbers::pi;
+    // half the width of the windowed sinc placing the fractional delay
+    constexpr size_t HALF_WIDTH = 4;
+
+    const double radiusDelay = RADIUS / SPEED * rate;
+    const double maxDelay = radiusDelay * (1. + std::numbers::pi / 2.);
+
+    // The head shadow is a one-pole/one-zero shelf at w0 = c / a, bilinear transformed. Its pole
+    // decides how long the tail gets, cut where it has fallen by 40 dB.
+    const double w0 = SPEED / RADIUS;
+    const double k = 2. * rate;
+    const double pole = (k - 2. * w0) / (k + 2. * w0);
+    const auto tail = static_cast<size_t>(std::ceil(std::log(1e-2) / std::log(pole)));
+    const size_t tapCount = static_cast<size_t>(std::ceil(maxDelay)) + 2 * HALF_WIDTH + tail;
+
+    std::vector<float> taps(2 * azimuthCount * tapCount);
+    std::vector<double> impulse(tapCount);
+
+    for (size_t azimuth = 0; azimuth < azimuthCount; ++azimuth)
+    {
+        const double direction = 2. * std::numbers::pi * static_cast<double>(azimuth) / static_cast<double>(azimuthCount);
+
+        for (size_t ear = 0; ear < 2; ++ear)
+        {
+            // angle between the source and the ear, the left one at -90 degrees and the right one at 90
+            const double earDirection = ear == 0 ? -std::numbers::pi / 2. : std::numbers::pi / 2.;
+            const double incidence = std::abs(std::remainder(direction - earDirection, 2. * std::numbers::pi));
+
+            // Woodworth's path around the head, relative to the ear closest to the source
+            const double path = incidence < std::numbers::pi / 2. ? 1. - std::cos(incidence)
+                                                                  : 1. + incidence - std::numbers::pi / 2.;
+            const double delay = HALF_WIDTH + radiusDelay * path;
+
+            for (size_t i = 0; i < tapCount; ++i)
+            {
+                const double t = static_cast<double>(i) - delay;
+                const double sinc = t == 0. ? 1. : std::sin(std::numbers::pi * t) / (std::numbers::pi * t);
+                const double window = std::abs(t) < HALF_WIDTH ? 0.5 + 0.5 * std::cos(std::numbers::pi * t / HALF_WIDTH) : 0.;
+                impulse[i] = sinc * window;
+            }
+
+            const double alpha = 1. + MIN_ALPHA / 2. + (1. - MIN_ALPHA / 2.) * std::cos(incidence / MIN_ALPHA_ANGLE * std::numbers::pi);
+            const double b0 = (2. * w0 + alpha * k) / (2. * w0 + k);
+            const double b1 = (2. * w0 - alpha * k) / (2. * w0 + k);
+
+            // both ears at unity are 3 dB louder than panning at the centre, scaled to the same power
+            float* out = taps.data() + (2 * azimuth + ear) * tapCount;
+            double previousIn = 0.;
+            double previousOut = 0.;
+            for (size_t i = 0; i < tapCount; ++i)
+            {
+                previousOut = b0 * impulse[i] + b1 * previousIn + pole * previousOut;
+                previousIn = impulse[i];
+                out[i] = static_cast<float>(previousOut * std::numbers::sqrt2 / 2.);
+            }
+        }
+    }
+
+    return std::shared_ptr<const HrirSet>(new HrirSet(rate, std::move(taps), tapCount, azimuthCount));
+}
+
+size_t HrirSet::Nearest(const float azimuth) const noexcept
+{
+    const float turns = azimuth / (2.f * std::numbers::pi_v<float>);
+    const auto index = static_cast<long>(std::lround(turns * static_cast<float>(m_AzimuthCount)));
+    const auto count = static_cast<long>(m_AzimuthCount);
+
+    return static_cast<size_t>((index % count + count) % count);
+}
+
+Spatializer::Spatializer(const uint32_t rate, const size_t maxEmitters, const size_t frameLength,
+                         SpatializerOptions options, const size_t commandCapacity)
+    : m_Spec { rate, ChannelLayout(ChannelLayoutType::STEREO) }, m_FrameLength(frameLength),
+      m_Options(std::move(options)), m_Commands(commandCapacity), m_Finished(maxEmitters), m_Slots(maxEmitters),
+      m_X(maxEmitters), m_Y(maxEmitters), m_Z(maxEmitters), m_EmitterGains(maxEmitters), m_Voices(maxEmitters)
+{
+    if (rate == 0 || frameLength == 0 || maxEmitters == 0 || maxEmitters > UINT16_MAX + 1)
+        throw std::runtime_error("Spatializer needs a rate, a non-zero frame length and 1 to 65536 emitters");
+
+    if (!(m_Options.m_ReferenceDistance > 0.f) || m_Options.m_MaxDistance < m_Options.m_ReferenceDistance ||
+        m_Options.m_Rolloff < 0.f)
+    {
+        throw std::runtime_error("Spatializer needs 0 < reference distance <= max distance and a rolloff >= 0");
+    }
+
+    if (m_Options.m_LimiterThreshold.has_value() &&
+        (*m_Options.m_LimiterThreshold < 0.f || *m_Options.m_LimiterThreshold >= 1.f))
+    {
+        throw std::runtime_error("Limiter threshold must be in [0, 1)");
+    }
+
+    size_t history = 0;
+    if (m_Options.m_Hrirs)
+    {
+        if (m_Options.m_Hrirs->Rate() != rate)
+        {
+            throw std::runtime_error("HRIRs at " + std::to_string(m_Options.m_Hrirs->Rate()) +
+                                     " don't fit a spatializer at " + std::to_string(rate));
+        }
+
+        history = m_Options.m_Hrirs->TapCount() - 1;
+        for (Voice& voice : m_Voices)
+            voice.m_History.resize(history);
+    }
+
+    m_Input.resize(history + frameLength);
+    m_Ears.resize(4 * frameLength);
+
+    for (GainSet& set : m_GainSets)
+    {
+        set.m_Generations.resize(maxEmitters);
+        set.m_Left.resize(maxEmitters);
+        set.m_Right.resize(maxEmitters);
+        set.m_Gains.resize(maxEmitters);
+        set.m_Hrirs.resize(maxEmitters);
+    }
+
+    // handed out from the back, lowest first
+    m_FreeSlots.reserve(maxEmitters);
+    for (size_t i = maxEmitters; i > 0; --i)
+        m_FreeSlots.push_back(static_cast<uint32_t>(i - 1));
+
+    SetListener({});
+}
+
+EmitterId Spatializer::MakeId(const uint32_t slot, const uint16_t generation) noexcept
+{
+    // generations start at 1, so no id is 0
+    return static_cast<EmitterId>(generation) << 16 | slot;
+}
+
+std::optional<uint32_t> Spatializer::SlotOf(const EmitterId id) const noexcept
+{
+    const uint32_t slot = id & 0xffff;
+    const auto generation = static_cast<uint16_t>(id >> 16);
+
+    if (slot >= m_Slots.size() || !m_Slots[slot].m_Taken || m_Slots[slot].m_Generation != generation)
+        return std::nullopt;
+
+    return slot;
+}
+
+EmitterId Spatializer::Play(std::shared_ptr<const DecodedSound> sound, const std::array<float, 3>& position,
+                            const float gain, const bool loop)
+{
+    if (sound->Spec().m_Rate != m_Spec.m_Rate)
+    {
+        throw std::runtime_error("Spatializer plays sounds at its own rate (" + std::to_string(m_Spec.m_Rate) +
+                                 "), not at " + std::to_string(sound->Spec().m_Rate));
+    }
+
+    if (sound->Spec().m_Channels.Count() != 1)
+        throw std::runtime_error("Spatializer only places mono sounds");
+
+    ReleaseFinished();
+
+    if (m_FreeSlots.empty())
+    {
+        m_RejectedCount.fetch_add(1, std::memory_order_relaxed);
+        return 0;
+    }
+
+    const uint32_t slot = m_FreeSlots.back();
+    Slot& state = m_Slots[slot];
+
+    m_X[slot] = position[0];
+    m_Y[slot] = position[1];
+    m_Z[slot] = position[2];
+    m_EmitterGains[slot] = gain;
+
+    // the voice starts out at its gains rather than ramping up from silence
+    const uint16_t generation = state.m_Generation == UINT16_MAX ? 1 : state.m_Generation + 1;
+    if (!m_Commands.Push({ .m_Play = true, .m_Slot = slot, .m_Generation = generation, .m_Sound = std::move(sound),
+                           .m_Loop = loop, .m_Gains = GainsOf(slot) }))
+    {
+        m_RejectedCount.fetch_add(1, std::memory_order_relaxed);
+        return 0;
+    }
+
+    m_FreeSlots.pop_back();
+    state.m_Generation = generation;
+    state.m_Taken = true;
+
+    return MakeId(slot, generation);
+}
+
+void Spatializer::Stop(const EmitterId id)
+{
+    ReleaseFinished();
+
+    // a full queue drops the stop, the game can try again on its next frame
+    if (const auto slot = SlotOf(id))
+        m_Commands.Push({ .m_Slot = *slot, .m_Generation = m_Slots[*slot].m_Generation });
+}
+
+void Spatializer::SetPosition(const EmitterId id, const std::array<float, 3>& position)
+{
+    if (const auto slot = SlotOf(id))
+    {
+        m_X[*slot] = position[0];
+        m_Y[*slot] = position[1];
+        m_Z[*slot] = position[2];
+    }
+}
+
+void Spatializer::SetGain(const EmitterId id, const float gain)
+{
+    if (const auto slot = SlotOf(id))
+        m_EmitterGains[*slot] = gain;
+}
+
+void Spatializer::SetListener(const ListenerPose& listener)
+{
+    const auto front = Normalized(listener.m_Front);
+    const auto right = Normalized(Cross(front, listener.m_Up));
+    const auto up = Cross(right, front);
+
+    std::copy(listener.m_Position.begin(), listener.m_Position.end(), m_Listener.begin());
+    std::copy(right.begin(), right.end(), m_Listener.begin() + 3);
+    std::copy(front.begin(), front.end(), m_Listener.begin() + 6);
+    std::copy(up.begin(), up.end(), m_Listener.begin() + 9);
+}
+
+void Spatializer::Update()
+{
+    ReleaseFinished();
+
+    GainSet& set = m_GainSets[m_Back];
+
+    // all slots in one pass, free ones included: cheaper than gathering the taken ones
+    SpatialGains(m_X.data(), m_Y.data(), m_Z.data(), m_EmitterGains.data(), m_Slots.size(), m_Listener.data(),
+                 m_Options.m_ReferenceDistance, m_Options.m_MaxDistance, m_Options.m_Rolloff, set.m_Left.data(),
+                 set.m_Right.data(), set.m_Gains.data());
+
+    for (uint32_t slot = 0; slot < m_Slots.size(); ++slot)
+    {
+        // no emitter has generation 0, so the audio thread leaves free slots alone
+        set.m_Generations[slot] = m_Slots[slot].m_Taken ? m_Slots[slot].m_Generation : 0;
+
+        if (m_Options.m_Hrirs && m_Slots[slot].m_Taken)
+            set.m_Hrirs[slot] = HrirFor(slot);
+    }
+
+    m_Back = m_Latest.exchange(m_Back | FRESH, std::memory_order_acq_rel) & ~FRESH;
+}
+
+bool Spatializer::IsPlaying(const EmitterId id) const noexcept
+{
+    return SlotOf(id).has_value();
+}
+
+SpatializerStats Spatializer::Stats() const noexcept
+{
+    return {
+        m_StartedCount.load(std::memory_order_relaxed),
+        m_FinishedCount.load(std::memory_order_relaxed),
+        m_RejectedCount.load(std::memory_order_relaxed),
+        m_ActiveEmitters.load(std::memory_order_relaxed),
+    };
+}
+
+void Spatializer::ReleaseFinished()
+{
+    Finished finished;
+    while (m_Finished.Pop(finished))
+    {
+        finished.m_Sound.reset();
+        m_Slots[finished.m_Slot].m_Taken = false;
+        m_FreeSlots.push_back(finished.m_Slot);
+    }
+}
+
+Spatializer::Gains Spatializer::GainsOf(const uint32_t slot) const noexcept
+{
+    Gains gains;
+    SpatialGains(&m_X[slot], &m_Y[slot], &m_Z[slot], &m_EmitterGains[slot], 1, m_Listener.data(),
+                 m_Options.m_ReferenceDistance, m_Options.m_MaxDistance, m_Options.m_Rolloff, &gains.m_Left,
+                 &gains.m_Right, &gains.m_Gain);
+
+    if (m_Options.m_Hrirs)
+        gains.m_Hrir = HrirFor(slot);
+
+    return gains;
+}
+
+uint32_t Spatializer::HrirFor(const uint32_t slot) const noexcept
+{
+    const float dx = m_X[slot] - m_Listener[0];
+    const float dy = m_Y[slot] - m_Listener[1];
+    const float dz = m_Z[slot] - m_Listener[2];
+
+    // projected onto the listener's horizontal plane, the responses have no elevation
+    const float side = dx * m_Listener[3] + dy * m_Listener[4] + dz * m_Listener[5];
+    const float ahead = dx * m_Listener[6] + dy * m_Listener[7] + dz * m_Listener[8];
+
+    return static_cast<uint32_t>(m_Options.m_Hrirs->Nearest(std::atan2(side, ahead)));
+}
+
+std::optional<AudioBuffer> Spatializer::NextFrame()
+{
+    AudioBuffer frame;
+    NextFrameInto(frame);
+
+    return frame;
+}
+
+bool Spatializer::DoNextFrameInto(AudioBuffer& frame)
+{
+    return NextFrameUpTo(frame, SIZE_MAX);
+}
+
+bool Spatializer::NextFrameUpTo(AudioBuffer& frame, const size_t maxFrames)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    const size_t frameCount = std::min(m_FrameLength, maxFrames);
+    const size_t sampleCount = frameCount * 2;
+
+    frame.Reformat(m_Spec, AudioEncoding::Float32, sampleCount * sizeof(float));
+    float* out = frame.View<float>().Samples().data();
+    std::fill_n(out, sampleCount, 0.f);
+
+    ApplyCommands();
+
+    if (m_Latest.load(std::memory_order_relaxed) & FRESH)
+        m_Front = m_Latest.exchange(m_Front, std::memory_order_acq_rel) & ~FRESH;
+
+    const GainSet& set = m_GainSets[m_Front];
+    const size_t history = m_Options.m_Hrirs ? m_Options.m_Hrirs->TapCount() - 1 : 0;
+
+    for (uint32_t slot = 0; slot < m_Voices.size(); ++slot)
+    {
+        Voice& voice = m_Voices[slot];
+        if (!voice.m_Active)
+            continue;
+
+        // gains from before the emitter started, or for an earlier one in the slot, hold the current ones
+        Gains target = voice.m_Gains;
+        if (set.m_Generations[slot] == voice.m_Generation)
+        {
+            target = { set.m_Left[slot], set.m_Right[slot], set.m_Gains[slot], set.m_Hrirs[slot] };
+        }
+
+        const bool playing = ReadVoice(voice, m_Input.data() + history, frameCount);
+
+        if (m_Options.m_Hrirs)
+            MixHrtf(voice, target, out, frameCount);
+        else
+            MixPanned(voice, target, out, frameCount);
+
+        if (!playing)
+        {
+            Release(voice, slot);
+            m_FinishedCount.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    if (m_Options.m_LimiterThreshold.has_value())
+        SoftLimit(out, sampleCount, *m_Options.m_LimiterThreshold);
+
+    m_Position += frameCount;
+    m_CallbackTiming.Record(std::chrono::steady_clock::now() - start);
+
+    return true;
+}
+
+void Spatializer::ApplyCommands()
+{
+    Command command;
+    while (m_Commands.Pop(command))
+    {
+        Voice& voice = m_Voices[command.m_Slot];
+
+        if (!command.m_Play)
+        {
+            if (voice.m_Active && voice.m_Generation == command.m_Generation)
+            {
+                Release(voice, command.m_Slot);
+                m_FinishedCount.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            continue;
+        }
+
+        // the game thread only reuses a slot once its voice has been released
+        voice.m_Active = true;
+        voice.m_Generation = command.m_Generation;
+        voice.m_Sound = std::move(command.m_Sound);
+        voice.m_Position = 0;
+        voice.m_Loop = command.m_Loop;
+        voice.m_Gains = command.m_Gains;
+        std::fill(voice.m_History.begin(), voice.m_History.end(), 0.f);
+
+        m_StartedCount.fetch_add(1, std::memory_order_relaxed);
+        m_ActiveEmitters.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void Spatializer::Release(Voice& voice, const uint32_t slot) noexcept
+{
+    m_Finished.Push({ slot, std::move(voice.m_Sound) });
+    voice.m_Active = false;
+
+    m_ActiveEmitters.fetch_sub(1, std::memory_order_relaxed);
+}
+
+bool Spatializer::ReadVoice(Voice& voice, float* dst, const size_t frameCount) noexcept
+{
+    const DecodedSound& sound = *voice.m_Sound;
+    const size_t frames = sound.FrameCount();
+    const size_t sampleSize = GetEffectiveEncodingSize(sound.Encoding());
+
+    size_t done = 0;
+
+    while (done < frameCount)
+    {
+        if (voice.m_Position == frames)
+        {
+            if (!voice.m_Loop || frames == 0)
+            {
+                std::fill(dst + done, dst + frameCount, 0.f);
+                return false;
+            }
+
+            voice.m_Position = 0;
+        }
+
+        const size_t count = std::min(frameCount - done, frames - voice.m_Position);
+        ConvertSampleBuffer(sound.Data() + voice.m_Position * sampleSize, sound.Encoding(), dst + done,
+                            AudioEncoding::Float32, count);
+
+        done += count;
+        voice.m_Position += count;
+    }
+
+    return true;
+}
+
+void Spatializer::MixPanned(Voice& voice, const Gains& target, float* out, const size_t frameCount) noexcept
+{
+    const auto frames = static_cast<float>(frameCount);
+    const Gains& current = voice.m_Gains;
+
+    // reaches the target on the first frame of the next call
+    MixAddMonoToStereoRamp(out, m_Input.data(), frameCount, current.m_Left, current.m_Right,
+                           (target.m_Left - current.m_Left) / frames, (target.m_Right - current.m_Right) / frames);
+
+    voice.m_Gains = target;
+}
+
+void Spatializer::MixHrtf(Voice& voice, const Gains& target, float* out, const size_t frameCount) noexcept
+{
+    const HrirSet& hrirs = *m_Options.m_Hrirs;
+    const size_t taps = hrirs.TapCount();
+    const size_t history = taps - 1;
+    const auto frames = static_cast<float>(frameCount);
+    const Gains& current = voice.m_Gains;
+
+    // the gain goes on before the filters, so that the history carries it along
+    float* input = m_Input.data() + history;
+    const float step = (target.m_Gain - current.m_Gain) / frames;
+    for (size_t i = 0; i < frameCount; ++i)
+        input[i] *= current.m_Gain + static_cast<float>(i) * step;
+
+    std::copy(voice.m_History.begin(), voice.m_History.end(), m_Input.begin());
+
+    float* left = m_Ears.data();
+    float* right = left + frameCount;
+    FirFilter(left, input, frameCount, hrirs.Left(current.m_Hrir), taps);
+    FirFilter(right, input, frameCount, hrirs.Right(current.m_Hrir), taps);
+
+    if (target.m_Hrir != current.m_Hrir)
+    {
+        // a new direction fades in over the frame rather than jumping
+        float* nextLeft = right + frameCount;
+        float* nextRight = nextLeft + frameCount;
+        FirFilter(nextLeft, input, frameCount, hrirs.Left(target.m_Hrir), taps);
+        FirFilter(nextRight, input, frameCount, hrirs.Right(target.m_Hrir), taps);
+
+        for (size_t i = 0; i < frameCount; ++i)
+        {
+            const float fade = static_cast<float>(i + 1) / frames;
+            left[i] += (nextLeft[i] - left[i]) * fade;
+            right[i] += (nextRight[i] - right[i]) * fade;
+        }
+    }
+
+    MixAddMonoToStereo(out, left, frameCount, 1.f, 0.f);
+    MixAddMonoToStereo(out, right, frameCount, 0.f, 1.f);
+
+    std::copy_n(m_Input.begin() + static_cast<std::ptrdiff_t>(frameCount), history, voice.m_History.begin());
+    voice.m_Gains = target;
+}
@@ -0,0 +1,272 @@
+#ifndef SPATIALIZER_H
+#define SPATIALIZER_H
+
+#include "AudioMetrics.h"
+#include "SoundCache.h"
+#include "SpscRingBuffer.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+// Where the listener is and which way it faces, in the game's world coordinates. The vectors don't
+// need to be normalized, front and up mustn't be parallel. See CameraPerspective::GetListenerPose().
+struct ListenerPose
+{
+    std::array<float, 3> m_Position {};
+    std::array<float, 3> m_Front { 0.f, 0.f, -1.f };
+    std::array<float, 3> m_Up { 0.f, 1.f, 0.f };
+};
+
+/*! \brief Head related impulse responses for directions around the listener in the horizontal plane,
+           one stereo pair per azimuth, all of the same length. */
+class HrirSet
+{
+public:
+    /*!
+        \param responses interleaved stereo, azimuthCount responses one after the other, for directions
+               evenly spaced clockwise (seen from above) starting straight ahead
+    */
+    HrirSet(const AudioBuffer& responses, size_t azimuthCount);
+
+    /*! \brief Responses of a rigid spherical head after Brown and Duda: the delay between the ears and
+               the shadow of the head, without the pinnae's cues. That's enough to place sounds left and
+               right, and a little in front or behind, with a few dozen taps. */
+    static std::shared_ptr<const HrirSet> SphericalHead(uint32_t rate, size_t azimuthCount = 72);
+
+    [[nodiscard]] uint32_t Rate() const noexcept { return m_Rate; }
+    [[nodiscard]] size_t TapCount() const noexcept { return m_TapCount; }
+    [[nodiscard]] size_t AzimuthCount() const noexcept { return m_AzimuthCount; }
+
+    [[nodiscard]] const float* Left(const size_t azimuth) const noexcept { return m_Taps.data() + 2 * azimuth * m_TapCount; }
+    [[nodiscard]] const float* Right(const size_t azimuth) const noexcept { return Left(azimuth) + m_TapCount; }
+
+    // the response closest to a direction given in radians clockwise from straight ahead
+    [[nodiscard]] size_t Nearest(float azimuth) const noexcept;
+
+private:
+    HrirSet(uint32_t rate, std::vector<float> taps, size_t tapCount, size_t azimuthCount);
+
+    uint32_t m_Rate;
+    // per azimuth, the left taps then the right ones
+    std::vector<float> m_Taps;
+    size_t m_TapCount;
+    size_t m_AzimuthCount;
+};
+
+struct SpatializerOptions
+{
+    // emitters within this distance play at their own gain
+    float m_ReferenceDistance = 1.f;
+    // emitters beyond this distance get no quieter
+    float m_MaxDistance = 100.f;
+    // 1 halves the gain with every doubling of the distance, 0 turns attenuation off
+    float m_Rolloff = 1.f;
+    // Convolves every emitter with the responses for its direction instead of panning it. They have to
+    // be at the spatializer's rate.
+    std::shared_ptr<const HrirSet> m_Hrirs;
+    // level above which the sum gets limited, nullopt leaves it unlimited
+    std::optional<float> m_LimiterThreshold = 0.8f;
+};
+
+// 0 is never an emitter
+using EmitterId = uint32_t;
+
+struct SpatializerStats
+{
+    uint64_t m_Started;
+    // emitters which played to their end or got stopped
+    uint64_t m_Finished;
+    // Play() calls dropped because every emitter was taken or the queue to the audio thread was full
+    uint64_t m_Rejected;
+    size_t m_ActiveEmitters;
+};
+
+/*! \brief Places mono DecodedSounds around a listener, mixing them into stereo with distance attenuation
+           and equal-power panning, or HRTF convolution.
+
+    Positions and gains are kept as arrays per field on the game thread. Update(), called once per game
+    frame, works out the gains of every emitter in one SIMD pass and hands them to the audio thread
+    through a triple buffer, so that neither side ever waits for the other and the audio thread always
+    picks up the latest set. Each voice then ramps from its previous gains to the new ones over its next
+    frame, sample by sample, so that moving emitters don't click. With HRTF, a change of direction
+    crossfades from the old responses to the new ones over the frame instead.
+
+    Starting and stopping emitters goes through wait-free queues as in the VoiceEngine, and sounds come
+    back to the game thread to be released there: pulling frames neither allocates nor locks.
+
+    Everything but the AudioSource methods and Stats() has to be called from a single thread, the frames
+    pulled from another.
+*/
+class Spatializer : public AudioSource
+{
+public:
+    /*!
+        \param rate rate of the mix and of the sounds played, the layout is stereo
+        \param maxEmitters emitters playing at once
+        \param frameLength frames produced by every NextFrame(), NextFrameUpTo() may ask for fewer
+        \param commandCapacity starts and stops which can be queued between two frames
+    */
+    Spatializer(uint32_t rate, size_t maxEmitters = 256, size_t frameLength = 512, SpatializerOptions options = {},
+                size_t commandCapacity = 256);
+
+    // Game thread: starts playing a mono sound at position. Returns 0 when it got dropped. Throws when the
+    // sound isn't mono or not at the spatializer's rate.
+    EmitterId Play(std::shared_ptr<const DecodedSound> sound, const std::array<float, 3>& position, float gain = 1.f,
+                   bool loop = false);
+
+    // Game thread. Emitters which have already ended are ignored. Position and gain changes take effect
+    // with the next Update().
+    void Stop(EmitterId id);
+    void SetPosition(EmitterId id, const std::array<float, 3>& position);
+    void SetGain(EmitterId id, float gain);
+    void SetListener(const ListenerPose& listener);
+
+    // Game thread: works out the gains of every emitter and publishes them to the audio thread, and
+    // releases the sounds of emitters which have ended. Call it once per game frame.
+    void Update();
+
+    // game thread, false once the emitter has ended and Update() has seen it
+    [[nodiscard]] bool IsPlaying(EmitterId id) const noexcept;
+
+    // safe to call from any thread
+    [[nodiscard]] SpatializerStats Stats() const noexcept;
+    // time NextFrameUpTo() takes, recorded on every call
+    [[nodiscard]] DurationHistogramSnapshot CallbackTiming() const noexcept { return m_CallbackTiming.Snapshot(); }
+
+    [[nodiscard]] size_t MaxEmitters() const noexcept { return m_Slots.size(); }
+
+    SignalSpec Spec() override { return m_Spec; }
+    AudioEncoding Encoding() override { return AudioEncoding::Float32; }
+
+    std::optional<size_t> TotalSamples() override { return std::nullopt; }
+    std::optional<size_t> CurrentSample() override { return m_Position; }
+
+    std::optional<AudioBuffer> NextFrame() override;
+    bool NextFrameUpTo(AudioBuffer& frame, size_t maxFrames) override;
+
+    // plays silence when no emitter is playing
+    bool IsInfallible() override { return true; }
+
+protected:
+    bool DoNextFrameInto(AudioBuffer& frame) override;
+
+private:
+    struct Gains
+    {
+        float m_Left = 0.f;
+        float m_Right = 0.f;
+        // with HRTF, the attenuated gain and the response to convolve with
+        float m_Gain = 0.f;
+        uint32_t m_Hrir = 0;
+    };
+
+    struct Command
+    {
+        bool m_Play = false;
+        uint32_t m_Slot = 0;
+        uint16_t m_Generation = 0;
+        std::shared_ptr<const DecodedSound> m_Sound;
+        bool m_Loop = false;
+        Gains m_Gains;
+    };
+
+    struct Finished
+    {
+        uint32_t m_Slot = 0;
+        std::shared_ptr<const DecodedSound> m_Sound;
+    };
+
+    // the gains of every slot as of one Update(), tagged with the generation of the emitter they're for
+    struct GainSet
+    {
+        std::vector<uint16_t> m_Generations;
+        std::vector<float> m_Left;
+        std::vector<float> m_Right;
+        std::vector<float> m_Gains;
+        std::vector<uint32_t> m_Hrirs;
+    };
+
+    // game thread side of an emitter slot
+    struct Slot
+    {
+        // bumped whenever the slot gets reused, so that stale commands and gains can be told apart
+        uint16_t m_Generation = 0;
+        bool m_Taken = false;
+    };
+
+    struct Voice
+    {
+        bool m_Active = false;
+        uint16_t m_Generation = 0;
+        std::shared_ptr<const DecodedSound> m_Sound;
+        size_t m_Position = 0;
+        bool m_Loop = false;
+        // the gains reached at the end of the last frame
+        Gains m_Gains;
+        // the last TapCount() - 1 input samples, with HRTF
+        std::vector<float> m_History;
+    };
+
+    [[nodiscard]] static EmitterId MakeId(uint32_t slot, uint16_t generation) noexcept;
+    // the slot of a live emitter, nullopt for 0 and ids of ended ones
+    [[nodiscard]] std::optional<uint32_t> SlotOf(EmitterId id) const noexcept;
+
+    // game thread
+    void ReleaseFinished();
+    [[nodiscard]] Gains GainsOf(uint32_t slot) const noexcept;
+    [[nodiscard]] uint32_t HrirFor(uint32_t slot) const noexcept;
+
+    // audio thread
+    void ApplyCommands();
+    void Release(Voice& voice, uint32_t slot) noexcept;
+    // reads up to frameCount mono samples into dst, zero filling past the end, returns false once the
+    // voice has ended
+    bool ReadVoice(Voice& voice, float* dst, size_t frameCount) noexcept;
+    void MixPanned(Voice& voice, const Gains& target, float* out, size_t frameCount) noexcept;
+    void MixHrtf(Voice& voice, const Gains& target, float* out, size_t frameCount) noexcept;
+
+    SignalSpec m_Spec;
+    size_t m_FrameLength;
+    SpatializerOptions m_Options;
+
+    SpscQueue<Command> m_Commands;
+    // one per slot at most, as a slot only gets reused once its sound is back
+    SpscQueue<Finished> m_Finished;
+
+    // game thread: the emitters, as arrays per field for the gain kernel
+    std::vector<Slot> m_Slots;
+    std::vector<uint32_t> m_FreeSlots;
+    std::vector<float> m_X;
+    std::vector<float> m_Y;
+    std::vector<float> m_Z;
+    std::vector<float> m_EmitterGains;
+    // position then right, front and up unit vectors
+    std::array<float, 12> m_Listener {};
+
+    // Triple buffer: the game thread fills m_GainSets[m_Back] and swaps it into m_Latest, the audio
+    // thread swaps m_Front out for it whenever the fresh bit is set.
+    static constexpr uint32_t FRESH = 4;
+    std::array<GainSet, 3> m_GainSets;
+    std::atomic<uint32_t> m_Latest = 1;
+    uint32_t m_Back = 0;
+    uint32_t m_Front = 2;
+
+    // audio thread
+    std::vector<Voice> m_Voices;
+    std::vector<float> m_Input;
+    std::vector<float> m_Ears;
+    size_t m_Position = 0;
+
+    std::atomic<uint64_t> m_StartedCount = 0;
+    std::atomic<uint64_t> m_FinishedCount = 0;
+    std::atomic<uint64_t> m_RejectedCount = 0;
+    std::atomic<size_t> m_ActiveEmitters = 0;
+
+    DurationHistogram m_CallbackTiming;
+};
+
+#endif //SPATIALIZER_H
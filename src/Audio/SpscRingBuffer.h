@@ -0,0 +1,161 @@
+#ifndef SPSCRINGBUFFER_H
+#define SPSCRINGBUFFER_H
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+// Wait-free single-producer/single-consumer byte ring. Write() may only be called from one
+// thread and Read() from one other thread; neither ever blocks or loops.
+class SpscByteRing
+{
+public:
+    // capacity gets rounded up to a power of two
+    explicit SpscByteRing(size_t capacity)
+        : m_Buffer(std::bit_ceil(std::max<size_t>(capacity, 1))), m_Mask(m_Buffer.size() - 1) {}
+
+    SpscByteRing(const SpscByteRing&) = delete;
+    SpscByteRing& operator=(const SpscByteRing&) = delete;
+
+    // producer side, writes as much of data as fits and returns the byte count written
+    size_t Write(const uint8_t* data, size_t length) noexcept
+    {
+        const size_t head = m_Head.load(std::memory_order_relaxed);
+
+        if (m_Buffer.size() - (head - m_CachedTail) < length)
+            m_CachedTail = m_Tail.load(std::memory_order_acquire);
+
+        const size_t count = std::min(length, m_Buffer.size() - (head - m_CachedTail));
+        CopyIn(head & m_Mask, data, count);
+
+        m_Head.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+    // consumer side, reads up to length bytes and returns the byte count read
+    size_t Read(uint8_t* data, size_t length) noexcept
+    {
+        const size_t tail = m_Tail.load(std::memory_order_relaxed);
+
+        if (m_CachedHead - tail < length)
+            m_CachedHead = m_Head.load(std::memory_order_acquire);
+
+        const size_t count = std::min(length, m_CachedHead - tail);
+        CopyOut(tail & m_Mask, data, count);
+
+        m_Tail.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+    // bytes queued, exact from either side and approximate from any other thread
+    [[nodiscard]] size_t Size() const noexcept
+    {
+        return m_Head.load(std::memory_order_acquire) - m_Tail.load(std::memory_order_acquire);
+    }
+
+    [[nodiscard]] size_t FreeSpace() const noexcept { return Capacity() - Size(); }
+    [[nodiscard]] size_t Capacity() const noexcept { return m_Buffer.size(); }
+
+    // Only safe while neither side is running.
+    void Clear() noexcept
+    {
+        m_Head.store(0, std::memory_order_relaxed);
+        m_Tail.store(0, std::memory_order_relaxed);
+        m_CachedHead = 0;
+        m_CachedTail = 0;
+    }
+
+private:
+    void CopyIn(const size_t offset, const uint8_t* data, const size_t count) noexcept
+    {
+        const size_t first = std::min(count, m_Buffer.size() - offset);
+        std::memcpy(m_Buffer.data() + offset, data, first);
+        std::memcpy(m_Buffer.data(), data + first, count - first);
+    }
+
+    void CopyOut(const size_t offset, uint8_t* data, const size_t count) const noexcept
+    {
+        const size_t first = std::min(count, m_Buffer.size() - offset);
+        std::memcpy(data, m_Buffer.data() + offset, first);
+        std::memcpy(data + first, m_Buffer.data(), count - first);
+    }
+
+    std::vector<uint8_t> m_Buffer;
+    size_t m_Mask;
+
+    // indices grow monotonically and get masked on access; each side's cache line holds its own
+    // index plus its last snapshot of the other side's, so the lines only bounce when needed
+    alignas(64) std::atomic<size_t> m_Head = 0;
+    size_t m_CachedTail = 0;
+
+    alignas(64) std::atomic<size_t> m_Tail = 0;
+    size_t m_CachedHead = 0;
+};
+
+// Wait-free single-producer/single-consumer queue of values, on the same terms as SpscByteRing. The
+// slots are constructed up front and values get moved in and out of them, so as long as moving a T
+// doesn't allocate, neither side does.
+template <typename T>
+class SpscQueue
+{
+public:
+    // capacity gets rounded up to a power of two
+    explicit SpscQueue(size_t capacity)
+        : m_Slots(std::bit_ceil(std::max<size_t>(capacity, 1))), m_Mask(m_Slots.size() - 1) {}
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // producer side, false when the queue is full and value was left alone
+    bool Push(T&& value) noexcept
+    {
+        const size_t head = m_Head.load(std::memory_order_relaxed);
+
+        if (head - m_CachedTail == m_Slots.size())
+        {
+            m_CachedTail = m_Tail.load(std::memory_order_acquire);
+            if (head - m_CachedTail == m_Slots.size())
+                return false;
+        }
+
+        m_Slots[head & m_Mask] = std::move(value);
+        m_Head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer side, false when the queue is empty
+    bool Pop(T& value) noexcept
+    {
+        const size_t tail = m_Tail.load(std::memory_order_relaxed);
+
+        if (m_CachedHead == tail)
+        {
+            m_CachedHead = m_Head.load(std::memory_order_acquire);
+            if (m_CachedHead == tail)
+                return false;
+        }
+
+        value = std::move(m_Slots[tail & m_Mask]);
+        m_Tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    [[nodiscard]] size_t Capacity() const noexcept { return m_Slots.size(); }
+
+private:
+    std::vector<T> m_Slots;
+    size_t m_Mask;
+
+    alignas(64) std::atomic<size_t> m_Head = 0;
+    size_t m_CachedTail = 0;
+
+    alignas(64) std::atomic<size_t> m_Tail = 0;
+    size_t m_CachedHead = 0;
+};
+
+#endif //SPSCRINGBUFFER_H
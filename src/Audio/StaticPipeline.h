@@ -0,0 +1,246 @@
+#ifndef STATICPIPELINE_H
+#define STATICPIPELINE_H
+
+#include "AudioSource.h"
+#include "SampleConversions.h"
+
+#include <algorithm>
+#include <concepts>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+// Stages of a StaticPipeline are function objects taking one sample and returning the sample for the
+// next stage. Besides the ones below, any callable works, lambdas included.
+
+// converts into D through the same ConvertSample<S, D> the scalar reference conversions use
+template <typename D>
+struct ConvertTo
+{
+    template <typename S>
+    D operator()(const S sample) const { return ConvertSample<S, D>(sample); }
+};
+
+// scales floating point samples, placing it after an integer sample type doesn't compile
+struct Gain
+{
+    float m_Factor;
+
+    template <std::floating_point T>
+    T operator()(const T sample) const { return sample * static_cast<T>(m_Factor); }
+};
+
+// clamps floating point samples into [-1, 1]
+struct HardClip
+{
+    template <std::floating_point T>
+    T operator()(const T sample) const { return std::clamp(sample, static_cast<T>(-1), static_cast<T>(1)); }
+};
+
+template <typename T>
+struct IsConvertTo : std::false_type {};
+
+template <typename D>
+struct IsConvertTo<ConvertTo<D>> : std::true_type {};
+
+// sample type coming out of the last of Stages when the first gets fed S
+template <typename S, typename... Stages>
+struct StageOutput
+{
+    using Type = S;
+};
+
+template <typename S, typename First, typename... Rest>
+struct StageOutput<S, First, Rest...>
+{
+    using Type = typename StageOutput<std::invoke_result_t<const First&, S>, Rest...>::Type;
+};
+
+/*! \brief Per-sample stages composed at compile time.
+
+    The stages between the first and the last conversion run fused, every sample goes through all of
+    them in one loop without any dispatch. Conversions at either end of the chain go through the SIMD
+    conversion kernels instead, which the compiler can't match by vectorizing ConvertSample, one block
+    small enough to stay in L1 at a time. The result is identical to applying the stages one by one.
+    Wrap it in a StaticPipelineSource to use it between dynamic AudioSources.
+*/
+template <typename S, typename... Stages>
+class StaticPipeline
+{
+public:
+    using Input = S;
+    using Output = typename StageOutput<S, Stages...>::Type;
+
+    explicit StaticPipeline(Stages... stages) : m_Stages(std::move(stages)...) {}
+
+    // Runs count packed samples through the stages. src and dst may be equal when Output isn't wider
+    // than Input, no alignment required.
+    void Process(const uint8_t* src, uint8_t* dst, const size_t count) const
+    {
+        // samples going into and coming out of the fused stages
+        using FusedInput = decltype(Apply<0, FUSED_BEGIN>(S {}));
+        using FusedOutput = decltype(Apply<0, FUSED_END>(S {}));
+
+        FusedInput input[BLOCK];
+        FusedOutput output[BLOCK];
+
+        for (size_t offset = 0; offset < count; offset += BLOCK)
+        {
+            const size_t n = std::min(BLOCK, count - offset);
+
+            // a block is read completely before it gets written, so in place works as long as the
+            // output isn't wider
+            if constexpr (FUSED_BEGIN == 1)
+            {
+                ConvertSampleBuffer(src + offset * sizeof(S), SampleEncoding<S>::value, input,
+                                    SampleEncoding<FusedInput>::value, n);
+            }
+            else
+            {
+                std::memcpy(input, src + offset * sizeof(S), n * sizeof(S));
+            }
+
+            for (size_t i = 0; i < n; ++i)
+                output[i] = Apply<FUSED_BEGIN, FUSED_END>(input[i]);
+
+            if constexpr (FUSED_END < sizeof...(Stages))
+            {
+                ConvertSampleBuffer(output, SampleEncoding<FusedOutput>::value, dst + offset * sizeof(Output),
+                                    SampleEncoding<Output>::value, n);
+            }
+            else
+            {
+                std::memcpy(dst + offset * sizeof(Output), output, n * sizeof(Output));
+            }
+        }
+    }
+
+private:
+    // samples per block, small enough for both block buffers to stay in L1
+    static constexpr size_t BLOCK = 256;
+
+    static constexpr size_t STAGE_COUNT = sizeof...(Stages);
+
+    // leading and trailing conversions go through the kernels, the stages in between get fused
+    static constexpr size_t FUSED_BEGIN = [] {
+        if constexpr (STAGE_COUNT > 0)
+            return IsConvertTo<std::tuple_element_t<0, std::tuple<Stages...>>>::value ? 1 : 0;
+        else
+            return 0;
+    }();
+
+    static constexpr size_t FUSED_END = [] {
+        if constexpr (STAGE_COUNT > FUSED_BEGIN)
+            return IsConvertTo<std::tuple_element_t<STAGE_COUNT - 1, std::tuple<Stages...>>>::value ? STAGE_COUNT - 1
+                                                                                                    : STAGE_COUNT;
+        else
+            return STAGE_COUNT;
+    }();
+
+    // applies the stages [I, End) to sample
+    template <size_t I, size_t End, typename T>
+    [[gnu::always_inline]] auto Apply(const T sample) const
+    {
+        if constexpr (I == End)
+            return sample;
+        else
+            return Apply<I + 1, End>(std::get<I>(m_Stages)(sample));
+    }
+
+    std::tuple<Stages...> m_Stages;
+};
+
+template <typename S, typename... Stages>
+StaticPipeline<S, Stages...> MakeStaticPipeline(Stages... stages)
+{
+    return StaticPipeline<S, Stages...>(std::move(stages)...);
+}
+
+// Runs the frames of a dynamic source through a StaticPipeline. Only the two ends go through the
+// AudioSource interface, once per frame; the source has to produce S samples.
+template <typename S, typename... Stages>
+class StaticPipelineSource : public AudioSource
+{
+public:
+    using Pipeline = StaticPipeline<S, Stages...>;
+
+    StaticPipelineSource(std::shared_ptr<AudioSource> source, Pipeline pipeline)
+        : m_Source(std::move(source)), m_Pipeline(std::move(pipeline))
+    {
+        if (m_Source->Encoding() != SampleEncoding<S>::value)
+            throw std::runtime_error("Source encoding doesn't match the static pipeline's input");
+    }
+
+    SignalSpec Spec() override { return m_Source->Spec(); }
+    AudioEncoding Encoding() override { return SampleEncoding<typename Pipeline::Output>::value; }
+
+    std::optional<size_t> TotalSamples() override { return m_Source->TotalSamples(); }
+    std::optional<size_t> CurrentSample() override { return m_Source->CurrentSample(); }
+
+    std::optional<AudioBuffer> NextFrame() override
+    {
+        AudioBuffer frame;
+        if (!NextFrameInto(frame))
+            return std::nullopt;
+
+        return frame;
+    }
+
+
+    bool NextFrameUpTo(AudioBuffer& frame, const size_t maxFrames) override
+    {
+        if (!m_Source->NextFrameUpTo(m_Input, maxFrames))
+            return false;
+
+        if (m_Input.Encoding() != SampleEncoding<S>::value)
+            throw std::runtime_error("Source produced a frame in the wrong encoding");
+
+        constexpr AudioEncoding outputEncoding = SampleEncoding<typename Pipeline::Output>::value;
+        const AudioBuffer& input = m_Input;
+
+        // samples don't depend on their neighbours, so planes go through plane by plane
+        if (input.IsPlanar())
+        {
+            const size_t frameCount = input.FrameCount();
+            frame.ReformatPlanar(input.Spec(), outputEncoding, frameCount);
+
+            for (size_t c = 0; c < input.Spec().m_Channels.Count(); ++c)
+                m_Pipeline.Process(input.PlaneData(c), frame.PlaneData(c), frameCount);
+        }
+        else
+        {
+            const size_t sampleCount = input.SampleCount();
+            frame.Reformat(input.Spec(), outputEncoding, sampleCount * sizeof(typename Pipeline::Output));
+            m_Pipeline.Process(input.Data(), frame.Data(), sampleCount);
+        }
+
+        return true;
+    }
+
+    bool IsInfallible() override { return m_Source->IsInfallible(); }
+    bool IsSeekable() override { return m_Source->IsSeekable(); }
+
+protected:
+    void SeekTo(const size_t sample) override { m_Source->Seek(sample); }
+    bool DoNextFrameInto(AudioBuffer& frame) override { return NextFrameUpTo(frame, SIZE_MAX); }
+
+private:
+    std::shared_ptr<AudioSource> m_Source;
+    Pipeline m_Pipeline;
+
+    AudioBuffer m_Input;
+};
+
+template <typename S, typename... Stages>
+std::shared_ptr<StaticPipelineSource<S, Stages...>> MakeStaticPipelineSource(std::shared_ptr<AudioSource> source,
+                                                                             Stages... stages)
+{
+    return std::make_shared<StaticPipelineSource<S, Stages...>>(std::move(source),
+                                                                MakeStaticPipeline<S>(std::move(stages)...));
+}
+
+#endif //STATICPIPELINE_H
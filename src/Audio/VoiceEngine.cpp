@@ -0,0 +1,337 @@
+#include "VoiceEngine.h"
+#include "AudioMixer.h"
+#include "SampleConversions.h"
+#include "Simd.h"
+#include "SimdKernels.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+VoiceEngine::VoiceEngine(const SignalSpec spec, const size_t maxVoices, const VoiceStealing stealing,
+                         const size_t frameLength, const size_t commandCapacity,
+                         const std::optional<float> limiterThreshold)
+    : m_Spec(spec), m_Channels(spec.m_Channels.Count()), m_Stealing(stealing), m_FrameLength(frameLength),
+      m_LimiterThreshold(limiterThreshold), m_Commands(commandCapacity),
+      m_Finished(maxVoices + m_Commands.Capacity()), m_Voices(maxVoices),
+      m_Converted(frameLength * spec.m_Channels.Count())
+{
+    if (m_Channels == 0 || frameLength == 0 || maxVoices == 0)
+        throw std::runtime_error("VoiceEngine needs at least one channel, one voice and a non-zero frame length");
+
+    if (limiterThreshold.has_value() && (*limiterThreshold < 0.f || *limiterThreshold >= 1.f))
+        throw std::runtime_error("Limiter threshold must be in [0, 1)");
+
+    for (Voice& voice : m_Voices)
+        voice.m_GainPattern.resize(SIMD_LANES * m_Channels);
+}
+
+VoiceId VoiceEngine::Play(std::shared_ptr<const DecodedSound> sound, const VoiceParams& params)
+{
+    const size_t channels = sound->Spec().m_Channels.Count();
+
+    if (sound->Spec().m_Rate != m_Spec.m_Rate)
+    {
+        throw std::runtime_error("VoiceEngine plays sounds at its own rate (" + std::to_string(m_Spec.m_Rate) +
+                                 "), not at " + std::to_string(sound->Spec().m_Rate));
+    }
+
+    // mono gets panned onto stereo, any other layout has to be converted beforehand, e.g. by the SoundCache
+    if (channels != m_Channels && !(channels == 1 && m_Channels == 2))
+    {
+        throw std::runtime_error("VoiceEngine plays sounds with its " + std::to_string(m_Channels) +
+                                 " channels, not " + std::to_string(channels));
+    }
+
+    ReleaseFinished();
+
+    const VoiceId id = m_NextId;
+    m_NextId = m_NextId == UINT32_MAX ? 1 : m_NextId + 1;
+
+    if (!Queue({ .m_Type = CommandType::Play, .m_Id = id, .m_Sound = std::move(sound), .m_Params = params }))
+        return 0;
+
+    return id;
+}
+
+void VoiceEngine::Stop(const VoiceId id)
+{
+    ReleaseFinished();
+    Queue({ .m_Type = CommandType::Stop, .m_Id = id });
+}
+
+void VoiceEngine::StopAll()
+{
+    ReleaseFinished();
+    Queue({ .m_Type = CommandType::StopAll });
+}
+
+void VoiceEngine::SetGain(const VoiceId id, const float gain)
+{
+    ReleaseFinished();
+    Queue({ .m_Type = CommandType::SetGain, .m_Id = id, .m_Value = gain });
+}
+
+void VoiceEngine::SetPan(const VoiceId id, const float pan)
+{
+    ReleaseFinished();
+    Queue({ .m_Type = CommandType::SetPan, .m_Id = id, .m_Value = pan });
+}
+
+void VoiceEngine::ReleaseFinished()
+{
+    std::shared_ptr<const DecodedSound> sound;
+    while (m_Finished.Pop(sound))
+        sound.reset();
+}
+
+VoiceEngineStats VoiceEngine::Stats() const noexcept
+{
+    return {
+        m_TriggeredCount.load(std::memory_order_relaxed),
+        m_StolenCount.load(std::memory_order_relaxed),
+        m_RejectedCount.load(std::memory_order_relaxed),
+        m_FinishedCount.load(std::memory_order_relaxed),
+        m_QueueFullCount.load(std::memory_order_relaxed),
+        m_ActiveVoices.load(std::memory_order_relaxed),
+    };
+}
+
+bool VoiceEngine::Queue(Command&& command)
+{
+    if (m_Commands.Push(std::move(command)))
+        return true;
+
+    m_QueueFullCount.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+std::optional<AudioBuffer> VoiceEngine::NextFrame()
+{
+    AudioBuffer frame;
+    NextFrameInto(frame);
+
+    return frame;
+}
+
+bool VoiceEngine::DoNextFrameInto(AudioBuffer& frame)
+{
+    return NextFrameUpTo(frame, SIZE_MAX);
+}
+
+bool VoiceEngine::NextFrameUpTo(AudioBuffer& frame, const size_t maxFrames)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    const size_t frameCount = std::min(m_FrameLength, maxFrames);
+    const size_t sampleCount = frameCount * m_Channels;
+
+    // the frame's storage is reused from one call to the next
+    frame.Reformat(m_Spec, AudioEncoding::Float32, sampleCount * sizeof(float));
+    float* out = frame.View<float>().Samples().data();
+    std::fill_n(out, sampleCount, 0.f);
+
+    ApplyCommands();
+
+    for (Voice& voice : m_Voices)
+    {
+        if (voice.m_Id != 0 && !MixVoice(voice, out, frameCount))
+        {
+            Release(voice);
+            m_FinishedCount.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    if (m_LimiterThreshold.has_value())
+        SoftLimit(out, sampleCount, *m_LimiterThreshold);
+
+    m_Position += frameCount;
+    m_CallbackTiming.Record(std::chrono::steady_clock::now() - start);
+
+    return true;
+}
+
+void VoiceEngine::ApplyCommands()
+{
+    Command command;
+    while (m_Commands.Pop(command))
+    {
+        switch (command.m_Type)
+        {
+        case CommandType::Play:
+            Start(command);
+            break;
+        case CommandType::Stop:
+            if (Voice* voice = FindVoice(command.m_Id))
+            {
+                Release(*voice);
+                m_FinishedCount.fetch_add(1, std::memory_order_relaxed);
+            }
+            break;
+        case CommandType::StopAll:
+            for (Voice& voice : m_Voices)
+            {
+                if (voice.m_Id != 0)
+                {
+                    Release(voice);
+                    m_FinishedCount.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+            break;
+        case CommandType::SetGain:
+        case CommandType::SetPan:
+            if (Voice* voice = FindVoice(command.m_Id))
+            {
+                (command.m_Type == CommandType::SetGain ? voice->m_Gain : voice->m_Pan) = command.m_Value;
+                UpdateGains(*voice);
+            }
+            break;
+        }
+    }
+}
+
+void VoiceEngine::Start(Command& command)
+{
+    Voice* voice = SlotFor(command.m_Params.m_Priority);
+    if (voice == nullptr)
+    {
+        // popping the next command into this one would release the sound here
+        m_Finished.Push(std::move(command.m_Sound));
+        m_RejectedCount.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    if (voice->m_Id != 0)
+    {
+        Release(*voice);
+        m_StolenCount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    voice->m_Id = command.m_Id;
+    voice->m_Sound = std::move(command.m_Sound);
+    voice->m_Channels = voice->m_Sound->Spec().m_Channels.Count();
+    voice->m_Position = 0;
+    voice->m_Loop = command.m_Params.m_Loop;
+    voice->m_Priority = command.m_Params.m_Priority;
+    voice->m_Started = m_Triggers++;
+    voice->m_Gain = command.m_Params.m_Gain;
+    voice->m_Pan = command.m_Params.m_Pan;
+    UpdateGains(*voice);
+
+    m_TriggeredCount.fetch_add(1, std::memory_order_relaxed);
+    m_ActiveVoices.fetch_add(1, std::memory_order_relaxed);
+}
+
+VoiceEngine::Voice* VoiceEngine::FindVoice(const VoiceId id) noexcept
+{
+    if (id == 0)
+        return nullptr;
+
+    const auto it = std::find_if(m_Voices.begin(), m_Voices.end(), [id](const Voice& v) { return v.m_Id == id; });
+    return it == m_Voices.end() ? nullptr : &*it;
+}
+
+VoiceEngine::Voice* VoiceEngine::SlotFor(const int32_t priority) noexcept
+{
+    Voice* victim = nullptr;
+
+    for (Voice& voice : m_Voices)
+    {
+        if (voice.m_Id == 0)
+            return &voice;
+
+        if (victim == nullptr)
+        {
+            victim = &voice;
+            continue;
+        }
+
+        const bool lower = m_Stealing == VoiceStealing::LowestPriority && voice.m_Priority != victim->m_Priority
+                               ? voice.m_Priority < victim->m_Priority
+                               : voice.m_Started < victim->m_Started;
+        if (lower)
+            victim = &voice;
+    }
+
+    if (m_Stealing == VoiceStealing::LowestPriority && victim->m_Priority > priority)
+        return nullptr;
+
+    return victim;
+}
+
+void VoiceEngine::UpdateGains(Voice& voice) const noexcept
+{
+    const auto [left, right] = ComputePanGains(voice.m_Gain, voice.m_Pan, voice.m_Channels, m_Channels);
+
+    voice.m_Left = left;
+    voice.m_Right = right;
+
+    // one gain per output sample over SIMD_LANES frames, so the pattern spans whole vectors
+    std::fill(voice.m_GainPattern.begin(), voice.m_GainPattern.end(), voice.m_Gain);
+    if (m_Channels >= 2)
+    {
+        for (size_t i = 0; i < voice.m_GainPattern.size(); i += m_Channels)
+        {
+            voice.m_GainPattern[i] = left;
+            voice.m_GainPattern[i + 1] = right;
+        }
+    }
+}
+
+void VoiceEngine::Release(Voice& voice) noexcept
+{
+    m_Finished.Push(std::move(voice.m_Sound));
+    voice.m_Id = 0;
+
+    m_ActiveVoices.fetch_sub(1, std::memory_order_relaxed);
+}
+
+bool VoiceEngine::MixVoice(Voice& voice, float* out, const size_t frameCount) noexcept
+{
+    const DecodedSound& sound = *voice.m_Sound;
+    const size_t frames = sound.FrameCount();
+    const bool upmix = voice.m_Channels == 1 && m_Channels == 2;
+
+    size_t done = 0;
+
+    while (done < frameCount)
+    {
+        if (voice.m_Position == frames)
+        {
+            if (!voice.m_Loop || frames == 0)
+                return false;
+
+            voice.m_Position = 0;
+        }
+
+        const size_t count = std::min(frameCount - done, frames - voice.m_Position);
+        const size_t sampleCount = count * voice.m_Channels;
+        const size_t first = voice.m_Position * voice.m_Channels;
+
+        const float* src;
+        if (sound.Encoding() == AudioEncoding::Float32)
+        {
+            src = reinterpret_cast<const float*>(sound.Data()) + first;
+        }
+        else
+        {
+            // at most a frame of the engine's, which m_Converted is sized for
+            ConvertSampleBuffer(sound.Data() + first * GetEffectiveEncodingSize(sound.Encoding()), sound.Encoding(),
+                                m_Converted.data(), AudioEncoding::Float32, sampleCount);
+            src = m_Converted.data();
+        }
+
+        float* dst = out + done * m_Channels;
+
+        if (upmix)
+            MixAddMonoToStereo(dst, src, count, voice.m_Left, voice.m_Right);
+        else
+            MixAdd(dst, src, sampleCount, voice.m_GainPattern.data(), voice.m_GainPattern.size());
+
+        done += count;
+        voice.m_Position += count;
+    }
+
+    return true;
+}
@@ -0,0 +1,198 @@
+#ifndef VOICEENGINE_H
+#define VOICEENGINE_H
+
+#include "AudioMetrics.h"
+#include "SoundCache.h"
+#include "SpscRingBuffer.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+// 0 is never a voice
+using VoiceId = uint32_t;
+
+enum class VoiceStealing
+{
+    // a trigger on a full pool cuts off the voice playing the longest
+    Oldest,
+    // cuts off the lowest priority voice, the oldest among equals, and drops the trigger when every
+    // voice playing outranks it
+    LowestPriority
+};
+
+struct VoiceParams
+{
+    float m_Gain = 1.f;
+    // -1 (left) to 1 (right), see ComputePanGains()
+    float m_Pan = 0.f;
+    int32_t m_Priority = 0;
+    // plays until stopped
+    bool m_Loop = false;
+};
+
+struct VoiceEngineStats
+{
+    uint64_t m_Triggered;
+    // voices cut off to make room for a trigger
+    uint64_t m_Stolen;
+    // triggers dropped because every voice playing outranked them
+    uint64_t m_Rejected;
+    // voices which played to their end or got stopped
+    uint64_t m_Finished;
+    // commands dropped because the queue to the audio thread was full
+    uint64_t m_QueueFull;
+    size_t m_ActiveVoices;
+};
+
+/*! \brief Fire-and-forget playback of short decoded clips, e.g. game sound effects, at a fixed maximum
+           polyphony.
+
+    Voices are slots allocated up front, and play DecodedSounds at the engine's rate and in its layout
+    (or mono on a stereo engine) straight out of their samples. Play(), Stop() and the setters run on the game
+    thread and only queue commands, which the audio thread applies at the start of its next frame
+    through a wait-free queue. Sounds of finished voices go back to the game thread through a second
+    queue to be released there, so that the audio thread never frees a sound either: pulling frames
+    neither allocates nor locks.
+
+    The methods queueing commands have to be called from a single thread, the frames pulled from another.
+*/
+class VoiceEngine : public AudioSource
+{
+public:
+    /*!
+        \param spec rate and layout of the mix
+        \param maxVoices voices playing at once, triggers on a full pool steal one
+        \param frameLength frames produced by every NextFrame(), NextFrameUpTo() may ask for fewer
+        \param commandCapacity commands which can be queued between two frames
+        \param limiterThreshold level above which the sum gets limited, nullopt leaves it unlimited
+    */
+    VoiceEngine(SignalSpec spec, size_t maxVoices = 32, VoiceStealing stealing = VoiceStealing::Oldest,
+                size_t frameLength = 512, size_t commandCapacity = 256,
+                std::optional<float> limiterThreshold = 0.8f);
+
+    // Game thread: starts a voice playing sound. Returns 0 when the command queue is full. Throws when
+    // the sound's rate or layout don't fit the engine.
+    VoiceId Play(std::shared_ptr<const DecodedSound> sound, const VoiceParams& params = {});
+
+    // Game thread. Voices which have already ended are ignored.
+    void Stop(VoiceId id);
+    void StopAll();
+    void SetGain(VoiceId id, float gain);
+    void SetPan(VoiceId id, float pan);
+
+    // Game thread: releases the sounds of voices which have ended. Every other game thread call does
+    // this too, call it now and then when there's nothing else to queue.
+    void ReleaseFinished();
+
+    // safe to call from any thread
+    [[nodiscard]] VoiceEngineStats Stats() const noexcept;
+    // time NextFrameUpTo() takes, recorded on every call
+    [[nodiscard]] DurationHistogramSnapshot CallbackTiming() const noexcept { return m_CallbackTiming.Snapshot(); }
+
+    [[nodiscard]] size_t MaxVoices() const noexcept { return m_Voices.size(); }
+
+    SignalSpec Spec() override { return m_Spec; }
+    AudioEncoding Encoding() override { return AudioEncoding::Float32; }
+
+    std::optional<size_t> TotalSamples() override { return std::nullopt; }
+    std::optional<size_t> CurrentSample() override { return m_Position; }
+
+    std::optional<AudioBuffer> NextFrame() override;
+    bool NextFrameUpTo(AudioBuffer& frame, size_t maxFrames) override;
+
+    // plays silence when no voice is playing
+    bool IsInfallible() override { return true; }
+
+protected:
+    bool DoNextFrameInto(AudioBuffer& frame) override;
+
+private:
+    enum class CommandType : uint8_t
+    {
+        Play,
+        Stop,
+        StopAll,
+        SetGain,
+        SetPan
+    };
+
+    struct Command
+    {
+        CommandType m_Type = CommandType::Stop;
+        VoiceId m_Id = 0;
+        std::shared_ptr<const DecodedSound> m_Sound;
+        VoiceParams m_Params;
+        // the gain or pan of SetGain and SetPan
+        float m_Value = 0.f;
+    };
+
+    struct Voice
+    {
+        // 0 while the slot is free
+        VoiceId m_Id = 0;
+        std::shared_ptr<const DecodedSound> m_Sound;
+        size_t m_Channels = 0;
+        size_t m_Position = 0;
+        bool m_Loop = false;
+        int32_t m_Priority = 0;
+        // order the voices got triggered in, for stealing the oldest
+        uint64_t m_Started = 0;
+
+        float m_Gain = 1.f;
+        float m_Pan = 0.f;
+        float m_Left = 1.f;
+        float m_Right = 1.f;
+        // per output sample gains for MixAdd, sized for the engine's layout up front
+        std::vector<float> m_GainPattern;
+    };
+
+    // queues the command, counting it when the queue is full
+    bool Queue(Command&& command);
+
+    // audio thread
+    void ApplyCommands();
+    void Start(Command& command);
+    [[nodiscard]] Voice* FindVoice(VoiceId id) noexcept;
+    // a free slot, or the voice to steal for a trigger of the given priority, nullptr when there's none
+    [[nodiscard]] Voice* SlotFor(int32_t priority) noexcept;
+    void UpdateGains(Voice& voice) const noexcept;
+    // frees the slot and sends its sound back to the game thread
+    void Release(Voice& voice) noexcept;
+    // adds frameCount frames of the voice to out, returns false once it has ended
+    bool MixVoice(Voice& voice, float* out, size_t frameCount) noexcept;
+
+    SignalSpec m_Spec;
+    size_t m_Channels;
+    VoiceStealing m_Stealing;
+    size_t m_FrameLength;
+    std::optional<float> m_LimiterThreshold;
+
+    // game thread to audio thread, and the sounds of finished voices back. Those always fit: there are
+    // at most the voices playing when the game thread last emptied it, plus the Play() commands queued
+    SpscQueue<Command> m_Commands;
+    SpscQueue<std::shared_ptr<const DecodedSound>> m_Finished;
+
+    // game thread
+    VoiceId m_NextId = 1;
+
+    // audio thread
+    std::vector<Voice> m_Voices;
+    // samples of voices which aren't Float32, converted a frame at a time
+    std::vector<float> m_Converted;
+    uint64_t m_Triggers = 0;
+    size_t m_Position = 0;
+
+    std::atomic<uint64_t> m_TriggeredCount = 0;
+    std::atomic<uint64_t> m_StolenCount = 0;
+    std::atomic<uint64_t> m_RejectedCount = 0;
+    std::atomic<uint64_t> m_FinishedCount = 0;
+    std::atomic<uint64_t> m_QueueFullCount = 0;
+    std::atomic<size_t> m_ActiveVoices = 0;
+
+    DurationHistogram m_CallbackTiming;
+};
+
+#endif //VOICEENGINE_H
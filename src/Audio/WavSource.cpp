@@ -0,0 +1,287 @@
+#include "WavSource.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+constexpr uint16_t WAVE_FORMAT_PCM = 0x0001;
+constexpr uint16_t WAVE_FORMAT_IEEE_FLOAT = 0x0003;
+constexpr uint16_t WAVE_FORMAT_EXTENSIBLE = 0xfffe;
+
+// speaker bits which have a ChannelFlagValue, the mask uses the same bit positions
+constexpr uint32_t KNOWN_SPEAKER_MASK = 0x03ffffff;
+
+// how far ahead of the read position pages get requested, and how far behind they get released
+constexpr size_t READ_AHEAD_WINDOW = 2 * 1024 * 1024;
+constexpr size_t RELEASE_LAG = 8 * 1024 * 1024;
+
+static size_t PageSize()
+{
+    static const auto size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return size;
+}
+
+template <typename T>
+static T ReadLittleEndian(const uint8_t* data)
+{
+    T value = 0;
+    for (size_t i = 0; i < sizeof(T); ++i)
+        value |= static_cast<T>(data[i]) << (8 * i);
+
+    return value;
+}
+
+FileMapping::FileMapping(const std::string& path)
+{
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        throw std::runtime_error("Could not open " + path + ": " + std::strerror(errno));
+
+    struct stat status {};
+    if (fstat(fd, &status) != 0 || status.st_size <= 0)
+    {
+        close(fd);
+        throw std::runtime_error("Could not map " + path + ": empty or unreadable file");
+    }
+
+    m_Size = static_cast<size_t>(status.st_size);
+    void* data = mmap(nullptr, m_Size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    // the mapping keeps the file referenced on its own
+    close(fd);
+
+    if (data == MAP_FAILED)
+        throw std::runtime_error("Could not map " + path + ": " + std::strerror(errno));
+
+    m_Data = static_cast<const uint8_t*>(data);
+    madvise(data, m_Size, MADV_SEQUENTIAL);
+}
+
+FileMapping::~FileMapping()
+{
+    munmap(const_cast<uint8_t*>(m_Data), m_Size);
+}
+
+void FileMapping::WillNeed(const size_t offset, const size_t length) const noexcept
+{
+    const size_t start = offset / PageSize() * PageSize();
+    const size_t end = std::min(offset + length, m_Size);
+
+    if (end > start)
+        madvise(const_cast<uint8_t*>(m_Data) + start, end - start, MADV_WILLNEED);
+}
+
+void FileMapping::DontNeed(const size_t offset, const size_t length) const noexcept
+{
+    // only whole pages inside the range, the ones at its edges may still be in use
+    const size_t start = (offset + PageSize() - 1) / PageSize() * PageSize();
+    const size_t end = std::min(offset + length, m_Size) / PageSize() * PageSize();
+
+    if (end > start)
+        madvise(const_cast<uint8_t*>(m_Data) + start, end - start, MADV_DONTNEED);
+}
+
+WavSource::WavSource(const std::string& path, const size_t frameLength)
+    : m_Mapping(std::make_shared<FileMapping>(path)),
+      m_FrameLength(frameLength)
+{
+    if (frameLength == 0)
+        throw std::runtime_error("WavSource needs a non-zero frame length");
+
+    ParseChunks();
+    AdviseAround(m_DataOffset);
+}
+
+void WavSource::ParseChunks()
+{
+    const uint8_t* file = m_Mapping->Data();
+    const size_t size = m_Mapping->Size();
+
+    if (size < 12 || std::memcmp(file, "RIFF", 4) != 0 || std::memcmp(file + 8, "WAVE", 4) != 0)
+        throw std::runtime_error("Not a RIFF/WAVE file");
+
+    bool haveFormat = false;
+    size_t offset = 12;
+
+    while (offset + 8 <= size)
+    {
+        const uint8_t* chunk = file + offset;
+        const size_t length = ReadLittleEndian<uint32_t>(chunk + 4);
+        const size_t available = std::min(length, size - offset - 8);
+
+        if (std::memcmp(chunk, "fmt ", 4) == 0)
+        {
+            ParseFormat(chunk + 8, available);
+            haveFormat = true;
+        }
+        else if (std::memcmp(chunk, "data", 4) == 0)
+        {
+            if (!haveFormat)
+                throw std::runtime_error("WAVE data chunk comes before its format chunk");
+
+            // files still being written (or truncated) claim more data than there is
+            m_DataOffset = offset + 8;
+            m_TotalFrames = available / m_FrameSize;
+
+            // frames are whole samples apart, so if the first sample is aligned for its type all are
+            const size_t sampleSize = GetEffectiveEncodingSize(m_Encoding);
+            const size_t alignment = sampleSize == 3 ? 1 : sampleSize;
+            m_Aligned = reinterpret_cast<uintptr_t>(file + m_DataOffset) % alignment == 0;
+            return;
+        }
+
+        // chunks are padded to an even length
+        offset += 8 + length + (length & 1);
+    }
+
+    throw std::runtime_error("WAVE file has no data chunk");
+}
+
+void WavSource::ParseFormat(const uint8_t* chunk, const size_t length)
+{
+    if (length < 16)
+        throw std::runtime_error("WAVE format chunk is truncated");
+
+    uint16_t format = ReadLittleEndian<uint16_t>(chunk);
+    const size_t channels = ReadLittleEndian<uint16_t>(chunk + 2);
+    const uint32_t rate = ReadLittleEndian<uint32_t>(chunk + 4);
+    const size_t blockAlign = ReadLittleEndian<uint16_t>(chunk + 12);
+
+    uint32_t channelMask = 0;
+
+    if (format == WAVE_FORMAT_EXTENSIBLE)
+    {
+        if (length < 40)
+            throw std::runtime_error("WAVE_FORMAT_EXTENSIBLE format chunk is truncated");
+
+        channelMask = ReadLittleEndian<uint32_t>(chunk + 20);
+        // the sub format GUID starts with the plain format code
+        format = ReadLittleEndian<uint16_t>(chunk + 24);
+    }
+
+    if (channels == 0 || rate == 0 || blockAlign == 0 || blockAlign % channels != 0)
+        throw std::runtime_error("Malformed WAVE format chunk");
+
+    // the container size decides the encoding, valid bits below it are just zero padding
+    const size_t containerSize = blockAlign / channels;
+
+    if (format == WAVE_FORMAT_PCM)
+    {
+        switch (containerSize)
+        {
+        case 1: m_Encoding = AudioEncoding::UInt8; break;
+        case 2: m_Encoding = AudioEncoding::Int16; break;
+        case 3: m_Encoding = AudioEncoding::Int24; break;
+        case 4: m_Encoding = AudioEncoding::Int32; break;
+        default: throw std::runtime_error("Unsupported PCM sample size " + std::to_string(containerSize));
+        }
+    }
+    else if (format == WAVE_FORMAT_IEEE_FLOAT)
+    {
+        switch (containerSize)
+        {
+        case 4: m_Encoding = AudioEncoding::Float32; break;
+        case 8: m_Encoding = AudioEncoding::Float64; break;
+        default: throw std::runtime_error("Unsupported float sample size " + std::to_string(containerSize));
+        }
+    }
+    else
+    {
+        throw std::runtime_error("Unsupported WAVE format " + std::to_string(format));
+    }
+
+    // ChannelLayout flags use the speaker mask's bit positions, a mask which doesn't describe
+    // every channel falls back on the default assignment in speaker order
+    ChannelLayout layout;
+    channelMask &= KNOWN_SPEAKER_MASK;
+
+    if (static_cast<size_t>(std::popcount(channelMask)) != channels)
+    {
+        if (channels > ALL_CHANNEL_FLAG_VALUES.size())
+            throw std::runtime_error("Unsupported WAVE channel count " + std::to_string(channels));
+
+        channelMask = (1u << channels) - 1;
+    }
+
+    for (const auto flag : ALL_CHANNEL_FLAG_VALUES)
+        layout.SetFlagState(flag, (channelMask & static_cast<uint32_t>(flag)) != 0);
+
+    m_Spec = { rate, layout };
+    m_FrameSize = blockAlign;
+}
+
+std::optional<AudioBuffer> WavSource::NextFrame()
+{
+    AudioBuffer frame;
+    if (!NextFrameInto(frame))
+        return std::nullopt;
+
+    return frame;
+}
+
+bool WavSource::DoNextFrameInto(AudioBuffer& frame)
+{
+    return NextFrameUpTo(frame, SIZE_MAX);
+}
+
+bool WavSource::NextFrameUpTo(AudioBuffer& frame, const size_t maxFrames)
+{
+    const size_t frameCount = std::min({ m_FrameLength, maxFrames, m_TotalFrames - m_Position });
+    if (frameCount == 0)
+        return false;
+
+    const size_t offset = m_DataOffset + m_Position * m_FrameSize;
+    const std::span samples(m_Mapping->Data() + offset, frameCount * m_FrameSize);
+
+    // a misaligned data chunk would hand out misaligned typed views, those frames get copied
+    if (m_Aligned)
+    {
+        frame.Alias(m_Mapping, samples, m_Spec, m_Encoding);
+    }
+    else
+    {
+        frame.Reformat(m_Spec, m_Encoding, samples.size());
+        std::memcpy(frame.Data(), samples.data(), samples.size());
+    }
+
+    m_Position += frameCount;
+    AdviseAround(offset + samples.size());
+
+    return true;
+}
+
+void WavSource::SeekTo(const size_t sample)
+{
+    m_Position = std::min(sample, m_TotalFrames);
+
+    // read-ahead starts over from the new position
+    const size_t offset = m_DataOffset + m_Position * m_FrameSize;
+    m_AdvisedUntil = offset;
+    m_ReleasedUntil = std::min(m_ReleasedUntil, offset);
+    AdviseAround(offset);
+}
+
+void WavSource::AdviseAround(const size_t offset)
+{
+    // hints go out a window at a time rather than on every frame
+    if (offset + READ_AHEAD_WINDOW / 2 >= m_AdvisedUntil)
+    {
+        const size_t start = std::max(offset, m_AdvisedUntil);
+        m_AdvisedUntil = offset + READ_AHEAD_WINDOW;
+        m_Mapping->WillNeed(start, m_AdvisedUntil - start);
+    }
+
+    if (offset > m_ReleasedUntil + RELEASE_LAG + READ_AHEAD_WINDOW)
+    {
+        const size_t end = offset - RELEASE_LAG;
+        m_Mapping->DontNeed(m_ReleasedUntil, end - m_ReleasedUntil);
+        m_ReleasedUntil = end;
+    }
+}
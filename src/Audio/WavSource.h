@@ -0,0 +1,83 @@
+#ifndef WAVSOURCE_H
+#define WAVSOURCE_H
+
+#include "AudioSource.h"
+
+#include <memory>
+
+// Read-only mapping of a whole file, unmapped once the last frame referencing it is gone.
+class FileMapping
+{
+public:
+    explicit FileMapping(const std::string& path);
+
+    FileMapping(const FileMapping&) = delete;
+    FileMapping& operator=(const FileMapping&) = delete;
+
+    ~FileMapping();
+
+    [[nodiscard]] const uint8_t* Data() const noexcept { return m_Data; }
+    [[nodiscard]] size_t Size() const noexcept { return m_Size; }
+
+    // Tells the kernel that [offset, offset + length) will be read soon.
+    void WillNeed(size_t offset, size_t length) const noexcept;
+    // Lets the kernel drop the pages of [offset, offset + length), they get read back in if touched again.
+    void DontNeed(size_t offset, size_t length) const noexcept;
+
+private:
+    const uint8_t* m_Data = nullptr;
+    size_t m_Size = 0;
+};
+
+// RIFF/WAVE source (PCM, IEEE float and WAVE_FORMAT_EXTENSIBLE) over a memory mapped file. Frames
+// alias the mapping instead of copying out of it, and the pages are hinted for sequential reading,
+// so a large file streams through the page cache without staying resident.
+class WavSource : public AudioSource
+{
+public:
+    // frameLength is the number of frames handed out per NextFrame(), NextFrameUpTo() may ask for fewer
+    explicit WavSource(const std::string& path, size_t frameLength = 4096);
+
+    SignalSpec Spec() override { return m_Spec; }
+    AudioEncoding Encoding() override { return m_Encoding; }
+
+    std::optional<size_t> TotalSamples() override { return m_TotalFrames; }
+    std::optional<size_t> CurrentSample() override { return m_Position; }
+
+    std::optional<AudioBuffer> NextFrame() override;
+    bool NextFrameUpTo(AudioBuffer& frame, size_t maxFrames) override;
+
+    bool IsInfallible() override { return true; }
+    bool IsSeekable() override { return true; }
+
+protected:
+    void SeekTo(size_t sample) override;
+    bool DoNextFrameInto(AudioBuffer& frame) override;
+
+private:
+    void ParseChunks();
+    void ParseFormat(const uint8_t* chunk, size_t length);
+
+    // hints the window ahead of the read position in, and the one far behind it out
+    void AdviseAround(size_t offset);
+
+    std::shared_ptr<FileMapping> m_Mapping;
+
+    SignalSpec m_Spec {};
+    AudioEncoding m_Encoding = AudioEncoding::Int16;
+    size_t m_FrameSize = 0;
+
+    size_t m_DataOffset = 0;
+    size_t m_TotalFrames = 0;
+    // samples which aren't aligned for their type in the mapping get copied out instead
+    bool m_Aligned = true;
+
+    size_t m_FrameLength;
+    size_t m_Position = 0;
+
+    // end of the region already hinted with WillNeed, and start of the one not released yet
+    size_t m_AdvisedUntil = 0;
+    size_t m_ReleasedUntil = 0;
+};
+
+#endif //WAVSOURCE_H
@@ -1,4 +1,5 @@
 #include "CameraPerspective.h"
+#include "Audio/Spatializer.h"
 #include <cmath>
 #include <glm/ext/quaternion_geometric.hpp>
 #include <glm/geometric.hpp>
@@ -18,12 +19,33 @@ glm::vec3 CameraPerspective::GetFrontVector() const
     });
 }
 
+glm::vec3 CameraPerspective::GetRightVector() const
+{
+    return glm::normalize(glm::cross(GetFrontVector(), c_UpVector));
+}
+
+glm::vec3 CameraPerspective::GetUpVector() const
+{
+    return glm::normalize(glm::cross(GetRightVector(), GetFrontVector()));
+}
+
+ListenerPose CameraPerspective::GetListenerPose() const
+{
+    const auto front = GetFrontVector();
+    const auto up = GetUpVector();
+
+    return {
+        { m_Translation.x, m_Translation.y, m_Translation.z },
+        { front.x, front.y, front.z },
+        { up.x, up.y, up.z },
+    };
+}
+
 glm::mat4 CameraPerspective::GetMVPMatrix(glm::mat4 modelMatrix) const
 {
     const auto& cameraPos = m_Translation;
     const auto cameraFront = GetFrontVector();
-    const auto cameraRight = glm::normalize(glm::cross(cameraFront, c_UpVector));
-    const auto cameraUp = glm::normalize(glm::cross(cameraRight, cameraFront));
+    const auto cameraUp = GetUpVector();
 
     return glm::perspective(m_FieldOfView, m_AspectRatio, m_NearPlane, m_FarPlane) *
         (glm::lookAt(m_Translation, m_Translation + cameraFront, cameraUp)) *
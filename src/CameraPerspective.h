@@ -5,6 +5,8 @@
 
 const glm::vec3 c_UpVector{ 0.F, 1.F, 0.F };
 
+struct ListenerPose;
+
 struct CameraPerspective
 {
     // camera parameters
@@ -20,6 +22,11 @@ struct CameraPerspective
     // methods
     [[nodiscard]] glm::mat4 GetMVPMatrix(glm::mat4 modelMatrix) const;
     [[nodiscard]] glm::vec3 GetFrontVector() const;
+    [[nodiscard]] glm::vec3 GetRightVector() const;
+    [[nodiscard]] glm::vec3 GetUpVector() const;
+
+    // the camera as the listener of a Spatializer
+    [[nodiscard]] ListenerPose GetListenerPose() const;
 };
 
 #endif // CAMERA_H
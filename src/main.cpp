@@ -160,7 +160,7 @@ int main()
     // std::cout << std::filesystem::current_path() << '\n';
     // InitSDLAudioSubsystem();
 
-    // std::unique_ptr<AudioOutput> audioOutput = std::make_unique<SdlAudioOutput>(
+    // auto audioOutput = std::make_unique<SdlCallbackAudioOutput>(
     //     SignalSpec{
     //         .m_Rate = 48000,
     //         .m_Channels = ChannelLayout(ChannelLayoutType::STEREO)
@@ -172,12 +172,12 @@ int main()
     //     .m_Channels = ChannelLayout(ChannelLayoutType::STEREO)
     // }, 440.f);
 
-    // auto frame = audioSource->NextFrame();
+    // // the device pulls from the source on its own thread
+    // audioOutput->SetSource(audioSource);
 
-    // while (frame != std::nullopt && !g_ShouldQuit)
+    // while (!audioOutput->IsFinished() && !g_ShouldQuit)
     // {
-    //     audioOutput->Write(*frame);
-    //     frame = audioSource->NextFrame();
+    //     SDL_Delay(10);
     // }
 
     // audioOutput.reset();
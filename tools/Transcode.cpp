@@ -0,0 +1,401 @@
+// Converts every WAV and Ogg Opus file under a directory into WAV files in the device's format, through
+// file source -> SourceResampler -> SourceReencoder -> FileAudioOutput, on as many threads as asked for.
+// Each thread only ever holds the file it's working on, with a staging buffer of --buffer-kb, so memory
+// stays bounded however many files there are. Files whose channels don't match the target layout are
+// skipped rather than remixed, and every output gets read back to check its format and length.
+//
+// usage: Transcode <input directory> <output directory> [--rate 48000] [--encoding s16] [--layout stereo]
+//                  [--quality medium] [--dither tpdf] [--threads 0] [--buffer-kb 1024]
+//
+// encodings: u8 s16 s24 s32 f32 f64, layouts: mono stereo 2.1 5.1, qualities: fast medium high,
+// dither: none tpdf shaped, 0 threads meaning one per hardware thread.
+//
+// Exits with 0 when every file got converted, 2 when a file didn't match the target spec, 1 on any
+// other failure.
+
+#include "Audio/OfflineRenderer.h"
+#include "Audio/OpusSource.h"
+#include "Audio/WavSource.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// thrown for inputs, and outputs read back, whose format isn't the one asked for
+class SpecMismatch : public std::runtime_error
+{
+public:
+    using std::runtime_error::runtime_error;
+};
+
+struct TranscodeOptions
+{
+    fs::path m_Input;
+    fs::path m_Output;
+
+    SignalSpec m_Spec { 48000, ChannelLayout(ChannelLayoutType::STEREO) };
+    AudioEncoding m_Encoding = AudioEncoding::Int16;
+    ResamplerQuality m_Quality = ResamplerQuality::Medium;
+    DitherMode m_Dither = DitherMode::Tpdf;
+    size_t m_Threads = 0;
+    size_t m_BufferBytes = 1024 * 1024;
+};
+
+struct TranscodeFile
+{
+    fs::path m_Input;
+    fs::path m_Output;
+    // the input relative to the input directory, for reporting
+    std::string m_Name;
+    uintmax_t m_Bytes;
+    // set when opening the output created it, so that only files this run brought into being get cleaned up
+    bool m_Created = false;
+};
+
+static const std::map<std::string, AudioEncoding> ENCODINGS = {
+    { "u8", AudioEncoding::UInt8 },    { "s16", AudioEncoding::Int16 },   { "s24", AudioEncoding::Int24 },
+    { "s32", AudioEncoding::Int32 },   { "f32", AudioEncoding::Float32 }, { "f64", AudioEncoding::Float64 },
+};
+
+static const std::map<std::string, ChannelLayoutType> LAYOUTS = {
+    { "mono", ChannelLayoutType::MONO },
+    { "stereo", ChannelLayoutType::STEREO },
+    { "2.1", ChannelLayoutType::TWO_POINT_FIVE },
+    { "5.1", ChannelLayoutType::FIVE_POINT_FIVE },
+};
+
+static const std::map<std::string, ResamplerQuality> QUALITIES = {
+    { "fast", ResamplerQuality::Fast },
+    { "medium", ResamplerQuality::Medium },
+    { "high", ResamplerQuality::High },
+};
+
+static const std::map<std::string, DitherMode> DITHERS = {
+    { "none", DitherMode::None },
+    { "tpdf", DitherMode::Tpdf },
+    { "shaped", DitherMode::NoiseShaped },
+};
+
+template <typename T>
+static T Lookup(const std::map<std::string, T>& values, const std::string& option, const std::string& name)
+{
+    const auto found = values.find(name);
+    if (found == values.end())
+        throw std::runtime_error("Unknown " + option + " '" + name + "'");
+
+    return found->second;
+}
+
+static size_t ParseCount(const std::string& option, const std::string& value)
+{
+    char* end = nullptr;
+    const unsigned long long count = std::strtoull(value.c_str(), &end, 10);
+    if (value.empty() || *end != '\0')
+        throw std::runtime_error("Expected a number for " + option + ", got '" + value + "'");
+
+    return static_cast<size_t>(count);
+}
+
+static TranscodeOptions ParseOptions(const int argc, char** argv)
+{
+    if (argc < 3)
+        throw std::runtime_error("Expected an input and an output directory");
+
+    TranscodeOptions options;
+    options.m_Input = argv[1];
+    options.m_Output = argv[2];
+
+    for (int i = 3; i < argc; i += 2)
+    {
+        const std::string option = argv[i];
+        if (i + 1 >= argc)
+            throw std::runtime_error("Missing a value for " + option);
+
+        const std::string value = argv[i + 1];
+
+        if (option == "--rate")
+            options.m_Spec.m_Rate = static_cast<uint32_t>(ParseCount(option, value));
+        else if (option == "--encoding")
+            options.m_Encoding = Lookup(ENCODINGS, "encoding", value);
+        else if (option == "--layout")
+            options.m_Spec.m_Channels = ChannelLayout(Lookup(LAYOUTS, "layout", value));
+        else if (option == "--quality")
+            options.m_Quality = Lookup(QUALITIES, "quality", value);
+        else if (option == "--dither")
+            options.m_Dither = Lookup(DITHERS, "dither", value);
+        else if (option == "--threads")
+            options.m_Threads = ParseCount(option, value);
+        else if (option == "--buffer-kb")
+            options.m_BufferBytes = std::max<size_t>(ParseCount(option, value), 1) * 1024;
+        else
+            throw std::runtime_error("Unknown option " + option);
+    }
+
+    if (options.m_Spec.m_Rate == 0)
+        throw std::runtime_error("The rate can't be 0");
+
+    if (!fs::is_directory(options.m_Input))
+        throw std::runtime_error(options.m_Input.string() + " isn't a directory");
+
+    return options;
+}
+
+static std::string Extension(const fs::path& path)
+{
+    std::string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](const unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+    return extension;
+}
+
+static bool IsInput(const fs::path& path)
+{
+    const std::string extension = Extension(path);
+    return extension == ".wav" || extension == ".opus" || extension == ".ogg";
+}
+
+// every input under the input directory, mirrored into the output directory as WAV files
+static std::vector<TranscodeFile> FindFiles(const TranscodeOptions& options)
+{
+    std::vector<TranscodeFile> files;
+
+    for (const fs::directory_entry& entry : fs::recursive_directory_iterator(options.m_Input))
+    {
+        if (!entry.is_regular_file() || !IsInput(entry.path()))
+            continue;
+
+        const fs::path relative = fs::relative(entry.path(), options.m_Input);
+        fs::path output = options.m_Output / relative;
+        output.replace_extension(".wav");
+
+        files.push_back({ entry.path(), output, relative.string(), entry.file_size() });
+    }
+
+    // the largest files go first, so that no thread is left with a long one once the rest are done
+    std::sort(files.begin(), files.end(), [](const TranscodeFile& a, const TranscodeFile& b) {
+        return a.m_Bytes != b.m_Bytes ? a.m_Bytes > b.m_Bytes : a.m_Input < b.m_Input;
+    });
+
+    return files;
+}
+
+// the name --layout takes for a layout, or its speaker mask
+static std::string DescribeLayout(const ChannelLayout& layout)
+{
+    for (const auto& [name, type] : LAYOUTS)
+    {
+        if (ChannelLayout(type) == layout)
+            return name;
+    }
+
+    uint32_t mask = 0;
+    for (const ChannelFlagValue flag : layout.GetAllEnabledFlags())
+        mask |= static_cast<uint32_t>(flag);
+
+    char buffer[64];
+    std::snprintf(buffer, sizeof(buffer), "%zu channels with speaker mask 0x%x", layout.Count(), mask);
+    return buffer;
+}
+
+static std::shared_ptr<AudioSource> OpenInput(const fs::path& path)
+{
+    if (Extension(path) == ".wav")
+        return std::make_shared<WavSource>(path.string());
+
+    return std::make_shared<OpusSource>(path.string());
+}
+
+static OfflineRenderJob MakeJob(const TranscodeOptions& options, TranscodeFile& file)
+{
+    std::shared_ptr<AudioSource> source = OpenInput(file.m_Input);
+    const SignalSpec spec = source->Spec();
+
+    // the samples get written unchanged, a layout which merely has as many channels would mislabel them
+    if (spec.m_Channels != options.m_Spec.m_Channels)
+    {
+        throw SpecMismatch("input is " + DescribeLayout(spec.m_Channels) + ", the target layout is " +
+                           DescribeLayout(options.m_Spec.m_Channels));
+    }
+
+    if (fs::exists(file.m_Output) && fs::equivalent(file.m_Input, file.m_Output))
+        throw std::runtime_error("would overwrite its own input");
+
+    if (spec.m_Rate != options.m_Spec.m_Rate)
+    {
+        // resampled in float, so that the only requantization is the dithered one at the end
+        if (source->Encoding() != AudioEncoding::Float32)
+            source = std::make_shared<SourceReencoder>(source, AudioEncoding::Float32);
+
+        source = std::make_shared<SourceResampler>(source, SignalSpec { options.m_Spec.m_Rate, spec.m_Channels },
+                                                   options.m_Quality);
+    }
+
+    if (source->Encoding() != options.m_Encoding)
+        source = std::make_shared<SourceReencoder>(source, options.m_Encoding, options.m_Dither);
+
+    fs::create_directories(file.m_Output.parent_path());
+
+    // the output gets opened for truncation, an existing file is overwritten rather than created
+    const bool existed = fs::exists(file.m_Output);
+    auto output = std::make_shared<FileAudioOutput>(file.m_Output.string(), source->Spec(), options.m_Encoding,
+                                                    FileFormat::Wav, options.m_BufferBytes);
+    file.m_Created = !existed;
+
+    return { source, output, std::nullopt };
+}
+
+// reads the output's header back and checks it against what was asked for
+static void Verify(const TranscodeOptions& options, const TranscodeFile& file, const size_t frames)
+{
+    WavSource written(file.m_Output.string());
+
+    if (written.Spec().m_Rate != options.m_Spec.m_Rate ||
+        written.Spec().m_Channels != options.m_Spec.m_Channels || written.Encoding() != options.m_Encoding ||
+        written.TotalSamples() != frames)
+    {
+        throw SpecMismatch("output came out as " + std::to_string(*written.TotalSamples()) + " frames at " +
+                           std::to_string(written.Spec().m_Rate) + " Hz, " + DescribeLayout(written.Spec().m_Channels));
+    }
+}
+
+static std::string Describe(const std::exception_ptr& error)
+{
+    try
+    {
+        std::rethrow_exception(error);
+    }
+    catch (const std::exception& e)
+    {
+        return e.what();
+    }
+    catch (...)
+    {
+        return "unknown error";
+    }
+}
+
+static bool IsMismatch(const std::exception_ptr& error)
+{
+    try
+    {
+        std::rethrow_exception(error);
+    }
+    catch (const SpecMismatch&)
+    {
+        return true;
+    }
+    catch (...)
+    {
+        return false;
+    }
+}
+
+int main(const int argc, char** argv)
+{
+    TranscodeOptions options;
+
+    try
+    {
+        options = ParseOptions(argc, argv);
+    }
+    catch (const std::exception& e)
+    {
+        std::fprintf(stderr, "%s\n\nusage: %s <input directory> <output directory> [--rate 48000] [--encoding s16] "
+                             "[--layout stereo] [--quality medium] [--dither tpdf] [--threads 0] [--buffer-kb 1024]\n",
+                     e.what(), argv[0]);
+        return 1;
+    }
+
+    std::vector<TranscodeFile> files;
+
+    try
+    {
+        files = FindFiles(options);
+    }
+    catch (const fs::filesystem_error& e)
+    {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+
+    std::mutex printMutex;
+    size_t finished = 0;
+    size_t mismatches = 0;
+    size_t failures = 0;
+
+    const auto onFinished = [&](const size_t index, const OfflineRenderStats& stats, std::exception_ptr error) {
+        const TranscodeFile& file = files[index];
+
+        if (!error)
+        {
+            try
+            {
+                Verify(options, file, stats.m_Frames);
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+        }
+
+        // Don't leave half a file behind for the next step of the pipeline to pick up. Only a file this job
+        // created though: an output which was there before stays, overwritten as far as the job got, and
+        // the input is never touched.
+        if (error && file.m_Created)
+        {
+            std::error_code ignored;
+            if (!fs::equivalent(file.m_Input, file.m_Output, ignored))
+                fs::remove(file.m_Output, ignored);
+        }
+
+        const std::string& name = file.m_Name;
+
+        std::lock_guard lock(printMutex);
+        ++finished;
+
+        if (error)
+        {
+            const bool mismatch = IsMismatch(error);
+            mismatches += mismatch ? 1 : 0;
+            failures += mismatch ? 0 : 1;
+
+            std::fprintf(stderr, "[%zu/%zu] %s: %s%s\n", finished, files.size(), name.c_str(),
+                         mismatch ? "spec mismatch, " : "", Describe(error).c_str());
+            return;
+        }
+
+        const double megabytes = static_cast<double>(stats.m_Frames * options.m_Spec.m_Channels.Count() *
+                                                     GetEffectiveEncodingSize(options.m_Encoding)) / 1e6;
+
+        std::printf("[%zu/%zu] %s: %.2f s of audio in %.3f s, %.1fx realtime, %.1f MB/s\n", finished, files.size(),
+                    name.c_str(), stats.m_AudioSeconds, stats.m_WallSeconds, stats.m_RealtimeFactor,
+                    stats.m_WallSeconds > 0. ? megabytes / stats.m_WallSeconds : 0.);
+    };
+
+    const OfflineRenderReport report = RenderOffline(
+        files.size(), [&](const size_t index) { return MakeJob(options, files[index]); }, options.m_Threads,
+        onFinished);
+
+    std::printf("%zu files, %zu converted, %zu mismatched, %zu failed; %.1f s of audio in %.2f s, %.1fx realtime\n",
+                files.size(), files.size() - mismatches - failures, mismatches, failures, report.m_Total.m_AudioSeconds,
+                report.m_Total.m_WallSeconds, report.m_Total.m_RealtimeFactor);
+
+    if (mismatches > 0)
+        return 2;
+
+    return failures > 0 ? 1 : 0;
+}